@@ -1,67 +1,367 @@
 #include "ActionCommandQueue.h"
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
 
 ActionCommandQueue::ActionCommandQueue(QObject* parent)
     : QObject(parent)
 {
+    m_clock.start();
 }
 
-uint32_t ActionCommandQueue::queueCommand(const patrol::ActionCommand& cmd)
+bool ActionConsumerFilter::matches(const patrol::ActionCommand& cmd, quint32 targetSession) const
 {
-    QMutexLocker lock(&m_mutex);
+    if (sessionId != 0 && targetSession != 0 && sessionId != targetSession) {
+        return false;
+    }
+
+    if (cmd.type() != patrol::ActionCommand::Type::TRIGGER_EVENT) {
+        return controlCommands;
+    }
+
+    if (eventRanges.isEmpty()) {
+        return true;
+    }
+    const quint32 eventId = cmd.eventId();
+    for (const ActionEventRange& range : eventRanges) {
+        if (eventId >= range.first && eventId <= range.last) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    patrol::ActionCommand cmdCopy = cmd;
-    uint32_t id = m_nextCommandId++;
-    cmdCopy.setCommandId(id);
+uint32_t ActionCommandQueue::queueCommand(const patrol::ActionCommand& cmd, qint64 detectedUs, quint32 targetSession)
+{
+    uint32_t id;
+    AvailableHook hook;
+    {
+        QMutexLocker lock(&m_mutex);
 
-    m_queue.enqueue(cmdCopy);
+        id = m_nextCommandId++;
+        LogEntry entry{ m_nextSequence++, cmd, detectedUs, targetSession };
+        entry.command.setCommandId(id);
+        m_log.append(entry);
+
+        // Over the bound: the oldest entry goes even if someone still wants it
+        if (m_log.size() > ACTION_LOG_MAX) {
+            const LogEntry& oldest = m_log.first();
+            for (Consumer& consumer : m_consumers) {
+                if (consumer.cursor <= oldest.sequence) {
+                    if (consumer.filter.matches(oldest.command, oldest.targetSession)) {
+                        consumer.dropped++;
+                    }
+                    consumer.cursor = oldest.sequence + 1;
+                }
+            }
+            m_log.removeFirst();
+        }
+        trimLog();
+
+        m_pendingWait.wakeAll();
+        hook = m_availableHook;
+    }
+
+    if (hook) {
+        hook();
+    }
+    emit commandsQueued();
     return id;
 }
 
-QList<patrol::ActionCommand> ActionCommandQueue::takePending()
+void ActionCommandQueue::setAvailableHook(AvailableHook hook)
+{
+    QMutexLocker lock(&m_mutex);
+    m_availableHook = std::move(hook);
+}
+
+void ActionCommandQueue::registerConsumer(quintptr consumerId, const ActionConsumerFilter& filter)
+{
+    QMutexLocker lock(&m_mutex);
+    consumerFor(consumerId).filter = filter;
+    trimLog();
+}
+
+void ActionCommandQueue::unregisterConsumer(quintptr consumerId)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_consumers.remove(consumerId)) {
+        trimLog();
+    }
+}
+
+ActionBatch ActionCommandQueue::takeFor(quintptr consumerId, Delivery delivery, int maxCommands, int timeoutMs)
 {
     QMutexLocker lock(&m_mutex);
+    Consumer* consumer = &consumerFor(consumerId);
+
+    if (timeoutMs > 0) {
+        QDeadlineTimer deadline(timeoutMs);
+        while (!hasPendingLocked(*consumer) && !deadline.hasExpired()) {
+            m_pendingWait.wait(&m_mutex, deadline);
+            // Re-resolve: the consumer may have been removed while we waited
+            auto it = m_consumers.find(consumerId);
+            if (it == m_consumers.end()) {
+                return ActionBatch();
+            }
+            consumer = &it.value();
+        }
+    }
+
+    ActionBatch batch;
+    batch.dropped = consumer->dropped;
+    consumer->dropped = 0;
+
+    if (!m_log.isEmpty()) {
+        const quint64 base = m_log.first().sequence;
+        qsizetype index = consumer->cursor > base ? static_cast<qsizetype>(consumer->cursor - base) : 0;
+        for (; index < m_log.size(); index++) {
+            const LogEntry& entry = m_log.at(index);
+            if (!consumer->filter.matches(entry.command, entry.targetSession)) {
+                continue;
+            }
+            if (maxCommands > 0 && batch.commands.size() >= maxCommands) {
+                batch.more = true;
+                break;
+            }
+            batch.commands.append(entry.command);
+            recordDelivery(delivery, entry.detectedUs);
+        }
+        consumer->cursor = (index < m_log.size()) ? m_log.at(index).sequence : m_nextSequence;
+    }
 
-    QList<patrol::ActionCommand> result;
-    while (!m_queue.isEmpty()) {
-        result.append(m_queue.dequeue());
+    trimLog();
+    return batch;
+}
+
+QList<patrol::ActionCommand> ActionCommandQueue::takePending(Delivery delivery, int timeoutMs)
+{
+    return takeFor(ACTION_CONSUMER_ANONYMOUS, delivery, 0, timeoutMs).commands;
+}
+
+bool ActionCommandQueue::hasPending(quintptr consumerId) const
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_consumers.constFind(consumerId);
+    if (it == m_consumers.constEnd()) {
+        // Not registered yet: it would start at the oldest entry if it were the first
+        return m_consumers.isEmpty() && !m_log.isEmpty();
     }
-    return result;
+    return hasPendingLocked(it.value());
 }
 
-bool ActionCommandQueue::hasPending() const
+int ActionCommandQueue::logLength() const
 {
     QMutexLocker lock(&m_mutex);
-    return !m_queue.isEmpty();
+    return m_log.size();
 }
 
-uint32_t ActionCommandQueue::triggerEvent(uint32_t eventId)
+bool ActionCommandQueue::hasPendingLocked(const Consumer& consumer) const
 {
+    // Caller holds m_mutex
+    if (m_log.isEmpty() || consumer.cursor >= m_nextSequence) {
+        return false;
+    }
+    const quint64 base = m_log.first().sequence;
+    for (qsizetype index = consumer.cursor > base ? static_cast<qsizetype>(consumer.cursor - base) : 0;
+         index < m_log.size(); index++) {
+        const LogEntry& entry = m_log.at(index);
+        if (consumer.filter.matches(entry.command, entry.targetSession)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ActionCommandQueue::Consumer& ActionCommandQueue::consumerFor(quintptr consumerId)
+{
+    // Caller holds m_mutex
+    auto it = m_consumers.find(consumerId);
+    if (it != m_consumers.end()) {
+        return it.value();
+    }
+
+    Consumer consumer;
+    consumer.cursor = (m_consumers.isEmpty() && !m_log.isEmpty()) ? m_log.first().sequence : m_nextSequence;
+    return m_consumers.insert(consumerId, consumer).value();
+}
+
+void ActionCommandQueue::trimLog()
+{
+    // Caller holds m_mutex. With no consumers at all the log is kept (up to
+    // the bound) for whoever registers first.
+    if (m_consumers.isEmpty()) {
+        return;
+    }
+
+    while (!m_log.isEmpty()) {
+        const LogEntry& oldest = m_log.first();
+        for (const Consumer& consumer : std::as_const(m_consumers)) {
+            if (consumer.cursor <= oldest.sequence
+                && consumer.filter.matches(oldest.command, oldest.targetSession)) {
+                return;
+            }
+        }
+        m_log.removeFirst();
+    }
+}
+
+uint32_t ActionCommandQueue::triggerEvent(uint32_t eventId, qint64 detectedUs)
+{
+    patrol::ActionCommand cmd;
+    cmd.setType(patrol::ActionCommand::Type::TRIGGER_EVENT);
+    cmd.setEventId(eventId);
+    return queueCommand(cmd, detectedUs);
+}
+
+uint32_t ActionCommandQueue::triggerValue(uint32_t eventId, int value, qint64 detectedUs)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+
+        if (!m_log.isEmpty()) {
+            LogEntry& newest = m_log.last();
+            bool unread = newest.command.type() == patrol::ActionCommand::Type::TRIGGER_EVENT
+                          && newest.command.eventId() == eventId;
+            for (const Consumer& consumer : std::as_const(m_consumers)) {
+                unread = unread && consumer.cursor <= newest.sequence;
+            }
+            if (unread) {
+                newest.command.setIndex(value);
+                return newest.command.commandId();
+            }
+        }
+    }
+
     patrol::ActionCommand cmd;
     cmd.setType(patrol::ActionCommand::Type::TRIGGER_EVENT);
     cmd.setEventId(eventId);
-    return queueCommand(cmd);
+    cmd.setIndex(value);
+    return queueCommand(cmd, detectedUs);
 }
+
+LatencyHistogram& ActionCommandQueue::deliveryLatency(Delivery delivery)
+{
+    return delivery == Delivery::Push ? m_pushLatency : m_pollLatency;
+}
+
+qint64 ActionCommandQueue::monotonicUs()
+{
+    // Absolute monotonic time, so stamps taken by different objects compare
+    return QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs() / 1000;
+}
+
+void ActionCommandQueue::recordDelivery(Delivery delivery, qint64 detectedUs)
+{
+    // Caller holds m_mutex
+    if (detectedUs <= 0) {
+        return;
+    }
+    deliveryLatency(delivery).record(static_cast<quint64>(qMax<qint64>(0, monotonicUs() - detectedUs)));
+}
+
 void ActionCommandQueue::storeResult(uint32_t commandId, const patrol::ActionCommandResultRequest& result)
 {
     QMutexLocker lock(&m_mutex);
-    m_results[commandId] = result;
-    m_resultWait.wakeAll();
+    evictExpired(false);
+
+    ActionCompletionHandle completion = completionFor(commandId);
+    completion->m_result = result;
+    completion->m_ready = true;
+    completion->m_expiresAt = m_clock.elapsed() + ACTION_RESULT_TTL_MS;
+    completion->m_done.wakeAll();
+}
+
+ActionCompletionHandle ActionCommandQueue::expectResult(uint32_t commandId)
+{
+    QMutexLocker lock(&m_mutex);
+    evictExpired(false);
+    return completionFor(commandId);
+}
+
+bool ActionCommandQueue::waitForResult(const ActionCompletionHandle& handle,
+                                       patrol::ActionCommandResultRequest& outResult, int timeoutMs)
+{
+    if (!handle) {
+        return false;
+    }
+
+    QMutexLocker lock(&m_mutex);
+
+    QDeadlineTimer deadline(qMax(0, timeoutMs));
+    handle->m_waiters++;
+    while (!handle->m_ready && !deadline.hasExpired()) {
+        handle->m_done.wait(&m_mutex, deadline);
+    }
+    handle->m_waiters--;
+
+    if (!handle->m_ready) {
+        return false;
+    }
+
+    // The result goes to one caller
+    outResult = handle->m_result;
+    auto it = m_completions.constFind(handle->m_commandId);
+    if (it != m_completions.constEnd() && it.value() == handle) {
+        m_completions.erase(it);
+    }
+    return true;
 }
 
 bool ActionCommandQueue::waitForResult(uint32_t commandId, patrol::ActionCommandResultRequest& outResult, int timeoutMs)
+{
+    return waitForResult(expectResult(commandId), outResult, timeoutMs);
+}
+
+int ActionCommandQueue::storedResultCount() const
 {
     QMutexLocker lock(&m_mutex);
+    return m_completions.size();
+}
 
-    QElapsedTimer timer;
-    timer.start();
+ActionCompletionHandle ActionCommandQueue::completionFor(uint32_t commandId)
+{
+    // Caller holds m_mutex
+    ActionCompletionHandle completion = m_completions.value(commandId);
+    if (!completion) {
+        if (m_completions.size() >= ACTION_RESULT_MAX) {
+            evictExpired(true);
+        }
+        completion = ActionCompletionHandle(new ActionCompletion(commandId));
+        completion->m_expiresAt = m_clock.elapsed() + ACTION_RESULT_TTL_MS;
+        m_completions.insert(commandId, completion);
+    }
+    return completion;
+}
 
-    while (!m_results.contains(commandId) && timer.elapsed() < timeoutMs) {
-        m_resultWait.wait(&m_mutex, 100);
+void ActionCommandQueue::evictExpired(bool force)
+{
+    // Caller holds m_mutex. Entries with a thread waiting on them stay.
+    const qint64 now = m_clock.elapsed();
+    if (!force && now - m_lastSweep < ACTION_RESULT_SWEEP_MS) {
+        return;
     }
+    m_lastSweep = now;
 
-    if (m_results.contains(commandId)) {
-        outResult = m_results.take(commandId);
-        return true;
+    for (auto it = m_completions.begin(); it != m_completions.end();) {
+        if (it.value()->m_waiters == 0 && it.value()->m_expiresAt <= now) {
+            it = m_completions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Still full: drop the entries closest to expiry to make room
+    while (m_completions.size() >= ACTION_RESULT_MAX) {
+        auto oldest = m_completions.end();
+        for (auto it = m_completions.begin(); it != m_completions.end(); ++it) {
+            if (it.value()->m_waiters == 0
+                && (oldest == m_completions.end() || it.value()->m_expiresAt < oldest.value()->m_expiresAt)) {
+                oldest = it;
+            }
+        }
+        if (oldest == m_completions.end()) {
+            break;
+        }
+        m_completions.erase(oldest);
     }
-    return false;
 }
@@ -3,39 +3,196 @@
 
 #include <QObject>
 #include <QMutex>
-#include <QQueue>
+#include <QList>
 #include "command.qpb.h"
 #include <QWaitCondition>
+#include <QHash>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <functional>
+#include "metrics/latencyhistogram.h"
 
+#define ACTION_RESULT_TTL_MS        30000   // Results nobody collects are dropped after this
+#define ACTION_RESULT_MAX           1024    // Hard bound on stored results and open handles
+#define ACTION_RESULT_SWEEP_MS      1000    // Expiry scan at most this often
+
+#define ACTION_LOG_MAX              1024    // Entries kept for the slowest consumer
+#define ACTION_CONSUMER_ANONYMOUS   0       // In-process pollers without a consumer id
+
+// Inclusive range of TRIGGER_EVENT ids
+struct ActionEventRange {
+    quint32 first = 0;
+    quint32 last = 0xFFFFFFFF;
+};
+
+// What a consumer wants from the action log
+struct ActionConsumerFilter {
+    QList<ActionEventRange> eventRanges;    // Empty = every event
+    bool controlCommands = true;            // Non-event commands (ADD_ACTION, GET_ACTIONS, ...)
+    quint32 sessionId = 0;                  // Entries for this session plus broadcasts; 0 = all
+
+    bool matches(const patrol::ActionCommand& cmd, quint32 targetSession) const;
+};
+
+struct ActionBatch {
+    QList<patrol::ActionCommand> commands;
+    quint32 dropped = 0;        // Entries lost to the log bound since the last take
+    bool more = false;          // maxCommands cut the batch short
+};
+
+class ActionCommandQueue;
+
+// Completion state for one command's result. Waiters block on the handle's
+// own condition, so a stored result wakes only the threads waiting for that
+// command.
+class ActionCompletion
+{
+public:
+    uint32_t commandId() const { return m_commandId; }
+
+private:
+    friend class ActionCommandQueue;
+    explicit ActionCompletion(uint32_t commandId) : m_commandId(commandId) {}
+
+    // Guarded by the queue's mutex
+    uint32_t m_commandId;
+    QWaitCondition m_done;
+    bool m_ready = false;
+    int m_waiters = 0;
+    qint64 m_expiresAt = 0;     // Queue clock ms
+    patrol::ActionCommandResultRequest m_result;
+};
+
+using ActionCompletionHandle = QSharedPointer<ActionCompletion>;
+
+/**
+ * @brief ActionCommandQueue - Commands waiting for CSMonitor
+ *
+ * A log shared by every consumer rather than a queue drained by whoever
+ * asks first. Each consumer (a polling or subscribed pipe client) has a
+ * cursor and a filter; taking advances the cursor, and an entry is dropped
+ * once every consumer whose filter matches it has moved past. The log holds
+ * at most ACTION_LOG_MAX entries - a consumer that falls further behind
+ * loses the oldest and is told how many in its next batch. Consumers
+ * registered while others exist start at the end of the log; the first one
+ * picks up whatever was queued before anyone was listening.
+ *
+ * Input events can carry the monotonic time they were detected (see
+ * monotonicUs()). The stamp is kept in the log entry - the shared
+ * ActionCommand message has no field for it - and the time from
+ * detection to the command leaving the service is recorded per delivery
+ * path, so bezel responsiveness shows up in the metrics.
+ *
+ * takePending() can block until a command arrives (long poll), and results
+ * posted back by CSMonitor complete a per-command ActionCompletion. Results
+ * and handles nobody is waiting on expire after ACTION_RESULT_TTL_MS, so the
+ * table stays bounded when callers give up or never ask.
+ */
 class ActionCommandQueue : public QObject
 {
     Q_OBJECT
 
 public:
+    enum class Delivery {
+        Poll,       // PollActionCommandsRequest
+        Push        // NotificationHub subscriber
+    };
+
     explicit ActionCommandQueue(QObject* parent = nullptr);
 
-    // Queue a command (from Control Screens)
-    uint32_t queueCommand(const patrol::ActionCommand& cmd);
+    // Queue a command (from Control Screens); detectedUs is monotonicUs() at
+    // detection for input events, 0 if the command has no input behind it.
+    // targetSession limits it to consumers of that session, 0 = everyone.
+    uint32_t queueCommand(const patrol::ActionCommand& cmd, qint64 detectedUs = 0, quint32 targetSession = 0);
+
+    // Consumers are identified by the caller (the pipe client). Registering
+    // again replaces the filter and keeps the cursor.
+    void registerConsumer(quintptr consumerId, const ActionConsumerFilter& filter = ActionConsumerFilter());
+    void unregisterConsumer(quintptr consumerId);
 
-    // Get pending commands (Monitor polls this)
-    QList<patrol::ActionCommand> takePending();
+    // Commands past the consumer's cursor that match its filter. With
+    // timeoutMs > 0 waits until there is at least one or the timeout passes.
+    // An unknown consumer is registered with the default filter.
+    ActionBatch takeFor(quintptr consumerId, Delivery delivery, int maxCommands = 0, int timeoutMs = 0);
 
-    // Check if any pending
-    bool hasPending() const;
+    // PollActionCommands without a consumer id (ACTION_CONSUMER_ANONYMOUS)
+    QList<patrol::ActionCommand> takePending(Delivery delivery = Delivery::Poll, int timeoutMs = 0);
+
+    // Check if any pending for the consumer
+    bool hasPending(quintptr consumerId = ACTION_CONSUMER_ANONYMOUS) const;
+    int logLength() const;
 
     // Trigger event directly (from ACPI)
-    uint32_t triggerEvent(uint32_t eventId);
-    QMap<uint32_t, patrol::ActionCommandResultRequest> m_results;
-    QWaitCondition m_resultWait;
+    uint32_t triggerEvent(uint32_t eventId, qint64 detectedUs = 0);
+
+    // Continuous control (slider): TRIGGER_EVENT with the value in index.
+    // Last value wins - if the newest log entry is the same event and no
+    // consumer has read it yet, its value is updated in place instead of
+    // appending, keeping the first detection time.
+    uint32_t triggerValue(uint32_t eventId, int value, qint64 detectedUs = 0);
+
+    // Detection to delivery, for commands queued with a detection time
+    LatencyHistogram& deliveryLatency(Delivery delivery);
+
+    // Process-wide monotonic clock shared by producers and the queue
+    static qint64 monotonicUs();
 
-    // Add methods:
+    // Push delivery (NotificationHub). Called outside the lock after every
+    // queued command; subscribers then read through takeFor().
+    using AvailableHook = std::function<void()>;
+    void setAvailableHook(AvailableHook hook);
+
+    // Results posted back by CSMonitor
     void storeResult(uint32_t commandId, const patrol::ActionCommandResultRequest& result);
+
+    // Handle for a command's result; take it right after queueCommand() and
+    // keep it while waiting. A result stored first is picked up as well.
+    ActionCompletionHandle expectResult(uint32_t commandId);
+
+    // Wait for and take the result; false on timeout
+    bool waitForResult(const ActionCompletionHandle& handle, patrol::ActionCommandResultRequest& outResult, int timeoutMs);
     bool waitForResult(uint32_t commandId, patrol::ActionCommandResultRequest& outResult, int timeoutMs);
 
+    int storedResultCount() const;
+
+signals:
+    // After every queued command, from the queuing thread. Parked pipe long
+    // polls listen with a queued connection.
+    void commandsQueued();
+
 private:
+    struct LogEntry {
+        quint64 sequence;
+        patrol::ActionCommand command;
+        qint64 detectedUs;
+        quint32 targetSession;
+    };
+
+    struct Consumer {
+        ActionConsumerFilter filter;
+        quint64 cursor = 0;         // Next sequence to read
+        quint32 dropped = 0;
+    };
+
+    bool hasPendingLocked(const Consumer& consumer) const;
+    Consumer& consumerFor(quintptr consumerId);
+    void trimLog();
+    void recordDelivery(Delivery delivery, qint64 detectedUs);
+    ActionCompletionHandle completionFor(uint32_t commandId);
+    void evictExpired(bool force);
+
     mutable QMutex m_mutex;
-    QQueue<patrol::ActionCommand> m_queue;
+    QList<LogEntry> m_log;                      // Oldest first, sequences contiguous
+    quint64 m_nextSequence = 1;
+    QHash<quintptr, Consumer> m_consumers;
+    QWaitCondition m_pendingWait;               // Long polls in takeFor()
+    QHash<uint32_t, ActionCompletionHandle> m_completions;
+    QElapsedTimer m_clock;
+    qint64 m_lastSweep = 0;
     uint32_t m_nextCommandId = 1;
+    AvailableHook m_availableHook;
+    LatencyHistogram m_pollLatency;
+    LatencyHistogram m_pushLatency;
 };
 
 #endif
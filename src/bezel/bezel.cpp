@@ -1,10 +1,11 @@
 #include "bezel.h"
 #include "commandproc.h"
 #include <QDebug>
+#include <QDateTime>
 
 // Button bit → event ID mapping
 // Button state register is a bitmask: bit0=But1, bit1=But2, ... bit5=But6
-// We detect rising edges (0→1 transitions) as button presses.
+// Debounced rising edges are presses, falling edges releases.
 const quint32 BezelMonitor::s_buttonEventMap[6] = {
     ECEVENT_BUT1_DN,    // bit 0
     ECEVENT_BUT2_DN,    // bit 1
@@ -14,6 +15,27 @@ const quint32 BezelMonitor::s_buttonEventMap[6] = {
     ECEVENT_BUT6_DN,    // bit 5
 };
 
+const quint32 BezelMonitor::s_releaseEventMap[6] = {
+    ECEVENT_BUT1_UP, ECEVENT_BUT2_UP, ECEVENT_BUT3_UP,
+    ECEVENT_BUT4_UP, ECEVENT_BUT5_UP, ECEVENT_BUT6_UP,
+};
+
+const quint32 BezelMonitor::s_longPressEventMap[6] = {
+    ECEVENT_BUT1_LONG, ECEVENT_BUT2_LONG, ECEVENT_BUT3_LONG,
+    ECEVENT_BUT4_LONG, ECEVENT_BUT5_LONG, ECEVENT_BUT6_LONG,
+};
+
+// Buttons and slider are read every poll, the device id every
+// presenceCheckMs. The planner folds 0x27-0x28 into one read; the identity
+// registers are far enough away to stay separate.
+const QList<AcpiRegister> BezelMonitor::s_registerMap = {
+    { RegBezelState, "BezelState", ACPI_REG_BEZ_STATE,  1, AcpiPollClass::OnDemand },
+    { RegButtons,    "Buttons",    ACPI_REG_BUT_POS,    1, AcpiPollClass::EveryTick },
+    { RegSlider,     "Slider",     ACPI_REG_SLIDER_POS, 1, AcpiPollClass::EveryTick },
+    { RegDeviceId,   "DeviceId",   ACPI_REG_BEZ_DEV,    1, AcpiPollClass::Periodic },
+    { RegFirmware,   "Firmware",   ACPI_REG_BEZ_VER,    1, AcpiPollClass::OnDemand },
+};
+
 BezelMonitor::BezelMonitor(EcManager* ecManager, CommandProc* commandProc,
                            Logger* logger, QObject* parent)
     : QObject(parent)
@@ -21,6 +43,18 @@ BezelMonitor::BezelMonitor(EcManager* ecManager, CommandProc* commandProc,
     , m_commandProc(commandProc)
     , m_logger(logger)
     , m_pollTimer(new QTimer(this))
+    , m_planner(s_registerMap)
+    , m_failCount(0)
+    , m_pollState(BezelPollState::Absent)
+    , m_lastActivityAt(-1)
+    , m_lastPollAt(-1)
+    , m_lastPresenceCheckAt(-1)
+    , m_pollCount(0)
+    , m_transactionCount(0)
+    , m_sliderTimer(new QTimer(this))
+    , m_sliderSentPos(-1)
+    , m_sliderSentAtUs(0)
+    , m_sliderDetectedUs(0)
     , m_running(false)
     , m_bezelPresent(false)
     , m_deviceId(0xFF)
@@ -29,8 +63,13 @@ BezelMonitor::BezelMonitor(EcManager* ecManager, CommandProc* commandProc,
     , m_lastSliderPos(0)
     , m_firstPoll(true)
 {
-    m_pollTimer->setTimerType(Qt::PreciseTimer);
+    m_presencePlan = m_planner.planFor({ RegDeviceId });
+    m_clock.start();
     connect(m_pollTimer, &QTimer::timeout, this, &BezelMonitor::onPollTimer);
+
+    m_sliderTimer->setSingleShot(true);
+    m_sliderTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_sliderTimer, &QTimer::timeout, this, &BezelMonitor::onSliderTimer);
 }
 
 BezelMonitor::~BezelMonitor()
@@ -38,7 +77,7 @@ BezelMonitor::~BezelMonitor()
     stop();
 }
 
-void BezelMonitor::start(int pollIntervalMs)
+void BezelMonitor::start(const BezelPollTuning& tuning)
 {
     if (m_running) {
         log("Already running");
@@ -55,19 +94,17 @@ void BezelMonitor::start(int pollIntervalMs)
         return;
     }
 
-    // Read initial bezel device info
-    QByteArray devData;
-    if (m_ecManager->acpi0Read(ACPI_REG_BEZ_DEV, 1, devData) == EC_HOST_CMD_SUCCESS
-        && devData.size() >= 1)
-    {
-        m_deviceId = static_cast<quint8>(devData.at(0));
-    }
+    m_tuning = tuning;
 
-    QByteArray verData;
-    if (m_ecManager->acpi0Read(ACPI_REG_BEZ_VER, 1, verData) == EC_HOST_CMD_SUCCESS
-        && verData.size() >= 1)
-    {
-        m_firmwareVersion = static_cast<quint8>(verData.at(0));
+    // Read initial bezel device info (0xEF and 0xF6 fit in one read)
+    const AcpiReadResult info = m_planner.execute(m_ecManager, m_planner.planFor({ RegDeviceId, RegFirmware }));
+    m_transactionCount += info.transactions;
+    m_lastPresenceCheckAt = m_clock.elapsed();
+    if (info.has(RegDeviceId)) {
+        m_deviceId = static_cast<quint8>(info.value(RegDeviceId));
+    }
+    if (info.has(RegFirmware)) {
+        m_firmwareVersion = static_cast<quint8>(info.value(RegFirmware));
     }
 
     m_bezelPresent = (m_deviceId != 0xFF && m_deviceId != 0x00);
@@ -82,10 +119,46 @@ void BezelMonitor::start(int pollIntervalMs)
     }
 
     m_firstPoll = true;
+    m_lastActivityAt = -1;
     m_running = true;
-    m_pollTimer->start(pollIntervalMs);
+    reschedule(m_clock.elapsed());
+
+    log(QString("Started, polling every %1ms (active %2ms, absent %3ms)")
+            .arg(m_tuning.idleMs).arg(m_tuning.activeMs).arg(m_tuning.absentMs));
+}
+
+void BezelMonitor::setInputTuning(const BezelInputTuning& tuning)
+{
+    m_inputTuning = tuning;
+    if (m_sliderTimer->isActive() && m_inputTuning.sliderMaxRateHz <= 0) {
+        m_sliderTimer->stop();
+        sendSliderValue(ActionCommandQueue::monotonicUs());
+    }
+}
+
+void BezelMonitor::setPollTuning(const BezelPollTuning& tuning)
+{
+    m_tuning = tuning;
+    if (m_running) {
+        reschedule(m_clock.elapsed());
+    }
+}
 
-    log(QString("Started, polling every %1ms").arg(pollIntervalMs));
+BezelPollStatus BezelMonitor::pollStatus() const
+{
+    const qint64 now = m_clock.elapsed();
+    const qint64 wallNow = QDateTime::currentMSecsSinceEpoch();
+    auto toWall = [now, wallNow](qint64 at) { return at < 0 ? 0 : wallNow - (now - at); };
+
+    BezelPollStatus status;
+    status.state = m_pollState;
+    status.intervalMs = m_running ? m_pollTimer->interval() : 0;
+    status.lastActivityMs = toWall(m_lastActivityAt);
+    status.lastPollMs = toWall(m_lastPollAt);
+    status.lastPresenceCheckMs = toWall(m_lastPresenceCheckAt);
+    status.polls = m_pollCount;
+    status.ecTransactions = m_transactionCount;
+    return status;
 }
 
 void BezelMonitor::stop()
@@ -93,6 +166,8 @@ void BezelMonitor::stop()
     if (!m_running) return;
 
     m_pollTimer->stop();
+    m_sliderTimer->stop();
+    m_sliderDetectedUs = 0;
     m_running = false;
     log("Stopped");
 }
@@ -107,69 +182,123 @@ void BezelMonitor::onPollTimer()
         return;
     }
 
-    // --- Read button state ---
-    QByteArray btnData;
-    EC_HOST_CMD_STATUS status = m_ecManager->acpi0Read(ACPI_REG_BUT_POS, 1, btnData);
+    const qint64 now = m_clock.elapsed();
+    m_lastPollAt = now;
+    m_pollCount++;
+
+    // No bezel: only watch for one being attached
+    if (!m_bezelPresent) {
+        const AcpiReadResult presence = m_planner.execute(m_ecManager, m_presencePlan);
+        m_transactionCount += presence.transactions;
+        m_lastPresenceCheckAt = now;
+        if (presence.has(RegDeviceId)) {
+            updatePresence(static_cast<quint8>(presence.value(RegDeviceId)));
+            if (m_bezelPresent) {
+                m_firstPoll = true;     // Fresh baseline, no events for state at attach time
+            }
+        }
+        reschedule(now);
+        return;
+    }
+
+    // Buttons + slider in one read; the device id joins when a check is due
+    const bool presenceDue = (now - m_lastPresenceCheckAt >= m_tuning.presenceCheckMs);
+    const AcpiReadResult regs = m_planner.execute(m_ecManager, m_planner.plan(presenceDue));
+    m_transactionCount += regs.transactions;
+    if (presenceDue) {
+        m_lastPresenceCheckAt = now;
+    }
 
-    if (status != EC_HOST_CMD_SUCCESS || btnData.size() < 1) {
+    if (!regs.has(RegButtons)) {
         // Don't spam logs - only log every 100th failure
-        static int failCount = 0;
-        if (++failCount % 100 == 1) {
+        if (++m_failCount % 100 == 1) {
             log(QString("Failed to read button state (status=%1, fails=%2)")
-                    .arg(status).arg(failCount), Logger::Warning);
+                    .arg(regs.status).arg(m_failCount), Logger::Warning);
         }
+        reschedule(now);
         return;
     }
 
-    quint8 buttonState = static_cast<quint8>(btnData.at(0));
-
-    // --- Read slider ---
-    QByteArray sliderData;
-    quint8 sliderPos = m_lastSliderPos;
-    if (m_ecManager->acpi0Read(ACPI_REG_SLIDER_POS, 1, sliderData) == EC_HOST_CMD_SUCCESS
-        && sliderData.size() >= 1)
-    {
-        sliderPos = static_cast<quint8>(sliderData.at(0));
-    }
-
-    // --- Periodic bezel presence check (every ~5s at 50ms poll) ---
-    static int presenceCounter = 0;
-    if (++presenceCounter >= 100) {
-        presenceCounter = 0;
-
-        QByteArray devData;
-        if (m_ecManager->acpi0Read(ACPI_REG_BEZ_DEV, 1, devData) == EC_HOST_CMD_SUCCESS
-            && devData.size() >= 1)
-        {
-            quint8 newDevId = static_cast<quint8>(devData.at(0));
-            bool newPresent = (newDevId != 0xFF && newDevId != 0x00);
-
-            if (newPresent != m_bezelPresent) {
-                m_bezelPresent = newPresent;
-                m_deviceId = newDevId;
-                log(QString("Bezel %1 (deviceId=0x%2)")
-                        .arg(m_bezelPresent ? "connected" : "disconnected")
-                        .arg(m_deviceId, 2, 16, QChar('0')));
-                emit bezelPresenceChanged(m_bezelPresent);
-            }
-        }
+    const qint64 nowUs = ActionCommandQueue::monotonicUs();
+    quint8 buttonState = static_cast<quint8>(regs.value(RegButtons));
+    quint8 sliderPos = static_cast<quint8>(regs.value(RegSlider, m_lastSliderPos));
+
+    if (regs.has(RegDeviceId)) {
+        updatePresence(static_cast<quint8>(regs.value(RegDeviceId)));
     }
 
     // --- First poll: just capture baseline, don't fire events ---
     if (m_firstPoll) {
-        m_lastButtonState = buttonState;
+        resetButtons(buttonState);
         m_lastSliderPos = sliderPos;
+        m_sliderSentPos = sliderPos;
+        m_sliderDetectedUs = 0;
+        m_sliderTimer->stop();
         m_firstPoll = false;
+        reschedule(now);
         return;
     }
 
     // --- Detect and process changes ---
-    if (buttonState != m_lastButtonState) {
-        processButtonState(buttonState);
+    // Runs every poll: pending debounces and long presses mature without a new edge
+    if (processButtonState(buttonState, nowUs)) {
+        m_lastActivityAt = now;
     }
 
     if (sliderPos != m_lastSliderPos) {
-        processSliderState(sliderPos);
+        processSliderState(sliderPos, nowUs);
+        m_lastActivityAt = now;
+    }
+
+    reschedule(now);
+}
+
+void BezelMonitor::reschedule(qint64 now)
+{
+    BezelPollState state = BezelPollState::Idle;
+    int interval = m_tuning.idleMs;
+
+    if (!m_bezelPresent) {
+        state = BezelPollState::Absent;
+        interval = m_tuning.absentMs;
+    } else if (m_lastActivityAt >= 0) {
+        const qint64 sinceActivity = now - m_lastActivityAt;
+        if (sinceActivity < m_tuning.activeHoldMs) {
+            state = BezelPollState::Active;
+            interval = m_tuning.activeMs;
+        } else {
+            // Double once per decay step after the hold expires
+            const qint64 steps = (sinceActivity - m_tuning.activeHoldMs) / qMax(1, m_tuning.decayStepMs) + 1;
+            const qint64 decayed = static_cast<qint64>(m_tuning.activeMs) << qMin<qint64>(steps, 16);
+            if (decayed < m_tuning.idleMs) {
+                state = BezelPollState::Decaying;
+                interval = static_cast<int>(decayed);
+            }
+        }
+    }
+
+    // Wake exactly when a debounce or long press is due
+    const qint64 dueUs = nextInputDueUs();
+    if (dueUs >= 0) {
+        const qint64 dueMs = (qMax<qint64>(0, dueUs - ActionCommandQueue::monotonicUs()) + 999) / 1000;
+        interval = static_cast<int>(qMin<qint64>(interval, dueMs));
+    }
+    interval = qMax(1, interval);
+
+    if (state != m_pollState) {
+        LOG_DEBUG(m_logger, CatBezelMonitor, QString("Poll state %1 -> %2, interval %3ms")
+                                                 .arg(static_cast<int>(m_pollState))
+                                                 .arg(static_cast<int>(state)).arg(interval));
+        m_pollState = state;
+    }
+
+    // Precise timing only matters while the user is interacting; coarse
+    // timers let the OS batch the idle and absent wakeups
+    const Qt::TimerType type = (state == BezelPollState::Active || state == BezelPollState::Decaying || dueUs >= 0)
+                                   ? Qt::PreciseTimer : Qt::CoarseTimer;
+    if (!m_pollTimer->isActive() || m_pollTimer->interval() != interval || m_pollTimer->timerType() != type) {
+        m_pollTimer->setTimerType(type);
+        m_pollTimer->start(interval);
     }
 }
 
@@ -177,45 +306,167 @@ void BezelMonitor::onPollTimer()
 // Change Detection
 // ============================================================================
 
-void BezelMonitor::processButtonState(quint8 newState)
+void BezelMonitor::updatePresence(quint8 deviceId)
+{
+    bool present = (deviceId != 0xFF && deviceId != 0x00);
+    if (present == m_bezelPresent) {
+        return;
+    }
+
+    m_bezelPresent = present;
+    m_deviceId = deviceId;
+    log(QString("Bezel %1 (deviceId=0x%2)")
+            .arg(m_bezelPresent ? "connected" : "disconnected")
+            .arg(m_deviceId, 2, 16, QChar('0')));
+    emit bezelPresenceChanged(m_bezelPresent);
+}
+
+void BezelMonitor::resetButtons(quint8 state)
 {
-    quint8 oldState = m_lastButtonState;
-    m_lastButtonState = newState;
+    m_lastButtonState = state;
+    for (int i = 0; i < 6; i++) {
+        ButtonTrack& track = m_buttons[i];
+        track.raw = track.stable = (state & (1 << i)) != 0;
+        track.rawSinceUs = 0;
+        track.pressedAtUs = 0;
+        track.longFired = true;     // Held at baseline - not a press we saw start
+    }
+}
 
-    // Rising edges = button presses (bits that went 0→1)
-    quint8 pressed = (newState & ~oldState);
+bool BezelMonitor::processButtonState(quint8 newState, qint64 nowUs)
+{
+    const quint8 oldState = m_lastButtonState;
+    const qint64 debounceUs = static_cast<qint64>(qMax(0, m_inputTuning.debounceMs)) * 1000;
+    const qint64 longPressUs = static_cast<qint64>(m_inputTuning.longPressMs) * 1000;
+    bool rawChanged = false;
 
     for (int i = 0; i < 6; i++) {
-        if (pressed & (1 << i)) {
-            quint32 eventId = s_buttonEventMap[i];
+        ButtonTrack& track = m_buttons[i];
+        const bool level = (newState & (1 << i)) != 0;
+
+        if (level != track.raw) {
+            track.raw = level;
+            track.rawSinceUs = nowUs;
+            rawChanged = true;
+        }
+
+        // Accept the level once it has held for the debounce time
+        if (track.raw != track.stable && nowUs - track.rawSinceUs >= debounceUs) {
+            track.stable = track.raw;
+
+            if (track.stable) {
+                const quint32 eventId = s_buttonEventMap[i];
+                track.pressedAtUs = track.rawSinceUs;
+                track.longFired = false;
+                m_lastButtonState |= (1 << i);
+
+                log(QString("Button %1 pressed → event 0x%2 (state 0x%3→0x%4)")
+                        .arg(i + 1)
+                        .arg(eventId, 4, 16, QChar('0'))
+                        .arg(oldState, 2, 16, QChar('0'))
+                        .arg(m_lastButtonState, 2, 16, QChar('0')));
+
+                // Push into CommandProc's existing action queue
+                // This is the same queue that handlePollActionCommands() drains
+                m_commandProc->triggerActionEvent(eventId, track.rawSinceUs);
+
+                emit buttonPressed(i + 1, eventId);
+            } else {
+                const quint32 eventId = s_releaseEventMap[i];
+                const int heldMs = track.pressedAtUs > 0
+                                       ? static_cast<int>((track.rawSinceUs - track.pressedAtUs) / 1000) : 0;
+                m_lastButtonState &= ~(1 << i);
+
+                LOG_DEBUG(m_logger, CatBezelMonitor, QString("Button %1 released after %2ms").arg(i + 1).arg(heldMs));
+
+                if (m_inputTuning.releaseEvents) {
+                    m_commandProc->triggerActionEvent(eventId, track.rawSinceUs);
+                }
+                emit buttonReleased(i + 1, eventId, heldMs);
+            }
+        }
+
+        // Long press: fires once per press, stamped when the threshold passed
+        if (track.stable && !track.longFired && longPressUs > 0
+            && nowUs - track.pressedAtUs >= longPressUs) {
+            const quint32 eventId = s_longPressEventMap[i];
+            track.longFired = true;
+
+            log(QString("Button %1 long press → event 0x%2").arg(i + 1).arg(eventId, 4, 16, QChar('0')));
 
-            log(QString("Button %1 pressed → event 0x%2 (state 0x%3→0x%4)")
-                    .arg(i + 1)
-                    .arg(eventId, 4, 16, QChar('0'))
-                    .arg(oldState, 2, 16, QChar('0'))
-                    .arg(newState, 2, 16, QChar('0')));
+            m_commandProc->triggerActionEvent(eventId, track.pressedAtUs + longPressUs);
+            emit buttonLongPressed(i + 1, eventId);
+        }
+    }
+
+    return rawChanged;
+}
+
+qint64 BezelMonitor::nextInputDueUs() const
+{
+    if (!m_running || !m_bezelPresent || m_firstPoll) {
+        return -1;
+    }
 
-            // Push into CommandProc's existing action queue
-            // This is the same queue that handlePollActionCommands() drains
-            m_commandProc->triggerActionEvent(eventId);
+    const qint64 debounceUs = static_cast<qint64>(qMax(0, m_inputTuning.debounceMs)) * 1000;
+    const qint64 longPressUs = static_cast<qint64>(m_inputTuning.longPressMs) * 1000;
+    qint64 due = -1;
+    auto consider = [&due](qint64 at) { due = (due < 0) ? at : qMin(due, at); };
 
-            emit buttonPressed(i + 1, eventId);
+    for (const ButtonTrack& track : m_buttons) {
+        if (track.raw != track.stable) {
+            consider(track.rawSinceUs + debounceUs);
+        } else if (track.stable && !track.longFired && longPressUs > 0) {
+            consider(track.pressedAtUs + longPressUs);
         }
     }
+    return due;
 }
 
-void BezelMonitor::processSliderState(quint8 newPos)
+void BezelMonitor::processSliderState(quint8 newPos, qint64 nowUs)
 {
     quint8 oldPos = m_lastSliderPos;
     m_lastSliderPos = newPos;
 
-    log(QString("Slider changed: %1 → %2").arg(oldPos).arg(newPos), Logger::Debug);
+    LOG_DEBUG(m_logger, CatBezelMonitor, QString("Slider changed: %1 → %2").arg(oldPos).arg(newPos));
 
-    m_commandProc->triggerActionEvent(ECEVENT_SLIDER_CHG);
+    if (m_sliderDetectedUs == 0) {
+        m_sliderDetectedUs = nowUs;
+    }
+
+    // Leading edge goes out at once; changes inside the interval wait for the timer
+    const qint64 minIntervalUs = m_inputTuning.sliderMaxRateHz > 0 ? 1000000 / m_inputTuning.sliderMaxRateHz : 0;
+    const qint64 sinceSentUs = nowUs - m_sliderSentAtUs;
+    if (sinceSentUs >= minIntervalUs) {
+        m_sliderTimer->stop();
+        sendSliderValue(nowUs);
+    } else if (!m_sliderTimer->isActive()) {
+        m_sliderTimer->start(static_cast<int>((minIntervalUs - sinceSentUs + 999) / 1000));
+    }
 
     emit sliderChanged(newPos);
 }
 
+void BezelMonitor::onSliderTimer()
+{
+    sendSliderValue(ActionCommandQueue::monotonicUs());
+}
+
+void BezelMonitor::sendSliderValue(qint64 nowUs)
+{
+    if (m_sliderDetectedUs == 0) {
+        return;
+    }
+
+    // A sweep that came back to where it started needs no event
+    if (m_lastSliderPos != m_sliderSentPos) {
+        m_commandProc->triggerActionValue(ECEVENT_SLIDER_CHG, m_lastSliderPos, m_sliderDetectedUs);
+        m_sliderSentPos = m_lastSliderPos;
+        m_sliderSentAtUs = nowUs;
+    }
+    m_sliderDetectedUs = 0;
+}
+
 // ============================================================================
 // Logging
 // ============================================================================
@@ -223,6 +474,6 @@ void BezelMonitor::processSliderState(quint8 newPos)
 void BezelMonitor::log(const QString& message, Logger::LogLevel level)
 {
     if (m_logger) {
-        m_logger->log(QString("BezelMonitor: %1").arg(message), level);
+        m_logger->log(Logger::CatBezelMonitor, level, message);
     }
 }
@@ -3,7 +3,9 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include "ecmanager.h"
+#include "acpiregistermap.h"
 #include "logger.h"
 
 // ============================================================================
@@ -14,7 +16,7 @@
 #define ACPI_REG_BUT_POS        0x27    // Button state bitmask register
 #define ACPI_REG_SLIDER_POS     0x28    // Slider position (0-255)
 #define ACPI_REG_BEZ_DEV        0xEF    // Bezel device ID
-#define ACPI_REG_BEZ_VER        0xF6    // Bezel firmware version  // Slider position (0-255)
+#define ACPI_REG_BEZ_VER        0xF6    // Bezel firmware version
 
 // ============================================================================
 // Bezel event IDs - must match ec_events_m3.h so ActionManager maps them
@@ -30,6 +32,74 @@
 #define ECEVENT_SLIDER_CHG      0x00020002
 #endif
 
+// Release and long-press IDs are placeholders until ec_events_m3.h defines
+// them; BezelInputTuning leaves both off by default so nothing unmapped is
+// queued. Enable them once the real IDs are in place.
+#ifndef ECEVENT_BUT1_UP
+#define ECEVENT_BUT1_UP         0x00010010
+#define ECEVENT_BUT2_UP         0x00010011
+#define ECEVENT_BUT3_UP         0x00010012
+#define ECEVENT_BUT4_UP         0x00010013
+#define ECEVENT_BUT5_UP         0x00010014
+#define ECEVENT_BUT6_UP         0x00010015
+#define ECEVENT_BUT1_LONG       0x00010020
+#define ECEVENT_BUT2_LONG       0x00010021
+#define ECEVENT_BUT3_LONG       0x00010022
+#define ECEVENT_BUT4_LONG       0x00010023
+#define ECEVENT_BUT5_LONG       0x00010024
+#define ECEVENT_BUT6_LONG       0x00010025
+#endif
+
+// ============================================================================
+// Button input handling
+// ============================================================================
+#define BEZEL_DEBOUNCE_MS       20      // A button must keep a new level this long
+#define BEZEL_LONG_PRESS_MS     800     // Suggested threshold when long-press events are enabled
+#define BEZEL_SLIDER_MAX_RATE_HZ 20     // ECEVENT_SLIDER_CHG at most this often during a sweep
+
+struct BezelInputTuning {
+    int debounceMs = BEZEL_DEBOUNCE_MS;     // 0 = accept every polled change
+    int longPressMs = 0;                    // 0 = no long-press events; see BEZEL_LONG_PRESS_MS
+    bool releaseEvents = false;             // Queue ECEVENT_BUTn_UP on release
+    int sliderMaxRateHz = BEZEL_SLIDER_MAX_RATE_HZ;    // 0 = queue every sampled change
+};
+
+// ============================================================================
+// Adaptive poll rates
+// ============================================================================
+#define BEZEL_POLL_ACTIVE_MS        10      // Right after button/slider activity
+#define BEZEL_POLL_IDLE_MS          50      // Short taps must still be seen at this rate
+#define BEZEL_POLL_ABSENT_MS        2000    // No bezel: device id only
+#define BEZEL_ACTIVE_HOLD_MS        3000    // Stay at the active rate this long after activity
+#define BEZEL_DECAY_STEP_MS         500     // Then double the interval every step until idle
+#define BEZEL_PRESENCE_CHECK_MS     5000    // Device id re-read while a bezel is present
+
+struct BezelPollTuning {
+    int activeMs = BEZEL_POLL_ACTIVE_MS;
+    int idleMs = BEZEL_POLL_IDLE_MS;
+    int absentMs = BEZEL_POLL_ABSENT_MS;
+    int activeHoldMs = BEZEL_ACTIVE_HOLD_MS;
+    int decayStepMs = BEZEL_DECAY_STEP_MS;
+    int presenceCheckMs = BEZEL_PRESENCE_CHECK_MS;
+};
+
+enum class BezelPollState {
+    Active,         // Polling at activeMs after activity
+    Decaying,       // Stepping back towards idleMs
+    Idle,
+    Absent          // No bezel - presence checks only
+};
+
+struct BezelPollStatus {
+    BezelPollState state = BezelPollState::Absent;
+    int intervalMs = 0;
+    qint64 lastActivityMs = 0;          // Wall clock, 0 = none yet
+    qint64 lastPollMs = 0;
+    qint64 lastPresenceCheckMs = 0;
+    quint64 polls = 0;
+    quint64 ecTransactions = 0;
+};
+
 class CommandProc;  // Forward declare - we just call triggerActionEvent()
 
 /**
@@ -37,12 +107,27 @@ class CommandProc;  // Forward declare - we just call triggerActionEvent()
  *        into CommandProc's action queue.
  *
  * Flow:
- *   EC ACPI regs → BezelMonitor (polls, detects rising edges)
- *       → CommandProc::triggerActionEvent(eventId)
+ *   EC ACPI regs → BezelMonitor (polls, debounces, detects press/long/release)
+ *       → CommandProc::triggerActionEvent(eventId, detectedUs)
  *       → m_actionQueue (already exists)
  *       → CSMonitor polls via PollActionCommandsRequest
  *       → ActionPoller → ActionManager::executeEvent()
  *
+ * The poll interval adapts: activeMs for a few seconds after any button or
+ * slider change, decaying to idleMs, and absentMs (device id only) while no
+ * bezel is attached.
+ *
+ * Every event carries the monotonic time of the poll that first saw the
+ * change (ActionCommandQueue::monotonicUs()), so the queue can measure
+ * detection-to-delivery latency including the debounce delay. While a
+ * change is waiting out its debounce or a press is heading for the
+ * long-press threshold, the next poll is scheduled for exactly that moment.
+ *
+ * The slider is a continuous control: ECEVENT_SLIDER_CHG carries the
+ * position in ActionCommand.index, and a sweep is queued at most
+ * sliderMaxRateHz times a second - the first change at once, the rest
+ * merged, and the final position always sent when the interval runs out.
+ *
  * Lives in WindowsService, created after EC is initialized.
  */
 class BezelMonitor : public QObject
@@ -54,10 +139,18 @@ public:
                           Logger* logger, QObject* parent = nullptr);
     ~BezelMonitor();
 
-    void start(int pollIntervalMs = 50);
+    void start(const BezelPollTuning& tuning = BezelPollTuning());
     void stop();
     bool isRunning() const { return m_running; }
 
+    // Takes effect from the next poll
+    void setPollTuning(const BezelPollTuning& tuning);
+    BezelPollTuning pollTuning() const { return m_tuning; }
+    BezelPollStatus pollStatus() const;
+
+    void setInputTuning(const BezelInputTuning& tuning);
+    BezelInputTuning inputTuning() const { return m_inputTuning; }
+
     // Debug/status
     quint8 currentButtonState() const { return m_lastButtonState; }
     quint8 currentSliderPos() const { return m_lastSliderPos; }
@@ -66,31 +159,82 @@ public:
 
 signals:
     void buttonPressed(int buttonIndex, quint32 eventId);
+    void buttonLongPressed(int buttonIndex, quint32 eventId);
+    void buttonReleased(int buttonIndex, quint32 eventId, int heldMs);
     void sliderChanged(quint8 position);
     void bezelPresenceChanged(bool present);
 
 private slots:
     void onPollTimer();
+    void onSliderTimer();
 
 private:
+    // Ids in the bezel register map
+    enum BezelRegister {
+        RegBezelState,
+        RegButtons,
+        RegSlider,
+        RegDeviceId,
+        RegFirmware
+    };
+
+    // Per-button debounce and press tracking (ActionCommandQueue::monotonicUs())
+    struct ButtonTrack {
+        bool raw = false;           // Level at the last poll
+        bool stable = false;        // Debounced level
+        qint64 rawSinceUs = 0;      // First poll that saw the current raw level
+        qint64 pressedAtUs = 0;     // Detection time of the current press
+        bool longFired = false;
+    };
+
     void log(const QString& message, Logger::LogLevel level = Logger::Info);
-    void processButtonState(quint8 newState);
-    void processSliderState(quint8 newPos);
+    void updatePresence(quint8 deviceId);
+    void reschedule(qint64 now);
+    void resetButtons(quint8 state);
+    bool processButtonState(quint8 newState, qint64 nowUs);
+    void processSliderState(quint8 newPos, qint64 nowUs);
+    qint64 nextInputDueUs() const;
+    void sendSliderValue(qint64 nowUs);
 
     EcManager*    m_ecManager;
     CommandProc*  m_commandProc;
     Logger*       m_logger;
     QTimer*       m_pollTimer;
+    AcpiReadPlanner m_planner;
+    QList<AcpiReadSpan> m_presencePlan;
+    int           m_failCount;
+
+    // Adaptive scheduling (m_clock milliseconds, -1 = never)
+    BezelPollTuning m_tuning;
+    BezelPollState m_pollState;
+    QElapsedTimer m_clock;
+    qint64        m_lastActivityAt;
+    qint64        m_lastPollAt;
+    qint64        m_lastPresenceCheckAt;
+    quint64       m_pollCount;
+    quint64       m_transactionCount;
+
+    BezelInputTuning m_inputTuning;
+    ButtonTrack   m_buttons[6];
+
+    // Slider rate limiting (ActionCommandQueue::monotonicUs())
+    QTimer*       m_sliderTimer;        // Trailing edge of a merged burst
+    int           m_sliderSentPos;      // Last position queued, -1 = none
+    qint64        m_sliderSentAtUs;
+    qint64        m_sliderDetectedUs;   // First unsent change, 0 = none
 
     bool    m_running;
     bool    m_bezelPresent;
     quint8  m_deviceId;
     quint8  m_firmwareVersion;
-    quint8  m_lastButtonState;
+    quint8  m_lastButtonState;      // Debounced
     quint8  m_lastSliderPos;
     bool    m_firstPoll;
 
     static const quint32 s_buttonEventMap[6];
+    static const quint32 s_releaseEventMap[6];
+    static const quint32 s_longPressEventMap[6];
+    static const QList<AcpiRegister> s_registerMap;
 };
 
 #endif // BEZELMONITOR_H
@@ -1,24 +1,58 @@
 #include "commandproc.h"
 #include <windows.h>
 #include "./os/os.h"
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
 // Qt Protobuf generates enums inside Gadget wrapper classes
 // Use these shortcuts for cleaner code
 using ResultCode = patrol::ResultCodeGadget::ResultCode;
 using RegValueType = patrol::RegValueTypeGadget::RegValueType;
 using EcStatus = patrol::EcStatusGadget::EcStatus;
 
+// consumerId of the command being dispatched on this thread. Handlers only
+// see the request; PollActionCommands reads the pipe client from here.
+// Per thread because processCommand() may be called from any thread.
+static thread_local quintptr t_dispatchConsumer = ACTION_CONSUMER_ANONYMOUS;
+
+// Binds a Command payload field to one of the handle* members. The handler's
+// response goes into the matching response field and its result is returned
+// so dispatch can account errors without knowing the message type.
+#define REGISTER_COMMAND(Field, reqGetter, respSetter, handlerFn) \
+    registerHandler(static_cast<int>(patrol::Command::PayloadFields::Field), QStringLiteral(#Field), \
+        [this](const patrol::Command& request, patrol::Command& response) { \
+            auto resp = handlerFn(request.reqGetter()); \
+            const int result = resp.result(); \
+            response.respSetter(std::move(resp)); \
+            return result; \
+        })
+
 CommandProc::CommandProc(Logger* logger, QObject *parent)
     : QObject(parent)
     , m_pLogger(logger)
     , m_RegistryAccess(logger)
     , m_WmiAccess(logger)
+    , m_wmiEngine(&m_WmiAccess, logger)
+    , m_wmiCache(&m_wmiEngine, logger)
     , m_pEcManager(nullptr)
+    , m_pNotificationHub(nullptr)
+    , m_unknownCommands(0)
 {
-    m_WmiAccess.initialize();
+    if (m_WmiAccess.initialize()) {
+        m_wmiEngine.start();
+    }
+    registerBuiltinHandlers();
+
+    connect(&m_actionQueue, &ActionCommandQueue::commandsQueued, this, &CommandProc::actionCommandsQueued);
 }
 
 CommandProc::~CommandProc()
 {
+    // Async WMI completions use the cache and the handler table
+    m_wmiEngine.stop();
+
+    qDeleteAll(m_handlers);
+    m_handlers.clear();
+
     if (m_pEcManager) {
         delete m_pEcManager;
         m_pEcManager = nullptr;
@@ -28,21 +62,21 @@ CommandProc::~CommandProc()
 bool CommandProc::initializeEc(quint16 emiOffset)
 {
     if (m_pEcManager) {
-        m_pLogger->log("CommandProc: EC already initialized", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "EC already initialized");
         return m_pEcManager->isInitialized();
     }
 
     m_pEcManager = new EcManager(m_pLogger, this);
 
     if (!m_pEcManager->initialize(emiOffset)) {
-        m_pLogger->log("CommandProc: Failed to initialize EC", Logger::Error);
+        LOG_ERROR(m_pLogger, CatCommandProc, "Failed to initialize EC");
         delete m_pEcManager;
         m_pEcManager = nullptr;
         return false;
     }
 
-    m_pLogger->log(QString("CommandProc: EC initialized at offset 0x%1")
-                       .arg(emiOffset, 4, 16, QChar('0')), Logger::Info);
+    LOG_INFO(m_pLogger, CatCommandProc, QString("EC initialized at offset 0x%1")
+                                            .arg(emiOffset, 4, 16, QChar('0')));
     return true;
 }
 
@@ -51,108 +85,462 @@ bool CommandProc::isEcInitialized() const
     return m_pEcManager && m_pEcManager->isInitialized();
 }
 
-patrol::Command CommandProc::processCommand(const patrol::Command& request)
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+void CommandProc::registerBuiltinHandlers()
 {
-    patrol::Command response;
-    response.setSequenceNumber(request.sequenceNumber());
+    REGISTER_COMMAND(MsrReadReq, msrReadReq, setMsrReadResp, handleMsrRead);
+    REGISTER_COMMAND(MsrWriteReq, msrWriteReq, setMsrWriteResp, handleMsrWrite);
+    REGISTER_COMMAND(RegistryReadReq, registryReadReq, setRegistryReadResp, handleRegistryRead);
+    REGISTER_COMMAND(RegistryWriteReq, registryWriteReq, setRegistryWriteResp, handleRegistryWrite);
+    REGISTER_COMMAND(RegistryDeleteReq, registryDeleteReq, setRegistryDeleteResp, handleRegistryDelete);
+    REGISTER_COMMAND(WmiQueryReq, wmiQueryReq, setWmiQueryResp, handleWmiQuery);
+    REGISTER_COMMAND(FileDeleteReq, fileDeleteReq, setFileDeleteResp, handleFileDelete);
+    REGISTER_COMMAND(FileRenameReq, fileRenameReq, setFileRenameResp, handleFileRename);
+    REGISTER_COMMAND(FileCopyReq, fileCopyReq, setFileCopyResp, handleFileCopy);
+    REGISTER_COMMAND(FileMoveReq, fileMoveReq, setFileMoveResp, handleFileMove);
+    REGISTER_COMMAND(GetCapabilitiesReq, getCapabilitiesReq, setGetCapabilitiesResp, handleGetCapabilities);
+    REGISTER_COMMAND(GetSystemInfoReq, getSystemInfoReq, setGetSystemInfoResp, handleGetSystemInfo);
+    REGISTER_COMMAND(EcRawReq, ecRawReq, setEcRawResp, handleEcRawCommand);
+    REGISTER_COMMAND(EcAcpiReadReq, ecAcpiReadReq, setEcAcpiReadResp, handleEcAcpiRead);
+    REGISTER_COMMAND(EcAcpiWriteReq, ecAcpiWriteReq, setEcAcpiWriteResp, handleEcAcpiWrite);
+    REGISTER_COMMAND(EcAcpiQueueWriteReq, ecAcpiQueueWriteReq, setEcAcpiQueueWriteResp, handleEcAcpiQueueWrite);
+    REGISTER_COMMAND(EcRamReadReq, ecRamReadReq, setEcRamReadResp, handleEcRamRead);
+    REGISTER_COMMAND(EcDfuInfoReq, ecDfuInfoReq, setEcDfuInfoResp, handleEcDfuInfo);
+    REGISTER_COMMAND(EcBatteryHealthReq, ecBatteryHealthReq, setEcBatteryHealthResp, handleEcBatteryHealth);
+    REGISTER_COMMAND(EcPeciReadReq, ecPeciReadReq, setEcPeciReadResp, handleEcPeciRead);
+    REGISTER_COMMAND(EcPeciWriteReq, ecPeciWriteReq, setEcPeciWriteResp, handleEcPeciWrite);
+    REGISTER_COMMAND(EcSmbusReq, ecSmbusReq, setEcSmbusResp, handleEcSmbus);
+    REGISTER_COMMAND(EcShellReq, ecShellReq, setEcShellResp, handleEcShellCommand);
+    REGISTER_COMMAND(EcStatusReq, ecStatusReq, setEcStatusResp, handleEcGetStatus);
+    REGISTER_COMMAND(PowerReq, powerReq, setPowerResp, handlePowerCommand);
+    REGISTER_COMMAND(PollActionCmdsReq, pollActionCmdsReq, setPollActionCmdsResp, handlePollActionCommands);
+    REGISTER_COMMAND(ActionCmdResultReq, actionCmdResultReq, setActionCmdResultResp, handleActionCommandResult);
+    REGISTER_COMMAND(DisplayBrightnessReq, displayBrightnessReq, setDisplayBrightnessResp, handleDisplayBrightness);
+    REGISTER_COMMAND(DisplayAutoBrightnessReq, displayAutoBrightnessReq, setDisplayAutoBrightnessResp, handleDisplayAutoBrightness);
+}
 
-    // Route based on which payload field is set
-    if (request.hasMsrReadReq()) {
-        response.setMsrReadResp(handleMsrRead(request.msrReadReq()));
-    }
-    else if (request.hasMsrWriteReq()) {
-        response.setMsrWriteResp(handleMsrWrite(request.msrWriteReq()));
-    }
-    else if (request.hasRegistryReadReq()) {
-        response.setRegistryReadResp(handleRegistryRead(request.registryReadReq()));
-    }
-    else if (request.hasRegistryWriteReq()) {
-        response.setRegistryWriteResp(handleRegistryWrite(request.registryWriteReq()));
-    }
-    else if (request.hasRegistryDeleteReq()) {
-        response.setRegistryDeleteResp(handleRegistryDelete(request.registryDeleteReq()));
-    }
-    else if (request.hasWmiQueryReq()) {
-        response.setWmiQueryResp(handleWmiQuery(request.wmiQueryReq()));
-    }
-    else if (request.hasFileDeleteReq()) {
-        response.setFileDeleteResp(handleFileDelete(request.fileDeleteReq()));
-    }
-    else if (request.hasFileRenameReq()) {
-        response.setFileRenameResp(handleFileRename(request.fileRenameReq()));
-    }
-    else if (request.hasFileCopyReq()) {
-        response.setFileCopyResp(handleFileCopy(request.fileCopyReq()));
-    }
-    else if (request.hasFileMoveReq()) {
-        response.setFileMoveResp(handleFileMove(request.fileMoveReq()));
-    }
-    else if (request.hasGetCapabilitiesReq()) {
-        response.setGetCapabilitiesResp(handleGetCapabilities(request.getCapabilitiesReq()));
+void CommandProc::registerHandler(int fieldNumber, const QString& name, CommandHandler handler)
+{
+    if (fieldNumber <= 0 || !handler) {
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("Ignoring handler registration for field %1").arg(fieldNumber));
+        return;
     }
-    else if (request.hasGetSystemInfoReq()) {
-        response.setGetSystemInfoResp(handleGetSystemInfo(request.getSystemInfoReq()));
+
+    if (fieldNumber >= m_handlers.size()) {
+        m_handlers.resize(fieldNumber + 1, nullptr);
     }
-    // EC Commands
-    else if (request.hasEcRawReq()) {
-        response.setEcRawResp(handleEcRawCommand(request.ecRawReq()));
+
+    delete m_handlers[fieldNumber];
+
+    HandlerEntry* entry = new HandlerEntry;
+    entry->name = name;
+    entry->fieldNumber = fieldNumber;
+    entry->handler = std::move(handler);
+    m_handlers[fieldNumber] = entry;
+}
+
+void CommandProc::addMiddleware(CommandMiddleware middleware)
+{
+    if (middleware) {
+        m_middleware.append(std::move(middleware));
     }
-    else if (request.hasEcAcpiReadReq()) {
-        response.setEcAcpiReadResp(handleEcAcpiRead(request.ecAcpiReadReq()));
+}
+
+CommandProc::HandlerEntry* CommandProc::handlerFor(const patrol::Command& request) const
+{
+    const int field = static_cast<int>(request.payloadField());
+    return (field > 0 && field < m_handlers.size()) ? m_handlers.at(field) : nullptr;
+}
+
+int CommandProc::runChain(int index, const HandlerEntry& entry, const CommandContext& ctx)
+{
+    if (index >= m_middleware.size()) {
+        return entry.handler(ctx.request, ctx.response);
     }
-    else if (request.hasEcAcpiWriteReq()) {
-        response.setEcAcpiWriteResp(handleEcAcpiWrite(request.ecAcpiWriteReq()));
+
+    return m_middleware.at(index)(ctx, [this, index, &entry, &ctx]() {
+        return runChain(index + 1, entry, ctx);
+    });
+}
+
+void CommandProc::recordDispatch(HandlerEntry* entry, int result, quint64 elapsedUs)
+{
+    entry->latency.record(elapsedUs);
+    if (result != static_cast<int>(ResultCode::RES_OK)) {
+        entry->errors.fetch_add(1, std::memory_order_relaxed);
     }
-    else if (request.hasEcAcpiQueueWriteReq()) {
-        response.setEcAcpiQueueWriteResp(handleEcAcpiQueueWrite(request.ecAcpiQueueWriteReq()));
+}
+
+patrol::Command CommandProc::processCommand(const patrol::Command& request, int* resultCode, quintptr consumerId)
+{
+    patrol::Command response;
+    response.setSequenceNumber(request.sequenceNumber());
+    int result = static_cast<int>(ResultCode::RES_FAILED_OP);
+
+    const quintptr outerConsumer = t_dispatchConsumer;
+    t_dispatchConsumer = consumerId;
+
+    // Route on the payload oneof case - one table index instead of a has*() chain
+    HandlerEntry* entry = handlerFor(request);
+
+    if (entry) {
+        QElapsedTimer timer;
+        timer.start();
+
+        if (m_middleware.isEmpty()) {
+            result = entry->handler(request, response);
+        } else {
+            CommandContext ctx{request, response, entry->name};
+            result = runChain(0, *entry, ctx);
+        }
+
+        recordDispatch(entry, result, static_cast<quint64>(timer.nsecsElapsed() / 1000));
     }
-    else if (request.hasEcRamReadReq()) {
-        response.setEcRamReadResp(handleEcRamRead(request.ecRamReadReq()));
+    else {
+        m_unknownCommands.fetch_add(1, std::memory_order_relaxed);
+        LOG_WARNING(m_pLogger, CatCommandProc, "Unknown command type received");
     }
-    else if (request.hasEcDfuInfoReq()) {
-        response.setEcDfuInfoResp(handleEcDfuInfo(request.ecDfuInfoReq()));
+    t_dispatchConsumer = outerConsumer;
+
+    if (resultCode) {
+        *resultCode = result;
     }
-    else if (request.hasEcBatteryHealthReq()) {
-        response.setEcBatteryHealthResp(handleEcBatteryHealth(request.ecBatteryHealthReq()));
+    return response;
+}
+
+void CommandProc::processWmiQueryAsync(const patrol::Command& request, CommandCallback done)
+{
+    HandlerEntry* entry = handlerFor(request);
+    if (!request.hasWmiQueryReq() || !entry || !m_middleware.isEmpty()) {
+        int result = static_cast<int>(ResultCode::RES_FAILED_OP);
+        const patrol::Command response = processCommand(request, &result);
+        done(response, result);
+        return;
+    }
+
+    const patrol::WmiQueryRequest& req = request.wmiQueryReq();
+    const QString namespacePath = req.namespacePath().isEmpty() ? QStringLiteral("ROOT\\CIMV2") : req.namespacePath();
+
+    LOG_INFO(m_pLogger, CatCommandProc, QString("WMI Query - Namespace: %1, Query: %2, Property: %3")
+                                            .arg(namespacePath, req.query(), req.property_proto()));
+
+    QElapsedTimer timer;
+    timer.start();
+    m_wmiCache.queryAsync(namespacePath, req.query(), req.property_proto(),
+                          [this, entry, timer, request, done](bool ok, const WmiRows& rows) {
+        patrol::Command response;
+        response.setSequenceNumber(request.sequenceNumber());
+        patrol::WmiQueryResponse resp = wmiQueryResponse(ok, rows);
+        const int result = resp.result();
+        response.setWmiQueryResp(std::move(resp));
+
+        recordDispatch(entry, result, static_cast<quint64>(timer.nsecsElapsed() / 1000));
+        done(response, result);
+    });
+}
+
+patrol::MetricsResponse CommandProc::collectMetrics(bool reset)
+{
+    patrol::MetricsResponse resp;
+
+    QtProtobuf::uint32List bounds;
+    for (quint32 bound : LatencyHistogram::boundsUs()) {
+        bounds.append(bound);
     }
-    else if (request.hasEcPeciReadReq()) {
-        response.setEcPeciReadResp(handleEcPeciRead(request.ecPeciReadReq()));
+    resp.setBucketBoundsUs(bounds);
+
+    QList<patrol::HandlerMetrics> handlers;
+    for (HandlerEntry* entry : m_handlers) {
+        if (!entry) {
+            continue;
+        }
+
+        LatencyHistogram::Snapshot snap = entry->latency.snapshot();
+        quint64 errors = entry->errors.load(std::memory_order_relaxed);
+        if (reset) {
+            entry->latency.reset();
+            entry->errors.store(0, std::memory_order_relaxed);
+        }
+
+        // Handlers that never ran only add noise
+        if (snap.count == 0) {
+            continue;
+        }
+
+        patrol::HandlerMetrics metrics;
+        metrics.setName(entry->name);
+        metrics.setFieldNumber(entry->fieldNumber);
+        metrics.setCalls(snap.count);
+        metrics.setErrors(errors);
+        metrics.setTotalUs(snap.totalUs);
+        metrics.setMaxUs(snap.maxUs);
+
+        QtProtobuf::uint64List buckets;
+        for (quint64 count : snap.buckets) {
+            buckets.append(count);
+        }
+        metrics.setLatencyBuckets(buckets);
+        handlers.append(metrics);
+    }
+    resp.setHandlers(handlers);
+
+    QList<patrol::InputLatencyMetrics> inputLatency;
+    const struct { ActionCommandQueue::Delivery delivery; const char* name; } paths[] = {
+        { ActionCommandQueue::Delivery::Poll, "poll" },
+        { ActionCommandQueue::Delivery::Push, "push" },
+    };
+    for (const auto& path : paths) {
+        LatencyHistogram& histogram = m_actionQueue.deliveryLatency(path.delivery);
+        LatencyHistogram::Snapshot snap = histogram.snapshot();
+        if (reset) {
+            histogram.reset();
+        }
+
+        patrol::InputLatencyMetrics metrics;
+        metrics.setDelivery(QString::fromLatin1(path.name));
+        metrics.setEvents(snap.count);
+        metrics.setTotalUs(snap.totalUs);
+        metrics.setMaxUs(snap.maxUs);
+
+        QtProtobuf::uint64List buckets;
+        for (quint64 count : snap.buckets) {
+            buckets.append(count);
+        }
+        metrics.setLatencyBuckets(buckets);
+        inputLatency.append(metrics);
     }
-    else if (request.hasEcPeciWriteReq()) {
-        response.setEcPeciWriteResp(handleEcPeciWrite(request.ecPeciWriteReq()));
+    resp.setInputLatency(inputLatency);
+
+    resp.setUnknownCommands(reset ? m_unknownCommands.exchange(0) : m_unknownCommands.load());
+    resp.setResult(static_cast<int>(ResultCode::RES_OK));
+    return resp;
+}
+
+patrol::WmiCacheResponse CommandProc::handleWmiCache(const patrol::WmiCacheRequest& req)
+{
+    patrol::WmiCacheResponse resp;
+
+    if (req.invalidate()) {
+        int dropped = 0;
+        if (req.classNames().isEmpty()) {
+            dropped = m_wmiCache.invalidate();
+        } else {
+            for (const QString& className : req.classNames()) {
+                dropped += m_wmiCache.invalidate(className);
+            }
+        }
+        resp.setInvalidated(static_cast<quint32>(dropped));
+        LOG_INFO(m_pLogger, CatCommandProc, QString("WMI cache invalidated, %1 entries dropped").arg(dropped));
+    }
+
+    const WmiCacheStats stats = m_wmiCache.stats(req.resetStats());
+    resp.setHits(stats.hits);
+    resp.setMisses(stats.misses);
+    resp.setJoined(stats.joined);
+    resp.setFailures(stats.failures);
+    resp.setEvictions(stats.evictions);
+    resp.setEntries(static_cast<quint32>(stats.entries));
+
+    const WmiEngineStats engine = m_wmiEngine.stats(req.resetStats());
+    resp.setEngineWorkers(static_cast<quint32>(engine.workers));
+    resp.setEngineBusy(static_cast<quint32>(engine.busy));
+    resp.setEngineQueued(static_cast<quint32>(engine.queued));
+    resp.setEnginePeakQueued(static_cast<quint32>(engine.peakQueued));
+    resp.setEngineRejected(engine.rejected);
+    resp.setEngineTimedOut(engine.timedOut);
+    resp.setEngineTruncated(engine.truncated);
+    resp.setResult(static_cast<int>(ResultCode::RES_OK));
+    return resp;
+}
+
+// ============================================================================
+// Batch Processing
+// ============================================================================
+
+patrol::CommandBatchResponse CommandProc::processBatch(const patrol::CommandBatchRequest& request, quintptr consumerId)
+{
+    patrol::CommandBatchResponse resp;
+    const QList<patrol::Command>& commands = request.commands();
+    const bool stopOnError = request.stopOnError();
+
+    if (commands.size() > MAX_BATCH_COMMANDS) {
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("Batch rejected - %1 commands (max %2)")
+                                                   .arg(commands.size()).arg(MAX_BATCH_COMMANDS));
+        resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
+        resp.setExecutedCount(0);
+        return resp;
     }
-    else if (request.hasEcSmbusReq()) {
-        response.setEcSmbusResp(handleEcSmbus(request.ecSmbusReq()));
+
+    QList<patrol::Command> responses;
+    responses.reserve(commands.size());
+    int batchResult = static_cast<int>(ResultCode::RES_OK);
+    bool stopped = false;
+
+    // The whole batch runs on the pipe thread, so it gets one time budget rather
+    // than the sum of its commands' timeouts; commands not started in time are
+    // left out of the response (executed_count tells the client where it stopped)
+    QDeadlineTimer budget(MAX_BATCH_TIME_MS);
+
+    int i = 0;
+    while (i < commands.size() && !stopped) {
+        if (budget.hasExpired()) {
+            LOG_WARNING(m_pLogger, CatCommandProc, QString("Batch time budget of %1ms spent after %2 of %3 commands")
+                                                       .arg(MAX_BATCH_TIME_MS).arg(i).arg(commands.size()));
+            batchResult = static_cast<int>(ResultCode::RES_FAILED_OP);
+            break;
+        }
+
+        // Collect a run of consecutive EC commands that can share one EmiThread
+        // hand-off. With stop-on-error only reads are grouped, so a failure never
+        // leaves later writes already applied on the EC. Grouped commands do not
+        // pass through middleware, so nothing is grouped once middleware is installed.
+        QList<QSharedPointer<EmiCmd>> group;
+        qint64 groupTimeout = 0;
+        if (isEcInitialized() && m_middleware.isEmpty()) {
+            for (int j = i; j < commands.size(); j++) {
+                QSharedPointer<EmiCmd> pCmd = buildGroupedEcCmd(commands.at(j), stopOnError);
+                if (!pCmd) {
+                    break;
+                }
+                groupTimeout += pCmd->waittime;
+                group.append(pCmd);
+            }
+        }
+        groupTimeout = qMin(groupTimeout, qMax<qint64>(1, budget.remainingTime()));
+
+        if (group.size() > 1) {
+            LOG_DEBUG(m_pLogger, CatCommandProc, QString("Batch: sending %1 EC commands as one group").arg(group.size()));
+            QElapsedTimer groupTimer;
+            groupTimer.start();
+            QList<bool> completed;
+            m_pEcManager->sendCommandsSync(group, completed, static_cast<int>(groupTimeout));
+
+            // Grouped commands skip the handler table; account each one under
+            // its handler with an even share of the group's time
+            const quint64 shareUs = static_cast<quint64>(groupTimer.nsecsElapsed() / 1000) / group.size();
+
+            for (int g = 0; g < group.size(); g++) {
+                int result = static_cast<int>(ResultCode::RES_FAILED_OP);
+                responses.append(groupedEcResponse(commands.at(i + g), *group.at(g), completed.at(g), &result));
+                if (HandlerEntry* entry = handlerFor(commands.at(i + g))) {
+                    recordDispatch(entry, result, shareUs);
+                }
+                if (result != static_cast<int>(ResultCode::RES_OK)) {
+                    batchResult = static_cast<int>(ResultCode::RES_FAILED_OP);
+                    if (stopOnError) {
+                        stopped = true;
+                        break;
+                    }
+                }
+            }
+            i += group.size();
+            continue;
+        }
+
+        int result = static_cast<int>(ResultCode::RES_FAILED_OP);
+        if (commands.at(i).hasWmiQueryReq()) {
+            // Would hold the pipe thread for seconds; WmiQuery is only answered asynchronously
+            LOG_WARNING(m_pLogger, CatCommandProc, "Batch: WmiQuery refused, send it alone or in a BulkRequest");
+            patrol::WmiQueryResponse refused;
+            refused.setResult(result);
+            patrol::Command response;
+            response.setSequenceNumber(commands.at(i).sequenceNumber());
+            response.setWmiQueryResp(refused);
+            responses.append(response);
+        } else {
+            responses.append(processCommand(commands.at(i), &result, consumerId));
+        }
+        i++;
+
+        if (result != static_cast<int>(ResultCode::RES_OK)) {
+            batchResult = static_cast<int>(ResultCode::RES_FAILED_OP);
+            stopped = stopOnError;
+        }
     }
-    else if (request.hasEcShellReq()) {
-        response.setEcShellResp(handleEcShellCommand(request.ecShellReq()));
+
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("Batch processed %1 of %2 commands%3")
+                                             .arg(responses.size()).arg(commands.size())
+                                             .arg(stopped ? " (stopped on error)" : ""));
+
+    resp.setResult(batchResult);
+    resp.setExecutedCount(responses.size());
+    resp.setResponses(responses);
+    return resp;
+}
+
+QSharedPointer<EmiCmd> CommandProc::buildGroupedEcCmd(const patrol::Command& request, bool readOnly) const
+{
+    // Same encoding as the single-command handlers - both go through EcManager's builders
+    if (request.hasEcAcpiReadReq()) {
+        const patrol::EcAcpiReadRequest& req = request.ecAcpiReadReq();
+        return EcManager::makeAcpiRead(req.namespaceId(), req.offset(), req.size());
     }
-    else if (request.hasEcStatusReq()) {
-        response.setEcStatusResp(handleEcGetStatus(request.ecStatusReq()));
+    if (request.hasEcRamReadReq()) {
+        const patrol::EcRamReadRequest& req = request.ecRamReadReq();
+        return EcManager::makeEcRamRead(req.offset(), req.size());
     }
-    else if (request.hasPowerReq()) {
-        response.setPowerResp(handlePowerCommand(request.powerReq()));
+    if (!readOnly && request.hasEcAcpiWriteReq()) {
+        const patrol::EcAcpiWriteRequest& req = request.ecAcpiWriteReq();
+        return EcManager::makeAcpiWrite(req.namespaceId(), req.offset(), req.data());
     }
-    else if (request.hasPollActionCmdsReq()) {
-        response.setPollActionCmdsResp(handlePollActionCommands(request.pollActionCmdsReq()));
+    if (!readOnly && request.hasEcRawReq()) {
+        const patrol::EcRawCommandRequest& req = request.ecRawReq();
+        return EcManager::makeRaw(static_cast<quint16>(req.commandId()), req.payload(), req.timeoutMs());
     }
-    else if (request.hasActionCmdResultReq()) {
-        response.setActionCmdResultResp(handleActionCommandResult(request.actionCmdResultReq()));
+    return QSharedPointer<EmiCmd>();
+}
+
+patrol::Command CommandProc::groupedEcResponse(const patrol::Command& request, const EmiCmd& cmd, bool completed,
+                                               int* resultCode) const
+{
+    patrol::Command response;
+    response.setSequenceNumber(request.sequenceNumber());
+
+    // An unfinished command still belongs to EmiThread: report a timeout
+    // without reading its result or payload
+    const EC_HOST_CMD_STATUS status = completed ? static_cast<EC_HOST_CMD_STATUS>(cmd.result) : EC_HOST_CMD_TIMEOUT;
+    const QByteArray payload = completed ? cmd.payloadin : QByteArray();
+    int result = (status == EC_HOST_CMD_SUCCESS) ?
+                     static_cast<int>(ResultCode::RES_OK) :
+                     static_cast<int>(ResultCode::RES_FAILED_OP);
+
+    if (request.hasEcAcpiReadReq()) {
+        patrol::EcAcpiReadResponse resp;
+        resp.setResult(result);
+        resp.setEcStatus(static_cast<EcStatus>(status));
+        resp.setData(payload);
+        response.setEcAcpiReadResp(resp);
     }
-    else if (request.hasDisplayBrightnessReq()) {
-        response.setDisplayBrightnessResp(
-            handleDisplayBrightness(request.displayBrightnessReq()));
+    else if (request.hasEcRamReadReq()) {
+        patrol::EcRamReadResponse resp;
+        resp.setResult(result);
+        resp.setEcStatus(static_cast<EcStatus>(status));
+        resp.setData(payload);
+        response.setEcRamReadResp(resp);
     }
-    else if (request.hasDisplayAutoBrightnessReq()) {
-        response.setDisplayAutoBrightnessResp(
-            handleDisplayAutoBrightness(request.displayAutoBrightnessReq()));
+    else if (request.hasEcAcpiWriteReq()) {
+        patrol::EcAcpiWriteResponse resp;
+        resp.setResult(result);
+        resp.setEcStatus(static_cast<EcStatus>(status));
+        response.setEcAcpiWriteResp(resp);
     }
-    else {
-        m_pLogger->log("Unknown command type received", Logger::Warning);
+    else if (request.hasEcRawReq()) {
+        patrol::EcRawCommandResponse resp;
+        resp.setResult(result);
+        resp.setEcStatus(static_cast<EcStatus>(status));
+        resp.setPayload(payload);
+        response.setEcRawResp(resp);
     }
 
+    if (resultCode) {
+        *resultCode = result;
+    }
     return response;
 }
+
 uint32_t CommandProc::queueAddAction(uint32_t eventId, const QString& name, const QString& qmlPath, const QStringList& params, int position)
 {
     patrol::ActionCommand cmd;
@@ -236,7 +624,7 @@ patrol::MsrReadResponse CommandProc::handleMsrRead(const patrol::MsrReadRequest&
     patrol::MsrReadResponse resp;
 
     quint32 msrAddr = static_cast<quint32>(req.msrAddress());
-    m_pLogger->log(QString("MSR Read request - MSR: 0x%1").arg(msrAddr, 0, 16));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("MSR Read request - MSR: 0x%1").arg(msrAddr, 0, 16));
 
     // TODO: Implement actual MSR read via WinRing0 driver
     resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
@@ -254,8 +642,8 @@ patrol::MsrWriteResponse CommandProc::handleMsrWrite(const patrol::MsrWriteReque
     quint32 dataL = static_cast<quint32>(req.dataLow());
     quint32 dataH = static_cast<quint32>(req.dataHigh());
 
-    m_pLogger->log(QString("MSR Write request - MSR: 0x%1, Low: 0x%2, High: 0x%3")
-                       .arg(msrAddr, 0, 16).arg(dataL, 0, 16).arg(dataH, 0, 16));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("MSR Write request - MSR: 0x%1, Low: 0x%2, High: 0x%3")
+                                            .arg(msrAddr, 0, 16).arg(dataL, 0, 16).arg(dataH, 0, 16));
 
     // TODO: Implement actual MSR write via WinRing0 driver
     resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
@@ -275,7 +663,7 @@ patrol::RegistryReadResponse CommandProc::handleRegistryRead(const patrol::Regis
     QString valueName = req.valueName();
     auto valueType = req.valueType();
 
-    m_pLogger->log(QString("Registry Read - Key: %1, Value: %2").arg(keyPath, valueName));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("Registry Read - Key: %1, Value: %2").arg(keyPath, valueName));
 
     QVariant value;
     quint16 regType = 0;
@@ -330,18 +718,58 @@ patrol::RegistryReadResponse CommandProc::handleRegistryRead(const patrol::Regis
             break;
         }
 
-        m_pLogger->log(QString("Registry Read success - Value: %1").arg(value.toString()));
+        LOG_INFO(m_pLogger, CatCommandProc, QString("Registry Read success - Value: %1").arg(value.toString()));
     } else {
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log("Registry Read failed", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "Registry Read failed");
     }
 
     return resp;
 }
-void CommandProc::triggerActionEvent(uint32_t eventId)
+void CommandProc::triggerActionEvent(uint32_t eventId, qint64 detectedUs)
+{
+    m_actionQueue.triggerEvent(eventId, detectedUs);
+    LOG_INFO(m_pLogger, CatCommandProc, QString("Queued action trigger for event 0x%1").arg(eventId, 0, 16));
+}
+
+void CommandProc::triggerActionValue(uint32_t eventId, int value, qint64 detectedUs)
 {
-    m_actionQueue.triggerEvent(eventId);
-    m_pLogger->log(QString("Queued action trigger for event 0x%1").arg(eventId, 0, 16), Logger::Info);
+    // Value travels in ActionCommand.index, so consumers need no register readback
+    m_actionQueue.triggerValue(eventId, value, detectedUs);
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("Queued action value %1 for event 0x%2").arg(value).arg(eventId, 0, 16));
+}
+
+void CommandProc::setNotificationHub(NotificationHub* hub)
+{
+    if (m_pNotificationHub && m_pNotificationHub != hub) {
+        m_pNotificationHub->setActionSource(nullptr);
+    }
+    m_pNotificationHub = hub;
+
+    if (hub) {
+        hub->setActionSource(&m_actionQueue);
+        m_actionQueue.setAvailableHook([hub]() {
+            hub->actionsAvailable();
+        });
+    } else {
+        m_actionQueue.setAvailableHook(nullptr);
+    }
+}
+
+ActionBatch CommandProc::pollActionCommands(quintptr consumerId, const ActionConsumerFilter& filter, int maxCommands)
+{
+    m_actionQueue.registerConsumer(consumerId, filter);
+    ActionBatch batch = m_actionQueue.takeFor(consumerId, ActionCommandQueue::Delivery::Poll, maxCommands);
+
+    if (batch.dropped) {
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("Action consumer fell behind, %1 commands dropped").arg(batch.dropped));
+    }
+    return batch;
+}
+
+void CommandProc::releaseActionConsumer(quintptr consumerId)
+{
+    m_actionQueue.unregisterConsumer(consumerId);
 }
 
 patrol::PollActionCommandsResponse CommandProc::handlePollActionCommands(const patrol::PollActionCommandsRequest& req)
@@ -349,16 +777,38 @@ patrol::PollActionCommandsResponse CommandProc::handlePollActionCommands(const p
     Q_UNUSED(req)
     patrol::PollActionCommandsResponse resp;
     resp.setResult(0);
-    resp.setCommands(m_actionQueue.takePending());
+
+    // Keyed by the pipe client like ActionPollRequest, so legacy pollers do
+    // not share one cursor and each is released when its client disconnects.
+    // Never waits: pipe clients long-poll with ActionPollRequest.wait_ms.
+    const ActionBatch batch = m_actionQueue.takeFor(t_dispatchConsumer, ActionCommandQueue::Delivery::Poll);
+    if (batch.dropped) {
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("Action consumer fell behind, %1 commands dropped").arg(batch.dropped));
+    }
+    resp.setCommands(batch.commands);
     return resp;
 }
 
+void CommandProc::storeActionResult(uint32_t commandId, const patrol::ActionCommandResultRequest& result)
+{
+    m_actionQueue.storeResult(commandId, result);
+}
+
+bool CommandProc::getActionResult(uint32_t commandId, patrol::ActionCommandResultRequest& outResult, int timeoutMs)
+{
+    if (m_actionQueue.waitForResult(commandId, outResult, timeoutMs)) {
+        return true;
+    }
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("No result for action command %1 within %2ms").arg(commandId).arg(timeoutMs));
+    return false;
+}
+
 patrol::ActionCommandResultResponse CommandProc::handleActionCommandResult(const patrol::ActionCommandResultRequest& req)
 {
-    // Store the result so Control Screens can retrieve it
-    m_actionQueue.storeResult(req.commandId(), req);
+    // Store the result so Control Screens can retrieve it; unclaimed results expire
+    storeActionResult(req.commandId(), req);
 
-    m_pLogger->log(QString("Action command %1 result: %2").arg(req.commandId()).arg(req.result()), Logger::Debug);
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("Action command %1 result: %2").arg(req.commandId()).arg(req.result()));
 
     patrol::ActionCommandResultResponse resp;
     resp.setResult(0);
@@ -374,8 +824,8 @@ patrol::QueueActionCommandResponse CommandProc::handleQueueActionCommand(const p
     resp.setResult(0);
     resp.setCommandId(cmdId);
 
-    m_pLogger->log(QString("Queued action command type %1, id %2")
-                       .arg(static_cast<int>(req.command().type())).arg(cmdId), Logger::Debug);
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("Queued action command type %1, id %2")
+                                             .arg(static_cast<int>(req.command().type())).arg(cmdId));
     return resp;
 }
 patrol::RegistryWriteResponse CommandProc::handleRegistryWrite(const patrol::RegistryWriteRequest& req)
@@ -386,7 +836,7 @@ patrol::RegistryWriteResponse CommandProc::handleRegistryWrite(const patrol::Reg
     QString valueName = req.valueName();
     auto valueType = req.valueType();
 
-    m_pLogger->log(QString("Registry Write - Key: %1, Value: %2").arg(keyPath, valueName));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("Registry Write - Key: %1, Value: %2").arg(keyPath, valueName));
 
     QVariant value;
     quint16 regType = 0;
@@ -422,10 +872,10 @@ patrol::RegistryWriteResponse CommandProc::handleRegistryWrite(const patrol::Reg
 
     if (success) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("Registry Write success");
+        LOG_INFO(m_pLogger, CatCommandProc, "Registry Write success");
     } else {
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log("Registry Write failed", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "Registry Write failed");
     }
 
     return resp;
@@ -438,7 +888,7 @@ patrol::RegistryDeleteResponse CommandProc::handleRegistryDelete(const patrol::R
     QString keyPath = req.keyPath();
     QString valueName = req.valueName();
 
-    m_pLogger->log(QString("Registry Delete - Key: %1, Value: %2").arg(keyPath, valueName));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("Registry Delete - Key: %1, Value: %2").arg(keyPath, valueName));
 
     bool success;
     if (valueName.isEmpty()) {
@@ -449,10 +899,10 @@ patrol::RegistryDeleteResponse CommandProc::handleRegistryDelete(const patrol::R
 
     if (success) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("Registry Delete success");
+        LOG_INFO(m_pLogger, CatCommandProc, "Registry Delete success");
     } else {
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log("Registry Delete failed", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "Registry Delete failed");
     }
 
     return resp;
@@ -464,8 +914,6 @@ patrol::RegistryDeleteResponse CommandProc::handleRegistryDelete(const patrol::R
 
 patrol::WmiQueryResponse CommandProc::handleWmiQuery(const patrol::WmiQueryRequest& req)
 {
-    patrol::WmiQueryResponse resp;
-
     QString namespacePath = req.namespacePath();
     QString query = req.query();
     QString property = req.property_proto();
@@ -474,17 +922,23 @@ patrol::WmiQueryResponse CommandProc::handleWmiQuery(const patrol::WmiQueryReque
         namespacePath = "ROOT\\CIMV2";
     }
 
-    m_pLogger->log(QString("WMI Query - Namespace: %1, Query: %2, Property: %3")
-                       .arg(namespacePath, query, property));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("WMI Query - Namespace: %1, Query: %2, Property: %3")
+                                            .arg(namespacePath, query, property));
 
-    QVector<QMap<QString, QVariant>> queryResults;
-    bool success = m_WmiAccess.query(namespacePath, query, queryResults, property);
+    WmiRows queryResults;
+    const bool success = m_wmiCache.query(namespacePath, query, queryResults, property);
+    return wmiQueryResponse(success, queryResults);
+}
 
-    if (success) {
+patrol::WmiQueryResponse CommandProc::wmiQueryResponse(bool ok, const WmiRows& rows) const
+{
+    patrol::WmiQueryResponse resp;
+
+    if (ok) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
 
         QList<patrol::WmiQueryResult> results;
-        for (const auto& resultMap : queryResults) {
+        for (const auto& resultMap : rows) {
             patrol::WmiQueryResult queryResult;
             QList<patrol::WmiPropertyValue> properties;
 
@@ -501,10 +955,10 @@ patrol::WmiQueryResponse CommandProc::handleWmiQuery(const patrol::WmiQueryReque
         }
 
         resp.setResults(results);
-        m_pLogger->log(QString("WMI Query success - %1 results").arg(results.size()));
+        LOG_INFO(m_pLogger, CatCommandProc, QString("WMI Query success - %1 results").arg(results.size()));
     } else {
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log("WMI Query failed", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "WMI Query failed");
     }
 
     return resp;
@@ -519,15 +973,15 @@ patrol::FileDeleteResponse CommandProc::handleFileDelete(const patrol::FileDelet
     patrol::FileDeleteResponse resp;
 
     QString filePath = req.filePath();
-    m_pLogger->log(QString("File Delete - Path: %1").arg(filePath));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("File Delete - Path: %1").arg(filePath));
 
     if (DeleteFileW(reinterpret_cast<LPCWSTR>(filePath.utf16()))) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("File Delete success");
+        LOG_INFO(m_pLogger, CatCommandProc, "File Delete success");
     } else {
         DWORD error = GetLastError();
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log(QString("File Delete failed - Error: %1").arg(error), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("File Delete failed - Error: %1").arg(error));
     }
 
     return resp;
@@ -539,16 +993,16 @@ patrol::FileRenameResponse CommandProc::handleFileRename(const patrol::FileRenam
 
     QString oldPath = req.oldPath();
     QString newPath = req.newPath();
-    m_pLogger->log(QString("File Rename - Old: %1, New: %2").arg(oldPath, newPath));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("File Rename - Old: %1, New: %2").arg(oldPath, newPath));
 
     if (MoveFileW(reinterpret_cast<LPCWSTR>(oldPath.utf16()),
                   reinterpret_cast<LPCWSTR>(newPath.utf16()))) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("File Rename success");
+        LOG_INFO(m_pLogger, CatCommandProc, "File Rename success");
     } else {
         DWORD error = GetLastError();
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log(QString("File Rename failed - Error: %1").arg(error), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("File Rename failed - Error: %1").arg(error));
     }
 
     return resp;
@@ -560,16 +1014,16 @@ patrol::FileCopyResponse CommandProc::handleFileCopy(const patrol::FileCopyReque
 
     QString sourcePath = req.sourcePath();
     QString destPath = req.destPath();
-    m_pLogger->log(QString("File Copy - Source: %1, Dest: %2").arg(sourcePath, destPath));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("File Copy - Source: %1, Dest: %2").arg(sourcePath, destPath));
 
     if (CopyFileW(reinterpret_cast<LPCWSTR>(sourcePath.utf16()),
                   reinterpret_cast<LPCWSTR>(destPath.utf16()), FALSE)) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("File Copy success");
+        LOG_INFO(m_pLogger, CatCommandProc, "File Copy success");
     } else {
         DWORD error = GetLastError();
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log(QString("File Copy failed - Error: %1").arg(error), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("File Copy failed - Error: %1").arg(error));
     }
 
     return resp;
@@ -581,16 +1035,16 @@ patrol::FileMoveResponse CommandProc::handleFileMove(const patrol::FileMoveReque
 
     QString sourcePath = req.sourcePath();
     QString destPath = req.destPath();
-    m_pLogger->log(QString("File Move - Source: %1, Dest: %2").arg(sourcePath, destPath));
+    LOG_INFO(m_pLogger, CatCommandProc, QString("File Move - Source: %1, Dest: %2").arg(sourcePath, destPath));
 
     if (MoveFileW(reinterpret_cast<LPCWSTR>(sourcePath.utf16()),
                   reinterpret_cast<LPCWSTR>(destPath.utf16()))) {
         resp.setResult(static_cast<int>(ResultCode::RES_OK));
-        m_pLogger->log("File Move success");
+        LOG_INFO(m_pLogger, CatCommandProc, "File Move success");
     } else {
         DWORD error = GetLastError();
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
-        m_pLogger->log(QString("File Move failed - Error: %1").arg(error), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("File Move failed - Error: %1").arg(error));
     }
 
     return resp;
@@ -621,7 +1075,7 @@ patrol::GetCapabilitiesResponse CommandProc::handleGetCapabilities(const patrol:
 
     resp.setCapabilities(caps);
 
-    m_pLogger->log("GetCapabilities processed");
+    LOG_INFO(m_pLogger, CatCommandProc, "GetCapabilities processed");
     return resp;
 }
 
@@ -655,7 +1109,7 @@ patrol::GetSystemInfoResponse CommandProc::handleGetSystemInfo(const patrol::Get
     GetSystemInfo(&sysInfo);
     resp.setCpuCount(sysInfo.dwNumberOfProcessors);
 
-    m_pLogger->log("GetSystemInfo processed");
+    LOG_INFO(m_pLogger, CatCommandProc, "GetSystemInfo processed");
     return resp;
 }
 
@@ -670,7 +1124,7 @@ patrol::EcRawCommandResponse CommandProc::handleEcRawCommand(const patrol::EcRaw
     if (!isEcInitialized()) {
         resp.setResult(static_cast<int>(ResultCode::RES_FAILED_OP));
         resp.setEcStatus(EcStatus::EC_STATUS_UNAVAILABLE);
-        m_pLogger->log("EC Raw Command failed - EC not initialized", Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, "EC Raw Command failed - EC not initialized");
         return resp;
     }
 
@@ -678,8 +1132,8 @@ patrol::EcRawCommandResponse CommandProc::handleEcRawCommand(const patrol::EcRaw
     QByteArray payloadOut = req.payload();
     int timeout = req.timeoutMs() > 0 ? req.timeoutMs() : 5000;
 
-    m_pLogger->log(QString("EC Raw Command 0x%1, payload %2 bytes")
-                       .arg(cmdId, 4, 16, QChar('0')).arg(payloadOut.size()), Logger::Debug);
+    LOG_FMT(m_pLogger, CatCommandProc, Debug, "EC Raw Command 0x%1, payload %2 bytes",
+            Logger::hex(cmdId, 4), payloadOut.size());
 
     QByteArray payloadIn;
     EC_HOST_CMD_STATUS status = m_pEcManager->sendCommandSync(cmdId, payloadOut, payloadIn, timeout);
@@ -688,7 +1142,7 @@ patrol::EcRawCommandResponse CommandProc::handleEcRawCommand(const patrol::EcRaw
                        static_cast<int>(ResultCode::RES_OK) :
                        static_cast<int>(ResultCode::RES_FAILED_OP));
     resp.setEcStatus(static_cast<EcStatus>(status));
-    resp.setPayload(payloadIn);
+    resp.setPayload(std::move(payloadIn));
 
     return resp;
 }
@@ -707,24 +1161,17 @@ patrol::EcAcpiReadResponse CommandProc::handleEcAcpiRead(const patrol::EcAcpiRea
     quint32 offset = req.offset();
     quint32 size = req.size();
 
-    m_pLogger->log(QString("EC ACPI%1 Read offset=0x%2, size=%3")
-                       .arg(nsId).arg(offset, 4, 16, QChar('0')).arg(size), Logger::Debug);
-
-    // Build request payload
-    mem_region_r_e memReq;
-    memReq.start = offset;
-    memReq.size = size;
-    QByteArray payload(reinterpret_cast<const char*>(&memReq), sizeof(memReq));
+    LOG_FMT(m_pLogger, CatCommandProc, Debug, "EC ACPI%1 Read offset=0x%2, size=%3",
+            nsId, Logger::hex(offset, 4), size);
 
     QByteArray data;
-    quint16 cmd = (nsId == 0) ? ECCMD_ACPI0_READ : ECCMD_ACPI1_READ;
-    EC_HOST_CMD_STATUS status = m_pEcManager->sendCommandSync(cmd, payload, data);
+    EC_HOST_CMD_STATUS status = m_pEcManager->acpiRead(nsId, offset, size, data);
 
     resp.setResult(status == EC_HOST_CMD_SUCCESS ?
                        static_cast<int>(ResultCode::RES_OK) :
                        static_cast<int>(ResultCode::RES_FAILED_OP));
     resp.setEcStatus(static_cast<EcStatus>(status));
-    resp.setData(data);
+    resp.setData(std::move(data));
 
     return resp;
 }
@@ -743,22 +1190,10 @@ patrol::EcAcpiWriteResponse CommandProc::handleEcAcpiWrite(const patrol::EcAcpiW
     quint32 offset = req.offset();
     QByteArray data = req.data();
 
-    m_pLogger->log(QString("EC ACPI%1 Write offset=0x%2, size=%3")
-                       .arg(nsId).arg(offset, 4, 16, QChar('0')).arg(data.size()), Logger::Debug);
-
-    // Build payload with header + data
-    QByteArray payload;
-    payload.reserve(sizeof(mem_region_w) + data.size());
+    LOG_FMT(m_pLogger, CatCommandProc, Debug, "EC ACPI%1 Write offset=0x%2, size=%3",
+            nsId, Logger::hex(offset, 4), data.size());
 
-    mem_region_w hdr;
-    hdr.start = offset;
-    hdr.size = data.size();
-    payload.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
-    payload.append(data);
-
-    QByteArray response;
-    quint16 cmd = (nsId == 0) ? ECCMD_ACPI0_WRITE : ECCMD_ACPI1_WRITE;
-    EC_HOST_CMD_STATUS status = m_pEcManager->sendCommandSync(cmd, payload, response);
+    EC_HOST_CMD_STATUS status = m_pEcManager->acpiWrite(nsId, offset, data);
 
     resp.setResult(status == EC_HOST_CMD_SUCCESS ?
                        static_cast<int>(ResultCode::RES_OK) :
@@ -781,10 +1216,8 @@ patrol::EcAcpiQueueWriteResponse CommandProc::handleEcAcpiQueueWrite(const patro
     quint32 offset = req.namespaceId() == 0 ? req.offset() : req.offset();
     QByteArray data = req.data();
 
-    m_pLogger->log(QString("ACPI Queue Write: ns=%1 offset=0x%2 size=%3")
-                       .arg(req.namespaceId())
-                       .arg(req.offset(), 2, 16, QChar('0'))
-                       .arg(data.size()), Logger::Debug);
+    LOG_FMT(m_pLogger, CatCommandProc, Debug, "ACPI Queue Write: ns=%1 offset=0x%2 size=%3",
+            req.namespaceId(), Logger::hex(req.offset(), 2), data.size());
 
     EC_HOST_CMD_STATUS status = m_pEcManager->acpi0Write(req.offset(), data);
 
@@ -813,7 +1246,7 @@ patrol::EcRamReadResponse CommandProc::handleEcRamRead(const patrol::EcRamReadRe
                        static_cast<int>(ResultCode::RES_OK) :
                        static_cast<int>(ResultCode::RES_FAILED_OP));
     resp.setEcStatus(static_cast<EcStatus>(status));
-    resp.setData(data);
+    resp.setData(std::move(data));
 
     return resp;
 }
@@ -1003,7 +1436,7 @@ patrol::EcShellCommandResponse CommandProc::handleEcShellCommand(const patrol::E
     }
 
     QString command = req.command();
-    m_pLogger->log(QString("EC Shell Command: %1").arg(command), Logger::Debug);
+    LOG_DEBUG(m_pLogger, CatCommandProc, QString("EC Shell Command: %1").arg(command));
 
     EC_HOST_CMD_STATUS status = m_pEcManager->sendShellCommand(command);
 
@@ -1049,52 +1482,52 @@ patrol::PowerCommandResponse CommandProc::handlePowerCommand(const patrol::Power
 
     switch (request.action()) {
     case patrol::PowerActionGadget::PowerAction::POWER_SHUTDOWN:
-        m_pLogger->log(QString("Power: Shutdown requested (timeout=%1s, force=%2)")
-                           .arg(request.timeoutSeconds()).arg(request.force()), Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, QString("Power: Shutdown requested (timeout=%1s, force=%2)")
+                                                .arg(request.timeoutSeconds()).arg(request.force()));
         success = OS::shutdown(request.timeoutSeconds(), request.force(), request.reason());
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_RESTART:
-        m_pLogger->log(QString("Power: Restart requested (timeout=%1s, force=%2)")
-                           .arg(request.timeoutSeconds()).arg(request.force()), Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, QString("Power: Restart requested (timeout=%1s, force=%2)")
+                                                .arg(request.timeoutSeconds()).arg(request.force()));
         success = OS::restart(request.timeoutSeconds(), request.force(), request.reason());
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_SLEEP:
-        m_pLogger->log("Power: Sleep requested", Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, "Power: Sleep requested");
         success = OS::sleep();
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_HIBERNATE:
-        m_pLogger->log("Power: Hibernate requested", Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, "Power: Hibernate requested");
         success = OS::hibernate();
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_LOGOFF:
-        m_pLogger->log(QString("Power: Logoff requested (force=%1)").arg(request.force()), Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, QString("Power: Logoff requested (force=%1)").arg(request.force()));
         success = OS::logOff(request.force());
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_LOCK:
-        m_pLogger->log("Power: Lock workstation requested", Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, "Power: Lock workstation requested");
         success = OS::lockWorkstation();
         if (!success) errorMsg = OS::lastError();
         break;
 
     case patrol::PowerActionGadget::PowerAction::POWER_CANCEL:
-        m_pLogger->log("Power: Cancel shutdown requested", Logger::Info);
+        LOG_INFO(m_pLogger, CatCommandProc, "Power: Cancel shutdown requested");
         success = OS::cancelShutdown();
         if (!success) errorMsg = OS::lastError();
         break;
 
     default:
         errorMsg = "Unknown power action";
-        m_pLogger->log(QString("Power: Unknown action %1").arg(static_cast<int>(request.action())), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatCommandProc, QString("Power: Unknown action %1").arg(static_cast<int>(request.action())));
         break;
     }
 
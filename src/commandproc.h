@@ -3,12 +3,40 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QVector>
+#include <atomic>
+#include <functional>
 #include "logger.h"
 #include "RegistryAccess.h"
 #include "WmiAccess.h"
+#include "wmi/wmiengine.h"
+#include "wmi/wmiquerycache.h"
 #include "eccommunication/ecmanager.h"
 #include "action/actioncommandqueue.h"
+#include "notify/notificationhub.h"
+#include "metrics/latencyhistogram.h"
 #include "command.qpb.h"
+#include "serviceext.qpb.h"
+
+#define MAX_BATCH_COMMANDS      64      // Upper bound on commands per CommandBatchRequest
+#define MAX_BATCH_TIME_MS       10000   // No command of a batch is started after this long
+
+// Fills the response for one payload type and returns the handler's result code
+using CommandHandler = std::function<int(const patrol::Command& request, patrol::Command& response)>;
+
+struct CommandContext {
+    const patrol::Command& request;
+    patrol::Command& response;
+    const QString& handlerName;
+};
+
+// Middleware wraps every table dispatch. Call next() to run the rest of the
+// chain and the handler, or return a result code without calling it to short-circuit.
+using CommandNext = std::function<int()>;
+using CommandMiddleware = std::function<int(const CommandContext& ctx, const CommandNext& next)>;
+
+// Completion of a command answered later: the response and its result code
+using CommandCallback = std::function<void(const patrol::Command& response, int result)>;
 
 class CommandProc : public QObject
 {
@@ -21,10 +49,45 @@ public:
     bool initializeEc(quint16 emiOffset = 0x220);
     bool isEcInitialized() const;
     EcManager* getEcManager() {return m_pEcManager;};
-    // Process protobuf command and return response
-    patrol::Command processCommand(const patrol::Command& request);
+    // Process protobuf command and return response.
+    // resultCode (optional) receives the handler's result field (RES_OK on success).
+    // consumerId is the pipe client, so PollActionCommands reads with that
+    // client's own cursor; ACTION_CONSUMER_ANONYMOUS for in-process callers.
+    patrol::Command processCommand(const patrol::Command& request, int* resultCode = nullptr,
+                                   quintptr consumerId = ACTION_CONSUMER_ANONYMOUS);
+
+    // Run a WmiQuery without blocking the caller. done gets the response on a
+    // WMI worker thread, or on the calling thread for a cache hit or a rejected
+    // query. Middleware cannot wrap a query that finishes later, so once
+    // middleware is installed the query runs inline through processCommand().
+    void processWmiQueryAsync(const patrol::Command& request, CommandCallback done);
+
+    // Handler table, keyed by the Command payload field number. Register at
+    // startup only - dispatch reads the table without locking.
+    void registerHandler(int fieldNumber, const QString& name, CommandHandler handler);
+    void addMiddleware(CommandMiddleware middleware);
+
+    // Per-handler call/error counts and latency histograms
+    patrol::MetricsResponse collectMetrics(bool reset = false);
 
-    void triggerActionEvent(uint32_t eventId);
+    // WMI result cache statistics and invalidation (WmiCacheRequest)
+    patrol::WmiCacheResponse handleWmiCache(const patrol::WmiCacheRequest& req);
+
+    // Process a batch of commands for one secure round trip. Consecutive EC
+    // commands are handed to EmiThread as a single group. WmiQuery is refused:
+    // the batch runs on the pipe thread and WMI can take seconds.
+    patrol::CommandBatchResponse processBatch(const patrol::CommandBatchRequest& request,
+                                              quintptr consumerId = ACTION_CONSUMER_ANONYMOUS);
+
+    void triggerActionEvent(uint32_t eventId, qint64 detectedUs = 0);   // ActionCommandQueue::monotonicUs()
+    void triggerActionValue(uint32_t eventId, int value, qint64 detectedUs = 0);
+
+    // Route queued action commands to push subscribers (nullptr = polling only)
+    void setNotificationHub(NotificationHub* hub);
+
+    // Per-client action polling (ActionPollRequest); the consumer id is the pipe client
+    ActionBatch pollActionCommands(quintptr consumerId, const ActionConsumerFilter& filter, int maxCommands);
+    void releaseActionConsumer(quintptr consumerId);
 
     uint32_t queueAddAction(uint32_t eventId, const QString& name, const QString& qmlPath, const QStringList& params, int position = -1);
     uint32_t queueEditAction(uint32_t eventId, int index, const QString& name, const QString& qmlPath, const QStringList& params);
@@ -41,7 +104,29 @@ public:
     patrol::ActionCommandResultResponse handleActionCommandResult(const patrol::ActionCommandResultRequest& req);
     patrol::QueueActionCommandResponse handleQueueActionCommand(const patrol::QueueActionCommandRequest& req);
 
+signals:
+    // An action command was queued (ActionCommandQueue::commandsQueued)
+    void actionCommandsQueued();
+
 private:
+    struct HandlerEntry {
+        QString name;
+        int fieldNumber = 0;
+        CommandHandler handler;
+        std::atomic<quint64> errors{0};
+        LatencyHistogram latency;       // count() doubles as the call count
+    };
+
+    void registerBuiltinHandlers();
+    HandlerEntry* handlerFor(const patrol::Command& request) const;
+    int runChain(int index, const HandlerEntry& entry, const CommandContext& ctx);
+    void recordDispatch(HandlerEntry* entry, int result, quint64 elapsedUs);
+
+    // Batch helpers - EC requests that can be queued to EmiThread as a group
+    QSharedPointer<EmiCmd> buildGroupedEcCmd(const patrol::Command& request, bool readOnly) const;
+    patrol::Command groupedEcResponse(const patrol::Command& request, const EmiCmd& cmd, bool completed,
+                                      int* resultCode) const;
+
     // MSR
     patrol::MsrReadResponse handleMsrRead(const patrol::MsrReadRequest& req);
     patrol::MsrWriteResponse handleMsrWrite(const patrol::MsrWriteRequest& req);
@@ -53,6 +138,7 @@ private:
 
     // WMI
     patrol::WmiQueryResponse handleWmiQuery(const patrol::WmiQueryRequest& req);
+    patrol::WmiQueryResponse wmiQueryResponse(bool ok, const WmiRows& rows) const;
 
     // File operations
     patrol::FileDeleteResponse handleFileDelete(const patrol::FileDeleteRequest& req);
@@ -85,9 +171,15 @@ private:
     Logger* m_pLogger;
     RegistryAccess m_RegistryAccess;
     WmiAccess m_WmiAccess;
+    WmiEngine m_wmiEngine;              // Runs m_WmiAccess queries on its MTA workers
+    WmiQueryCache m_wmiCache;           // In front of m_wmiEngine
     EcManager* m_pEcManager;
     ActionCommandQueue m_actionQueue;
+    NotificationHub* m_pNotificationHub;
 
+    QVector<HandlerEntry*> m_handlers;          // Indexed by payload field number
+    QList<CommandMiddleware> m_middleware;
+    std::atomic<quint64> m_unknownCommands;
 };
 
 #endif // COMMANDPROC_H
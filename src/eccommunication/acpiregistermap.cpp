@@ -0,0 +1,127 @@
+#include "acpiregistermap.h"
+#include "ecmanager.h"
+#include <algorithm>
+
+AcpiReadPlanner::AcpiReadPlanner(const QList<AcpiRegister>& registers, int gapTolerance, int periodicTicks)
+    : m_registers(registers)
+    , m_gapTolerance(qMax(0, gapTolerance))
+    , m_periodicTicks(qMax(1, periodicTicks))
+{
+    rebuildTickPlans();
+}
+
+void AcpiReadPlanner::setGapTolerance(int bytes)
+{
+    m_gapTolerance = qMax(0, bytes);
+    rebuildTickPlans();
+}
+
+void AcpiReadPlanner::setPeriodicTicks(int ticks)
+{
+    m_periodicTicks = qMax(1, ticks);
+}
+
+const QList<AcpiReadSpan>& AcpiReadPlanner::planForTick(quint64 tick) const
+{
+    return plan(tick % m_periodicTicks == 0);
+}
+
+const QList<AcpiReadSpan>& AcpiReadPlanner::plan(bool includePeriodic) const
+{
+    return includePeriodic ? m_periodicPlan : m_tickPlan;
+}
+
+QList<AcpiReadSpan> AcpiReadPlanner::planFor(const QList<int>& ids) const
+{
+    QList<int> indices;
+    for (int i = 0; i < m_registers.size(); i++) {
+        if (ids.contains(m_registers.at(i).id)) {
+            indices.append(i);
+        }
+    }
+    return buildPlan(indices);
+}
+
+void AcpiReadPlanner::rebuildTickPlans()
+{
+    QList<int> tick;
+    QList<int> periodic;
+    for (int i = 0; i < m_registers.size(); i++) {
+        switch (m_registers.at(i).pollClass) {
+        case AcpiPollClass::EveryTick:
+            tick.append(i);
+            periodic.append(i);
+            break;
+        case AcpiPollClass::Periodic:
+            periodic.append(i);
+            break;
+        case AcpiPollClass::OnDemand:
+            break;
+        }
+    }
+    m_tickPlan = buildPlan(tick);
+    m_periodicPlan = buildPlan(periodic);
+}
+
+QList<AcpiReadSpan> AcpiReadPlanner::buildPlan(QList<int> indices) const
+{
+    std::sort(indices.begin(), indices.end(), [this](int a, int b) {
+        return m_registers.at(a).offset < m_registers.at(b).offset;
+    });
+
+    QList<AcpiReadSpan> plan;
+    for (int index : indices) {
+        const AcpiRegister& reg = m_registers.at(index);
+        const int regEnd = reg.offset + reg.width;
+
+        if (!plan.isEmpty()) {
+            AcpiReadSpan& span = plan.last();
+            const int spanEnd = span.offset + span.size;
+            if (reg.offset <= spanEnd + m_gapTolerance && regEnd - span.offset <= ACPI_PLAN_MAX_SPAN) {
+                span.size = static_cast<quint16>(qMax(spanEnd, regEnd) - span.offset);
+                span.registers.append(index);
+                continue;
+            }
+        }
+
+        AcpiReadSpan span;
+        span.offset = reg.offset;
+        span.size = reg.width;
+        span.registers.append(index);
+        plan.append(span);
+    }
+    return plan;
+}
+
+AcpiReadResult AcpiReadPlanner::execute(EcManager* ecManager, const QList<AcpiReadSpan>& plan) const
+{
+    AcpiReadResult result;
+    if (!ecManager) {
+        result.status = EC_HOST_CMD_UNAVAILABLE;
+        return result;
+    }
+
+    for (const AcpiReadSpan& span : plan) {
+        QByteArray data;
+        const EC_HOST_CMD_STATUS status = ecManager->acpi0Read(span.offset, span.size, data);
+        result.transactions++;
+
+        if (status != EC_HOST_CMD_SUCCESS || data.size() < span.size) {
+            if (result.status == EC_HOST_CMD_SUCCESS) {
+                result.status = (status != EC_HOST_CMD_SUCCESS) ? status : EC_HOST_CMD_ERROR;
+            }
+            continue;
+        }
+
+        for (int index : span.registers) {
+            const AcpiRegister& reg = m_registers.at(index);
+            const int at = reg.offset - span.offset;
+            quint32 value = 0;
+            for (int b = 0; b < reg.width && b < 4; b++) {
+                value |= static_cast<quint32>(static_cast<quint8>(data.at(at + b))) << (8 * b);
+            }
+            result.values.insert(reg.id, value);
+        }
+    }
+    return result;
+}
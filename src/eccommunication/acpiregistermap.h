@@ -0,0 +1,91 @@
+#ifndef ACPIREGISTERMAP_H
+#define ACPIREGISTERMAP_H
+
+#include <QList>
+#include <QHash>
+#include "host_ec_cmds.h"
+
+class EcManager;
+
+#define ACPI_PLAN_GAP_TOLERANCE     8       // Unused bytes worth reading to save a transaction
+#define ACPI_PLAN_MAX_SPAN          128     // Bytes per ECCMD_ACPI0_READ
+#define ACPI_PLAN_PERIODIC_TICKS    100     // Periodic registers are read every this many ticks
+
+// How often a register is read by a polling loop
+enum class AcpiPollClass {
+    EveryTick,      // Input state - read on every poll
+    Periodic,       // Identity/presence - every periodic interval
+    OnDemand        // Only through an explicit plan (start-up, diagnostics)
+};
+
+// One entry of a declarative register map. Multi-byte registers are little-endian.
+struct AcpiRegister {
+    int id;                 // Caller-defined, unique within the map
+    const char* name;
+    quint16 offset;         // ACPI namespace 0
+    quint8 width;           // 1..4 bytes
+    AcpiPollClass pollClass;
+};
+
+// One ECCMD_ACPI0_READ covering one or more registers
+struct AcpiReadSpan {
+    quint16 offset = 0;
+    quint16 size = 0;
+    QList<int> registers;   // Indices into the planner's register list
+};
+
+struct AcpiReadResult {
+    EC_HOST_CMD_STATUS status = EC_HOST_CMD_SUCCESS;    // First failure, if any
+    int transactions = 0;
+    QHash<int, quint32> values;                         // Register id -> value, for reads that succeeded
+
+    bool has(int id) const { return values.contains(id); }
+    quint32 value(int id, quint32 fallback = 0) const { return values.value(id, fallback); }
+};
+
+/**
+ * @brief AcpiReadPlanner - Merges register reads into the fewest contiguous spans
+ *
+ * Registers due together are sorted by offset and merged while the hole
+ * between them is at most the gap tolerance and the span stays within
+ * ACPI_PLAN_MAX_SPAN, so a poll of several nearby registers costs one EC
+ * transaction. The per-tick plans only depend on whether the periodic
+ * registers are due, so both are computed once up front.
+ */
+class AcpiReadPlanner
+{
+public:
+    explicit AcpiReadPlanner(const QList<AcpiRegister>& registers,
+                             int gapTolerance = ACPI_PLAN_GAP_TOLERANCE,
+                             int periodicTicks = ACPI_PLAN_PERIODIC_TICKS);
+
+    void setGapTolerance(int bytes);
+    void setPeriodicTicks(int ticks);
+
+    // Registers due on this poll tick (tick 0 includes the periodic ones)
+    const QList<AcpiReadSpan>& planForTick(quint64 tick) const;
+
+    // EveryTick registers, plus the Periodic ones if asked - for pollers
+    // that schedule the periodic reads by time rather than by tick
+    const QList<AcpiReadSpan>& plan(bool includePeriodic) const;
+
+    // Ad-hoc plan for the given register ids
+    QList<AcpiReadSpan> planFor(const QList<int>& ids) const;
+
+    // Run a plan; registers in a span that failed are absent from values
+    AcpiReadResult execute(EcManager* ecManager, const QList<AcpiReadSpan>& plan) const;
+
+    const QList<AcpiRegister>& registers() const { return m_registers; }
+
+private:
+    QList<AcpiReadSpan> buildPlan(QList<int> indices) const;
+    void rebuildTickPlans();
+
+    QList<AcpiRegister> m_registers;
+    int m_gapTolerance;
+    int m_periodicTicks;
+    QList<AcpiReadSpan> m_tickPlan;         // EveryTick registers
+    QList<AcpiReadSpan> m_periodicPlan;     // EveryTick + Periodic registers
+};
+
+#endif // ACPIREGISTERMAP_H
@@ -86,15 +86,7 @@ EC_HOST_CMD_STATUS EcManager::sendCommandSync(quint16 cmd,
                                               QByteArray& payloadIn,
                                               int timeoutMs)
 {
-    auto pCmd = QSharedPointer<EmiCmd>::create();
-    pCmd->cmd = cmd;
-    pCmd->payloadout = payloadOut;
-    pCmd->result = EC_HOST_CMD_TIMEOUT;
-
-    EC_HOST_CMD_STATUS status = sendCommandSync(pCmd, timeoutMs);
-    payloadIn = pCmd->payloadin;
-
-    return status;
+    return runSync(makeRaw(cmd, payloadOut, timeoutMs), payloadIn, timeoutMs);
 }
 
 EC_HOST_CMD_STATUS EcManager::sendCommandSync(QSharedPointer<EmiCmd> pCmd, int timeoutMs)
@@ -135,10 +127,9 @@ EC_HOST_CMD_STATUS EcManager::sendCommandSync(QSharedPointer<EmiCmd> pCmd, int t
     }
 
     m_commandCount++;
-    /*log(QString("Queued sync command 0x%1, packet %2")
-            .arg(pCmd->cmd, 4, 16, QChar('0'))
-            .arg(pCmd->packetid), 3);
-    */
+    LOG_FMT(m_logger, CatEcManager, Debug, "Queued sync command 0x%1, packet %2",
+            Logger::hex(pCmd->cmd, 4), pCmd->packetid);
+
     // Wait for completion - wait() atomically releases mutex and waits
     QElapsedTimer timer;
     timer.start();
@@ -157,6 +148,10 @@ EC_HOST_CMD_STATUS EcManager::sendCommandSync(QSharedPointer<EmiCmd> pCmd, int t
                 .arg(pCmd->cmd, 4, 16, QChar('0'))
                 .arg(timeoutMs), 1);
         m_errorCount++;
+        FLIGHT_EVENT(m_logger, EcCommandTimeout, pCmd->cmd, pCmd->packetid, timeoutMs);
+        if (m_logger) {
+            m_logger->flightRecorder().trigger(QStringLiteral("EC command timeout"));
+        }
         return EC_HOST_CMD_TIMEOUT;
     }
 
@@ -170,6 +165,83 @@ EC_HOST_CMD_STATUS EcManager::sendCommandSync(QSharedPointer<EmiCmd> pCmd, int t
     return static_cast<EC_HOST_CMD_STATUS>(pCmd->result);
 }
 
+EC_HOST_CMD_STATUS EcManager::sendCommandsSync(const QList<QSharedPointer<EmiCmd>>& cmds, QList<bool>& completed,
+                                               int timeoutMs)
+{
+    completed = QList<bool>(cmds.size(), false);
+    if (!m_initialized || !m_thread) {
+        log("EcManager not initialized", 2);
+        return EC_HOST_CMD_UNAVAILABLE;
+    }
+
+    if (cmds.isEmpty()) {
+        return EC_HOST_CMD_SUCCESS;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    // Counted down per command. The count is shared with the callbacks, so
+    // commands still queued after a timeout can complete into it harmlessly.
+    QSharedPointer<int> remaining = QSharedPointer<int>::create(cmds.size());
+    for (const auto& pCmd : cmds) {
+        pCmd->packetid = nextPacketId();
+        pCmd->result = EC_HOST_CMD_TIMEOUT;
+        pCmd->completed = false;
+        m_pendingCommands.insert(pCmd->packetid, pCmd);
+        pCmd->FuncDone = [this, remaining](QSharedPointer<EmiCmd> done) {
+            QMutexLocker lock(&m_mutex);
+            done->completed = true;
+            (*remaining)--;
+            m_waitCondition.wakeAll();
+        };
+    }
+
+    if (m_thread->addCmdsToQueue(cmds) != 0) {
+        for (const auto& pCmd : cmds) {
+            pCmd->FuncDone = nullptr;
+            m_pendingCommands.remove(pCmd->packetid);
+        }
+        log("Failed to queue command group", 2);
+        return EC_HOST_CMD_ERROR;
+    }
+
+    m_commandCount += cmds.size();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (*remaining > 0 && timer.elapsed() < timeoutMs) {
+        m_waitCondition.wait(&m_mutex, qMin(100, timeoutMs - (int)timer.elapsed()));
+    }
+
+    // FuncDone is left in place: EmiThread may be calling it right now, and
+    // for unfinished commands it will still run. Neither result nor payloadin
+    // of an unfinished command is touched here.
+    const int pending = *remaining;
+    for (int i = 0; i < cmds.size(); i++) {
+        const auto& pCmd = cmds.at(i);
+        m_pendingCommands.remove(pCmd->packetid);
+        completed[i] = pCmd->completed;
+        if (!pCmd->completed) {
+            m_errorCount++;
+            FLIGHT_EVENT(m_logger, EcCommandTimeout, pCmd->cmd, pCmd->packetid, timeoutMs);
+        } else if (pCmd->result != EC_HOST_CMD_SUCCESS) {
+            m_errorCount++;
+        }
+    }
+
+    if (pending > 0) {
+        log(QString("Command group timed out after %1ms (%2 of %3 pending)")
+                .arg(timeoutMs).arg(pending).arg(cmds.size()), 1);
+        if (m_logger) {
+            m_logger->flightRecorder().trigger(QStringLiteral("EC command group timeout"));
+        }
+        return EC_HOST_CMD_TIMEOUT;
+    }
+
+    return EC_HOST_CMD_SUCCESS;
+}
+
 // ============================================================================
 // Asynchronous API
 // ============================================================================
@@ -227,9 +299,8 @@ quint32 EcManager::sendCommandAsync(QSharedPointer<EmiCmd> pCmd)
     }
 
     m_commandCount++;
-    log(QString("Queued async command 0x%1, packet %2")
-            .arg(pCmd->cmd, 4, 16, QChar('0'))
-            .arg(packetId), 3);
+    LOG_FMT(m_logger, CatEcManager, Debug, "Queued async command 0x%1, packet %2",
+            Logger::hex(pCmd->cmd, 4), packetId);
 
     return packetId;
 }
@@ -238,40 +309,96 @@ quint32 EcManager::sendCommandAsync(QSharedPointer<EmiCmd> pCmd)
 // Convenience Methods
 // ============================================================================
 
-EC_HOST_CMD_STATUS EcManager::acpi0Read(quint32 offset, quint32 size, QByteArray& data)
+QSharedPointer<EmiCmd> EcManager::makeAcpiRead(quint32 namespaceId, quint32 offset, quint32 size)
 {
     mem_region_r_e req;
     req.start = offset;
     req.size = size;
 
-    QByteArray payload(reinterpret_cast<const char*>(&req), sizeof(req));
-    return sendCommandSync(ECCMD_ACPI0_READ, payload, data);
+    auto pCmd = QSharedPointer<EmiCmd>::create();
+    pCmd->cmd = (namespaceId == 0) ? ECCMD_ACPI0_READ : ECCMD_ACPI1_READ;
+    pCmd->payloadout = QByteArray(reinterpret_cast<const char*>(&req), sizeof(req));
+    pCmd->waittime = 5000;
+    return pCmd;
 }
 
-EC_HOST_CMD_STATUS EcManager::acpi0Write(quint32 offset, const QByteArray& data)
+QSharedPointer<EmiCmd> EcManager::makeAcpiWrite(quint32 namespaceId, quint32 offset, const QByteArray& data)
 {
-    QByteArray payload;
-    payload.reserve(sizeof(mem_region_w) + data.size());
-
     mem_region_w hdr;
     hdr.start = offset;
     hdr.size = data.size();
 
-    payload.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
-    payload.append(data);
-
-    QByteArray response;
-    return sendCommandSync(ECCMD_ACPI0_WRITE, payload, response);
+    auto pCmd = QSharedPointer<EmiCmd>::create();
+    pCmd->cmd = (namespaceId == 0) ? ECCMD_ACPI0_WRITE : ECCMD_ACPI1_WRITE;
+    pCmd->payloadout.reserve(sizeof(mem_region_w) + data.size());
+    pCmd->payloadout.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    pCmd->payloadout.append(data);
+    pCmd->waittime = 5000;
+    return pCmd;
 }
 
-EC_HOST_CMD_STATUS EcManager::ecRamRead(quint32 offset, quint32 size, QByteArray& data)
+QSharedPointer<EmiCmd> EcManager::makeEcRamRead(quint32 offset, quint32 size)
 {
     mem_region_r_e req;
     req.start = offset;
     req.size = size;
 
-    QByteArray payload(reinterpret_cast<const char*>(&req), sizeof(req));
-    return sendCommandSync(ECCMD_ECRAM_READ, payload, data);
+    auto pCmd = QSharedPointer<EmiCmd>::create();
+    pCmd->cmd = ECCMD_ECRAM_READ;
+    pCmd->payloadout = QByteArray(reinterpret_cast<const char*>(&req), sizeof(req));
+    pCmd->waittime = 5000;
+    return pCmd;
+}
+
+QSharedPointer<EmiCmd> EcManager::makeRaw(quint16 cmd, const QByteArray& payload, int timeoutMs)
+{
+    auto pCmd = QSharedPointer<EmiCmd>::create();
+    pCmd->cmd = cmd;
+    pCmd->payloadout = payload;
+    pCmd->waittime = timeoutMs > 0 ? timeoutMs : 5000;
+    return pCmd;
+}
+
+EC_HOST_CMD_STATUS EcManager::runSync(QSharedPointer<EmiCmd> pCmd, QByteArray& payloadIn, int timeoutMs)
+{
+    EC_HOST_CMD_STATUS status = sendCommandSync(pCmd, timeoutMs);
+
+    // Take the buffer rather than sharing it; on timeout EmiThread may still own pCmd
+    if (status != EC_HOST_CMD_TIMEOUT) {
+        payloadIn.swap(pCmd->payloadin);
+    } else {
+        payloadIn.clear();
+    }
+    return status;
+}
+
+EC_HOST_CMD_STATUS EcManager::acpiRead(quint32 namespaceId, quint32 offset, quint32 size, QByteArray& data)
+{
+    QSharedPointer<EmiCmd> pCmd = makeAcpiRead(namespaceId, offset, size);
+    return runSync(pCmd, data, pCmd->waittime);
+}
+
+EC_HOST_CMD_STATUS EcManager::acpiWrite(quint32 namespaceId, quint32 offset, const QByteArray& data)
+{
+    QSharedPointer<EmiCmd> pCmd = makeAcpiWrite(namespaceId, offset, data);
+    QByteArray response;
+    return runSync(pCmd, response, pCmd->waittime);
+}
+
+EC_HOST_CMD_STATUS EcManager::acpi0Read(quint32 offset, quint32 size, QByteArray& data)
+{
+    return acpiRead(0, offset, size, data);
+}
+
+EC_HOST_CMD_STATUS EcManager::acpi0Write(quint32 offset, const QByteArray& data)
+{
+    return acpiWrite(0, offset, data);
+}
+
+EC_HOST_CMD_STATUS EcManager::ecRamRead(quint32 offset, quint32 size, QByteArray& data)
+{
+    QSharedPointer<EmiCmd> pCmd = makeEcRamRead(offset, size);
+    return runSync(pCmd, data, pCmd->waittime);
 }
 
 EC_HOST_CMD_STATUS EcManager::getDfuInfo(dfu_info& info)
@@ -286,10 +413,10 @@ EC_HOST_CMD_STATUS EcManager::getDfuInfo(dfu_info& info)
     return status;
 }
 
-EC_HOST_CMD_STATUS EcManager::getBatteryHealth(bat_health& health)
+EC_HOST_CMD_STATUS EcManager::getBatteryHealth(bat_health& health, int timeoutMs)
 {
     QByteArray response;
-    EC_HOST_CMD_STATUS status = sendCommandSync(ECCMD_BAT_GET_HEALTH, QByteArray(), response);
+    EC_HOST_CMD_STATUS status = sendCommandSync(ECCMD_BAT_GET_HEALTH, QByteArray(), response, timeoutMs);
 
     if (status == EC_HOST_CMD_SUCCESS && response.size() >= (int)sizeof(bat_health)) {
         memcpy(&health, response.constData(), sizeof(bat_health));
@@ -319,7 +446,7 @@ EC_HOST_CMD_STATUS EcManager::sendShellCommand(const QString& command)
 
 EC_HOST_CMD_STATUS EcManager::peciReadPackage(quint8 hostId, quint8 index,
                                               quint8 paramL, quint8 paramH,
-                                              quint32& data)
+                                              quint32& data, int timeoutMs)
 {
     peci_rd_pkg req;
     req.hostid = hostId;
@@ -330,7 +457,7 @@ EC_HOST_CMD_STATUS EcManager::peciReadPackage(quint8 hostId, quint8 index,
     QByteArray payload(reinterpret_cast<const char*>(&req), sizeof(req));
     QByteArray response;
 
-    EC_HOST_CMD_STATUS status = sendCommandSync(ECCMD_PECI_RD_PKG, payload, response);
+    EC_HOST_CMD_STATUS status = sendCommandSync(ECCMD_PECI_RD_PKG, payload, response, timeoutMs);
 
     if (status == EC_HOST_CMD_SUCCESS && response.size() >= (int)sizeof(peci_rd_pkg_resp)) {
         const peci_rd_pkg_resp* resp = reinterpret_cast<const peci_rd_pkg_resp*>(response.constData());
@@ -419,7 +546,7 @@ void EcManager::log(const QString& message, int level)
         case 3: logLevel = Logger::Debug; break;
         default: logLevel = Logger::Info; break;
         }
-        m_logger->log(QString("EcManager: %1").arg(message), logLevel);
+        m_logger->log(Logger::CatEcManager, logLevel, message);
     }
 }
 
@@ -89,6 +89,19 @@ public:
      */
     EC_HOST_CMD_STATUS sendCommandSync(QSharedPointer<EmiCmd> pCmd, int timeoutMs = 5000);
 
+    /**
+     * @brief Send a group of EmiCmds back-to-back and wait for all of them
+     *
+     * The group is handed to EmiThread in one go, so the commands run
+     * consecutively with a single wakeup. completed receives, per command,
+     * whether EmiThread had finished it when the wait ended. Only those may
+     * be read: EmiThread still owns result and payloadin of the others.
+     * @return EC_HOST_CMD_SUCCESS if every command completed (regardless of
+     *         its own result), EC_HOST_CMD_TIMEOUT otherwise
+     */
+    EC_HOST_CMD_STATUS sendCommandsSync(const QList<QSharedPointer<EmiCmd>>& cmds, QList<bool>& completed,
+                                        int timeoutMs = 5000);
+
     // ========================================================================
     // Asynchronous API - returns immediately, callback invoked when done
     // ========================================================================
@@ -111,10 +124,31 @@ public:
      */
     quint32 sendCommandAsync(QSharedPointer<EmiCmd> pCmd);
 
+    // ========================================================================
+    // Command builders - the one place request payloads are encoded, shared by
+    // the convenience methods below and by callers that queue EmiCmds
+    // themselves (batched command groups)
+    // ========================================================================
+
+    static QSharedPointer<EmiCmd> makeAcpiRead(quint32 namespaceId, quint32 offset, quint32 size);
+    static QSharedPointer<EmiCmd> makeAcpiWrite(quint32 namespaceId, quint32 offset, const QByteArray& data);
+    static QSharedPointer<EmiCmd> makeEcRamRead(quint32 offset, quint32 size);
+    static QSharedPointer<EmiCmd> makeRaw(quint16 cmd, const QByteArray& payload, int timeoutMs = 5000);
+
     // ========================================================================
     // Convenience methods for common EC operations
     // ========================================================================
 
+    /**
+     * @brief Read from ACPI namespace 0 or 1
+     */
+    EC_HOST_CMD_STATUS acpiRead(quint32 namespaceId, quint32 offset, quint32 size, QByteArray& data);
+
+    /**
+     * @brief Write to ACPI namespace 0 or 1
+     */
+    EC_HOST_CMD_STATUS acpiWrite(quint32 namespaceId, quint32 offset, const QByteArray& data);
+
     /**
      * @brief Read from ACPI namespace 0
      */
@@ -138,7 +172,7 @@ public:
     /**
      * @brief Get battery health information
      */
-    EC_HOST_CMD_STATUS getBatteryHealth(bat_health& health);
+    EC_HOST_CMD_STATUS getBatteryHealth(bat_health& health, int timeoutMs = 5000);
 
     /**
      * @brief Send shell command to EC console
@@ -150,7 +184,7 @@ public:
      */
     EC_HOST_CMD_STATUS peciReadPackage(quint8 hostId, quint8 index,
                                        quint8 paramL, quint8 paramH,
-                                       quint32& data);
+                                       quint32& data, int timeoutMs = 5000);
 
     /**
      * @brief Write PECI package
@@ -192,6 +226,7 @@ private slots:
 
 private:
     void log(const QString& message, int level = 0);
+    EC_HOST_CMD_STATUS runSync(QSharedPointer<EmiCmd> pCmd, QByteArray& payloadIn, int timeoutMs);
     quint32 nextPacketId();
 
     Logger* m_logger;
@@ -1,6 +1,7 @@
 #include "emithread.h"
 #include "emiio.h"
 #include "appstd.h"
+#include <QElapsedTimer>
 
 #define HOST_EC_IND     m_EmiOffset
 #define EC_HOST_IND     m_EmiOffset + 1
@@ -30,7 +31,7 @@ EmiThread::~EmiThread()
 void EmiThread::log(const QString& message, Logger::LogLevel level)
 {
     if (m_pLogger) {
-        m_pLogger->log(QString("EmiThread: %1").arg(message), level);
+        m_pLogger->log(Logger::CatEmiThread, level, message);
     }
 }
 
@@ -60,7 +61,12 @@ void EmiThread::run()
         locker.unlock();
 
         //Process the command
+        FLIGHT_EVENT(m_pLogger, EcCommandStart, pCmd->cmd, pCmd->packetid, pCmd->payloadout.size());
+        QElapsedTimer cmdTimer;
+        cmdTimer.start();
         ProcCmd(pCmd);
+        FLIGHT_EVENT(m_pLogger, EcCommandFinish, pCmd->cmd, pCmd->packetid, pCmd->result,
+                     static_cast<quint32>(cmdTimer.nsecsElapsed() / 1000));
 
         // Call the completion callback directly from this thread.
         // This is CRITICAL for synchronous waiters who are blocked on QWaitCondition.
@@ -99,6 +105,22 @@ int EmiThread::addCmdToQueue(QSharedPointer<EmiCmd> pCmd)
     return 0;
 }
 
+int EmiThread::addCmdsToQueue(const QList<QSharedPointer<EmiCmd>>& cmds)
+{
+    if (!m_pPort) return -1;
+
+    // Enqueue the whole group under one lock so the thread drains it
+    // back-to-back without interleaving other callers' commands
+    QMutexLocker locker(&m_Mutex);
+    for (const auto& pCmd : cmds) {
+        Q_ASSERT(pCmd);
+        m_pCmdQueue.enqueue(pCmd);
+    }
+    m_WaitCondition.wakeOne();
+
+    return 0;
+}
+
 EC_HOST_CMD_STATUS EmiThread::ProcCmd(QSharedPointer<EmiCmd> pCmd)
 {
     Q_ASSERT(pCmd);
@@ -108,8 +130,7 @@ EC_HOST_CMD_STATUS EmiThread::ProcCmd(QSharedPointer<EmiCmd> pCmd)
     quint8 data;
 
     //Convert the payload to an full packet
-    QByteArray packetout;
-    stat = PayloadToOutPack(pCmd->cmd, pCmd->payloadout, packetout);
+    stat = PayloadToOutPack(pCmd->cmd, pCmd->payloadout, m_PacketOut);
     if (stat == EC_HOST_CMD_SUCCESS)
     {
 
@@ -117,7 +138,7 @@ EC_HOST_CMD_STATUS EmiThread::ProcCmd(QSharedPointer<EmiCmd> pCmd)
         int retry = 10;
         while (retry--)
         {
-            stat = SendCmdOut(packetout, pCmd->payloadin);
+            stat = SendCmdOut(m_PacketOut, pCmd->payloadin);
             if (stat == EC_HOST_CMD_SUCCESS || stat == EC_HOST_CMD_IN_PROGRESS) break;
         }
 
@@ -136,19 +157,22 @@ EC_HOST_CMD_STATUS EmiThread::ProcCmd(QSharedPointer<EmiCmd> pCmd)
 EC_HOST_CMD_STATUS EmiThread::SendCmdGetResults(QByteArray &payloadin)
 {
     EC_HOST_CMD_STATUS stat;
-    QByteArray payloadout;
-    QByteArray packetout;
 
-    PayloadToOutPack(ECCMD_GET_RESULT,payloadout,packetout);
+    //The get-result packet never changes, build it once
+    if (m_GetResultPacket.isEmpty())
+    {
+        QByteArray payloadout;
+        PayloadToOutPack(ECCMD_GET_RESULT,payloadout,m_GetResultPacket);
+    }
 
     int i=0;
     while (i < 1000)
     {
         //Send the command to get the results
-        stat = SendCmdOut(packetout, payloadin);
+        stat = SendCmdOut(m_GetResultPacket, payloadin);
         if (stat == EC_HOST_CMD_SUCCESS)
         {
-            log(QString("Results ready after %1ms").arg(i), Logger::Debug);
+            LOG_FMT(m_pLogger, CatEmiThread, Debug, "Results ready after %1ms", i);
             return stat;
         }
         else if (stat != EC_HOST_CMD_IN_PROGRESS)
@@ -172,6 +196,10 @@ EC_HOST_CMD_STATUS EmiThread::SendCmdGetResults(QByteArray &payloadin)
     }
 
     log(QString("Results timeout after %1ms").arg(i), Logger::Warning);
+    FLIGHT_EVENT(m_pLogger, EcResultTimeout, i);
+    if (m_pLogger) {
+        m_pLogger->flightRecorder().trigger(QStringLiteral("EC result timeout"));
+    }
 
     return EC_HOST_CMD_TIMEOUT;
 }
@@ -214,10 +242,15 @@ EC_HOST_CMD_STATUS EmiThread::SendCmdOut(QByteArray &packetout, QByteArray &payl
         {
             log(QString("Send cmd timeout, EC_HOST=0x%1").arg(data, 2, 16, QChar('0')), Logger::Warning);
             resp = EC_HOST_CMD_TIMEOUT;
+            FLIGHT_EVENT(m_pLogger, EcSendTimeout, data);
 
             // Reset the bus
             QThread::msleep(1000);
             m_pPort->Write(EC_HOST_IND, 1);
+            FLIGHT_EVENT(m_pLogger, EcBusReset);
+            if (m_pLogger) {
+                m_pLogger->flightRecorder().trigger(QStringLiteral("EC bus timeout"));
+            }
             goto done;
         }
         else if (waittime >= 10)
@@ -235,7 +268,7 @@ EC_HOST_CMD_STATUS EmiThread::SendCmdOut(QByteArray &packetout, QByteArray &payl
 
     if (waittime > 10)
     {
-        log(QString("Slow EC response: %1ms").arg(waittime), Logger::Debug);
+        LOG_FMT(m_pLogger, CatEmiThread, Debug, "Slow EC response: %1ms", waittime);
     }
 
     //Read the input data packet
@@ -263,7 +296,8 @@ EC_HOST_CMD_STATUS EmiThread::PayloadToOutPack(quint16 cmd, QByteArray &payloado
     hdr.cmd_ver = 1;
     hdr.data_len = payloadout.size();
     hdr.reserved = 0;
-    packetout.clear();
+    packetout.truncate(0);     //Keeps the capacity for the next command
+    packetout.reserve(sizeof(struct ec_host_cmd_request_header) + payloadout.size());
     packetout.append(reinterpret_cast<const char*>(&hdr),sizeof(struct ec_host_cmd_request_header));
 
     //Load the payload
@@ -329,6 +363,9 @@ EC_HOST_CMD_STATUS EmiThread::GetPayloadIn(QByteArray &in)
     return EC_HOST_CMD_INVALID_VERSION;
 #else
 
+    //One allocation for the whole response instead of growing byte by byte
+    packetin.reserve(EMI_BUF_MAX_SIZE);
+
     quint16 readbytes = 8;
     for (qint16 i=0;i<readbytes;i++)
     {
@@ -390,11 +427,13 @@ EC_HOST_CMD_STATUS EmiThread::GetPayloadIn(QByteArray &in)
         resp = EC_HOST_CMD_INVALID_CHECKSUM;
     }
 
-    //Remove the header
-    in = packetin.mid(8);
-
     emit RxIn(packetin.size());
 
+    //Remove the header - dropping the front only moves the data pointer, so
+    //the payload is handed over without another copy
+    in = std::move(packetin);
+    in.remove(0, 8);
+
     return resp;
 #endif
 }
@@ -21,6 +21,7 @@ public:
     void run() override;
     void stop();
     int addCmdToQueue(QSharedPointer<EmiCmd>);
+    int addCmdsToQueue(const QList<QSharedPointer<EmiCmd>>& cmds);
 
     void setLogger(Logger* logger) { m_pLogger = logger; }
 
@@ -39,6 +40,11 @@ private:
     QQueue<QSharedPointer<EmiCmd>> m_pCmdQueue;
     QWaitCondition m_WaitCondition;
     bool m_StopFlag = false;
+
+    // Scratch packets reused for every command on this thread (EMI packets are
+    // at most EMI_BUF_MAX_SIZE, so one allocation each for the thread's life)
+    QByteArray m_PacketOut;
+    QByteArray m_GetResultPacket;
     EC_HOST_CMD_STATUS ProcCmd(QSharedPointer<EmiCmd> pCmd);
     EC_HOST_CMD_STATUS SendCmdGetResults(QByteArray& payloadin);
     EC_HOST_CMD_STATUS SendCmdOut(QByteArray& packetout, QByteArray& payloadin);
@@ -393,6 +393,7 @@ public:
     int waittime;
     std::function<void(QSharedPointer<EmiCmd>)> FuncDone;
     EmiCmdParam* pParam = NULL;
+    bool completed = false;     // EcManager::sendCommandsSync: set under its mutex once EmiThread is done
 };
 
 #endif // HOST_EC_CMDS_H
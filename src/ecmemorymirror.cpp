@@ -1,13 +1,42 @@
-#include "ECMemoryMirror.h"
-#include <sddl.h>
+#include "ecmemorymirror.h"
+#include <QElapsedTimer>
+#include <QThread>
 #include <chrono>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+quint32 alignLine(quint32 value)
+{
+    return (value + EC_MIRROR_LINE_SIZE - 1) & ~static_cast<quint32>(EC_MIRROR_LINE_SIZE - 1);
+}
+
+uint32_t nowMs()
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// Lines [first, last] covered by a byte range
+quint64 lineMask(quint32 offset, quint32 size)
+{
+    if (size == 0) return 0;
+    const quint32 first = offset / EC_MIRROR_LINE_SIZE;
+    const quint32 last = (offset + size - 1) / EC_MIRROR_LINE_SIZE;
+    const quint64 upper = (last >= 63) ? ~0ULL : ((1ULL << (last + 1)) - 1);
+    return upper & ~((1ULL << first) - 1);
+}
+
+} // namespace
 
 // ============================================================================
 // ECMemoryWriter (Service-side)
 // ============================================================================
 
 ECMemoryWriter::ECMemoryWriter(Logger* logger, QObject* parent)
-    : QObject(parent), m_logger(logger)
+    : QObject(parent), m_logger(logger), m_region(logger), m_notifier(logger)
 {
 }
 
@@ -16,147 +45,179 @@ ECMemoryWriter::~ECMemoryWriter()
     close();
 }
 
-bool ECMemoryWriter::createSecurityDescriptor(SECURITY_ATTRIBUTES& sa)
+bool ECMemoryWriter::addRegion(quint16 id, const QString& name, quint32 capacity)
 {
-    // Allow Authenticated Users to read, Administrators full access
-    const wchar_t* sddl = L"D:(A;OICI;GRGW;;;AU)(A;OICI;GA;;;BA)";
-
-    PSECURITY_DESCRIPTOR pSD = nullptr;
-    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(
-            sddl, SDDL_REVISION_1, &pSD, nullptr))
-    {
-        m_logger->log(QString("Failed to create security descriptor: %1").arg(GetLastError()));
+    if (m_region.isValid()) {
+        LOG_WARNING(m_logger, CatMirror, QString("EC mirror: cannot add region %1 after create()").arg(name));
+        return false;
+    }
+    if (id == 0 || m_regionIndex.contains(id)) {
+        LOG_WARNING(m_logger, CatMirror, QString("EC mirror: invalid or duplicate region id %1").arg(id));
+        return false;
+    }
+    if (capacity == 0 || capacity > EC_MIRROR_MAX_REGION_SIZE || m_regions.size() >= EC_MIRROR_MAX_REGIONS) {
+        LOG_WARNING(m_logger, CatMirror, QString("EC mirror: region %1 rejected (capacity %2, %3 regions)")
+                                             .arg(name).arg(capacity).arg(m_regions.size()));
         return false;
     }
 
-    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
-    sa.lpSecurityDescriptor = pSD;
-    sa.bInheritHandle = FALSE;
+    ECMirrorRegionInfo info;
+    info.id = id;
+    info.name = name.left(EC_MIRROR_NAME_SIZE - 1);
+    info.capacity = capacity;
 
+    m_regionIndex.insert(id, m_regions.size());
+    m_regions.append(info);
     return true;
 }
 
 bool ECMemoryWriter::create()
 {
-    SECURITY_ATTRIBUTES sa = {0};
-    if (!createSecurityDescriptor(sa)) {
-        return false;
-    }
-
-    // Create shared memory
-    m_memoryHandle = CreateFileMappingW(
-        INVALID_HANDLE_VALUE,
-        &sa,
-        PAGE_READWRITE,
-        0,
-        sizeof(ECMemoryData),
-        EC_MEMORY_NAME);
-
-    if (sa.lpSecurityDescriptor) {
-        LocalFree(sa.lpSecurityDescriptor);
+    // Lay out region headers after the fixed directory, each line aligned
+    quint32 offset = sizeof(ECMirrorHeader) + sizeof(ECMirrorDirEntry) * EC_MIRROR_MAX_REGIONS;
+    for (ECMirrorRegionInfo& info : m_regions) {
+        info.offset = offset;
+        offset += sizeof(ECMirrorRegionHeader) + alignLine(info.capacity);
     }
+    const quint32 totalSize = offset;
 
-    if (!m_memoryHandle) {
-        m_logger->log(QString("Failed to create EC memory: %1").arg(GetLastError()));
+    // Clients only read; the seqlock relies on there being a single writer
+    if (!m_region.create(EC_MEMORY_NAME, totalSize, false)) {
+        LOG_ERROR(m_logger, CatMirror, QString("Failed to create EC memory: %1").arg(m_region.errorString()));
         return false;
     }
 
-    // Map the memory
-    m_pData = static_cast<ECMemoryData*>(
-        MapViewOfFile(m_memoryHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ECMemoryData)));
-
-    if (!m_pData) {
-        m_logger->log(QString("Failed to map EC memory: %1").arg(GetLastError()));
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-        return false;
+    m_pBase = static_cast<uint8_t*>(m_region.data());
+    memset(m_pBase, 0, totalSize);
+
+    ECMirrorDirEntry* dir = reinterpret_cast<ECMirrorDirEntry*>(m_pBase + sizeof(ECMirrorHeader));
+    for (int i = 0; i < m_regions.size(); i++) {
+        const ECMirrorRegionInfo& info = m_regions.at(i);
+        dir[i].id = info.id;
+        dir[i].offset = info.offset;
+        dir[i].capacity = info.capacity;
+        const QByteArray name = info.name.toLatin1();
+        memcpy(dir[i].name, name.constData(), qMin<int>(name.size(), EC_MIRROR_NAME_SIZE - 1));
     }
 
-    // Initialize memory
-    ZeroMemory(m_pData, sizeof(ECMemoryData));
-    m_pData->version = 0;
-
-    // Create mutex
-    if (!createSecurityDescriptor(sa)) {
-        UnmapViewOfFile(m_pData);
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-        m_pData = nullptr;
-        return false;
+    ECMirrorHeader* header = reinterpret_cast<ECMirrorHeader*>(m_pBase);
+    header->layoutVersion = EC_MIRROR_LAYOUT_VERSION;
+    header->headerSize = sizeof(ECMirrorHeader);
+    header->totalSize = totalSize;
+    header->regionCount = static_cast<uint16_t>(m_regions.size());
+    header->dirEntrySize = sizeof(ECMirrorDirEntry);
+    header->regionHeaderSize = sizeof(ECMirrorRegionHeader);
+    header->lineSize = EC_MIRROR_LINE_SIZE;
+
+    // Magic last: a reader that sees it also sees a complete directory
+    std::atomic_thread_fence(std::memory_order_release);
+    reinterpret_cast<std::atomic<uint32_t>*>(&header->magic)->store(EC_MIRROR_MAGIC, std::memory_order_release);
+
+    if (!m_notifier.create(EC_MEMORY_NOTIFY_NAME)) {
+        // Readers fall back to polling
+        LOG_WARNING(m_logger, CatMirror, "EC mirror: change notifier unavailable");
     }
 
-    m_mutex = CreateMutexW(&sa, FALSE, EC_MUTEX_NAME);
-
-    if (sa.lpSecurityDescriptor) {
-        LocalFree(sa.lpSecurityDescriptor);
-    }
+    LOG_INFO(m_logger, CatMirror, QString("EC Memory Writer created successfully (%1 regions, %2 bytes)")
+                                      .arg(m_regions.size()).arg(totalSize));
+    return true;
+}
 
-    if (!m_mutex) {
-        m_logger->log(QString("Failed to create EC mutex: %1").arg(GetLastError()));
-        UnmapViewOfFile(m_pData);
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-        m_pData = nullptr;
-        return false;
+ECMirrorRegionHeader* ECMemoryWriter::regionHeader(quint16 id, quint32* capacity) const
+{
+    auto it = m_regionIndex.constFind(id);
+    if (!m_pBase || it == m_regionIndex.constEnd()) {
+        return nullptr;
     }
 
-    m_logger->log("EC Memory Writer created successfully");
-    return true;
+    const ECMirrorRegionInfo& info = m_regions.at(it.value());
+    if (capacity) *capacity = info.capacity;
+    return reinterpret_cast<ECMirrorRegionHeader*>(m_pBase + info.offset);
 }
 
-bool ECMemoryWriter::updateMemory(const QByteArray& newData)
+bool ECMemoryWriter::updateRegion(quint16 id, const QByteArray& data, quint32 offset)
 {
-    if (!m_pData || !m_mutex) {
-        m_logger->log("EC Memory not initialized");
+    quint32 capacity = 0;
+    ECMirrorRegionHeader* region = regionHeader(id, &capacity);
+    if (!region) {
+        LOG_FMT(m_logger, CatMirror, Warning, "EC mirror: unknown region %1", id);
         return false;
     }
 
-    if (newData.size() > sizeof(m_pData->data)) {
-        m_logger->log(QString("Data too large: %1 bytes (max %2)")
-                          .arg(newData.size()).arg(sizeof(m_pData->data)));
+    const quint32 size = static_cast<quint32>(data.size());
+    if (offset > capacity || size > capacity - offset) {
+        LOG_FMT(m_logger, CatMirror, Warning, "EC mirror: update of region %1 out of range (%2+%3, capacity %4)",
+                id, offset, size, capacity);
         return false;
     }
 
-    // Acquire mutex with timeout
-    DWORD result = WaitForSingleObject(m_mutex, 100);
-    if (result != WAIT_OBJECT_0) {
-        m_logger->log("Failed to acquire EC mutex for writing");
-        return false;
+    // Only this thread writes the region, so comparing against the shared copy
+    // needs no synchronisation
+    uint8_t* regionData = reinterpret_cast<uint8_t*>(region) + sizeof(ECMirrorRegionHeader);
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(data.constData());
+
+    quint64 changed = 0;
+    const quint64 touched = lineMask(offset, size);
+    for (int line = 0; line < EC_MIRROR_MAX_LINES; line++) {
+        if (!(touched & (1ULL << line))) continue;
+
+        const quint32 start = qMax<quint32>(offset, line * EC_MIRROR_LINE_SIZE);
+        const quint32 end = qMin<quint32>(offset + size, (line + 1) * EC_MIRROR_LINE_SIZE);
+        if (memcmp(regionData + start, src + (start - offset), end - start) != 0) {
+            changed |= 1ULL << line;
+        }
     }
 
-    // Update the memory
-    m_pData->version++;
-    m_pData->timestamp = static_cast<uint32_t>(
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count());
-    m_pData->dataSize = static_cast<uint16_t>(newData.size());
-    memcpy(m_pData->data, newData.constData(), newData.size());
+    const uint32_t dataSize = qMax(region->dataSize, offset + size);
+    if (changed == 0 && dataSize == region->dataSize) {
+        return true;
+    }
+
+    std::atomic<uint32_t>* seq = ecMirrorSequence(region);
+    const uint32_t start = seq->load(std::memory_order_relaxed);
+    const uint32_t version = (start + 2) / 2;
+
+    // Odd: update in progress. The release fence keeps the data stores below
+    // from becoming visible before the odd sequence.
+    seq->store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int line = 0; line < EC_MIRROR_MAX_LINES; line++) {
+        if (!(changed & (1ULL << line))) continue;
+
+        const quint32 from = qMax<quint32>(offset, line * EC_MIRROR_LINE_SIZE);
+        const quint32 to = qMin<quint32>(offset + size, (line + 1) * EC_MIRROR_LINE_SIZE);
+        memcpy(regionData + from, src + (from - offset), to - from);
+        region->lineVersion[line] = version;
+    }
+    region->dirtyMask = changed;
+    region->dataSize = dataSize;
+    region->timestamp = nowMs();
 
-    ReleaseMutex(m_mutex);
+    // Even again: publishes the new contents
+    seq->store(start + 2, std::memory_order_release);
 
-    m_logger->log(QString("Updated EC memory: version %1, size %2 bytes")
-                      .arg(m_pData->version).arg(newData.size()));
+    m_notifier.notify();
     return true;
 }
 
-void ECMemoryWriter::close()
+uint32_t ECMemoryWriter::regionVersion(quint16 id) const
 {
-    if (m_mutex) {
-        CloseHandle(m_mutex);
-        m_mutex = nullptr;
-    }
+    ECMirrorRegionHeader* region = regionHeader(id);
+    return region ? ecMirrorSequence(region)->load(std::memory_order_relaxed) / 2 : 0;
+}
 
-    if (m_pData) {
-        UnmapViewOfFile(m_pData);
-        m_pData = nullptr;
+void ECMemoryWriter::close()
+{
+    if (!m_region.isValid()) {
+        return;
     }
 
-    if (m_memoryHandle) {
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-    }
+    m_notifier.close();
+    m_region.close();
+    m_pBase = nullptr;
 
-    m_logger->log("EC Memory Writer closed");
+    LOG_INFO(m_logger, CatMirror, "EC Memory Writer closed");
 }
 
 // ============================================================================
@@ -164,7 +225,7 @@ void ECMemoryWriter::close()
 // ============================================================================
 
 ECMemoryReader::ECMemoryReader(Logger* logger, QObject* parent)
-    : QObject(parent), m_logger(logger)
+    : QObject(parent), m_logger(logger), m_region(logger), m_notifier(logger)
 {
 }
 
@@ -175,112 +236,216 @@ ECMemoryReader::~ECMemoryReader()
 
 bool ECMemoryReader::open()
 {
-    // Open existing shared memory (read-only)
-    m_memoryHandle = OpenFileMappingW(FILE_MAP_READ, FALSE, EC_MEMORY_NAME);
-    if (!m_memoryHandle) {
-        m_logger->log(QString("Failed to open EC memory: %1").arg(GetLastError()));
+    close();
+
+    // Map the fixed header first to learn the full size, then remap
+    if (!m_region.open(EC_MEMORY_NAME, sizeof(ECMirrorHeader), SharedMemoryRegion::Access::ReadOnly)) {
+        LOG_ERROR(m_logger, CatMirror, QString("Failed to open EC memory: %1").arg(m_region.errorString()));
         return false;
     }
 
-    // Map with read-only access
-    m_pData = static_cast<ECMemoryData*>(
-        MapViewOfFile(m_memoryHandle, FILE_MAP_READ, 0, 0, sizeof(ECMemoryData)));
-
-    if (!m_pData) {
-        m_logger->log(QString("Failed to map EC memory: %1").arg(GetLastError()));
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
+    ECMirrorHeader header;
+    const uint32_t magic = reinterpret_cast<const std::atomic<uint32_t>*>(m_region.constData())
+                               ->load(std::memory_order_acquire);
+    memcpy(&header, m_region.constData(), sizeof(header));
+    m_region.close();
+
+    if (magic != EC_MIRROR_MAGIC || header.layoutVersion != EC_MIRROR_LAYOUT_VERSION
+        || header.dirEntrySize != sizeof(ECMirrorDirEntry)
+        || header.regionHeaderSize != sizeof(ECMirrorRegionHeader)
+        || header.lineSize != EC_MIRROR_LINE_SIZE
+        || header.regionCount > EC_MIRROR_MAX_REGIONS) {
+        LOG_ERROR(m_logger, CatMirror, QString("EC memory layout not supported (magic 0x%1, layout %2)")
+                                           .arg(magic, 8, 16, QChar('0')).arg(header.layoutVersion));
         return false;
     }
 
-    // Open mutex
-    m_mutex = OpenMutexW(SYNCHRONIZE, FALSE, EC_MUTEX_NAME);
-    if (!m_mutex) {
-        m_logger->log(QString("Failed to open EC mutex: %1").arg(GetLastError()));
-        UnmapViewOfFile(m_pData);
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-        m_pData = nullptr;
+    if (!m_region.open(EC_MEMORY_NAME, header.totalSize, SharedMemoryRegion::Access::ReadOnly)) {
+        LOG_ERROR(m_logger, CatMirror, QString("Failed to map EC memory: %1").arg(m_region.errorString()));
         return false;
     }
+    m_pBase = static_cast<const uint8_t*>(m_region.constData());
+
+    const ECMirrorDirEntry* dir = reinterpret_cast<const ECMirrorDirEntry*>(m_pBase + header.headerSize);
+    for (int i = 0; i < header.regionCount; i++) {
+        const ECMirrorDirEntry& entry = dir[i];
+        if (entry.capacity > EC_MIRROR_MAX_REGION_SIZE
+            || entry.offset + sizeof(ECMirrorRegionHeader) + entry.capacity > header.totalSize) {
+            continue;
+        }
+
+        ECMirrorRegionInfo info;
+        info.id = entry.id;
+        info.name = QString::fromLatin1(entry.name, qstrnlen(entry.name, EC_MIRROR_NAME_SIZE));
+        info.offset = entry.offset;
+        info.capacity = entry.capacity;
+
+        m_regionIndex.insert(info.id, m_regions.size());
+        m_regions.append(info);
+    }
+
+    if (!m_notifier.open(EC_MEMORY_NOTIFY_NAME)) {
+        LOG_WARNING(m_logger, CatMirror, "EC mirror change notifier not available, waitForChange() will poll");
+    }
 
-    m_logger->log("EC Memory Reader opened successfully");
+    LOG_INFO(m_logger, CatMirror, QString("EC Memory Reader opened successfully (%1 regions)").arg(m_regions.size()));
     return true;
 }
 
-QByteArray ECMemoryReader::readMemory(bool* success)
+ECMirrorRegionHeader* ECMemoryReader::regionHeader(quint16 id, quint32* capacity) const
+{
+    auto it = m_regionIndex.constFind(id);
+    if (!m_pBase || it == m_regionIndex.constEnd()) {
+        return nullptr;
+    }
+
+    const ECMirrorRegionInfo& info = m_regions.at(it.value());
+    if (capacity) *capacity = info.capacity;
+
+    // Mapped read-only; only loads are made through this pointer
+    return reinterpret_cast<ECMirrorRegionHeader*>(const_cast<uint8_t*>(m_pBase) + info.offset);
+}
+
+QByteArray ECMemoryReader::readRegion(quint16 id, bool* success)
 {
     if (success) *success = false;
 
-    if (!m_pData || !m_mutex) {
-        m_logger->log("EC Memory not initialized");
+    ECMirrorRegionView view;
+    if (!readChanged(id, view)) {
         return QByteArray();
     }
 
-    // Local copy for atomic read
-    ECMemoryData localCopy;
-    uint32_t v1, v2;
-
-    // Read with version checking to ensure consistency
-    int retries = 0;
-    do {
-        // Acquire mutex with timeout
-        DWORD result = WaitForSingleObject(m_mutex, 100);
-        if (result != WAIT_OBJECT_0) {
-            m_logger->log("Failed to acquire EC mutex for reading");
-            return QByteArray();
-        }
+    if (success) *success = true;
+    return view.data.left(view.dataSize);
+}
 
-        // Read version, data, then version again
-        v1 = m_pData->version;
-        memcpy(&localCopy, m_pData, sizeof(ECMemoryData));
-        v2 = m_pData->version;
+bool ECMemoryReader::readChanged(quint16 id, ECMirrorRegionView& view)
+{
+    quint32 capacity = 0;
+    ECMirrorRegionHeader* region = regionHeader(id, &capacity);
+    if (!region) {
+        return false;
+    }
 
-        ReleaseMutex(m_mutex);
+    if (view.data.size() != static_cast<int>(capacity)) {
+        view.data = QByteArray(static_cast<int>(capacity), '\0');
+        view.version = 0;
+    }
 
-        retries++;
-        if (retries > 3) {
-            m_logger->log("Too many retries reading EC memory");
-            return QByteArray();
+    std::atomic<uint32_t>* seq = ecMirrorSequence(region);
+    const uint8_t* regionData = reinterpret_cast<const uint8_t*>(region) + sizeof(ECMirrorRegionHeader);
+    char* dest = view.data.data();
+    const int lineCount = static_cast<int>(alignLine(capacity) / EC_MIRROR_LINE_SIZE);
+
+    for (int attempt = 0; attempt < EC_MIRROR_READ_RETRIES; attempt++) {
+        const uint32_t v1 = seq->load(std::memory_order_acquire);
+
+        if ((v1 & 1) == 0) {
+            if (v1 / 2 == view.version) {
+                view.changedLines = 0;
+                return true;
+            }
+
+            // Line versions only grow, so a line copied during an attempt that
+            // later fails is copied again by the retry (or the next call)
+            uint32_t lineVersion[EC_MIRROR_MAX_LINES];
+            memcpy(lineVersion, region->lineVersion, sizeof(lineVersion));
+
+            quint64 copied = 0;
+            for (int line = 0; line < lineCount; line++) {
+                if (lineVersion[line] > view.version) {
+                    const quint32 from = line * EC_MIRROR_LINE_SIZE;
+                    const quint32 len = qMin<quint32>(EC_MIRROR_LINE_SIZE, capacity - from);
+                    memcpy(dest + from, regionData + from, len);
+                    copied |= 1ULL << line;
+                }
+            }
+            const uint32_t timestamp = region->timestamp;
+            const uint32_t dataSize = region->dataSize;
+
+            // Keep the copies above from being reordered past the second load
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t v2 = seq->load(std::memory_order_relaxed);
+
+            if (v1 == v2) {
+                view.version = v1 / 2;
+                view.timestamp = timestamp;
+                view.dataSize = qMin(dataSize, capacity);
+                view.changedLines = copied;
+                return true;
+            }
         }
 
-    } while (v1 != v2); // Retry if version changed during read
+        // Writer active - spin briefly, then give up the time slice
+        m_retries++;
+        if (attempt >= 8) {
+            QThread::yieldCurrentThread();
+        }
+    }
 
-    if (success) *success = true;
+    LOG_FMT(m_logger, CatMirror, Warning, "Too many retries reading EC memory region %1", id);
+    return false;
+}
 
-    // Return the data as QByteArray
-    return QByteArray(reinterpret_cast<char*>(localCopy.data), localCopy.dataSize);
+uint32_t ECMemoryReader::getVersion(quint16 id)
+{
+    ECMirrorRegionHeader* region = regionHeader(id);
+    if (!region) return 0;
+
+    // Completed updates; an update in progress is not counted yet
+    return ecMirrorSequence(region)->load(std::memory_order_acquire) / 2;
 }
 
-uint32_t ECMemoryReader::getVersion()
+bool ECMemoryReader::waitForChange(quint16 id, uint32_t lastVersion, int timeoutMs, uint32_t* version)
 {
-    if (!m_pData) return 0;
+    if (!regionHeader(id)) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (;;) {
+        // Sample the notifier first: a change landing after the version check
+        // moves the sequence, and the wait below returns at once
+        const quint32 seen = m_notifier.sequence();
+        const uint32_t current = getVersion(id);
+        if (current != lastVersion) {
+            if (version) *version = current;
+            return true;
+        }
 
-    DWORD result = WaitForSingleObject(m_mutex, 100);
-    if (result != WAIT_OBJECT_0) return 0;
+        int remaining = INT_MAX;
+        if (timeoutMs >= 0) {
+            remaining = timeoutMs - static_cast<int>(timer.elapsed());
+            if (remaining <= 0) {
+                break;
+            }
+        }
 
-    uint32_t version = m_pData->version;
-    ReleaseMutex(m_mutex);
+        if (m_notifier.isValid()) {
+            m_notifier.wait(seen, remaining);
+        } else {
+            QThread::msleep(static_cast<unsigned long>(qMin(remaining, EC_MIRROR_POLL_MS)));
+        }
+    }
 
-    return version;
+    if (version) *version = lastVersion;
+    return false;
 }
 
 void ECMemoryReader::close()
 {
-    if (m_mutex) {
-        CloseHandle(m_mutex);
-        m_mutex = nullptr;
-    }
+    m_regions.clear();
+    m_regionIndex.clear();
 
-    if (m_pData) {
-        UnmapViewOfFile(m_pData);
-        m_pData = nullptr;
+    if (!m_region.isValid()) {
+        return;
     }
 
-    if (m_memoryHandle) {
-        CloseHandle(m_memoryHandle);
-        m_memoryHandle = nullptr;
-    }
+    m_notifier.close();
+    m_region.close();
+    m_pBase = nullptr;
 
-    m_logger->log("EC Memory Reader closed");
+    LOG_INFO(m_logger, CatMirror, "EC Memory Reader closed");
 }
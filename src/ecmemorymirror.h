@@ -3,22 +3,115 @@
 
 #include <QObject>
 #include <QByteArray>
-#include <windows.h>
-#include "Logger.h"
+#include <QHash>
+#include <QList>
+#include <atomic>
+#include "logger.h"
+#include "shm/sharedmemoryregion.h"
+#include "shm/changenotifier.h"
 
-#define EC_MEMORY_SIZE 512
-#define EC_MEMORY_NAME L"Global\\ECMemoryMirror"
-#define EC_MUTEX_NAME L"Global\\ECMemoryMutex"
+#define EC_MEMORY_NAME "ECMemoryMirror"     // Global\ECMemoryMirror on Windows, /ECMemoryMirror on POSIX
+#define EC_MEMORY_NOTIFY_NAME "ECMemoryMirrorChanged"
+
+#define EC_MIRROR_MAGIC             0x524D4345  // "ECMR"
+#define EC_MIRROR_LAYOUT_VERSION    2
+#define EC_MIRROR_MAX_REGIONS       16
+#define EC_MIRROR_LINE_SIZE         64          // Dirty-tracking granularity
+#define EC_MIRROR_MAX_LINES         64          // One bit per line in a 64-bit mask
+#define EC_MIRROR_MAX_REGION_SIZE   (EC_MIRROR_LINE_SIZE * EC_MIRROR_MAX_LINES)
+#define EC_MIRROR_NAME_SIZE         20
+
+#define EC_MIRROR_READ_RETRIES      64          // Seqlock retries before a read gives up
+#define EC_MIRROR_POLL_MS           5           // waitForChange() granularity without a notifier
+
+// Well-known region ids. Readers look regions up by id, so new ids can be
+// added without moving existing ones.
+#define EC_REGION_ACPI0             0x0001
+#define EC_REGION_ACPI1             0x0002
+#define EC_REGION_ECRAM             0x0003
+#define EC_REGION_BATTERY_HEALTH    0x0004
+#define EC_REGION_DFU_INFO          0x0005
+
+#define EC_REGION_ACPI_SIZE         256
+#define EC_REGION_ECRAM_SIZE        256
+#define EC_REGION_INFO_SIZE         64
+
+/*
+ * Shared layout (all offsets from the start of the mapping):
+ *
+ *   ECMirrorHeader                         64 bytes
+ *   ECMirrorDirEntry[EC_MIRROR_MAX_REGIONS] 512 bytes
+ *   per region: ECMirrorRegionHeader + data, each 64-byte aligned
+ *
+ * The header and directory are written once by create() and never change.
+ * Each region is a single-writer seqlock: its sequence is odd while an update
+ * is copied and advances by 2 per update, so the region version is
+ * sequence / 2. lineVersion[i] holds the version that last changed line i,
+ * which lets a reader copy only the lines that moved since the version it
+ * last saw.
+ */
 
 #pragma pack(push, 1)
-struct ECMemoryData {
-    uint32_t version;           // Incremented on each update
-    uint32_t timestamp;         // Milliseconds since epoch (optional)
-    uint16_t dataSize;          // Actual data size (max EC_MEMORY_SIZE - 10)
-    uint8_t  data[502];         // Payload data
+struct ECMirrorHeader {
+    uint32_t magic;                 // EC_MIRROR_MAGIC
+    uint16_t layoutVersion;         // EC_MIRROR_LAYOUT_VERSION
+    uint16_t headerSize;            // sizeof(ECMirrorHeader)
+    uint32_t totalSize;             // Bytes to map
+    uint16_t regionCount;
+    uint16_t dirEntrySize;          // sizeof(ECMirrorDirEntry)
+    uint16_t regionHeaderSize;      // sizeof(ECMirrorRegionHeader)
+    uint16_t lineSize;              // EC_MIRROR_LINE_SIZE
+    uint8_t  reserved[44];
+};
+
+struct ECMirrorDirEntry {
+    uint16_t id;                    // EC_REGION_*
+    uint16_t flags;
+    uint32_t offset;                // Region header offset
+    uint32_t capacity;              // Data bytes following the region header
+    char     name[EC_MIRROR_NAME_SIZE];
+};
+
+struct ECMirrorRegionHeader {
+    uint32_t sequence;              // Seqlock sequence: odd while an update is in progress
+    uint32_t timestamp;             // Milliseconds since epoch of the last update
+    uint32_t dataSize;              // Bytes written so far (high-water mark)
+    uint32_t reserved0;
+    uint64_t dirtyMask;             // Lines changed by the most recent update
+    uint64_t reserved1;
+    uint32_t lineVersion[EC_MIRROR_MAX_LINES];
+    uint8_t  reserved2[32];
 };
 #pragma pack(pop)
 
+static_assert(sizeof(ECMirrorHeader) == 64, "ECMirrorHeader layout changed");
+static_assert(sizeof(ECMirrorDirEntry) == 32, "ECMirrorDirEntry layout changed");
+static_assert(sizeof(ECMirrorRegionHeader) % EC_MIRROR_LINE_SIZE == 0, "Region data must stay line aligned");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Seqlock needs a lock-free 32-bit atomic");
+
+// The sequence word lives in shared memory; lock-free atomics are address-free,
+// so every process can use it through a std::atomic view
+inline std::atomic<uint32_t>* ecMirrorSequence(ECMirrorRegionHeader* p)
+{
+    return reinterpret_cast<std::atomic<uint32_t>*>(&p->sequence);
+}
+
+struct ECMirrorRegionInfo {
+    quint16 id = 0;
+    QString name;
+    quint32 offset = 0;
+    quint32 capacity = 0;
+};
+
+// Reader-side copy of a region, refreshed in place by ECMemoryReader::readChanged()
+struct ECMirrorRegionView {
+    QByteArray data;
+    uint32_t version = 0;           // Version the data corresponds to (0 = never read)
+    uint32_t timestamp = 0;
+    uint32_t dataSize = 0;
+    quint64 changedLines = 0;       // Lines refreshed by the last readChanged()
+};
+
 // Service-side: Writer
 class ECMemoryWriter : public QObject
 {
@@ -28,17 +121,29 @@ public:
     explicit ECMemoryWriter(Logger* logger, QObject* parent = nullptr);
     ~ECMemoryWriter();
 
+    // Declare regions before create(); the directory is fixed afterwards
+    bool addRegion(quint16 id, const QString& name, quint32 capacity);
+
     bool create();
-    bool updateMemory(const QByteArray& newData);
+
+    // Write data at offset within the region. Only lines whose bytes actually
+    // differ are copied and versioned; an update that changes nothing does not
+    // bump the version.
+    bool updateRegion(quint16 id, const QByteArray& data, quint32 offset = 0);
+
+    uint32_t regionVersion(quint16 id) const;
+    QList<ECMirrorRegionInfo> regions() const { return m_regions; }
     void close();
 
 private:
-    Logger* m_logger;
-    HANDLE m_memoryHandle = nullptr;
-    HANDLE m_mutex = nullptr;
-    ECMemoryData* m_pData = nullptr;
+    ECMirrorRegionHeader* regionHeader(quint16 id, quint32* capacity = nullptr) const;
 
-    bool createSecurityDescriptor(SECURITY_ATTRIBUTES& sa);
+    Logger* m_logger;
+    SharedMemoryRegion m_region;
+    ChangeNotifier m_notifier;
+    uint8_t* m_pBase = nullptr;
+    QList<ECMirrorRegionInfo> m_regions;
+    QHash<quint16, int> m_regionIndex;
 };
 
 // Client-side: Reader
@@ -51,15 +156,39 @@ public:
     ~ECMemoryReader();
 
     bool open();
-    QByteArray readMemory(bool* success = nullptr);
-    uint32_t getVersion();
     void close();
 
+    QList<ECMirrorRegionInfo> regions() const { return m_regions; }
+    bool hasRegion(quint16 id) const { return m_regionIndex.contains(id); }
+
+    // Consistent copy of the whole region
+    QByteArray readRegion(quint16 id, bool* success = nullptr);
+
+    // Refresh view with only the lines changed since view.version. Returns
+    // false if the region is unknown or the writer kept it busy; view.version
+    // is then left as it was, so the next call fetches the same lines again.
+    bool readChanged(quint16 id, ECMirrorRegionView& view);
+
+    uint32_t getVersion(quint16 id);      // Number of completed updates
+
+    // Block until the region's version differs from lastVersion or timeoutMs
+    // passes (< 0 waits indefinitely). Sleeps in the kernel rather than
+    // polling; returns true on a change and stores the new version.
+    bool waitForChange(quint16 id, uint32_t lastVersion, int timeoutMs, uint32_t* version = nullptr);
+
+    // Seqlock retries taken by reads so far (contention indicator)
+    quint64 retryCount() const { return m_retries; }
+
 private:
+    ECMirrorRegionHeader* regionHeader(quint16 id, quint32* capacity = nullptr) const;
+
     Logger* m_logger;
-    HANDLE m_memoryHandle = nullptr;
-    HANDLE m_mutex = nullptr;
-    ECMemoryData* m_pData = nullptr;
+    SharedMemoryRegion m_region;
+    ChangeNotifier m_notifier;
+    const uint8_t* m_pBase = nullptr;
+    QList<ECMirrorRegionInfo> m_regions;
+    QHash<quint16, int> m_regionIndex;
+    quint64 m_retries = 0;
 };
 
 #endif // ECMEMORYMIRROR_H
@@ -0,0 +1,209 @@
+#include "flightrecorder.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+FlightRecorder::FlightRecorder(const QString& dumpDir)
+    : m_dumpDir(dumpDir)
+    , m_epochMs(QDateTime::currentMSecsSinceEpoch())
+    , m_slots(new Slot[FLIGHT_RECORDER_CAPACITY])
+    , m_head(0)
+    , m_lastTriggerMs(-FLIGHT_DUMP_MIN_INTERVAL_MS)
+{
+    static_assert((FLIGHT_RECORDER_CAPACITY & (FLIGHT_RECORDER_CAPACITY - 1)) == 0,
+                  "FLIGHT_RECORDER_CAPACITY must be a power of two");
+
+    m_clock.start();
+    for (int i = 0; i < FLIGHT_RECORDER_CAPACITY; i++) {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+void FlightRecorder::record(Event event, quint32 a, quint32 b, quint32 c, quint32 d)
+{
+    const quint64 pos = m_head.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[pos & (FLIGHT_RECORDER_CAPACITY - 1)];
+
+    slot.sequence.store(2 * pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.monoUs.store(m_clock.nsecsElapsed() / 1000, std::memory_order_relaxed);
+    slot.thread.store(static_cast<quint32>(reinterpret_cast<quintptr>(QThread::currentThreadId())),
+                      std::memory_order_relaxed);
+    slot.event.store(event, std::memory_order_relaxed);
+    slot.args[0].store(a, std::memory_order_relaxed);
+    slot.args[1].store(b, std::memory_order_relaxed);
+    slot.args[2].store(c, std::memory_order_relaxed);
+    slot.args[3].store(d, std::memory_order_relaxed);
+
+    slot.sequence.store(2 * pos + 2, std::memory_order_release);
+}
+
+QList<FlightRecorder::Entry> FlightRecorder::snapshot() const
+{
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    const quint64 start = head > FLIGHT_RECORDER_CAPACITY ? head - FLIGHT_RECORDER_CAPACITY : 0;
+
+    QList<Entry> entries;
+    entries.reserve(static_cast<int>(head - start));
+
+    for (quint64 pos = start; pos < head; pos++) {
+        const Slot& slot = m_slots[pos & (FLIGHT_RECORDER_CAPACITY - 1)];
+
+        // Skip slots still being written or already reused for a newer event
+        const quint64 expected = 2 * pos + 2;
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            continue;
+        }
+
+        Entry entry;
+        entry.monoUs = slot.monoUs.load(std::memory_order_relaxed);
+        entry.thread = slot.thread.load(std::memory_order_relaxed);
+        entry.event = static_cast<Event>(slot.event.load(std::memory_order_relaxed));
+        for (int i = 0; i < 4; i++) {
+            entry.args[i] = slot.args[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+            entries.append(entry);
+        }
+    }
+    return entries;
+}
+
+QString FlightRecorder::dump(const QString& reason, int* eventCount)
+{
+    QMutexLocker locker(&m_dumpMutex);
+    return writeDump(reason, eventCount);
+}
+
+QString FlightRecorder::trigger(const QString& reason, int* eventCount)
+{
+    // Persistent faults (a hung EC) would otherwise dump on every command
+    const qint64 now = m_clock.elapsed();
+    qint64 last = m_lastTriggerMs.load(std::memory_order_relaxed);
+    do {
+        if (now - last < FLIGHT_DUMP_MIN_INTERVAL_MS) {
+            return QString();
+        }
+    } while (!m_lastTriggerMs.compare_exchange_weak(last, now, std::memory_order_relaxed));
+
+    return dump(reason, eventCount);
+}
+
+void FlightRecorder::dumpForCrash()
+{
+    if (m_dumpMutex.tryLock(200)) {
+        writeDump(QStringLiteral("crash"), nullptr);
+        m_dumpMutex.unlock();
+    }
+}
+
+QString FlightRecorder::writeDump(const QString& reason, int* eventCount)
+{
+    // Caller holds m_dumpMutex
+    const QList<Entry> entries = snapshot();
+    if (eventCount) {
+        *eventCount = entries.size();
+    }
+
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    const QDateTime now = QDateTime::fromMSecsSinceEpoch(m_epochMs + nowUs / 1000);
+    const QString path = QDir(m_dumpDir).filePath(
+        QString("flight_%1.txt").arg(now.toString("yyyyMMdd_hhmmss_zzz")));
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return QString();
+    }
+
+    QByteArray text;
+    text.reserve(entries.size() * 80 + 256);
+    text.append(QString("Flight recorder dump: %1\n").arg(reason).toUtf8());
+    text.append(QString("Written %1, %2 events (%3 recorded since start)\n\n")
+                    .arg(now.toString("yyyy-MM-dd hh:mm:ss.zzz"))
+                    .arg(entries.size())
+                    .arg(recordedCount()).toUtf8());
+
+    for (const Entry& entry : entries) {
+        const QDateTime stamp = QDateTime::fromMSecsSinceEpoch(m_epochMs + entry.monoUs / 1000);
+        text.append(QString("%1%2 T%3 %4 %5\n")
+                        .arg(stamp.toString("hh:mm:ss.zzz"))
+                        .arg(entry.monoUs % 1000, 3, 10, QChar('0'))
+                        .arg(entry.thread, -6)
+                        .arg(QLatin1String(eventName(entry.event)), -18)
+                        .arg(describe(entry)).toUtf8());
+    }
+
+    file.write(text);
+    file.close();
+
+    removeOldDumps();
+    return path;
+}
+
+QString FlightRecorder::describe(const Entry& entry) const
+{
+    const quint32* a = entry.args;
+    switch (entry.event) {
+    case EcCommandStart:
+        return QString("cmd=0x%1 packet=%2 out=%3B").arg(a[0], 4, 16, QChar('0')).arg(a[1]).arg(a[2]);
+    case EcCommandFinish:
+        return QString("cmd=0x%1 packet=%2 status=%3 %4us")
+            .arg(a[0], 4, 16, QChar('0')).arg(a[1]).arg(a[2]).arg(a[3]);
+    case EcCommandTimeout:
+        return QString("cmd=0x%1 packet=%2 after %3ms").arg(a[0], 4, 16, QChar('0')).arg(a[1]).arg(a[2]);
+    case EcSendTimeout:
+        return QString("EC_HOST=0x%1").arg(a[0], 2, 16, QChar('0'));
+    case EcResultTimeout:
+        return QString("after %1ms").arg(a[0]);
+    case PipeFrameReceived:
+    case PipeFrameSent:
+    case PipeThrottled:
+        return QString("pipe=%1 %2B").arg(a[0]).arg(a[1]);
+    case AuthFailure:
+        switch (a[0]) {
+        case AuthBadPacket:         return QStringLiteral("bad packet or HMAC");
+        case AuthBadCredentials:    return QStringLiteral("bad credentials");
+        case AuthUnknownClient:     return QStringLiteral("unknown client");
+        case AuthNotAuthenticated:  return QStringLiteral("not authenticated");
+        case AuthTokenMismatch:     return QStringLiteral("token mismatch");
+        case AuthBadSequence:       return QStringLiteral("bad sequence number");
+        default:                    return QString("reason %1").arg(a[0]);
+        }
+    case HandlerStall:
+        return QString("pipe=%1 handler took %2ms").arg(a[0]).arg(a[1]);
+    default:
+        return QString("%1 %2 %3 %4").arg(a[0]).arg(a[1]).arg(a[2]).arg(a[3]);
+    }
+}
+
+void FlightRecorder::removeOldDumps()
+{
+    QDir dir(m_dumpDir);
+    QStringList dumps = dir.entryList(QStringList() << "flight_*.txt", QDir::Files, QDir::Name);
+    while (dumps.size() > FLIGHT_MAX_DUMPS) {
+        dir.remove(dumps.takeFirst());
+    }
+}
+
+const char* FlightRecorder::eventName(Event event)
+{
+    switch (event) {
+    case EcCommandStart:    return "EcCommandStart";
+    case EcCommandFinish:   return "EcCommandFinish";
+    case EcCommandTimeout:  return "EcCommandTimeout";
+    case EcSendTimeout:     return "EcSendTimeout";
+    case EcResultTimeout:   return "EcResultTimeout";
+    case EcBusReset:        return "EcBusReset";
+    case PipeFrameReceived: return "PipeFrameReceived";
+    case PipeFrameSent:     return "PipeFrameSent";
+    case PipeThrottled:     return "PipeThrottled";
+    case AuthFailure:       return "AuthFailure";
+    case HandlerStall:      return "HandlerStall";
+    case DumpRequested:     return "DumpRequested";
+    default:                return "Unknown";
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <memory>
+
+#define FLIGHT_RECORDER_CAPACITY        8192    // Events kept; power of two
+#define FLIGHT_DUMP_MIN_INTERVAL_MS     60000   // Automatic dumps at most this often
+#define FLIGHT_MAX_DUMPS                10      // Older flight_*.txt files are removed
+#define FLIGHT_STALL_MS                 2000    // Pipe handlers slower than this are a stall
+
+// Records an event on the logger's flight recorder; a null logger is ignored.
+//   FLIGHT_EVENT(m_pLogger, EcCommandStart, pCmd->cmd, pCmd->packetid, pCmd->payloadout.size());
+#define FLIGHT_EVENT(logger, event, ...)                                            \
+    do {                                                                            \
+        if (Logger* _pLog = (logger)) {                                             \
+            _pLog->flightRecorder().record(FlightRecorder::event, ##__VA_ARGS__);   \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief FlightRecorder - Fixed-size in-memory trace of recent structured events
+ *
+ * Keeps the last FLIGHT_RECORDER_CAPACITY events regardless of log
+ * thresholds and never touches disk while recording: record() claims a slot
+ * with one atomic add and fills it under a per-slot sequence number, so any
+ * thread can record and a dump can read concurrently without stopping them.
+ *
+ * dump() renders the ring to a text file in the log directory. trigger() is
+ * the automatic variant for fault paths (EC timeouts, handler stalls) and is
+ * rate limited; the Logger's crash handler dumps as well.
+ */
+class FlightRecorder
+{
+public:
+    enum Event : quint16 {
+        None,
+        EcCommandStart,         // cmd, packet id, payload bytes
+        EcCommandFinish,        // cmd, packet id, status, elapsed us
+        EcCommandTimeout,       // cmd, packet id, timeout ms - caller gave up waiting
+        EcSendTimeout,          // EC_HOST register value
+        EcResultTimeout,        // waited ms
+        EcBusReset,             // -
+        PipeFrameReceived,      // pipe type, bytes
+        PipeFrameSent,          // pipe type, bytes
+        PipeThrottled,          // pipe type, bytes
+        AuthFailure,            // AuthFailureReason
+        HandlerStall,           // pipe type, elapsed ms
+        DumpRequested,          // -
+        EventCount
+    };
+
+    enum AuthFailureReason : quint32 {
+        AuthBadPacket = 1,
+        AuthBadCredentials,
+        AuthUnknownClient,
+        AuthNotAuthenticated,
+        AuthTokenMismatch,
+        AuthBadSequence
+    };
+
+    struct Entry {
+        qint64 monoUs = 0;
+        quint32 thread = 0;
+        Event event = None;
+        quint32 args[4] = { 0, 0, 0, 0 };
+    };
+
+    explicit FlightRecorder(const QString& dumpDir);
+
+    // Any thread; a few relaxed stores
+    void record(Event event, quint32 a = 0, quint32 b = 0, quint32 c = 0, quint32 d = 0);
+
+    // Oldest first. Slots being overwritten during the copy are skipped.
+    QList<Entry> snapshot() const;
+
+    // Write the ring to flight_<time>.txt; returns the path or an empty string
+    QString dump(const QString& reason, int* eventCount = nullptr);
+
+    // dump() unless one was written less than FLIGHT_DUMP_MIN_INTERVAL_MS ago
+    QString trigger(const QString& reason, int* eventCount = nullptr);
+
+    // Crash path: gives up rather than wait for a dump already in progress
+    void dumpForCrash();
+
+    quint64 recordedCount() const { return m_head.load(std::memory_order_relaxed); }
+
+    static const char* eventName(Event event);
+
+private:
+    struct Slot {
+        std::atomic<quint64> sequence;      // 2n+1 while writing event n, 2n+2 once written
+        std::atomic<qint64> monoUs;
+        std::atomic<quint32> thread;
+        std::atomic<quint32> event;
+        std::atomic<quint32> args[4];
+    };
+
+    QString writeDump(const QString& reason, int* eventCount);
+    QString describe(const Entry& entry) const;
+    void removeOldDumps();
+
+    QString m_dumpDir;
+    QElapsedTimer m_clock;
+    qint64 m_epochMs;               // Wall clock at m_clock start
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<quint64> m_head;
+    std::atomic<qint64> m_lastTriggerMs;
+    QMutex m_dumpMutex;
+
+    Q_DISABLE_COPY(FlightRecorder)
+};
+
+#endif // FLIGHTRECORDER_H
@@ -0,0 +1,171 @@
+#include "logformat.h"
+#include <cstring>
+
+namespace LogFormat {
+
+void putVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void putSigned(QByteArray& out, qint64 value)
+{
+    putVarint(out, (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63));
+}
+
+void putString(QByteArray& out, const QByteArray& utf8)
+{
+    putVarint(out, static_cast<quint64>(utf8.size()));
+    out.append(utf8);
+}
+
+bool getVarint(const char*& p, const char* end, quint64* value)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const quint8 byte = static_cast<quint8>(*p++);
+        result |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool getSigned(const char*& p, const char* end, qint64* value)
+{
+    quint64 raw;
+    if (!getVarint(p, end, &raw)) {
+        return false;
+    }
+    *value = static_cast<qint64>(raw >> 1) ^ -static_cast<qint64>(raw & 1);
+    return true;
+}
+
+bool getString(const char*& p, const char* end, QByteArray* utf8)
+{
+    quint64 length;
+    if (!getVarint(p, end, &length) || length > static_cast<quint64>(end - p)) {
+        return false;
+    }
+    *utf8 = QByteArray(p, static_cast<int>(length));
+    p += length;
+    return true;
+}
+
+void appendArg(QByteArray& out, const QString& value)
+{
+    out.append(static_cast<char>(ArgString));
+    putString(out, value.toUtf8());
+}
+
+void appendArg(QByteArray& out, const char* value)
+{
+    out.append(static_cast<char>(ArgString));
+    putString(out, QByteArray(value ? value : ""));
+}
+
+void appendArg(QByteArray& out, const Hex& value)
+{
+    out.append(static_cast<char>(ArgHex));
+    out.append(static_cast<char>(qBound(0, value.width, 16)));
+    putVarint(out, value.value);
+}
+
+bool decodeArgs(const QByteArray& packed, QList<Arg>* args)
+{
+    const char* p = packed.constData();
+    const char* end = p + packed.size();
+
+    while (p < end) {
+        Arg arg;
+        arg.type = static_cast<ArgType>(*p++);
+
+        switch (arg.type) {
+        case ArgInt:
+            if (!getSigned(p, end, &arg.i)) return false;
+            break;
+        case ArgUInt:
+            if (!getVarint(p, end, &arg.u)) return false;
+            break;
+        case ArgDouble:
+            if (end - p < static_cast<ptrdiff_t>(sizeof(double))) return false;
+            std::memcpy(&arg.d, p, sizeof(double));
+            p += sizeof(double);
+            break;
+        case ArgString: {
+            QByteArray utf8;
+            if (!getString(p, end, &utf8)) return false;
+            arg.s = QString::fromUtf8(utf8);
+            break;
+        }
+        case ArgHex:
+            if (p >= end) return false;
+            arg.width = static_cast<quint8>(*p++);
+            if (!getVarint(p, end, &arg.u)) return false;
+            break;
+        default:
+            return false;
+        }
+
+        args->append(arg);
+    }
+    return true;
+}
+
+QString argText(const Arg& arg)
+{
+    switch (arg.type) {
+    case ArgInt:    return QString::number(arg.i);
+    case ArgUInt:   return QString::number(arg.u);
+    case ArgDouble: return QString::number(arg.d);
+    case ArgString: return arg.s;
+    case ArgHex:    return QString("%1").arg(arg.u, arg.width, 16, QChar('0'));
+    default:        return QString();
+    }
+}
+
+QString render(const char* format, const QByteArray& packed)
+{
+    QList<Arg> args;
+    const bool argsOk = decodeArgs(packed, &args);
+
+    QString text;
+    for (const char* p = format; *p; p++) {
+        if (p[0] == '%' && p[1] >= '1' && p[1] <= '9') {
+            const int index = p[1] - '1';
+            text.append(index < args.size() ? argText(args.at(index)) : QStringLiteral("?"));
+            p++;
+            continue;
+        }
+        // Format strings are source literals; keep multi-byte UTF-8 intact
+        const char* start = p;
+        while (p[1] && p[1] != '%') {
+            p++;
+        }
+        text.append(QString::fromUtf8(start, static_cast<int>(p - start + 1)));
+    }
+
+    if (!argsOk) {
+        text.append(QStringLiteral(" <bad args>"));
+    }
+    return text;
+}
+
+const char* severityTag(int severity)
+{
+    switch (severity) {
+    case 0:  return "[DEBUG]";
+    case 1:  return "[INFO]";
+    case 2:  return "[WARN]";
+    case 3:  return "[ERROR]";
+    default: return "[INFO]";
+    }
+}
+
+} // namespace LogFormat
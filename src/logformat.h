@@ -0,0 +1,110 @@
+#ifndef LOGFORMAT_H
+#define LOGFORMAT_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <type_traits>
+
+#define LOG_BINARY_MAGIC        "CSLG"
+#define LOG_BINARY_VERSION      1
+#define LOG_MAX_FORMATS         4096    // Distinct LOG_FMT call sites per process
+
+/**
+ * @brief LogFormat - Encoding shared by the binary log writer and decoder
+ *
+ * A binary log file is the 4-byte magic, a version byte, then records. Each
+ * record starts with a RecordType byte; integers are LEB128 varints, signed
+ * ones zigzag-encoded.
+ *
+ *   Session  epochMs, monoUs, baseUs, category count, category names
+ *            Maps the monotonic clock to wall time; the first event's delta
+ *            is relative to baseUs. Written whenever a file is opened.
+ *   Format   id, format string - precedes the first event that uses it
+ *   Event    delta us (signed), (category << 2) | severity, format id, args
+ *   Text     delta us (signed), (category << 2) | severity, message
+ *
+ * Strings are a varint length followed by UTF-8. Event arguments are a
+ * varint length followed by ArgType-tagged values.
+ */
+namespace LogFormat {
+
+enum RecordType : quint8 {
+    RecSession = 1,
+    RecFormat = 2,
+    RecEvent = 3,
+    RecText = 4
+};
+
+enum ArgType : quint8 {
+    ArgInt = 1,         // zigzag varint
+    ArgUInt = 2,        // varint
+    ArgDouble = 3,      // 8 bytes, little-endian IEEE 754
+    ArgString = 4,      // varint length + UTF-8
+    ArgHex = 5          // width byte + varint, rendered zero-padded hex
+};
+
+// Argument wrapper for the .arg(value, width, 16, QChar('0')) idiom
+struct Hex {
+    quint64 value;
+    int width;
+};
+
+struct Arg {
+    ArgType type = ArgInt;
+    qint64 i = 0;
+    quint64 u = 0;
+    double d = 0.0;
+    int width = 0;
+    QString s;
+};
+
+void putVarint(QByteArray& out, quint64 value);
+void putSigned(QByteArray& out, qint64 value);
+void putString(QByteArray& out, const QByteArray& utf8);
+bool getVarint(const char*& p, const char* end, quint64* value);
+bool getSigned(const char*& p, const char* end, qint64* value);
+bool getString(const char*& p, const char* end, QByteArray* utf8);
+
+// Typed argument packing, used by Logger::logFormat()
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+appendArg(QByteArray& out, T value)
+{
+    out.append(static_cast<char>(ArgInt));
+    putSigned(out, static_cast<qint64>(value));
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+appendArg(QByteArray& out, T value)
+{
+    out.append(static_cast<char>(ArgUInt));
+    putVarint(out, static_cast<quint64>(value));
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_floating_point<T>::value>::type
+appendArg(QByteArray& out, T value)
+{
+    out.append(static_cast<char>(ArgDouble));
+    const double d = static_cast<double>(value);
+    out.append(reinterpret_cast<const char*>(&d), sizeof(d));
+}
+
+void appendArg(QByteArray& out, const QString& value);
+void appendArg(QByteArray& out, const char* value);
+void appendArg(QByteArray& out, const Hex& value);
+
+bool decodeArgs(const QByteArray& packed, QList<Arg>* args);
+QString argText(const Arg& arg);
+
+// Substitutes %1..%9 in format with the packed arguments
+QString render(const char* format, const QByteArray& packed);
+
+// "[INFO]" etc. for Logger::severity() values
+const char* severityTag(int severity);
+
+} // namespace LogFormat
+
+#endif // LOGFORMAT_H
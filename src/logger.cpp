@@ -1,12 +1,75 @@
-#include "Logger.h"
+#include "logger.h"
 #include <QDebug>
 #include <QCoreApplication>
-#include <QDebug>
-Logger::Logger(const QString &logDir, QObject *parent)
+#include <QDeadlineTimer>
+#include <csignal>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::atomic<Logger*> s_crashLogger(nullptr);
+
+#ifdef Q_OS_WIN
+LPTOP_LEVEL_EXCEPTION_FILTER s_previousFilter = nullptr;
+#else
+// Formatted at install time: a signal handler may not format or allocate
+char s_crashNote[512];
+size_t s_crashNoteLength = 0;
+#endif
+
+const char* const s_categoryNames[Logger::LogCategoryCount] = {
+    "General",
+    "EcManager",
+    "EmiThread",
+    "NamedPipeServer",
+    "SecureHandler",
+    "BezelMonitor",
+    "CommandProc",
+    "Mirror",
+    "Wmi",
+    "Notify",
+};
+
+// LOG_FMT format strings, indexed by id - 1. Entries are written once,
+// before the id is published, so readers need no lock.
+std::atomic<const char*> s_formats[LOG_MAX_FORMATS];
+std::atomic<int> s_formatCount(0);
+QMutex s_formatMutex;
+
+} // namespace
+
+Logger::Logger(const QString &logDir, QObject *parent, Mode mode, FileFormat format)
     : QObject(parent)
     , m_logDir(logDir)
+    , m_fileBytes(0)
     , m_isValid(false)
+    , m_mode(mode)
+    , m_format(format)
+    , m_flightRecorder(logDir)
+    , m_ring(mode == Async ? LOG_RING_CAPACITY : 2)
+    , m_writerThread(nullptr)
+    , m_stopping(false)
+    , m_writerIdle(false)
+    , m_overflowPolicy(BlockOnWarning)
+    , m_enqueued(0)
+    , m_written(0)
+    , m_dropped(0)
+    , m_droppedTotal(0)
+    , m_cachedSecond(-1)
+    , m_lastMonoUs(0)
+    , m_bufferBaseUs(0)
+    , m_formatsWritten(0)
 {
+    for (int i = 0; i < LogCategoryCount; i++) {
+        m_thresholds[i].store(severity(Info), std::memory_order_relaxed);
+    }
+    m_clock.start();
+
     // Ensure log directory exists
     QDir dir;
     if (!dir.exists(m_logDir)) {
@@ -31,18 +94,41 @@ Logger::Logger(const QString &logDir, QObject *parent)
     // Cleanup older logs after successful initialization
     rotateLogs();
 
+    if (m_mode == Async) {
+        m_writerThread = QThread::create([this]() { writerLoop(); });
+        m_writerThread->setObjectName("LogWriter");
+        m_writerThread->start(QThread::LowPriority);
+    }
+
     // Log startup
     log("Logger initialized", Info);
 }
 
 Logger::~Logger()
 {
+    if (s_crashLogger.load() == this) {
+        installCrashHandler(nullptr);
+    }
+
+    // The writer drains the ring completely before it exits
+    if (m_writerThread) {
+        m_stopping.store(true);
+        wakeWriter();
+        m_writerThread->wait();
+        delete m_writerThread;
+        m_writerThread = nullptr;
+    }
+
     QMutexLocker locker(&m_mutex);
 
     if (m_isValid) {
-        m_logStream << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
-                    << " [INFO] Logger shutting down\n";
-        m_logStream.flush();
+        Record record;
+        stamp(record);
+        record.message = QStringLiteral("Logger shutting down");
+
+        QByteArray buffer;
+        appendRecord(buffer, record);
+        writeBuffer(buffer);
     }
 
     closeCurrentLogFile();
@@ -50,9 +136,14 @@ Logger::~Logger()
 
 void Logger::log(const QString &message, LogLevel level)
 {
-    QMutexLocker locker(&m_mutex);
+    if (isEnabled(CatGeneral, level)) {
+        log(CatGeneral, level, message);
+    }
+}
 
-    if (!m_isValid || !m_logFile.isOpen()) {
+void Logger::log(LogCategory category, LogLevel level, const QString &message)
+{
+    if (!m_isValid) {
         // Fallback to debug output if logging fails
 #ifdef QT_DEBUG
         qDebug() << "Logger not available:" << message;
@@ -60,8 +151,326 @@ void Logger::log(const QString &message, LogLevel level)
         return;
     }
 
-    // Check file size and rotate if needed
-    if (m_logFile.size() > MAX_LOG_FILE_SIZE) {
+    Record record;
+    stamp(record);
+    record.level = level;
+    record.category = category;
+    record.message = message;
+    submit(std::move(record));
+}
+
+void Logger::submitFormat(LogCategory category, LogLevel level, quint16 formatId, QByteArray&& args)
+{
+    if (!m_isValid) {
+#ifdef QT_DEBUG
+        qDebug() << "Logger not available:" << LogFormat::render(s_formats[formatId - 1].load(), args);
+#endif
+        return;
+    }
+
+    Record record;
+    stamp(record);
+    record.level = level;
+    record.category = category;
+    record.formatId = formatId;
+    record.args = std::move(args);
+    submit(std::move(record));
+}
+
+quint16 Logger::registerFormat(const char* format)
+{
+    QMutexLocker locker(&s_formatMutex);
+    const int count = s_formatCount.load(std::memory_order_relaxed);
+    if (count >= LOG_MAX_FORMATS) {
+        return 0;
+    }
+    s_formats[count].store(format, std::memory_order_relaxed);
+    s_formatCount.store(count + 1, std::memory_order_release);
+    return static_cast<quint16>(count + 1);
+}
+
+void Logger::stamp(Record& record) const
+{
+    // Only the clock the file format needs is read on the caller's thread
+    if (m_format == BinaryFile) {
+        record.monoUs = m_clock.nsecsElapsed() / 1000;
+    } else {
+        record.timestampMs = QDateTime::currentMSecsSinceEpoch();
+    }
+}
+
+void Logger::submit(Record&& record)
+{
+    const LogLevel level = record.level;
+
+    if (m_mode == Synchronous) {
+        QMutexLocker locker(&m_mutex);
+        QByteArray buffer;
+        appendRecord(buffer, record);
+        writeBuffer(buffer);
+        return;
+    }
+
+    // Formatting and disk I/O happen on the writer thread; the caller only
+    // pays for the timestamp and the push
+    if (!m_ring.tryPush(std::move(record))) {
+        const int policy = m_overflowPolicy.load(std::memory_order_relaxed);
+        const bool block = (policy == Block)
+                           || (policy == BlockOnWarning && (level == Warning || level == Error));
+
+        if (!block || m_stopping.load(std::memory_order_relaxed)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            m_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // A failed push leaves the record untouched, so it can be retried
+        do {
+            wakeWriter();
+            QThread::yieldCurrentThread();
+        } while (!m_ring.tryPush(std::move(record)));
+    }
+
+    // seq_cst pairs with the writer announcing it is idle (see writerLoop)
+    m_enqueued.fetch_add(1, std::memory_order_seq_cst);
+    if (m_writerIdle.load(std::memory_order_seq_cst)) {
+        wakeWriter();
+    }
+}
+
+void Logger::flush()
+{
+    if (!m_isValid) return;
+
+    if (m_mode == Synchronous || !m_writerThread) {
+        QMutexLocker locker(&m_mutex);
+        m_logFile.flush();
+        return;
+    }
+
+    const quint64 target = m_enqueued.load();
+    QDeadlineTimer deadline(LOG_FLUSH_TIMEOUT_MS);
+
+    QMutexLocker locker(&m_wakeMutex);
+    m_wakeWriter.wakeOne();
+    while (m_written.load() < target && !deadline.hasExpired()) {
+        m_batchWritten.wait(&m_wakeMutex, deadline);
+    }
+}
+
+void Logger::setThreshold(LogCategory category, LogLevel level)
+{
+    if (category < 0 || category >= LogCategoryCount) return;
+    m_thresholds[category].store(severity(level), std::memory_order_relaxed);
+}
+
+Logger::LogLevel Logger::threshold(LogCategory category) const
+{
+    if (category < 0 || category >= LogCategoryCount) return Info;
+
+    switch (m_thresholds[category].load(std::memory_order_relaxed)) {
+    case 0:  return Debug;
+    case 2:  return Warning;
+    case 3:  return Error;
+    default: return Info;
+    }
+}
+
+QString Logger::categoryName(LogCategory category)
+{
+    if (category < 0 || category >= LogCategoryCount) return QString();
+    return QString::fromLatin1(s_categoryNames[category]);
+}
+
+bool Logger::categoryFromName(const QString& name, LogCategory* category)
+{
+    for (int i = 0; i < LogCategoryCount; i++) {
+        if (name.compare(QLatin1String(s_categoryNames[i]), Qt::CaseInsensitive) == 0) {
+            if (category) *category = static_cast<LogCategory>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::wakeWriter()
+{
+    QMutexLocker locker(&m_wakeMutex);
+    m_wakeWriter.wakeOne();
+}
+
+void Logger::writerLoop()
+{
+    QByteArray buffer;
+
+    for (;;) {
+        if (drainBatch(buffer)) {
+            continue;
+        }
+
+        if (m_stopping.load()) {
+            // One last pass for anything pushed while we were deciding to stop
+            if (!drainBatch(buffer)) {
+                break;
+            }
+            continue;
+        }
+
+        // Announce idle under the wake mutex, then check for records pushed
+        // before a producer could see the flag. A producer that does see it
+        // blocks on the mutex until we are waiting, so its wake is not lost.
+        QMutexLocker locker(&m_wakeMutex);
+        m_writerIdle.store(true, std::memory_order_seq_cst);
+        if (m_enqueued.load(std::memory_order_seq_cst) == m_written.load() && !m_stopping.load()) {
+            m_wakeWriter.wait(&m_wakeMutex, LOG_WRITER_IDLE_MS);
+        }
+        m_writerIdle.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool Logger::drainBatch(QByteArray& buffer)
+{
+    // Single consumer: the writer, or the crash path if it gets here first
+    if (m_consumerBusy.test_and_set(std::memory_order_acquire)) {
+        return false;
+    }
+
+    buffer.clear();
+
+    const quint64 dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        Record notice;
+        stamp(notice);
+        notice.level = Warning;
+        notice.message = QString("Logger: %1 messages dropped (ring full)").arg(dropped);
+        appendRecord(buffer, notice);
+    }
+
+    Record record;
+    int count = 0;
+    while (count < LOG_BATCH_MAX && m_ring.tryPop(record)) {
+        appendRecord(buffer, record);
+        count++;
+    }
+
+    if (!buffer.isEmpty()) {
+        QMutexLocker locker(&m_mutex);
+        writeBuffer(buffer);
+    }
+
+    m_consumerBusy.clear(std::memory_order_release);
+
+    if (count > 0) {
+        m_written.fetch_add(count);
+        QMutexLocker locker(&m_wakeMutex);
+        m_batchWritten.wakeAll();
+    }
+
+    return count > 0 || dropped > 0;
+}
+
+void Logger::appendRecord(QByteArray& buffer, const Record& record)
+{
+    if (m_format == BinaryFile) {
+        appendBinary(buffer, record);
+    } else {
+        appendLine(buffer, record);
+    }
+}
+
+void Logger::appendLine(QByteArray& buffer, const Record& record)
+{
+    // Date formatting is the expensive part; do it once per second
+    const qint64 second = record.timestampMs / 1000;
+    if (second != m_cachedSecond) {
+        m_cachedSecond = second;
+        m_cachedStamp = QDateTime::fromMSecsSinceEpoch(second * 1000)
+                            .toString("yyyy-MM-dd hh:mm:ss").toLatin1();
+    }
+
+    const int ms = static_cast<int>(record.timestampMs % 1000);
+
+    buffer.append(m_cachedStamp);
+    buffer.append('.');
+    buffer.append(static_cast<char>('0' + ms / 100));
+    buffer.append(static_cast<char>('0' + (ms / 10) % 10));
+    buffer.append(static_cast<char>('0' + ms % 10));
+    buffer.append(' ');
+    buffer.append(LogFormat::severityTag(severity(record.level)));
+    buffer.append(' ');
+    if (record.category != CatGeneral) {
+        buffer.append('[');
+        buffer.append(s_categoryNames[record.category]);
+        buffer.append("] ");
+    }
+    if (record.formatId) {
+        buffer.append(LogFormat::render(s_formats[record.formatId - 1].load(std::memory_order_relaxed),
+                                        record.args).toUtf8());
+    } else {
+        buffer.append(record.message.toUtf8());
+    }
+    buffer.append('\n');
+}
+
+void Logger::appendBinary(QByteArray& buffer, const Record& record)
+{
+    if (buffer.isEmpty()) {
+        m_bufferBaseUs = m_lastMonoUs;
+    }
+
+    // Define any formats registered since the last record; ids are dense
+    if (record.formatId > m_formatsWritten) {
+        for (int id = m_formatsWritten + 1; id <= record.formatId; id++) {
+            buffer.append(static_cast<char>(LogFormat::RecFormat));
+            LogFormat::putVarint(buffer, static_cast<quint64>(id));
+            LogFormat::putString(buffer, QByteArray(s_formats[id - 1].load(std::memory_order_relaxed)));
+        }
+        m_formatsWritten = record.formatId;
+    }
+
+    buffer.append(static_cast<char>(record.formatId ? LogFormat::RecEvent : LogFormat::RecText));
+    LogFormat::putSigned(buffer, record.monoUs - m_lastMonoUs);
+    buffer.append(static_cast<char>((record.category << 2) | severity(record.level)));
+    m_lastMonoUs = record.monoUs;
+
+    if (record.formatId) {
+        LogFormat::putVarint(buffer, record.formatId);
+        LogFormat::putString(buffer, record.args);
+    } else {
+        LogFormat::putString(buffer, record.message.toUtf8());
+    }
+}
+
+void Logger::appendBinaryPreamble(QByteArray& buffer)
+{
+    // Called for every newly opened file. The buffer being written when the
+    // file rotates was encoded against m_bufferBaseUs, so that is baseUs;
+    // m_lastMonoUs has already moved on to the buffer's last record.
+    const qint64 monoUs = m_clock.nsecsElapsed() / 1000;
+    buffer.append(static_cast<char>(LogFormat::RecSession));
+    LogFormat::putVarint(buffer, static_cast<quint64>(QDateTime::currentMSecsSinceEpoch()));
+    LogFormat::putVarint(buffer, static_cast<quint64>(monoUs));
+    LogFormat::putVarint(buffer, static_cast<quint64>(m_bufferBaseUs));
+    LogFormat::putVarint(buffer, LogCategoryCount);
+    for (int i = 0; i < LogCategoryCount; i++) {
+        LogFormat::putString(buffer, QByteArray(s_categoryNames[i]));
+    }
+
+    // Every file is self-contained: repeat the formats known so far
+    const int count = s_formatCount.load(std::memory_order_acquire);
+    for (int id = 1; id <= count; id++) {
+        buffer.append(static_cast<char>(LogFormat::RecFormat));
+        LogFormat::putVarint(buffer, static_cast<quint64>(id));
+        LogFormat::putString(buffer, QByteArray(s_formats[id - 1].load(std::memory_order_relaxed)));
+    }
+    m_formatsWritten = count;
+}
+
+void Logger::writeBuffer(QByteArray& buffer)
+{
+    // Caller holds m_mutex. Size is tracked locally rather than asking the
+    // file system on every write.
+    if (m_fileBytes + buffer.size() > MAX_LOG_FILE_SIZE) {
         closeCurrentLogFile();
 
         if (!openNewLogFile()) {
@@ -75,32 +484,93 @@ void Logger::log(const QString &message, LogLevel level)
         rotateLogs();
     }
 
-    // Determine level text
-    QString levelText;
-    switch (level) {
-    case Info:    levelText = "[INFO]";  break;
-    case Warning: levelText = "[WARN]";  break;
-    case Error:   levelText = "[ERROR]"; break;
-    case Debug:   levelText = "[DEBUG]"; break;
-    default:      levelText = "[INFO]";  break;
+    if (!m_logFile.isOpen()) {
+        return;
     }
 
-    // Create log line
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-    QString logLine = QString("%1 %2 %3").arg(timestamp, levelText, message);
-
-    // Write to file
-    m_logStream << logLine << "\n";
-    m_logStream.flush();
-    qDebug().noquote() << logLine;
+    m_logFile.write(buffer);
+    m_logFile.flush();
+    m_fileBytes += buffer.size();
 
 // Also output to debug console in debug builds
 #ifdef QT_DEBUG
-    // Only show warnings and errors in release to reduce noise
-    if (level >= Warning || level == Debug) {
-        qDebug().noquote() << logLine;
+    qDebug().noquote() << QString::fromUtf8(buffer).trimmed();
+#endif
+}
+
+void Logger::emergencyFlush()
+{
+    if (!m_isValid || m_mode != Async) {
+        return;
+    }
+
+    // Give a writer that is mid-batch a moment to finish, then drain the
+    // rest on this thread
+    QDeadlineTimer deadline(200);
+    QByteArray buffer;
+    while (!deadline.hasExpired()) {
+        if (!drainBatch(buffer) && m_enqueued.load() == m_written.load()) {
+            break;
+        }
+    }
+}
+
+void Logger::flushForCrash()
+{
+    // Once only, even if a second fault hits while flushing
+    if (Logger* logger = s_crashLogger.exchange(nullptr)) {
+        logger->emergencyFlush();
+        logger->m_flightRecorder.dumpForCrash();
     }
+}
+
+void Logger::installCrashHandler(Logger* logger)
+{
+    static const int crashSignals[] = { SIGSEGV, SIGILL, SIGFPE, SIGABRT };
+
+    Logger* previous = s_crashLogger.exchange(logger);
+    if (logger && !previous) {
+#ifdef Q_OS_WIN
+        // CRT signals are delivered synchronously on the faulting thread
+        for (int sig : crashSignals) {
+            std::signal(sig, [](int sig) {
+                flushForCrash();
+                std::signal(sig, SIG_DFL);
+                std::raise(sig);
+            });
+        }
+#else
+        // Only async-signal-safe calls in the handler: a fixed note to stderr, then
+        // the default action. Queued records are lost; flushing needs locks.
+        const int length = qsnprintf(s_crashNote, sizeof(s_crashNote),
+                                     "Fatal signal: queued log records for %s were not written\n",
+                                     logger->m_logDir.toLocal8Bit().constData());
+        s_crashNoteLength = length > 0 ? qMin<size_t>(static_cast<size_t>(length), sizeof(s_crashNote) - 1) : 0;
+        for (int sig : crashSignals) {
+            std::signal(sig, [](int sig) {
+                const ssize_t written = ::write(STDERR_FILENO, s_crashNote, s_crashNoteLength);
+                Q_UNUSED(written);
+                std::signal(sig, SIG_DFL);
+                std::raise(sig);
+            });
+        }
 #endif
+#ifdef Q_OS_WIN
+        // Access violations and other SEH faults do not raise signals
+        s_previousFilter = SetUnhandledExceptionFilter([](EXCEPTION_POINTERS* info) -> LONG {
+            flushForCrash();
+            return s_previousFilter ? s_previousFilter(info) : EXCEPTION_CONTINUE_SEARCH;
+        });
+#endif
+    } else if (!logger && previous) {
+        for (int sig : crashSignals) {
+            std::signal(sig, SIG_DFL);
+        }
+#ifdef Q_OS_WIN
+        SetUnhandledExceptionFilter(s_previousFilter);
+        s_previousFilter = nullptr;
+#endif
+    }
 }
 
 void Logger::rotateLogs()
@@ -109,7 +579,7 @@ void Logger::rotateLogs()
 
     // Get all log files sorted by time (oldest first)
     QStringList logFiles = dir.entryList(
-        QStringList() << "log_*.txt",
+        QStringList() << "log_*.txt" << "log_*.clog",
         QDir::Files,
         QDir::Time | QDir::Reversed);
 
@@ -137,11 +607,16 @@ bool Logger::openNewLogFile()
 
     // Generate new log file name with timestamp
     QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-    QString logFileName = QString("%1/log_%2.txt").arg(m_logDir, timestamp);
+    QString logFileName = QString("%1/log_%2.%3")
+                              .arg(m_logDir, timestamp, m_format == BinaryFile ? "clog" : "txt");
 
     m_logFile.setFileName(logFileName);
 
-    if (!m_logFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append)) {
+    QIODevice::OpenMode openMode = QIODevice::WriteOnly | QIODevice::Append;
+    if (m_format == TextFile) {
+        openMode |= QIODevice::Text;
+    }
+    if (!m_logFile.open(openMode)) {
 #ifdef QT_DEBUG
         qWarning() << "Failed to open log file:" << logFileName
                    << "Error:" << m_logFile.errorString();
@@ -149,8 +624,18 @@ bool Logger::openNewLogFile()
         return false;
     }
 
-    // Set up the text stream
-    m_logStream.setDevice(&m_logFile);
+    m_fileBytes = m_logFile.size();
+
+    if (m_format == BinaryFile) {
+        QByteArray preamble;
+        if (m_fileBytes == 0) {
+            preamble.append(LOG_BINARY_MAGIC);
+            preamble.append(static_cast<char>(LOG_BINARY_VERSION));
+        }
+        appendBinaryPreamble(preamble);
+        m_logFile.write(preamble);
+        m_fileBytes += preamble.size();
+    }
 
 #ifdef QT_DEBUG
     qDebug() << "Opened new log file:" << logFileName;
@@ -161,12 +646,8 @@ bool Logger::openNewLogFile()
 
 void Logger::closeCurrentLogFile()
 {
-    if (m_logStream.device()) {
-        m_logStream.flush();
-        m_logStream.setDevice(nullptr);
-    }
-
     if (m_logFile.isOpen()) {
+        m_logFile.flush();
         m_logFile.close();
     }
 }
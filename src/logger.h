@@ -3,10 +3,50 @@
 
 #include <QObject>
 #include <QFile>
-#include <QTextStream>
 #include <QDateTime>
 #include <QDir>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include "logring.h"
+#include "logformat.h"
+#include "flightrecorder.h"
+
+#define LOG_RING_CAPACITY       8192        // Records buffered between producers and the writer
+#define LOG_BATCH_MAX           512         // Records formatted per write/flush
+#define LOG_WRITER_IDLE_MS      100         // Writer wakes at least this often
+#define LOG_FLUSH_TIMEOUT_MS    2000
+
+// Lazy logging: the message expression is evaluated only when the category
+// is enabled at that level, so debug instrumentation can stay compiled in.
+//   LOG_DEBUG(m_pLogger, CatEcManager, QString("offset=0x%1").arg(offset, 4, 16, QChar('0')));
+#define LOG_AT(logger, category, level, message)                                    \
+    do {                                                                            \
+        Logger* _pLog = (logger);                                                   \
+        if (_pLog && _pLog->isEnabled(Logger::category, Logger::level)) {           \
+            _pLog->log(Logger::category, Logger::level, (message));                 \
+        }                                                                           \
+    } while (0)
+
+#define LOG_DEBUG(logger, category, message)    LOG_AT(logger, category, Debug, message)
+#define LOG_INFO(logger, category, message)     LOG_AT(logger, category, Info, message)
+#define LOG_WARNING(logger, category, message)  LOG_AT(logger, category, Warning, message)
+#define LOG_ERROR(logger, category, message)    LOG_AT(logger, category, Error, message)
+
+// Deferred formatting: the format literal is registered once per call site and
+// the arguments are stored typed. Binary log files keep them that way; text
+// files format them on the writer thread. Placeholders are %1..%9.
+//   LOG_FMT(m_pLogger, CatEmiThread, Debug, "Results ready after %1ms", i);
+#define LOG_FMT(logger, category, level, format, ...)                               \
+    do {                                                                            \
+        Logger* _pLog = (logger);                                                   \
+        if (_pLog && _pLog->isEnabled(Logger::category, Logger::level)) {           \
+            static const quint16 _fmtId = Logger::registerFormat(format);           \
+            _pLog->logFormat(Logger::category, Logger::level, _fmtId, format, ##__VA_ARGS__); \
+        }                                                                           \
+    } while (0)
 
 class Logger : public QObject
 {
@@ -21,25 +61,180 @@ public:
     };
     Q_ENUM(LogLevel)
 
-    explicit Logger(const QString &logDir, QObject *parent = nullptr);
+    // Modules with their own runtime threshold
+    enum LogCategory {
+        CatGeneral,
+        CatEcManager,
+        CatEmiThread,
+        CatPipeServer,
+        CatSecureHandler,
+        CatBezelMonitor,
+        CatCommandProc,
+        CatMirror,
+        CatWmi,
+        CatNotify,
+        LogCategoryCount
+    };
+    Q_ENUM(LogCategory)
+
+    // Async: log() queues the record and a writer thread formats, writes and
+    // rotates in batches. Synchronous: log() writes and flushes inline (the
+    // original behaviour; kept for tools and comparison).
+    enum Mode {
+        Async,
+        Synchronous
+    };
+
+    // Text: one formatted line per record (log_*.txt). Binary: monotonic
+    // timestamps, format ids and typed arguments (log_*.clog) - several times
+    // more history in the same disk budget; render with CSLogDecode.
+    enum FileFormat {
+        TextFile,
+        BinaryFile
+    };
+
+    // What log() does when the ring is full
+    enum OverflowPolicy {
+        DropNewest,         // Count it and move on; a summary line is written later
+        Block,              // Wait for the writer to make room
+        BlockOnWarning      // Block for Warning/Error, drop Info/Debug
+    };
+
+    explicit Logger(const QString &logDir, QObject *parent = nullptr, Mode mode = Async,
+                    FileFormat format = TextFile);
     ~Logger();
 
     void log(const QString &message, LogLevel level = Info);
+    void log(LogCategory category, LogLevel level, const QString &message);
+
+    // Backend of LOG_FMT. formatId 0 (registry full) formats immediately.
+    template <typename... Args>
+    void logFormat(LogCategory category, LogLevel level, quint16 formatId,
+                   const char* format, const Args&... args)
+    {
+        QByteArray packed;
+        int expand[] = { 0, (LogFormat::appendArg(packed, args), 0)... };
+        Q_UNUSED(expand);
+
+        if (formatId == 0) {
+            log(category, level, LogFormat::render(format, packed));
+            return;
+        }
+        submitFormat(category, level, formatId, std::move(packed));
+    }
+
+    // Ids are process-wide and stable for the life of the process
+    static quint16 registerFormat(const char* format);
+    static LogFormat::Hex hex(quint64 value, int width = 0) { return LogFormat::Hex{ value, width }; }
+
+    // Threshold check for the LOG_* macros - one relaxed load
+    bool isEnabled(LogCategory category, LogLevel level) const
+    {
+        return severity(level) >= m_thresholds[category].load(std::memory_order_relaxed);
+    }
+
+    // Lowest level written for a category (default Info: Debug is off)
+    void setThreshold(LogCategory category, LogLevel level);
+    LogLevel threshold(LogCategory category) const;
+
+    static QString categoryName(LogCategory category);
+    static bool categoryFromName(const QString& name, LogCategory* category);
+
+    // The enum order predates severities; Debug < Info < Warning < Error
+    static int severity(LogLevel level)
+    {
+        switch (level) {
+        case Debug:   return 0;
+        case Info:    return 1;
+        case Warning: return 2;
+        case Error:   return 3;
+        default:      return 1;
+        }
+    }
+
+    // Block until everything logged before the call is on disk
+    void flush();
+
+    void setOverflowPolicy(OverflowPolicy policy) { m_overflowPolicy.store(policy, std::memory_order_relaxed); }
+    quint64 droppedCount() const { return m_droppedTotal.load(std::memory_order_relaxed); }
+
+    // Debug-detail event trace kept in memory, dumped next to the log files
+    FlightRecorder& flightRecorder() { return m_flightRecorder; }
 
     // Optional: Check if logger is functional
     bool isValid() const { return m_isValid; }
     QString currentLogFile() const;
 
+    // Write out whatever is still queued, and dump the flight recorder, if
+    // the process crashes (Windows: SEH filter and CRT signals). POSIX crash
+    // signals only write a fixed note to stderr, since nothing else is
+    // async-signal-safe. One logger per process; pass nullptr to uninstall.
+    static void installCrashHandler(Logger* logger);
+
 private:
+    struct Record {
+        qint64 timestampMs = 0;     // Wall clock (text files)
+        qint64 monoUs = 0;          // Monotonic (binary files)
+        LogLevel level = Info;
+        LogCategory category = CatGeneral;
+        quint16 formatId = 0;       // Non-zero: args holds the packed arguments
+        QString message;
+        QByteArray args;
+    };
+
+    void stamp(Record& record) const;
+    void submit(Record&& record);
+    void submitFormat(LogCategory category, LogLevel level, quint16 formatId, QByteArray&& args);
+    void appendRecord(QByteArray& buffer, const Record& record);
+    void appendBinary(QByteArray& buffer, const Record& record);
+    void appendBinaryPreamble(QByteArray& buffer);
+
+    void writerLoop();
+    bool drainBatch(QByteArray& buffer);
+    void appendLine(QByteArray& buffer, const Record& record);
+    void writeBuffer(QByteArray& buffer);
+    void emergencyFlush();
+    static void flushForCrash();
+    void wakeWriter();
+
     void rotateLogs();
     bool openNewLogFile();
     void closeCurrentLogFile();
 
     QString m_logDir;
     QFile m_logFile;
-    QTextStream m_logStream;
-    mutable QMutex m_mutex;
+    qint64 m_fileBytes;
+    mutable QMutex m_mutex;         // File and rotation state
     bool m_isValid;
+    const Mode m_mode;
+    const FileFormat m_format;
+    std::atomic<int> m_thresholds[LogCategoryCount];   // Minimum severity()
+    FlightRecorder m_flightRecorder;
+
+    // Async pipeline
+    LogRing<Record> m_ring;
+    QThread* m_writerThread;
+    std::atomic<bool> m_stopping;
+    std::atomic<bool> m_writerIdle;
+    std::atomic_flag m_consumerBusy = ATOMIC_FLAG_INIT;
+    std::atomic<int> m_overflowPolicy;
+    std::atomic<quint64> m_enqueued;
+    std::atomic<quint64> m_written;
+    std::atomic<quint64> m_dropped;         // Since the last summary line
+    std::atomic<quint64> m_droppedTotal;
+    QMutex m_wakeMutex;
+    QWaitCondition m_wakeWriter;
+    QWaitCondition m_batchWritten;
+
+    // Timestamp formatting cache (writer side)
+    qint64 m_cachedSecond;
+    QByteArray m_cachedStamp;
+
+    // Binary file state (writer side, under m_mutex on rotation)
+    QElapsedTimer m_clock;
+    qint64 m_lastMonoUs;
+    qint64 m_bufferBaseUs;      // m_lastMonoUs before the first record of the buffer being built
+    int m_formatsWritten;       // Registered formats already defined in this file
 
     const qint64 MAX_LOG_FILE_SIZE = 5 * 1024 * 1024; // 5 MB
     const int MAX_LOG_FILES = 5;
@@ -0,0 +1,91 @@
+#ifndef LOGRING_H
+#define LOGRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief LogRing - Bounded lock-free multi-producer / single-consumer queue
+ *
+ * Each cell carries a sequence number: a producer claims a slot by advancing
+ * the enqueue position with a CAS, fills it and publishes it by storing
+ * pos + 1; the consumer takes it and hands the cell back to producers by
+ * storing pos + capacity. Producers never wait on each other beyond the CAS,
+ * and never wait on the consumer - a full ring fails the push instead.
+ *
+ * Capacity must be a power of two.
+ */
+template <typename T>
+class LogRing
+{
+public:
+    explicit LogRing(quint32 capacity)
+        : m_mask(capacity - 1)
+        , m_cells(new Cell[capacity])
+        , m_dequeuePos(0)
+    {
+        Q_ASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+        for (quint32 i = 0; i < capacity; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+    }
+
+    quint32 capacity() const { return m_mask + 1; }
+
+    // Any thread
+    bool tryPush(T&& value)
+    {
+        Cell* cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;   // Full
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool tryPop(T& value)
+    {
+        Cell* cell = &m_cells[m_dequeuePos & m_mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(m_dequeuePos + 1) < 0) {
+            return false;       // Empty, or the next producer has not finished
+        }
+
+        value = std::move(cell->value);
+        cell->sequence.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+        m_dequeuePos++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) size_t m_dequeuePos;
+
+    Q_DISABLE_COPY(LogRing)
+};
+
+#endif // LOGRING_H
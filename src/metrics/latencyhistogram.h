@@ -0,0 +1,89 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <QList>
+#include <atomic>
+
+#define LATENCY_BUCKET_COUNT    16      // 15 bounded buckets + overflow
+
+/**
+ * @brief LatencyHistogram - Lock-free fixed-bucket latency recorder
+ *
+ * Bucket i counts samples <= boundsUs()[i]; the last bucket takes everything
+ * above the largest bound. record() is safe from any thread and costs a few
+ * relaxed atomic adds, so it can sit on every command path.
+ */
+class LatencyHistogram
+{
+public:
+    struct Snapshot {
+        quint64 count = 0;
+        quint64 totalUs = 0;
+        quint64 maxUs = 0;
+        QList<quint64> buckets;
+    };
+
+    // Upper bound (microseconds) of each bounded bucket
+    static const QList<quint32>& boundsUs()
+    {
+        static const QList<quint32> bounds = {
+            10, 25, 50, 100, 250, 500,
+            1000, 2500, 5000, 10000, 25000, 50000,
+            100000, 250000, 1000000
+        };
+        return bounds;
+    }
+
+    LatencyHistogram() { reset(); }
+
+    void record(quint64 us)
+    {
+        const QList<quint32>& bounds = boundsUs();
+        int bucket = 0;
+        while (bucket < bounds.size() && us > bounds.at(bucket)) {
+            bucket++;
+        }
+
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_totalUs.fetch_add(us, std::memory_order_relaxed);
+
+        quint64 prev = m_maxUs.load(std::memory_order_relaxed);
+        while (us > prev && !m_maxUs.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot snap;
+        snap.count = m_count.load(std::memory_order_relaxed);
+        snap.totalUs = m_totalUs.load(std::memory_order_relaxed);
+        snap.maxUs = m_maxUs.load(std::memory_order_relaxed);
+        snap.buckets.reserve(LATENCY_BUCKET_COUNT);
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+            snap.buckets.append(m_buckets[i].load(std::memory_order_relaxed));
+        }
+        return snap;
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_totalUs.store(0, std::memory_order_relaxed);
+        m_maxUs.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<quint64> m_buckets[LATENCY_BUCKET_COUNT];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_totalUs;
+    std::atomic<quint64> m_maxUs;
+
+    Q_DISABLE_COPY(LatencyHistogram)
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,286 @@
+#include "ecmirrorproducer.h"
+#include "host_ec_cmds.h"
+#include <QMutexLocker>
+#include <cstring>
+
+EcMirrorProducer::EcMirrorProducer(EcManager* ecManager, Logger* logger, QObject* parent)
+    : QObject(parent)
+    , m_ecManager(ecManager)
+    , m_logger(logger)
+    , m_writer(logger)
+    , m_thread(nullptr)
+    , m_context(nullptr)
+    , m_running(false)
+{
+    m_clock.start();
+}
+
+EcMirrorProducer::~EcMirrorProducer()
+{
+    stop();
+    qDeleteAll(m_regions);
+    m_regions.clear();
+}
+
+bool EcMirrorProducer::addRegion(const MirrorRegionConfig& config)
+{
+    if (m_running) {
+        LOG_WARNING(m_logger, CatMirror, QString("EcMirrorProducer: cannot add region %1 while running").arg(config.name));
+        return false;
+    }
+    if (config.readCmd == 0 || config.intervalMs <= 0) {
+        LOG_WARNING(m_logger, CatMirror, QString("EcMirrorProducer: region %1 has no read command or interval").arg(config.name));
+        return false;
+    }
+    if (!m_writer.addRegion(config.regionId, config.name, config.size)) {
+        return false;
+    }
+
+    Region* region = new Region;
+    region->config = config;
+    region->shadow = QByteArray(static_cast<int>(config.size), '\0');
+    m_regions.append(region);
+    return true;
+}
+
+void EcMirrorProducer::addDefaultRegions()
+{
+    // ACPI0 holds the fast-moving state (bezel, brightness) - refresh it often
+    MirrorRegionConfig acpi0;
+    acpi0.regionId = EC_REGION_ACPI0;
+    acpi0.name = "ACPI0";
+    acpi0.readCmd = ECCMD_ACPI0_READ;
+    acpi0.size = EC_REGION_ACPI_SIZE;
+    acpi0.intervalMs = 50;
+    addRegion(acpi0);
+
+    MirrorRegionConfig acpi1;
+    acpi1.regionId = EC_REGION_ACPI1;
+    acpi1.name = "ACPI1";
+    acpi1.readCmd = ECCMD_ACPI1_READ;
+    acpi1.size = EC_REGION_ACPI_SIZE;
+    acpi1.intervalMs = 250;
+    addRegion(acpi1);
+
+    MirrorRegionConfig ecram;
+    ecram.regionId = EC_REGION_ECRAM;
+    ecram.name = "ECRAM";
+    ecram.readCmd = ECCMD_ECRAM_READ;
+    ecram.size = EC_REGION_ECRAM_SIZE;
+    ecram.intervalMs = 250;
+    addRegion(ecram);
+
+    MirrorRegionConfig battery;
+    battery.regionId = EC_REGION_BATTERY_HEALTH;
+    battery.name = "BatteryHealth";
+    battery.readCmd = ECCMD_BAT_GET_HEALTH;
+    battery.ranged = false;
+    battery.size = EC_REGION_INFO_SIZE;
+    battery.intervalMs = 5000;
+    addRegion(battery);
+
+    MirrorRegionConfig dfu;
+    dfu.regionId = EC_REGION_DFU_INFO;
+    dfu.name = "DfuInfo";
+    dfu.readCmd = ECCMD_DFU_INFO;
+    dfu.ranged = false;
+    dfu.size = EC_REGION_INFO_SIZE;
+    dfu.intervalMs = 30000;
+    addRegion(dfu);
+}
+
+bool EcMirrorProducer::start()
+{
+    if (m_running) {
+        return true;
+    }
+
+    if (!m_ecManager || !m_ecManager->isInitialized()) {
+        LOG_ERROR(m_logger, CatMirror, "EcMirrorProducer: cannot start - EcManager not initialized");
+        return false;
+    }
+
+    if (!m_writer.create()) {
+        LOG_ERROR(m_logger, CatMirror, "EcMirrorProducer: failed to create the shared mirror");
+        return false;
+    }
+
+    m_running = true;
+
+    m_thread = new QThread;
+    m_thread->setObjectName("EcMirror");
+    m_context = new QObject;
+    m_context->moveToThread(m_thread);
+    connect(m_thread, &QThread::started, m_context, [this]() { startTimers(); });
+    m_thread->start();
+
+    LOG_INFO(m_logger, CatMirror, QString("EcMirrorProducer: mirroring %1 regions").arg(m_regions.size()));
+    return true;
+}
+
+void EcMirrorProducer::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    // Timers must be stopped on their own thread; this waits out a refresh in progress
+    QMetaObject::invokeMethod(m_context, [this]() { stopTimers(); }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_context;
+    m_context = nullptr;
+    delete m_thread;
+    m_thread = nullptr;
+
+    QMutexLocker locker(&m_statsMutex);
+    m_writer.close();
+    m_running = false;
+
+    LOG_INFO(m_logger, CatMirror, "EcMirrorProducer: stopped");
+}
+
+void EcMirrorProducer::startTimers()
+{
+    for (Region* region : m_regions) {
+        region->timer = new QTimer(m_context);
+        region->timer->setInterval(region->config.intervalMs);
+        connect(region->timer, &QTimer::timeout, m_context, [this, region]() { refresh(region); });
+
+        // Populate the mirror before waiting for the first interval
+        refresh(region);
+        region->timer->start();
+    }
+}
+
+void EcMirrorProducer::stopTimers()
+{
+    for (Region* region : m_regions) {
+        delete region->timer;
+        region->timer = nullptr;
+        region->primed = false;
+    }
+}
+
+EC_HOST_CMD_STATUS EcMirrorProducer::readChunk(quint16 cmd, quint32 offset, quint32 size, QByteArray& data)
+{
+    mem_region_r_e req;
+    req.start = offset;
+    req.size = size;
+
+    QByteArray payload(reinterpret_cast<const char*>(&req), sizeof(req));
+    return m_ecManager->sendCommandSync(cmd, payload, data, MIRROR_EC_TIMEOUT_MS);
+}
+
+void EcMirrorProducer::refresh(Region* region)
+{
+    const MirrorRegionConfig& cfg = region->config;
+    QElapsedTimer timer;
+    timer.start();
+
+    EC_HOST_CMD_STATUS status = EC_HOST_CMD_SUCCESS;
+    bool changed = false;
+
+    if (!cfg.ranged) {
+        // Info commands return a whole structure; mirror its leading bytes
+        QByteArray data;
+        status = m_ecManager->sendCommandSync(cfg.readCmd, QByteArray(), data, MIRROR_EC_TIMEOUT_MS);
+        if (status == EC_HOST_CMD_SUCCESS && data.isEmpty()) {
+            status = EC_HOST_CMD_ERROR;
+        }
+        if (status == EC_HOST_CMD_SUCCESS) {
+            data.truncate(static_cast<int>(cfg.size));
+            changed = (region->shadow.left(data.size()) != data);
+            region->shadow.replace(0, data.size(), data);
+        }
+    } else {
+        // Collect every chunk before touching the shadow so a failed refresh
+        // never leaves it half updated and unpublished
+        QByteArray chunk;
+        region->scratch.resize(static_cast<int>(cfg.size));
+
+        for (quint32 pos = 0; pos < cfg.size && status == EC_HOST_CMD_SUCCESS; pos += MIRROR_EC_CHUNK_SIZE) {
+            const quint32 len = qMin<quint32>(MIRROR_EC_CHUNK_SIZE, cfg.size - pos);
+
+            status = readChunk(cfg.readCmd, cfg.ecOffset + pos, len, chunk);
+            if (status == EC_HOST_CMD_SUCCESS && chunk.size() < static_cast<int>(len)) {
+                status = EC_HOST_CMD_ERROR;
+            }
+            if (status == EC_HOST_CMD_SUCCESS) {
+                memcpy(region->scratch.data() + pos, chunk.constData(), len);
+            }
+        }
+
+        if (status == EC_HOST_CMD_SUCCESS) {
+            changed = (region->scratch != region->shadow);
+            if (changed) {
+                region->shadow.swap(region->scratch);
+            }
+        }
+    }
+
+    const bool ok = (status == EC_HOST_CMD_SUCCESS);
+    if (ok) {
+        if (changed || !region->primed) {
+            m_writer.updateRegion(cfg.regionId, region->shadow);
+        }
+        region->primed = true;
+    }
+
+    recordRefresh(region, ok, changed, timer.nsecsElapsed() / 1000);
+}
+
+void EcMirrorProducer::recordRefresh(Region* region, bool ok, bool changed, qint64 elapsedUs)
+{
+    QMutexLocker locker(&m_statsMutex);
+    region->refreshes++;
+    region->refreshUs += static_cast<quint64>(elapsedUs);
+
+    if (!ok) {
+        region->errors++;
+        return;
+    }
+
+    if (!changed) {
+        region->unchanged++;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    if (region->lastGoodMs >= 0) {
+        region->maxAgeMs = qMax(region->maxAgeMs, now - region->lastGoodMs);
+    }
+    region->lastGoodMs = now;
+}
+
+QList<patrol::MirrorRegionMetrics> EcMirrorProducer::snapshot(bool reset)
+{
+    QList<patrol::MirrorRegionMetrics> result;
+    QMutexLocker locker(&m_statsMutex);
+    const qint64 now = m_clock.elapsed();
+
+    for (Region* region : m_regions) {
+        patrol::MirrorRegionMetrics m;
+        m.setRegionId(region->config.regionId);
+        m.setName(region->config.name);
+        m.setVersion(m_writer.regionVersion(region->config.regionId));
+        m.setIntervalMs(static_cast<quint32>(region->config.intervalMs));
+        m.setRefreshes(region->refreshes);
+        m.setUnchanged(region->unchanged);
+        m.setErrors(region->errors);
+        m.setAgeMs(region->lastGoodMs >= 0 ? static_cast<quint64>(now - region->lastGoodMs) : 0);
+        m.setMaxAgeMs(static_cast<quint64>(qMax(region->maxAgeMs,
+                                                region->lastGoodMs >= 0 ? now - region->lastGoodMs : 0)));
+        m.setAvgRefreshUs(region->refreshes ? region->refreshUs / region->refreshes : 0);
+        result.append(m);
+
+        if (reset) {
+            region->refreshes = 0;
+            region->unchanged = 0;
+            region->errors = 0;
+            region->refreshUs = 0;
+            region->maxAgeMs = 0;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,96 @@
+#ifndef ECMIRRORPRODUCER_H
+#define ECMIRRORPRODUCER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QTimer>
+#include <QThread>
+#include "ecmanager.h"
+#include "ecmemorymirror.h"
+#include "logger.h"
+#include "serviceext.qpb.h"
+
+#define MIRROR_EC_CHUNK_SIZE        128     // Bytes per EC read; EMI packets carry at most 248
+#define MIRROR_DEFAULT_INTERVAL_MS  100
+#define MIRROR_EC_TIMEOUT_MS        500     // Short, so one stuck read cannot hold up the other regions for long
+
+// One mirrored EC source
+struct MirrorRegionConfig {
+    quint16 regionId = 0;           // EC_REGION_*
+    QString name;
+    quint16 readCmd = 0;            // ECCMD_*_READ (ranged) or an info command
+    bool ranged = true;             // readCmd takes a mem_region_r_e request
+    quint32 ecOffset = 0;           // Start of the mirrored window in the EC space
+    quint32 size = 0;               // Bytes mirrored (<= EC_MIRROR_MAX_REGION_SIZE)
+    int intervalMs = MIRROR_DEFAULT_INTERVAL_MS;
+};
+
+/**
+ * @brief EcMirrorProducer - Keeps the shared EC memory mirror up to date
+ *
+ * Each configured region is refreshed on its own timer and published through
+ * ECMemoryWriter, so clients read EC state from mapped memory instead of
+ * sending ACPI/ECRAM reads over the pipe.
+ *
+ * Every refresh is a plain READ; the shadow copy and the writer's line diff
+ * keep unchanged data from bumping the version.
+ *
+ * The refresh timers run on the producer's own thread, so the synchronous EC
+ * reads never block the service thread and its pipes. start() and stop()
+ * are called from the owning thread; snapshot() may be called from any thread.
+ */
+class EcMirrorProducer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EcMirrorProducer(EcManager* ecManager, Logger* logger, QObject* parent = nullptr);
+    ~EcMirrorProducer();
+
+    // Register before start()
+    bool addRegion(const MirrorRegionConfig& config);
+    void addDefaultRegions();
+
+    bool start();
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    QList<patrol::MirrorRegionMetrics> snapshot(bool reset);
+
+private:
+    struct Region {
+        MirrorRegionConfig config;
+        QTimer* timer = nullptr;        // Lives on m_thread
+        bool primed = false;            // A full read has been published
+        QByteArray shadow;              // Last known EC contents
+        QByteArray scratch;             // Ranged read in progress, swapped in when complete
+
+        // Guarded by m_statsMutex
+        quint64 refreshes = 0;
+        quint64 unchanged = 0;
+        quint64 errors = 0;
+        quint64 refreshUs = 0;
+        qint64 lastGoodMs = -1;
+        qint64 maxAgeMs = 0;
+    };
+
+    void startTimers();             // On m_thread
+    void stopTimers();              // On m_thread
+    void refresh(Region* region);
+    EC_HOST_CMD_STATUS readChunk(quint16 cmd, quint32 offset, quint32 size, QByteArray& data);
+    void recordRefresh(Region* region, bool ok, bool changed, qint64 elapsedUs);
+
+    EcManager* m_ecManager;
+    Logger* m_logger;
+    ECMemoryWriter m_writer;
+    QList<Region*> m_regions;
+    QThread* m_thread;
+    QObject* m_context;             // Owns the timers on m_thread
+    QElapsedTimer m_clock;
+    QMutex m_statsMutex;
+    bool m_running;
+};
+
+#endif // ECMIRRORPRODUCER_H
@@ -0,0 +1,255 @@
+#include "telemetryring.h"
+#include <cstring>
+
+namespace {
+
+quint64 ringSize(quint32 capacity)
+{
+    return sizeof(TelemetryRingHeader)
+           + sizeof(TelemetryChannelDesc) * TELEMETRY_MAX_CHANNELS
+           + static_cast<quint64>(sizeof(TelemetrySlot)) * capacity;
+}
+
+std::atomic<uint64_t>* atomicWord(const uint64_t* p)
+{
+    // Shared words are accessed through lock-free (address-free) atomic views
+    return reinterpret_cast<std::atomic<uint64_t>*>(const_cast<uint64_t*>(p));
+}
+
+} // namespace
+
+// ============================================================================
+// TelemetryRingWriter (Service-side)
+// ============================================================================
+
+TelemetryRingWriter::TelemetryRingWriter(Logger* logger)
+    : m_pLogger(logger)
+    , m_region(logger)
+    , m_pHeader(nullptr)
+    , m_pSlots(nullptr)
+    , m_head(0)
+{
+}
+
+TelemetryRingWriter::~TelemetryRingWriter()
+{
+    close();
+}
+
+bool TelemetryRingWriter::create(const QList<TelemetryChannel>& channels, quint32 capacity, quint32 intervalMs)
+{
+    close();
+
+    if (channels.isEmpty() || channels.size() > TELEMETRY_MAX_CHANNELS || capacity == 0) {
+        LOG_ERROR(m_pLogger, CatMirror, QString("TelemetryRing: invalid layout (%1 channels, capacity %2)")
+                                            .arg(channels.size()).arg(capacity));
+        return false;
+    }
+
+    if (!m_region.create(TELEMETRY_RING_NAME, static_cast<qint64>(ringSize(capacity)), false)) {
+        return false;
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(m_region.data());
+    m_pHeader = reinterpret_cast<TelemetryRingHeader*>(base);
+    TelemetryChannelDesc* desc = reinterpret_cast<TelemetryChannelDesc*>(base + sizeof(TelemetryRingHeader));
+    m_pSlots = reinterpret_cast<TelemetrySlot*>(base + sizeof(TelemetryRingHeader)
+                                                + sizeof(TelemetryChannelDesc) * TELEMETRY_MAX_CHANNELS);
+
+    for (int i = 0; i < channels.size(); i++) {
+        const QByteArray name = channels.at(i).name.toLatin1();
+        const QByteArray unit = channels.at(i).unit.toLatin1();
+        memcpy(desc[i].name, name.constData(), qMin<int>(name.size(), TELEMETRY_NAME_SIZE - 1));
+        memcpy(desc[i].unit, unit.constData(), qMin<int>(unit.size(), TELEMETRY_UNIT_SIZE - 1));
+    }
+
+    m_pHeader->layoutVersion = TELEMETRY_LAYOUT_VERSION;
+    m_pHeader->channelCount = static_cast<uint16_t>(channels.size());
+    m_pHeader->capacity = capacity;
+    m_pHeader->slotSize = sizeof(TelemetrySlot);
+    m_pHeader->intervalMs = intervalMs;
+    m_head = 0;
+
+    // Magic last: a reader that sees it also sees the channel table
+    std::atomic_thread_fence(std::memory_order_release);
+    reinterpret_cast<std::atomic<uint32_t>*>(&m_pHeader->magic)->store(TELEMETRY_MAGIC, std::memory_order_release);
+
+    LOG_INFO(m_pLogger, CatMirror, QString("TelemetryRing: created, %1 channels x %2 samples (%3 KB)")
+                                       .arg(channels.size()).arg(capacity).arg(ringSize(capacity) / 1024));
+    return true;
+}
+
+void TelemetryRingWriter::close()
+{
+    if (!m_region.isValid()) {
+        return;
+    }
+
+    m_region.close();
+    m_pHeader = nullptr;
+    m_pSlots = nullptr;
+}
+
+void TelemetryRingWriter::append(qint64 timestampMs, const QVector<float>& values, quint32 validMask)
+{
+    if (!m_pHeader) return;
+
+    const quint64 n = m_head;
+    TelemetrySlot& slot = m_pSlots[n % m_pHeader->capacity];
+    std::atomic<uint64_t>* seq = atomicWord(&slot.sequence);
+
+    seq->store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestampMs = timestampMs;
+    slot.validMask = validMask;
+    const int count = qMin<int>(values.size(), m_pHeader->channelCount);
+    memset(slot.values, 0, sizeof(slot.values));
+    memcpy(slot.values, values.constData(), sizeof(float) * count);
+
+    seq->store(2 * n + 2, std::memory_order_release);
+
+    m_head = n + 1;
+    atomicWord(&m_pHeader->head)->store(m_head, std::memory_order_release);
+}
+
+// ============================================================================
+// TelemetryRingReader (Client-side)
+// ============================================================================
+
+TelemetryRingReader::TelemetryRingReader(Logger* logger)
+    : m_pLogger(logger)
+    , m_region(logger)
+    , m_pHeader(nullptr)
+    , m_pSlots(nullptr)
+    , m_capacity(0)
+{
+}
+
+TelemetryRingReader::~TelemetryRingReader()
+{
+    close();
+}
+
+bool TelemetryRingReader::open()
+{
+    close();
+
+    // Map the header to learn the capacity, then map the whole ring
+    if (!m_region.open(TELEMETRY_RING_NAME, sizeof(TelemetryRingHeader), SharedMemoryRegion::Access::ReadOnly)) {
+        return false;
+    }
+
+    TelemetryRingHeader header;
+    const uint32_t magic = reinterpret_cast<const std::atomic<uint32_t>*>(m_region.constData())
+                               ->load(std::memory_order_acquire);
+    memcpy(&header, m_region.constData(), sizeof(header));
+    m_region.close();
+
+    if (magic != TELEMETRY_MAGIC || header.layoutVersion != TELEMETRY_LAYOUT_VERSION
+        || header.slotSize != sizeof(TelemetrySlot) || header.capacity == 0
+        || header.channelCount > TELEMETRY_MAX_CHANNELS) {
+        if (m_pLogger) {
+            LOG_WARNING(m_pLogger, CatMirror, QString("TelemetryRing: layout not supported (magic 0x%1, layout %2)")
+                                                  .arg(magic, 8, 16, QChar('0')).arg(header.layoutVersion));
+        }
+        return false;
+    }
+
+    if (!m_region.open(TELEMETRY_RING_NAME, static_cast<qint64>(ringSize(header.capacity)),
+                       SharedMemoryRegion::Access::ReadOnly)) {
+        return false;
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(m_region.constData());
+    m_pHeader = reinterpret_cast<const TelemetryRingHeader*>(base);
+    m_pSlots = reinterpret_cast<const TelemetrySlot*>(base + sizeof(TelemetryRingHeader)
+                                                      + sizeof(TelemetryChannelDesc) * TELEMETRY_MAX_CHANNELS);
+    m_capacity = header.capacity;
+
+    const TelemetryChannelDesc* desc = reinterpret_cast<const TelemetryChannelDesc*>(base + sizeof(TelemetryRingHeader));
+    for (int i = 0; i < header.channelCount; i++) {
+        TelemetryChannel channel;
+        channel.name = QString::fromLatin1(desc[i].name, qstrnlen(desc[i].name, TELEMETRY_NAME_SIZE));
+        channel.unit = QString::fromLatin1(desc[i].unit, qstrnlen(desc[i].unit, TELEMETRY_UNIT_SIZE));
+        m_channels.append(channel);
+    }
+
+    return true;
+}
+
+void TelemetryRingReader::close()
+{
+    m_channels.clear();
+    m_region.close();
+    m_pHeader = nullptr;
+    m_pSlots = nullptr;
+    m_capacity = 0;
+}
+
+quint32 TelemetryRingReader::intervalMs() const
+{
+    return m_pHeader ? m_pHeader->intervalMs : 0;
+}
+
+bool TelemetryRingReader::readSlot(quint64 n, TelemetrySample& sample) const
+{
+    const TelemetrySlot& slot = m_pSlots[n % m_capacity];
+    std::atomic<uint64_t>* seq = atomicWord(&slot.sequence);
+    const uint64_t expected = 2 * n + 2;
+
+    if (seq->load(std::memory_order_acquire) != expected) {
+        return false;
+    }
+
+    TelemetrySlot copy;
+    memcpy(&copy, &slot, sizeof(copy));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq->load(std::memory_order_relaxed) != expected) {
+        return false;
+    }
+
+    sample.timestampMs = copy.timestampMs;
+    sample.validMask = copy.validMask;
+    sample.values = QVector<float>(copy.values, copy.values + m_channels.size());
+    return true;
+}
+
+QList<TelemetrySample> TelemetryRingReader::readRange(qint64 fromMs, qint64 toMs, int maxSamples) const
+{
+    QList<TelemetrySample> newestFirst;
+    if (!m_pHeader || maxSamples == 0) {
+        return newestFirst;
+    }
+
+    const quint64 head = atomicWord(&m_pHeader->head)->load(std::memory_order_acquire);
+    const quint64 oldest = head > m_capacity ? head - m_capacity : 0;
+
+    // Walk back from the newest sample; a slot that fails its sequence check
+    // has been overwritten, and so has everything before it
+    for (quint64 n = head; n > oldest; n--) {
+        TelemetrySample sample;
+        if (!readSlot(n - 1, sample) || sample.timestampMs < fromMs) {
+            break;
+        }
+        if (sample.timestampMs > toMs) {
+            continue;
+        }
+
+        newestFirst.append(sample);
+        if (maxSamples > 0 && newestFirst.size() >= maxSamples) {
+            break;
+        }
+    }
+
+    return QList<TelemetrySample>(newestFirst.crbegin(), newestFirst.crend());
+}
+
+bool TelemetryRingReader::latest(TelemetrySample& sample) const
+{
+    if (!m_pHeader) return false;
+
+    const quint64 head = atomicWord(&m_pHeader->head)->load(std::memory_order_acquire);
+    return head > 0 && readSlot(head - 1, sample);
+}
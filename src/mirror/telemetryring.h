@@ -0,0 +1,133 @@
+#ifndef TELEMETRYRING_H
+#define TELEMETRYRING_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+#include "logger.h"
+#include "sharedmemoryregion.h"
+
+#define TELEMETRY_RING_NAME         "ECTelemetryRing"
+#define TELEMETRY_MAGIC             0x52544345  // "ECTR"
+#define TELEMETRY_LAYOUT_VERSION    1
+#define TELEMETRY_MAX_CHANNELS      16
+#define TELEMETRY_NAME_SIZE         16
+#define TELEMETRY_UNIT_SIZE         8
+#define TELEMETRY_DEFAULT_CAPACITY  3600        // One hour at 1 Hz
+
+/*
+ * Shared layout:
+ *
+ *   TelemetryRingHeader
+ *   TelemetryChannelDesc[TELEMETRY_MAX_CHANNELS]
+ *   TelemetrySlot[capacity]
+ *
+ * One writer appends samples; sample n lives in slot n % capacity. Each slot
+ * is its own seqlock: the writer stamps it 2n+1 before writing and 2n+2
+ * after, then advances head to n+1. A reader walking back from head accepts
+ * slot n only if it reads 2n+2 on both sides of the copy; anything else
+ * means the slot was overwritten, and everything older is gone as well.
+ */
+
+#pragma pack(push, 1)
+struct TelemetryRingHeader {
+    uint32_t magic;                 // TELEMETRY_MAGIC
+    uint16_t layoutVersion;
+    uint16_t channelCount;
+    uint32_t capacity;              // Slots
+    uint32_t slotSize;              // sizeof(TelemetrySlot)
+    uint32_t intervalMs;            // Nominal sampling cadence
+    uint32_t reserved0;
+    uint64_t head;                  // Samples written so far (atomic)
+    uint8_t  reserved1[32];
+};
+
+struct TelemetryChannelDesc {
+    char name[TELEMETRY_NAME_SIZE];
+    char unit[TELEMETRY_UNIT_SIZE];
+};
+
+struct TelemetrySlot {
+    uint64_t sequence;              // 2n+1 while sample n is written, 2n+2 once complete
+    int64_t  timestampMs;           // Milliseconds since epoch
+    uint32_t validMask;             // Channels that read successfully for this sample
+    uint32_t reserved;
+    float    values[TELEMETRY_MAX_CHANNELS];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(TelemetryRingHeader) == 64, "TelemetryRingHeader layout changed");
+static_assert(sizeof(TelemetrySlot) % 8 == 0, "Slot sequences must stay 8-byte aligned");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Telemetry ring needs lock-free 64-bit atomics");
+
+struct TelemetryChannel {
+    QString name;
+    QString unit;
+};
+
+struct TelemetrySample {
+    qint64 timestampMs = 0;
+    quint32 validMask = 0;
+    QVector<float> values;          // One per channel
+};
+
+// Service-side: appends samples
+class TelemetryRingWriter
+{
+public:
+    explicit TelemetryRingWriter(Logger* logger);
+    ~TelemetryRingWriter();
+
+    bool create(const QList<TelemetryChannel>& channels, quint32 capacity, quint32 intervalMs);
+    void close();
+    bool isValid() const { return m_pHeader != nullptr; }
+
+    // values holds one entry per channel; bit i of validMask marks values[i] good
+    void append(qint64 timestampMs, const QVector<float>& values, quint32 validMask);
+
+private:
+    Logger* m_pLogger;
+    SharedMemoryRegion m_region;
+    TelemetryRingHeader* m_pHeader;
+    TelemetrySlot* m_pSlots;
+    quint64 m_head;
+
+    Q_DISABLE_COPY(TelemetryRingWriter)
+};
+
+// Client-side: reads history without any EC traffic
+class TelemetryRingReader
+{
+public:
+    explicit TelemetryRingReader(Logger* logger = nullptr);
+    ~TelemetryRingReader();
+
+    bool open();
+    void close();
+    bool isValid() const { return m_pHeader != nullptr; }
+
+    QList<TelemetryChannel> channels() const { return m_channels; }
+    quint32 intervalMs() const;
+
+    // Samples with fromMs <= timestamp <= toMs, oldest first, at most maxSamples
+    // (the newest ones when there are more)
+    QList<TelemetrySample> readRange(qint64 fromMs, qint64 toMs, int maxSamples = -1) const;
+
+    bool latest(TelemetrySample& sample) const;
+
+private:
+    bool readSlot(quint64 n, TelemetrySample& sample) const;
+
+    Logger* m_pLogger;
+    SharedMemoryRegion m_region;
+    const TelemetryRingHeader* m_pHeader;
+    const TelemetrySlot* m_pSlots;
+    quint32 m_capacity;
+    QList<TelemetryChannel> m_channels;
+
+    Q_DISABLE_COPY(TelemetryRingReader)
+};
+
+#endif // TELEMETRYRING_H
@@ -0,0 +1,165 @@
+#include "telemetrysampler.h"
+#include "host_ec_cmds.h"
+#include <QDateTime>
+
+TelemetrySampler::TelemetrySampler(EcManager* ecManager, Logger* logger, QObject* parent)
+    : QObject(parent)
+    , m_ecManager(ecManager)
+    , m_logger(logger)
+    , m_thread(nullptr)
+    , m_context(nullptr)
+    , m_sampleTimer(nullptr)
+    , m_ring(logger)
+    , m_running(false)
+    , m_failedSamples(0)
+    , m_tjMax(-1)
+{
+}
+
+TelemetrySampler::~TelemetrySampler()
+{
+    stop();
+}
+
+QList<TelemetryChannel> TelemetrySampler::channels()
+{
+    return {
+        {"Cell1", "mV"},
+        {"Cell2", "mV"},
+        {"Cell3", "mV"},
+        {"CellDiff", "mV"},
+        {"SOH", "%"},
+        {"TimeRun", "s"},
+        {"PkgTemp", "C"},
+    };
+}
+
+bool TelemetrySampler::start(int intervalMs, quint32 capacity)
+{
+    if (m_running) {
+        return true;
+    }
+
+    if (!m_ecManager || !m_ecManager->isInitialized()) {
+        LOG_ERROR(m_logger, CatMirror, "TelemetrySampler: cannot start - EcManager not initialized");
+        return false;
+    }
+
+    intervalMs = qMax(intervalMs, 100);
+    if (!m_ring.create(channels(), capacity, static_cast<quint32>(intervalMs))) {
+        LOG_ERROR(m_logger, CatMirror, "TelemetrySampler: failed to create telemetry ring");
+        return false;
+    }
+
+    m_running = true;
+    m_failedSamples = 0;
+
+    m_thread = new QThread;
+    m_thread->setObjectName("Telemetry");
+    m_context = new QObject;
+    m_context->moveToThread(m_thread);
+    connect(m_thread, &QThread::started, m_context, [this, intervalMs]() { startTimer(intervalMs); });
+    m_thread->start();
+
+    LOG_INFO(m_logger, CatMirror, QString("TelemetrySampler: sampling every %1 ms, %2 samples of history")
+                                      .arg(intervalMs).arg(capacity));
+    return true;
+}
+
+void TelemetrySampler::stop()
+{
+    if (!m_running) {
+        return;
+    }
+
+    // The timer must be stopped on its own thread; this waits out a sample in progress
+    QMetaObject::invokeMethod(m_context, [this]() { stopTimer(); }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_context;
+    m_context = nullptr;
+    delete m_thread;
+    m_thread = nullptr;
+
+    m_ring.close();
+    m_running = false;
+
+    LOG_INFO(m_logger, CatMirror, "TelemetrySampler: stopped");
+}
+
+void TelemetrySampler::startTimer(int intervalMs)
+{
+    m_sampleTimer = new QTimer(m_context);
+    m_sampleTimer->setInterval(intervalMs);
+    connect(m_sampleTimer, &QTimer::timeout, m_context, [this]() { sample(); });
+
+    // Record the first sample before waiting for the first interval
+    sample();
+    m_sampleTimer->start();
+}
+
+void TelemetrySampler::stopTimer()
+{
+    delete m_sampleTimer;
+    m_sampleTimer = nullptr;
+}
+
+void TelemetrySampler::sample()
+{
+    QVector<float> values(ChannelCount, 0.0f);
+    quint32 validMask = 0;
+
+    bat_health health;
+    if (m_ecManager->getBatteryHealth(health, TELEMETRY_EC_TIMEOUT_MS) == EC_HOST_CMD_SUCCESS) {
+        values[Cell1Voltage] = health.cell1_V;
+        values[Cell2Voltage] = health.cell2_V;
+        values[Cell3Voltage] = health.cell3_V;
+        values[CellDiff] = health.cellDiff;
+        values[StateOfHealth] = health.SOH;
+        values[RunTime] = static_cast<float>(health.TimeRun);
+        validMask |= (1u << Cell1Voltage) | (1u << Cell2Voltage) | (1u << Cell3Voltage)
+                     | (1u << CellDiff) | (1u << StateOfHealth) | (1u << RunTime);
+    }
+
+    float packageTemp = 0.0f;
+    if (readPackageTemp(packageTemp)) {
+        values[PackageTemp] = packageTemp;
+        validMask |= 1u << PackageTemp;
+    }
+
+    if (validMask == 0) {
+        // Log the first failure and then occasionally, not every tick
+        if ((m_failedSamples++ % 60) == 0) {
+            LOG_WARNING(m_logger, CatMirror, QString("TelemetrySampler: no telemetry source answered (%1 failed samples)")
+                                                 .arg(m_failedSamples));
+        }
+    }
+
+    m_ring.append(QDateTime::currentMSecsSinceEpoch(), values, validMask);
+}
+
+bool TelemetrySampler::readPackageTemp(float& celsius)
+{
+    // TjMax is fixed per part; keep asking until the CPU answers once
+    if (m_tjMax < 0) {
+        quint32 target = 0;
+        if (m_ecManager->peciReadPackage(TELEMETRY_PECI_HOST_ID, TELEMETRY_PECI_TJMAX_INDEX,
+                                         TELEMETRY_PECI_TJMAX_PARAM, 0, target,
+                                         TELEMETRY_EC_TIMEOUT_MS) != EC_HOST_CMD_SUCCESS) {
+            return false;
+        }
+        m_tjMax = static_cast<int>((target >> 16) & 0xFF);
+        LOG_INFO(m_logger, CatMirror, QString("TelemetrySampler: CPU TjMax %1 C").arg(m_tjMax));
+    }
+
+    quint32 temp = 0;
+    if (m_ecManager->peciReadPackage(TELEMETRY_PECI_HOST_ID, TELEMETRY_PECI_TEMP_INDEX,
+                                     TELEMETRY_PECI_TEMP_PARAM, 0, temp,
+                                     TELEMETRY_EC_TIMEOUT_MS) != EC_HOST_CMD_SUCCESS) {
+        return false;
+    }
+
+    const qint16 offset = static_cast<qint16>(temp & 0xFFFF);
+    celsius = static_cast<float>(m_tjMax) + static_cast<float>(offset) / 64.0f;
+    return true;
+}
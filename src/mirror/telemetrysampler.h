@@ -0,0 +1,82 @@
+#ifndef TELEMETRYSAMPLER_H
+#define TELEMETRYSAMPLER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include "ecmanager.h"
+#include "logger.h"
+#include "telemetryring.h"
+
+#define TELEMETRY_DEFAULT_INTERVAL_MS   1000
+#define TELEMETRY_EC_TIMEOUT_MS         300     // Per EC read, so a stuck source cannot swallow the next tick
+
+// PECI RdPkgConfig on the default CPU address. Index 2 returns the package
+// temperature as a signed 1/64 C offset from TjMax (bits 15:0, negative below
+// TjMax); index 16 returns the temperature target with TjMax in bits 23:16.
+#define TELEMETRY_PECI_HOST_ID          0x30
+#define TELEMETRY_PECI_TEMP_INDEX       2
+#define TELEMETRY_PECI_TEMP_PARAM       0xFF
+#define TELEMETRY_PECI_TJMAX_INDEX      16
+#define TELEMETRY_PECI_TJMAX_PARAM      0
+
+/**
+ * @brief TelemetrySampler - Records battery and thermal history in shared memory
+ *
+ * Samples battery health (cell voltages, cell imbalance, SOH, run time) and
+ * the PECI package temperature on a fixed cadence and appends them to the
+ * shared TelemetryRing. Dashboards read minutes of history straight from the
+ * ring instead of issuing EcBatteryHealth/EcPeciRead requests per sample.
+ *
+ * Each tick costs two EC transactions however many clients are watching.
+ * A source that fails leaves its channels out of that sample's validMask.
+ *
+ * Sampling runs on the sampler's own thread, so the synchronous EC reads
+ * never block the service thread and its pipes. start() and stop() are
+ * called from the owning thread.
+ */
+class TelemetrySampler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Channel order in the ring
+    enum Channel {
+        Cell1Voltage,
+        Cell2Voltage,
+        Cell3Voltage,
+        CellDiff,
+        StateOfHealth,
+        RunTime,
+        PackageTemp,
+        ChannelCount
+    };
+
+    explicit TelemetrySampler(EcManager* ecManager, Logger* logger, QObject* parent = nullptr);
+    ~TelemetrySampler();
+
+    bool start(int intervalMs = TELEMETRY_DEFAULT_INTERVAL_MS,
+               quint32 capacity = TELEMETRY_DEFAULT_CAPACITY);
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    static QList<TelemetryChannel> channels();
+
+private:
+    void startTimer(int intervalMs);    // On m_thread
+    void stopTimer();                   // On m_thread
+    void sample();                      // On m_thread
+    bool readPackageTemp(float& celsius);
+
+    EcManager* m_ecManager;
+    Logger* m_logger;
+    QThread* m_thread;
+    QObject* m_context;                 // Owns the timer on m_thread
+    QTimer* m_sampleTimer;              // Lives on m_thread
+    TelemetryRingWriter m_ring;
+    bool m_running;
+    quint64 m_failedSamples;
+    int m_tjMax;                    // Degrees C, read once; -1 until known
+};
+
+#endif // TELEMETRYSAMPLER_H
@@ -1,124 +1,156 @@
 #include "namedpipeserver.h"
 #include <QDebug>
+#include <QThread>
+#include <QElapsedTimer>
 
 NamedPipeServer::NamedPipeServer(Logger* pLogger, QObject* parent)
     : QObject(parent)
     , m_pLogger(pLogger)
+    , m_dispatchStartMs(-1)
+    , m_dispatchPipe(0)
+    , m_dispatchSerial(0)
+    , m_watchdog(nullptr)
+    , m_watchdogStop(false)
 {
-    // Initialize pipe info structures
-    m_controlScreensPipe.type = PipeType::ControlScreens;
-    m_controlScreensPipe.name = PIPE_CONTROL_SCREENS;
-    m_controlScreensPipe.maxClients = MAX_CLIENTS_CONTROL_SCREENS;
+    m_clock.start();
 
-    m_csMonitorPipe.type = PipeType::CSMonitor;
-    m_csMonitorPipe.name = PIPE_CSMONITOR;
-    m_csMonitorPipe.maxClients = MAX_CLIENTS_CSMONITOR;
+    m_watchdog = QThread::create([this]() { watchdogLoop(); });
+    m_watchdog->setObjectName("PipeWatchdog");
+    m_watchdog->start();
 }
 
 NamedPipeServer::~NamedPipeServer()
 {
+    {
+        QMutexLocker locker(&m_watchdogMutex);
+        m_watchdogStop = true;
+        m_watchdogWake.wakeAll();
+    }
+    m_watchdog->wait();
+    delete m_watchdog;
+    m_watchdog = nullptr;
+
     stopAll();
+    qDeleteAll(m_endpoints);
+    m_endpoints.clear();
 }
 
-bool NamedPipeServer::initialize()
+bool NamedPipeServer::registerPipe(PipeType type, const PipeConfig& config)
 {
-    m_pLogger->log("NamedPipeServer: Initializing pipes...", Logger::Info);
+    if (type == PipeType::Unknown || config.name.isEmpty()) {
+        LOG_ERROR(m_pLogger, CatPipeServer, "Cannot register pipe without id and name");
+        return false;
+    }
 
-    // Create Control Screens pipe server
-    m_controlScreensPipe.server = new QLocalServer(this);
-    m_controlScreensPipe.server->setMaxPendingConnections(m_controlScreensPipe.maxClients);
-    connect(m_controlScreensPipe.server, &QLocalServer::newConnection,
-            this, &NamedPipeServer::onNewConnection);
-    m_serverToPipeType[m_controlScreensPipe.server] = PipeType::ControlScreens;
+    if (m_endpoints.contains(static_cast<int>(type))) {
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Pipe id %1 already registered")
+                                                .arg(static_cast<int>(type)));
+        return false;
+    }
 
-    // Create CSMonitor pipe server
-    m_csMonitorPipe.server = new QLocalServer(this);
-    m_csMonitorPipe.server->setMaxPendingConnections(m_csMonitorPipe.maxClients);
-    connect(m_csMonitorPipe.server, &QLocalServer::newConnection,
-            this, &NamedPipeServer::onNewConnection);
-    m_serverToPipeType[m_csMonitorPipe.server] = PipeType::CSMonitor;
+    PipeEndpoint* endpoint = new PipeEndpoint;
+    endpoint->type = type;
+    endpoint->config = config;
+    if (endpoint->config.label.isEmpty()) {
+        endpoint->config.label = config.name;
+    }
+    if (endpoint->config.maxClients <= 0) {
+        endpoint->config.maxClients = 1;
+    }
 
-    m_pLogger->log("NamedPipeServer: Pipes initialized", Logger::Info);
+    m_endpoints.insert(static_cast<int>(type), endpoint);
+    m_pipeOrder.append(type);
+
+    LOG_INFO(m_pLogger, CatPipeServer, QString("Registered %1 pipe '%2' (max clients %3, quota %4/s)")
+                                           .arg(endpoint->config.label).arg(config.name)
+                                           .arg(endpoint->config.maxClients).arg(config.requestQuota));
     return true;
 }
 
-bool NamedPipeServer::startAll()
+bool NamedPipeServer::initialize()
 {
-    bool success = true;
+    LOG_INFO(m_pLogger, CatPipeServer, "Initializing pipes...");
 
-    if (!startControlScreensPipe()) {
-        success = false;
+    if (m_pipeOrder.isEmpty()) {
+        LOG_ERROR(m_pLogger, CatPipeServer, "No pipes registered");
+        return false;
     }
 
-    if (!startCSMonitorPipe()) {
-        success = false;
-    }
+    for (PipeType type : m_pipeOrder) {
+        PipeEndpoint* endpoint = endpointFor(type);
+        if (endpoint->server) {
+            continue;
+        }
 
-    return success;
-}
+        endpoint->server = new QLocalServer(this);
+        endpoint->server->setMaxPendingConnections(endpoint->config.maxClients);
+        connect(endpoint->server, &QLocalServer::newConnection,
+                this, &NamedPipeServer::onNewConnection);
+        m_serverToEndpoint[endpoint->server] = endpoint;
+    }
 
-void NamedPipeServer::stopAll()
-{
-    m_pLogger->log("NamedPipeServer: Stopping all pipes...", Logger::Info);
-    stopControlScreensPipe();
-    stopCSMonitorPipe();
-    m_pLogger->log("NamedPipeServer: All pipes stopped", Logger::Info);
+    LOG_INFO(m_pLogger, CatPipeServer, QString("%1 pipes initialized").arg(m_pipeOrder.size()));
+    return true;
 }
 
-bool NamedPipeServer::startControlScreensPipe()
+bool NamedPipeServer::startAll()
 {
-    return startPipe(PipeType::ControlScreens);
-}
+    bool success = true;
 
-bool NamedPipeServer::startCSMonitorPipe()
-{
-    return startPipe(PipeType::CSMonitor);
-}
+    for (PipeType type : m_pipeOrder) {
+        if (!startPipe(type)) {
+            success = false;
+        }
+    }
 
-void NamedPipeServer::stopControlScreensPipe()
-{
-    stopPipe(PipeType::ControlScreens);
+    return success;
 }
 
-void NamedPipeServer::stopCSMonitorPipe()
+void NamedPipeServer::stopAll()
 {
-    stopPipe(PipeType::CSMonitor);
+    LOG_INFO(m_pLogger, CatPipeServer, "Stopping all pipes...");
+    for (PipeType type : m_pipeOrder) {
+        stopPipe(type);
+    }
+    LOG_INFO(m_pLogger, CatPipeServer, "All pipes stopped");
 }
 
 bool NamedPipeServer::startPipe(PipeType type)
 {
-    PipeInfo* info = getPipeInfo(type);
+    PipeEndpoint* info = endpointFor(type);
     if (!info || !info->server) {
-        m_pLogger->log(QString("NamedPipeServer: Cannot start %1 pipe - not initialized")
-                           .arg(pipeTypeToString(type)), Logger::Error);
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Cannot start %1 pipe - not initialized")
+                                                .arg(pipeTypeToString(type)));
         return false;
     }
 
     if (info->running) {
-        m_pLogger->log(QString("NamedPipeServer: %1 pipe already running")
-                           .arg(pipeTypeToString(type)), Logger::Warning);
+        LOG_WARNING(m_pLogger, CatPipeServer, QString("%1 pipe already running")
+                                                  .arg(pipeTypeToString(type)));
         return true;
     }
 
+    const QString& name = info->config.name;
+
     // Remove any existing server with this name
-    QLocalServer::removeServer(info->name);
+    QLocalServer::removeServer(name);
 
     // Set world access for usermode clients
     info->server->setSocketOptions(QLocalServer::WorldAccessOption);
 
-    if (!info->server->listen(info->name)) {
-        QString error = QString("NamedPipeServer: Failed to start %1 pipe '%2': %3")
+    if (!info->server->listen(name)) {
+        QString error = QString("Failed to start %1 pipe '%2': %3")
         .arg(pipeTypeToString(type))
-            .arg(info->name)
+            .arg(name)
             .arg(info->server->errorString());
-        m_pLogger->log(error, Logger::Error);
+        LOG_ERROR(m_pLogger, CatPipeServer, error);
         emit serverError(type, error);
         return false;
     }
 
     info->running = true;
-    m_pLogger->log(QString("NamedPipeServer: Started %1 pipe '%2'")
-                       .arg(pipeTypeToString(type)).arg(info->name), Logger::Info);
+    LOG_INFO(m_pLogger, CatPipeServer, QString("Started %1 pipe '%2'")
+                                           .arg(pipeTypeToString(type)).arg(name));
     emit pipeStarted(type);
 
     return true;
@@ -126,7 +158,7 @@ bool NamedPipeServer::startPipe(PipeType type)
 
 void NamedPipeServer::stopPipe(PipeType type)
 {
-    PipeInfo* info = getPipeInfo(type);
+    PipeEndpoint* info = endpointFor(type);
     if (!info) {
         return;
     }
@@ -135,8 +167,8 @@ void NamedPipeServer::stopPipe(PipeType type)
         return;
     }
 
-    m_pLogger->log(QString("NamedPipeServer: Stopping %1 pipe...")
-                       .arg(pipeTypeToString(type)), Logger::Info);
+    LOG_INFO(m_pLogger, CatPipeServer, QString("Stopping %1 pipe...")
+                                           .arg(pipeTypeToString(type)));
 
     info->running = false;
 
@@ -145,96 +177,93 @@ void NamedPipeServer::stopPipe(PipeType type)
     }
 
     // Disconnect and cleanup all clients for this pipe
-    for (auto it = info->clients.begin(); it != info->clients.end(); ++it) {
-        QLocalSocket* client = it.key();
-        if (client) {
-            m_clientToPipeType.remove(client);
-            client->disconnectFromServer();
-            client->deleteLater();
+    QList<QLocalSocket*> sockets;
+    for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+        if (it.value()->endpoint == info) {
+            sockets.append(it.key());
         }
     }
-    info->clients.clear();
 
-    m_pLogger->log(QString("NamedPipeServer: %1 pipe stopped")
-                       .arg(pipeTypeToString(type)), Logger::Info);
+    for (QLocalSocket* client : sockets) {
+        removeClient(client);
+        client->disconnect(this);
+        client->disconnectFromServer();
+        client->deleteLater();
+    }
+
+    LOG_INFO(m_pLogger, CatPipeServer, QString("%1 pipe stopped")
+                                           .arg(pipeTypeToString(type)));
     emit pipeStopped(type);
 }
 
-bool NamedPipeServer::isControlScreensRunning() const
+bool NamedPipeServer::isPipeRunning(PipeType type) const
 {
-    return m_controlScreensPipe.running &&
-           m_controlScreensPipe.server &&
-           m_controlScreensPipe.server->isListening();
+    const PipeEndpoint* info = endpointFor(type);
+    return info && info->running && info->server && info->server->isListening();
 }
 
-bool NamedPipeServer::isCSMonitorRunning() const
+bool NamedPipeServer::isAnyRunning() const
 {
-    return m_csMonitorPipe.running &&
-           m_csMonitorPipe.server &&
-           m_csMonitorPipe.server->isListening();
+    for (PipeType type : m_pipeOrder) {
+        if (isPipeRunning(type)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-bool NamedPipeServer::isAnyRunning() const
+int NamedPipeServer::clientCount(PipeType type) const
 {
-    return isControlScreensRunning() || isCSMonitorRunning();
+    const PipeEndpoint* info = endpointFor(type);
+    return info ? info->clientCount : 0;
 }
 
-int NamedPipeServer::controlScreensClientCount() const
+PipeStats NamedPipeServer::pipeStats(PipeType type, bool reset)
 {
-    return m_controlScreensPipe.clients.size();
+    PipeEndpoint* info = endpointFor(type);
+    if (!info) {
+        return PipeStats();
+    }
+
+    PipeStats stats = info->stats;
+    stats.clients = info->clientCount;
+    if (reset) {
+        info->stats = PipeStats();
+    }
+    return stats;
 }
 
-int NamedPipeServer::csMonitorClientCount() const
+QString NamedPipeServer::pipeLabel(PipeType type) const
 {
-    return m_csMonitorPipe.clients.size();
+    return pipeTypeToString(type);
 }
 
 PipeType NamedPipeServer::getClientPipeType(QLocalSocket* client) const
 {
-    return m_clientToPipeType.value(client, PipeType::Unknown);
+    const PipeClient* pc = clientFor(client);
+    return pc ? pc->endpoint->type : PipeType::Unknown;
 }
 
 QString NamedPipeServer::getClientPipeName(QLocalSocket* client) const
 {
-    PipeType type = getClientPipeType(client);
-    const PipeInfo* info = getPipeInfo(type);
-    return info ? info->name : QString();
+    const PipeClient* pc = clientFor(client);
+    return pc ? pc->endpoint->config.name : QString();
 }
 
-NamedPipeServer::PipeInfo* NamedPipeServer::getPipeInfo(PipeType type)
+NamedPipeServer::PipeEndpoint* NamedPipeServer::endpointFor(PipeType type) const
 {
-    switch (type) {
-    case PipeType::ControlScreens:
-        return &m_controlScreensPipe;
-    case PipeType::CSMonitor:
-        return &m_csMonitorPipe;
-    default:
-        return nullptr;
-    }
+    return m_endpoints.value(static_cast<int>(type), nullptr);
 }
 
-const NamedPipeServer::PipeInfo* NamedPipeServer::getPipeInfo(PipeType type) const
+NamedPipeServer::PipeClient* NamedPipeServer::clientFor(QLocalSocket* client) const
 {
-    switch (type) {
-    case PipeType::ControlScreens:
-        return &m_controlScreensPipe;
-    case PipeType::CSMonitor:
-        return &m_csMonitorPipe;
-    default:
-        return nullptr;
-    }
+    return m_clients.value(client, nullptr);
 }
 
 QString NamedPipeServer::pipeTypeToString(PipeType type) const
 {
-    switch (type) {
-    case PipeType::ControlScreens:
-        return "ControlScreens";
-    case PipeType::CSMonitor:
-        return "CSMonitor";
-    default:
-        return "Unknown";
-    }
+    const PipeEndpoint* info = endpointFor(type);
+    return info ? info->config.label : QString("Unknown");
 }
 
 void NamedPipeServer::onNewConnection()
@@ -245,11 +274,10 @@ void NamedPipeServer::onNewConnection()
     }
 
     // Determine which pipe this connection is for
-    PipeType pipeType = m_serverToPipeType.value(server, PipeType::Unknown);
-    PipeInfo* info = getPipeInfo(pipeType);
+    PipeEndpoint* info = m_serverToEndpoint.value(server, nullptr);
 
     if (!info) {
-        m_pLogger->log("NamedPipeServer: Connection from unknown server", Logger::Error);
+        LOG_ERROR(m_pLogger, CatPipeServer, "Connection from unknown server");
         return;
     }
 
@@ -261,17 +289,23 @@ void NamedPipeServer::onNewConnection()
         }
 
         // Check client limit
-        if (info->clients.size() >= info->maxClients) {
-            m_pLogger->log(QString("NamedPipeServer: Max clients reached for %1 pipe, rejecting")
-                               .arg(pipeTypeToString(pipeType)), Logger::Warning);
+        if (info->clientCount >= info->config.maxClients) {
+            LOG_WARNING(m_pLogger, CatPipeServer, QString("Max clients reached for %1 pipe, rejecting")
+                                                      .arg(info->config.label));
+            info->stats.rejectedConnections++;
             client->disconnectFromServer();
             client->deleteLater();
             continue;
         }
 
         // Track client
-        info->clients.insert(client, QPointer<QLocalSocket>(client));
-        m_clientToPipeType[client] = pipeType;
+        PipeClient* pc = new PipeClient;
+        pc->socket = client;
+        pc->endpoint = info;
+        pc->tokens = info->config.requestBurst > 0 ? info->config.requestBurst : info->config.requestQuota;
+        pc->lastRefillMs = m_clock.elapsed();
+        m_clients.insert(client, pc);
+        info->clientCount++;
 
         // Connect client signals
         connect(client, &QLocalSocket::readyRead,
@@ -280,11 +314,114 @@ void NamedPipeServer::onNewConnection()
                 this, &NamedPipeServer::onClientDisconnected);
         connect(client, &QLocalSocket::errorOccurred,
                 this, &NamedPipeServer::onClientError);
+        connect(client, &QLocalSocket::bytesWritten,
+                this, &NamedPipeServer::onClientBytesWritten);
+
+        LOG_INFO(m_pLogger, CatPipeServer, QString("Client connected to %1 pipe (total: %2)")
+                                               .arg(info->config.label).arg(info->clientCount));
+
+        emit clientConnected(info->type, client);
+    }
+}
+
+bool NamedPipeServer::consumeQuota(PipeClient* pc)
+{
+    const PipeConfig& config = pc->endpoint->config;
+    if (config.requestQuota <= 0) {
+        return true;
+    }
+
+    // Refill at requestQuota tokens per second, capped at the burst size
+    const double burst = config.requestBurst > 0 ? config.requestBurst : config.requestQuota;
+    const qint64 now = m_clock.elapsed();
+    pc->tokens = qMin(burst, pc->tokens + (now - pc->lastRefillMs) * config.requestQuota / 1000.0);
+    pc->lastRefillMs = now;
+
+    if (pc->tokens < 1.0) {
+        return false;
+    }
+
+    pc->tokens -= 1.0;
+    return true;
+}
+
+void NamedPipeServer::dispatch(PipeEndpoint* endpoint, const QByteArray& data, QLocalSocket* client)
+{
+    emit commandReceived(endpoint->type, data, client);
+
+    const PipeHandler& handler = endpoint->config.handler;
+    if (!handler) {
+        return;
+    }
+
+    // The watchdog reports handlers still running after FLIGHT_STALL_MS;
+    // the total is logged once the handler returns
+    const int pipe = static_cast<int>(endpoint->type);
+    auto timedHandler = [this, handler, pipe](const QByteArray& data, QLocalSocket* client) {
+        const qint64 startMs = m_clock.elapsed();
+        m_dispatchPipe.store(pipe, std::memory_order_relaxed);
+        m_dispatchSerial.fetch_add(1, std::memory_order_relaxed);
+        m_dispatchStartMs.store(startMs, std::memory_order_release);
+
+        handler(data, client);
+
+        m_dispatchStartMs.store(-1, std::memory_order_release);
+        const qint64 elapsedMs = m_clock.elapsed() - startMs;
+        if (elapsedMs >= FLIGHT_STALL_MS) {
+            LOG_WARNING(m_pLogger, CatPipeServer, QString("Handler on pipe %1 stalled for %2ms").arg(pipe).arg(elapsedMs));
+        }
+    };
+
+    switch (endpoint->config.dispatch) {
+    case PipeDispatchPolicy::Inline:
+        timedHandler(data, client);
+        break;
+
+    case PipeDispatchPolicy::Queued: {
+        // The client may have gone away while the request waited, and a new
+        // socket can be allocated at the same address, so track the object itself
+        QPointer<QLocalSocket> guard(client);
+        QMetaObject::invokeMethod(this, [this, timedHandler, data, guard]() {
+            if (guard && m_clients.contains(guard.data())) {
+                timedHandler(data, guard.data());
+            }
+        }, Qt::QueuedConnection);
+        break;
+    }
+    }
+}
+
+void NamedPipeServer::watchdogLoop()
+{
+    QMutexLocker locker(&m_watchdogMutex);
+    quint64 reported = 0;
+
+    while (!m_watchdogStop) {
+        m_watchdogWake.wait(&m_watchdogMutex, FLIGHT_STALL_MS / 4);
+        if (m_watchdogStop) {
+            break;
+        }
+
+        // Skip the sample if a new handler started while it was taken
+        const quint64 serial = m_dispatchSerial.load(std::memory_order_acquire);
+        const qint64 startMs = m_dispatchStartMs.load(std::memory_order_acquire);
+        const int pipe = m_dispatchPipe.load(std::memory_order_relaxed);
+        if (startMs < 0 || serial == reported || serial != m_dispatchSerial.load(std::memory_order_acquire)) {
+            continue;
+        }
 
-        m_pLogger->log(QString("NamedPipeServer: Client connected to %1 pipe (total: %2)")
-                           .arg(pipeTypeToString(pipeType)).arg(info->clients.size()), Logger::Info);
+        const qint64 elapsedMs = m_clock.elapsed() - startMs;
+        if (elapsedMs < FLIGHT_STALL_MS) {
+            continue;
+        }
 
-        emit clientConnected(pipeType, client);
+        // Once per handler call; the dump shows what led up to the stall
+        reported = serial;
+        FLIGHT_EVENT(m_pLogger, HandlerStall, pipe, static_cast<quint32>(elapsedMs));
+        LOG_WARNING(m_pLogger, CatPipeServer, QString("Handler on pipe %1 still running after %2ms").arg(pipe).arg(elapsedMs));
+        if (m_pLogger) {
+            m_pLogger->flightRecorder().trigger(QStringLiteral("pipe handler stall"));
+        }
     }
 }
 
@@ -295,37 +432,52 @@ void NamedPipeServer::onClientReadyRead()
         return;
     }
 
-    PipeType pipeType = m_clientToPipeType.value(client, PipeType::Unknown);
-    if (pipeType == PipeType::Unknown) {
-        m_pLogger->log("NamedPipeServer: Data from untracked client", Logger::Warning);
+    PipeClient* pc = clientFor(client);
+    if (!pc) {
+        LOG_WARNING(m_pLogger, CatPipeServer, "Data from untracked client");
         return;
     }
 
+    PipeEndpoint* endpoint = pc->endpoint;
+
     while (client->bytesAvailable() > 0) {
         QByteArray data = client->readAll();
 
         if (!data.isEmpty()) {
-            m_pLogger->log(QString("NamedPipeServer: Received %1 bytes on %2 pipe")
-                               .arg(data.size()).arg(pipeTypeToString(pipeType)), Logger::Debug);
-
-            // Emit general signal
-            emit commandReceived(pipeType, data, client);
-
-            // Emit pipe-specific signal for convenience
-            switch (pipeType) {
-            case PipeType::ControlScreens:
-                emit controlScreensCommandReceived(data, client);
-                break;
-            case PipeType::CSMonitor:
-                emit csMonitorCommandReceived(data, client);
-                break;
-            default:
-                break;
+            LOG_DEBUG(m_pLogger, CatPipeServer, QString("Received %1 bytes on %2 pipe")
+                                                    .arg(data.size()).arg(endpoint->config.label));
+            FLIGHT_EVENT(m_pLogger, PipeFrameReceived, static_cast<int>(endpoint->type), data.size());
+
+            if (!consumeQuota(pc)) {
+                endpoint->stats.throttled++;
+                FLIGHT_EVENT(m_pLogger, PipeThrottled, static_cast<int>(endpoint->type), data.size());
+                LOG_DEBUG(m_pLogger, CatPipeServer, QString("Request quota exceeded on %1 pipe, dropping %2 bytes")
+                                                        .arg(endpoint->config.label).arg(data.size()));
+                continue;
+            }
+
+            endpoint->stats.requests++;
+            dispatch(endpoint, data, client);
+
+            // An inline handler may have disconnected the client
+            if (!m_clients.contains(client)) {
+                return;
             }
         }
     }
 }
 
+void NamedPipeServer::removeClient(QLocalSocket* client)
+{
+    PipeClient* pc = m_clients.take(client);
+    if (!pc) {
+        return;
+    }
+
+    pc->endpoint->clientCount--;
+    delete pc;
+}
+
 void NamedPipeServer::onClientDisconnected()
 {
     QLocalSocket* client = qobject_cast<QLocalSocket*>(sender());
@@ -333,17 +485,16 @@ void NamedPipeServer::onClientDisconnected()
         return;
     }
 
-    PipeType pipeType = m_clientToPipeType.value(client, PipeType::Unknown);
-    PipeInfo* info = getPipeInfo(pipeType);
+    PipeClient* pc = clientFor(client);
 
-    if (info) {
-        info->clients.remove(client);
-        m_pLogger->log(QString("NamedPipeServer: Client disconnected from %1 pipe (remaining: %2)")
-                           .arg(pipeTypeToString(pipeType)).arg(info->clients.size()), Logger::Info);
-        emit clientDisconnected(pipeType, client);
+    if (pc) {
+        PipeEndpoint* info = pc->endpoint;
+        removeClient(client);
+        LOG_INFO(m_pLogger, CatPipeServer, QString("Client disconnected from %1 pipe (remaining: %2)")
+                                               .arg(info->config.label).arg(info->clientCount));
+        emit clientDisconnected(info->type, client);
     }
 
-    m_clientToPipeType.remove(client);
     client->deleteLater();
 }
 
@@ -356,47 +507,192 @@ void NamedPipeServer::onClientError(QLocalSocket::LocalSocketError socketError)
         return;
     }
 
-    PipeType pipeType = m_clientToPipeType.value(client, PipeType::Unknown);
-    m_pLogger->log(QString("NamedPipeServer: Client error on %1 pipe: %2")
-                       .arg(pipeTypeToString(pipeType)).arg(client->errorString()), Logger::Warning);
+    LOG_WARNING(m_pLogger, CatPipeServer, QString("Client error on %1 pipe: %2")
+                                              .arg(pipeTypeToString(getClientPipeType(client))).arg(client->errorString()));
 }
 
-void NamedPipeServer::sendResponse(QLocalSocket* client, const QByteArray& response)
+NamedPipeServer::PipeClient* NamedPipeServer::validateClient(QLocalSocket* client, const char* what) const
 {
     if (!client) {
-        m_pLogger->log("NamedPipeServer: Cannot send response - null client", Logger::Error);
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Cannot send %1 - null client").arg(what));
+        return nullptr;
+    }
+
+    PipeClient* pc = clientFor(client);
+
+    if (!pc) {
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Cannot send %1 - client not tracked").arg(what));
+        return nullptr;
+    }
+
+    if (pc->socket.isNull()) {
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Cannot send %1 - client no longer valid").arg(what));
+        return nullptr;
+    }
+
+    if (client->state() != QLocalSocket::ConnectedState) {
+        LOG_ERROR(m_pLogger, CatPipeServer, QString("Cannot send %1 - client not connected").arg(what));
+        return nullptr;
+    }
+
+    return pc;
+}
+
+void NamedPipeServer::sendResponse(QLocalSocket* client, const QByteArray& response)
+{
+    // Worker pool handlers reply from their own thread; sockets live on ours
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, client, response]() {
+            sendResponse(client, response);
+        }, Qt::QueuedConnection);
         return;
     }
 
-    PipeType pipeType = m_clientToPipeType.value(client, PipeType::Unknown);
-    PipeInfo* info = getPipeInfo(pipeType);
+    PipeClient* pc = validateClient(client, "response");
+    if (!pc) {
+        return;
+    }
 
-    if (!info) {
-        m_pLogger->log("NamedPipeServer: Cannot send response - client not tracked", Logger::Error);
+    enqueueFrame(pc, response, false);
+}
+
+void NamedPipeServer::sendPush(QLocalSocket* client, const QByteArray& frame)
+{
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, client, frame]() {
+            sendPush(client, frame);
+        }, Qt::QueuedConnection);
         return;
     }
 
-    if (!info->clients.contains(client) || info->clients[client].isNull()) {
-        m_pLogger->log("NamedPipeServer: Cannot send response - client no longer valid", Logger::Error);
+    PipeClient* pc = validateClient(client, "push");
+    if (!pc) {
         return;
     }
 
-    if (client->state() != QLocalSocket::ConnectedState) {
-        m_pLogger->log("NamedPipeServer: Cannot send response - client not connected", Logger::Error);
+    enqueueFrame(pc, frame, true);
+}
+
+void NamedPipeServer::enqueueFrame(PipeClient* pc, const QByteArray& data, bool droppable)
+{
+    const qint64 cap = m_outboundLimits.maxQueuedBytes;
+
+    if (pc->queuedBytes + data.size() > cap) {
+        if (m_outboundLimits.policy == SlowConsumerPolicy::Disconnect) {
+            disconnectSlowClient(pc, QString("outbound queue over %1 bytes").arg(cap));
+            return;
+        }
+
+        // Make room by discarding the oldest queued push frames
+        for (auto it = pc->frames.begin(); it != pc->frames.end() && pc->queuedBytes + data.size() > cap; ) {
+            if (it->droppable) {
+                pc->queuedBytes -= it->data.size();
+                it = pc->frames.erase(it);
+                m_outboundStats.pushesDropped++;
+            } else {
+                ++it;
+            }
+        }
+
+        if (pc->queuedBytes + data.size() > cap) {
+            if (droppable) {
+                m_outboundStats.pushesDropped++;
+                LOG_WARNING(m_pLogger, CatPipeServer, QString("Dropped %1-byte push for slow client on %2 pipe")
+                                                          .arg(data.size()).arg(pc->endpoint->config.label));
+                return;
+            }
+
+            // Only responses left and still over the cap - the client has stopped reading
+            disconnectSlowClient(pc, QString("%1 bytes of unread responses").arg(pc->queuedBytes));
+            return;
+        }
+    }
+
+    OutboundFrame frame;
+    frame.data = data;
+    frame.droppable = droppable;
+    pc->frames.enqueue(frame);
+    pc->queuedBytes += data.size();
+    m_outboundStats.peakQueuedBytes = qMax(m_outboundStats.peakQueuedBytes, pc->queuedBytes);
+
+    pumpClient(pc);
+}
+
+void NamedPipeServer::pumpClient(PipeClient* pc)
+{
+    QLocalSocket* client = pc->socket.data();
+    if (!client) {
         return;
     }
 
-    qint64 bytesWritten = client->write(response);
+    const QString& label = pc->endpoint->config.label;
+
+    // Hand frames to the socket only while its own buffer is below the high-water
+    // mark; the rest waits here until bytesWritten reports progress
+    while (!pc->frames.isEmpty() && client->bytesToWrite() < m_outboundLimits.socketHighWater) {
+        OutboundFrame frame = pc->frames.dequeue();
+        pc->queuedBytes -= frame.data.size();
+
+        qint64 bytesWritten = client->write(frame.data);
+
+        if (bytesWritten == -1) {
+            LOG_ERROR(m_pLogger, CatPipeServer, QString("Failed to send on %1 pipe: %2")
+                                                    .arg(label).arg(client->errorString()));
+            return;
+        } else if (bytesWritten != frame.data.size()) {
+            LOG_WARNING(m_pLogger, CatPipeServer, QString("Partial write on %1 pipe: %2 of %3 bytes")
+                                                      .arg(label).arg(bytesWritten).arg(frame.data.size()));
+        } else {
+            LOG_DEBUG(m_pLogger, CatPipeServer, QString("Sent %1 bytes on %2 pipe")
+                                                    .arg(bytesWritten).arg(label));
+        }
+
+        FLIGHT_EVENT(m_pLogger, PipeFrameSent, static_cast<int>(pc->endpoint->type),
+                     static_cast<quint32>(bytesWritten));
+        m_outboundStats.framesSent++;
+        m_outboundStats.bytesSent += bytesWritten;
+    }
+}
+
+void NamedPipeServer::onClientBytesWritten(qint64 bytes)
+{
+    Q_UNUSED(bytes);
+
+    PipeClient* pc = clientFor(qobject_cast<QLocalSocket*>(sender()));
+    if (pc) {
+        pumpClient(pc);
+    }
+}
+
+void NamedPipeServer::disconnectSlowClient(PipeClient* pc, const QString& reason)
+{
+    m_outboundStats.slowDisconnects++;
+    LOG_WARNING(m_pLogger, CatPipeServer, QString("Disconnecting slow client on %1 pipe (%2)")
+                                              .arg(pc->endpoint->config.label).arg(reason));
+
+    pc->frames.clear();
+    pc->queuedBytes = 0;
+
+    // abort() discards the socket's own buffer; disconnected() does the rest of the
+    // cleanup and deletes pc, so it must not be touched after this
+    if (QLocalSocket* client = pc->socket.data()) {
+        client->abort();
+    }
+}
+
+OutboundStats NamedPipeServer::outboundStats(bool reset)
+{
+    OutboundStats stats = m_outboundStats;
+    stats.currentQueuedBytes = 0;
+    for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+        stats.currentQueuedBytes += it.value()->queuedBytes;
+    }
 
-    if (bytesWritten == -1) {
-        m_pLogger->log(QString("NamedPipeServer: Failed to send on %1 pipe: %2")
-                           .arg(pipeTypeToString(pipeType)).arg(client->errorString()), Logger::Error);
-    } else if (bytesWritten != response.size()) {
-        m_pLogger->log(QString("NamedPipeServer: Partial write on %1 pipe: %2 of %3 bytes")
-                           .arg(pipeTypeToString(pipeType)).arg(bytesWritten).arg(response.size()), Logger::Warning);
-    } else {
-        client->flush();
-        m_pLogger->log(QString("NamedPipeServer: Sent %1 bytes on %2 pipe")
-                           .arg(bytesWritten).arg(pipeTypeToString(pipeType)), Logger::Debug);
+    if (reset) {
+        m_outboundStats = OutboundStats();
+        for (auto it = m_clients.cbegin(); it != m_clients.cend(); ++it) {
+            m_outboundStats.peakQueuedBytes = qMax(m_outboundStats.peakQueuedBytes, it.value()->queuedBytes);
+        }
     }
+    return stats;
 }
@@ -4,22 +4,75 @@
 #include <QObject>
 #include <QLocalServer>
 #include <QLocalSocket>
-#include <QMap>
 #include <QHash>
 #include <QPointer>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
 #include "logger.h"
 
 // Predefined pipe names
 #define PIPE_CONTROL_SCREENS    "PPC_SERV"        // Control Screens pipe
 #define PIPE_CSMONITOR          "PPC_MON"       // CSMonitor pipe
 
-// Pipe identifiers for routing
+// Pipe identifiers for routing. Endpoints are registered at runtime, so any
+// other value may be used as the id of an additional pipe.
 enum class PipeType {
     Unknown,
     ControlScreens,
     CSMonitor
 };
 
+// Where a pipe's handler runs
+enum class PipeDispatchPolicy {
+    Inline,         // Directly from readyRead on the server thread
+    Queued          // Posted to the server thread's event loop, so one busy pipe cannot starve the others
+};
+
+// Called with the bytes read from a client. Reply with sendResponse(), which is safe from any thread.
+using PipeHandler = std::function<void(const QByteArray& data, QLocalSocket* client)>;
+
+struct PipeConfig {
+    QString name;                       // Pipe name passed to QLocalServer::listen
+    QString label;                      // Used in log messages
+    int maxClients = 5;
+    int requestQuota = 0;               // Requests per second per client, 0 = unlimited
+    int requestBurst = 0;               // Bucket size, 0 = same as requestQuota
+    PipeDispatchPolicy dispatch = PipeDispatchPolicy::Inline;
+    PipeHandler handler;                // Optional - commandReceived is emitted either way
+};
+
+struct PipeStats {
+    int clients = 0;
+    quint64 requests = 0;
+    quint64 throttled = 0;              // Requests dropped by the quota
+    quint64 rejectedConnections = 0;    // Connections refused at maxClients
+};
+
+// What to do when a client stops reading and its outbound queue hits the cap
+enum class SlowConsumerPolicy {
+    DropOldestPush,     // Discard queued push events first; disconnect only if responses alone overflow
+    Disconnect          // Disconnect the client as soon as the cap is exceeded
+};
+
+struct OutboundLimits {
+    qint64 maxQueuedBytes = 1024 * 1024;    // Per-client cap on bytes held by the service
+    qint64 socketHighWater = 64 * 1024;     // Stop handing frames to the socket above this
+    SlowConsumerPolicy policy = SlowConsumerPolicy::DropOldestPush;
+};
+
+struct OutboundStats {
+    quint64 framesSent = 0;
+    quint64 bytesSent = 0;
+    quint64 pushesDropped = 0;
+    quint64 slowDisconnects = 0;
+    qint64 peakQueuedBytes = 0;         // Highest per-client backlog seen
+    qint64 currentQueuedBytes = 0;      // Sum over all clients right now
+};
+
 class NamedPipeServer : public QObject
 {
     Q_OBJECT
@@ -28,7 +81,11 @@ public:
     explicit NamedPipeServer(Logger* pLogger, QObject* parent = nullptr);
     ~NamedPipeServer();
 
-    // Initialize both pipes
+    // Register an endpoint. Must be called before initialize(); the id must be unique.
+    bool registerPipe(PipeType type, const PipeConfig& config);
+    QList<PipeType> registeredPipes() const { return m_pipeOrder; }
+
+    // Create a server for every registered pipe
     bool initialize();
 
     // Start/stop all pipes
@@ -36,35 +93,39 @@ public:
     void stopAll();
 
     // Start/stop individual pipes
-    bool startControlScreensPipe();
-    bool startCSMonitorPipe();
-    void stopControlScreensPipe();
-    void stopCSMonitorPipe();
+    bool startPipe(PipeType type);
+    void stopPipe(PipeType type);
 
     // Check status
-    bool isControlScreensRunning() const;
-    bool isCSMonitorRunning() const;
+    bool isPipeRunning(PipeType type) const;
     bool isAnyRunning() const;
 
-    // Send response to a specific client
+    // Send response to a specific client. Frames are queued per client and
+    // handed to the socket as it drains (bytesWritten), never blocking the event thread.
+    // Calls from other threads are forwarded to the server thread.
     void sendResponse(QLocalSocket* client, const QByteArray& response);
 
+    // Send an unsolicited push frame. Push frames may be dropped for slow consumers.
+    void sendPush(QLocalSocket* client, const QByteArray& frame);
+
+    // Outbound backpressure configuration and metrics
+    void setOutboundLimits(const OutboundLimits& limits) { m_outboundLimits = limits; }
+    OutboundLimits outboundLimits() const { return m_outboundLimits; }
+    OutboundStats outboundStats(bool reset = false);
+
     // Get which pipe type a client is connected to
     PipeType getClientPipeType(QLocalSocket* client) const;
     QString getClientPipeName(QLocalSocket* client) const;
 
-    // Get client counts
-    int controlScreensClientCount() const;
-    int csMonitorClientCount() const;
+    // Per-pipe counters
+    int clientCount(PipeType type) const;
+    PipeStats pipeStats(PipeType type, bool reset = false);
+    QString pipeLabel(PipeType type) const;
 
 signals:
-    // Command received with pipe type for routing
+    // Command received with pipe type for routing (after the quota check)
     void commandReceived(PipeType pipeType, const QByteArray& data, QLocalSocket* client);
 
-    // Convenience signals for specific pipes
-    void controlScreensCommandReceived(const QByteArray& data, QLocalSocket* client);
-    void csMonitorCommandReceived(const QByteArray& data, QLocalSocket* client);
-
     // Client connection events
     void clientConnected(PipeType pipeType, QLocalSocket* client);
     void clientDisconnected(PipeType pipeType, QLocalSocket* client);
@@ -81,36 +142,77 @@ private slots:
     void onClientReadyRead();
     void onClientDisconnected();
     void onClientError(QLocalSocket::LocalSocketError socketError);
+    void onClientBytesWritten(qint64 bytes);
 
 private:
-    struct PipeInfo {
-        QLocalServer* server = nullptr;
-        QMap<QLocalSocket*, QPointer<QLocalSocket>> clients;
-        QString name;
+    struct PipeEndpoint {
         PipeType type = PipeType::Unknown;
-        int maxClients = 5;
+        PipeConfig config;
+        QLocalServer* server = nullptr;
+        int clientCount = 0;
         bool running = false;
+        PipeStats stats;
     };
 
-    bool addPipe(const QString& pipeName, PipeType type, int maxClients);
-    bool startPipe(PipeType type);
-    void stopPipe(PipeType type);
-    PipeInfo* getPipeInfo(PipeType type);
-    const PipeInfo* getPipeInfo(PipeType type) const;
+    struct OutboundFrame {
+        QByteArray data;
+        bool droppable = false;     // Push frames; responses are never dropped
+    };
+
+    // Everything the server knows about one connection, reached from the socket in one lookup
+    struct PipeClient {
+        QPointer<QLocalSocket> socket;
+        PipeEndpoint* endpoint = nullptr;
+
+        // Outbound queue
+        QQueue<OutboundFrame> frames;
+        qint64 queuedBytes = 0;
+
+        // Request quota (token bucket)
+        double tokens = 0.0;
+        qint64 lastRefillMs = 0;
+    };
+
+    PipeEndpoint* endpointFor(PipeType type) const;
+    PipeClient* clientFor(QLocalSocket* client) const;
     QString pipeTypeToString(PipeType type) const;
 
-    Logger* m_pLogger;
+    bool consumeQuota(PipeClient* pc);
+    void dispatch(PipeEndpoint* endpoint, const QByteArray& data, QLocalSocket* client);
+    void removeClient(QLocalSocket* client);
 
-    // Two pipes: one for ControlScreens, one for CSMonitor
-    PipeInfo m_controlScreensPipe;
-    PipeInfo m_csMonitorPipe;
+    PipeClient* validateClient(QLocalSocket* client, const char* what) const;
+    void enqueueFrame(PipeClient* pc, const QByteArray& data, bool droppable);
+    void pumpClient(PipeClient* pc);
+    void disconnectSlowClient(PipeClient* pc, const QString& reason);
+    void watchdogLoop();
 
-    // Client tracking
-    QHash<QLocalSocket*, PipeType> m_clientToPipeType;
-    QHash<QLocalServer*, PipeType> m_serverToPipeType;
+    Logger* m_pLogger;
 
-    static const int MAX_CLIENTS_CONTROL_SCREENS = 5;
-    static const int MAX_CLIENTS_CSMONITOR = 10;
+    // Registered endpoints, in registration order
+    QHash<int, PipeEndpoint*> m_endpoints;
+    QList<PipeType> m_pipeOrder;
+    QHash<QLocalServer*, PipeEndpoint*> m_serverToEndpoint;
+
+    // All connected clients across every pipe
+    QHash<QLocalSocket*, PipeClient*> m_clients;
+
+    // Outbound backpressure
+    OutboundLimits m_outboundLimits;
+    OutboundStats m_outboundStats;
+
+    QElapsedTimer m_clock;
+
+    // Stall watchdog. dispatch() stamps each handler call so a handler that
+    // never returns is still reported; handlers run one at a time on the
+    // server thread.
+    std::atomic<qint64> m_dispatchStartMs;  // m_clock time, -1 while no handler runs
+    std::atomic<int> m_dispatchPipe;
+    std::atomic<quint64> m_dispatchSerial;
+    QThread* m_watchdog;
+    QMutex m_watchdogMutex;
+    QWaitCondition m_watchdogWake;
+    bool m_watchdogStop;
 };
 
 #endif // NAMEDPIPESERVER_H
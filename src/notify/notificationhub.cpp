@@ -0,0 +1,185 @@
+#include "notificationhub.h"
+#include "protocol/serviceenvelope.h"
+
+NotificationHub::NotificationHub(Logger* logger, QObject* parent)
+    : QObject(parent)
+    , m_pLogger(logger)
+    , m_pActionSource(nullptr)
+    , m_flushScheduled(false)
+{
+}
+
+NotificationHub::~NotificationHub()
+{
+    QMutexLocker locker(&m_mutex);
+    m_subscribers.clear();
+}
+
+void NotificationHub::setActionSource(ActionCommandQueue* queue)
+{
+    QMutexLocker locker(&m_mutex);
+    m_pActionSource = queue;
+}
+
+quint32 NotificationHub::subscribe(QLocalSocket* client, quint32 eventMask, int maxQueue,
+                                   const ActionConsumerFilter& filter)
+{
+    if (!client) return 0;
+
+    eventMask &= NOTIFY_ALL;
+    if (eventMask == 0) {
+        unsubscribe(client);
+        return 0;
+    }
+
+    if (maxQueue <= 0) {
+        maxQueue = NOTIFY_DEFAULT_QUEUE;
+    }
+    maxQueue = qMin(maxQueue, NOTIFY_MAX_QUEUE);
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_pActionSource) {
+        eventMask &= ~NOTIFY_ACTION_COMMANDS;
+    }
+
+    Subscriber& sub = m_subscribers[client];
+    sub.eventMask = eventMask;
+    sub.maxQueue = maxQueue;
+
+    if (m_pActionSource) {
+        const quintptr consumerId = reinterpret_cast<quintptr>(client);
+        if (eventMask & NOTIFY_ACTION_COMMANDS) {
+            m_pActionSource->registerConsumer(consumerId, filter);
+            // A first consumer picks up the backlog
+            if (m_pActionSource->hasPending(consumerId)) {
+                scheduleFlush();
+            }
+        } else {
+            m_pActionSource->unregisterConsumer(consumerId);
+        }
+    }
+
+    LOG_FMT(m_pLogger, CatNotify, Info, "NotificationHub: Client subscribed, mask=0x%1, queue=%2 (subscribers: %3)",
+            Logger::hex(eventMask, 4), maxQueue, m_subscribers.size());
+    return eventMask;
+}
+
+void NotificationHub::unsubscribe(QLocalSocket* client)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_pActionSource) {
+        m_pActionSource->unregisterConsumer(reinterpret_cast<quintptr>(client));
+    }
+    if (m_subscribers.remove(client)) {
+        LOG_FMT(m_pLogger, CatNotify, Info, "NotificationHub: Client unsubscribed (subscribers: %1)",
+                m_subscribers.size());
+    }
+}
+
+bool NotificationHub::hasSubscribers(quint32 eventMask) const
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_subscribers.cbegin(); it != m_subscribers.cend(); ++it) {
+        if (it->eventMask & eventMask) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NotificationHub::actionsAvailable()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_subscribers.cbegin(); it != m_subscribers.cend(); ++it) {
+        if (it->eventMask & NOTIFY_ACTION_COMMANDS) {
+            scheduleFlush();
+            return;
+        }
+    }
+}
+
+void NotificationHub::publishBezelPresence(bool present)
+{
+    QMutexLocker locker(&m_mutex);
+
+    bool delivered = false;
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+        Subscriber& sub = it.value();
+        if (sub.eventMask & NOTIFY_BEZEL_PRESENCE) {
+            // Last value wins - only the current presence matters
+            sub.presencePending = true;
+            sub.bezelPresent = present;
+            delivered = true;
+        }
+    }
+
+    if (delivered) {
+        scheduleFlush();
+    }
+}
+
+void NotificationHub::scheduleFlush()
+{
+    // Coalesce bursts into one push per subscriber per event loop pass
+    if (!m_flushScheduled) {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, &NotificationHub::flushPending, Qt::QueuedConnection);
+    }
+}
+
+void NotificationHub::flushPending()
+{
+    QList<QPair<QLocalSocket*, patrol::EventNotification>> outgoing;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flushScheduled = false;
+
+        bool more = false;
+        for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+            Subscriber& sub = it.value();
+
+            ActionBatch batch;
+            if ((sub.eventMask & NOTIFY_ACTION_COMMANDS) && m_pActionSource) {
+                batch = m_pActionSource->takeFor(reinterpret_cast<quintptr>(it.key()),
+                                                 ActionCommandQueue::Delivery::Push, sub.maxQueue);
+                more = more || batch.more;
+            }
+
+            if (batch.commands.isEmpty() && batch.dropped == 0 && !sub.presencePending) {
+                continue;
+            }
+
+            patrol::EventNotification note;
+            quint32 mask = 0;
+
+            if (!batch.commands.isEmpty()) {
+                mask |= NOTIFY_ACTION_COMMANDS;
+                note.setActionCommands(batch.commands);
+            }
+            if (sub.presencePending) {
+                mask |= NOTIFY_BEZEL_PRESENCE;
+                note.setBezelPresent(sub.bezelPresent);
+                sub.presencePending = false;
+            }
+
+            note.setEventMask(mask);
+            note.setDroppedCount(batch.dropped);
+
+            outgoing.append(qMakePair(it.key(), note));
+        }
+
+        // Batches cut at max_queue continue on the next pass
+        if (more) {
+            scheduleFlush();
+        }
+    }
+
+    // Serialize and emit outside the lock so publishers are never held up by the pipe
+    for (const auto& item : outgoing) {
+        patrol::ServiceEnvelope envelope;
+        envelope.setEventNotification(item.second);
+        emit notificationReady(item.first, wrapServiceEnvelope(envelope.serialize(&m_serializer)));
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef NOTIFICATIONHUB_H
+#define NOTIFICATIONHUB_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QLocalSocket>
+#include <QProtobufSerializer>
+#include "logger.h"
+#include "action/actioncommandqueue.h"
+#include "command.qpb.h"
+#include "serviceext.qpb.h"
+
+// Event kinds a subscriber can ask for (SubscribeRequest::event_mask)
+#define NOTIFY_ACTION_COMMANDS      0x0001
+#define NOTIFY_BEZEL_PRESENCE       0x0002
+#define NOTIFY_ALL                  (NOTIFY_ACTION_COMMANDS | NOTIFY_BEZEL_PRESENCE)
+
+#define NOTIFY_DEFAULT_QUEUE        64      // Action commands per push when client asks for 0
+#define NOTIFY_MAX_QUEUE            1024
+
+/**
+ * @brief NotificationHub - Pushes service events to subscribed pipe clients
+ *
+ * Flow:
+ *   ActionCommandQueue::queueCommand → actionsAvailable() / BezelMonitor → publishBezelPresence()
+ *       → flushPending() on the hub's thread, one EventNotification per client
+ *       → notificationReady(client, payload)
+ *       → WindowsService wraps it in a secure packet and writes it to the pipe
+ *
+ * Action commands are not copied per subscriber: each subscriber is a
+ * consumer of the ActionCommandQueue log and the flush reads its batch
+ * from its own cursor. Commands the log bound dropped before a subscriber
+ * read them are counted in the next push. A push carries at most the
+ * subscriber's max_queue commands; the rest follow in the next one.
+ */
+class NotificationHub : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NotificationHub(Logger* logger, QObject* parent = nullptr);
+    ~NotificationHub();
+
+    // Where action command subscribers read from; set before subscriptions
+    void setActionSource(ActionCommandQueue* queue);
+
+    // Returns the granted mask (0 on unsubscribe)
+    quint32 subscribe(QLocalSocket* client, quint32 eventMask, int maxQueue,
+                      const ActionConsumerFilter& filter = ActionConsumerFilter());
+    void unsubscribe(QLocalSocket* client);
+    bool hasSubscribers(quint32 eventMask) const;
+
+    // Thread-safe
+    void actionsAvailable();
+    void publishBezelPresence(bool present);
+
+signals:
+    // Serialized service envelope ready to be sent to one client
+    void notificationReady(QLocalSocket* client, const QByteArray& payload);
+
+private slots:
+    void flushPending();
+
+private:
+    struct Subscriber {
+        quint32 eventMask = 0;
+        int maxQueue = NOTIFY_DEFAULT_QUEUE;
+        bool presencePending = false;
+        bool bezelPresent = false;
+    };
+
+    void scheduleFlush();   // Caller must hold m_mutex
+
+    Logger* m_pLogger;
+    ActionCommandQueue* m_pActionSource;
+    mutable QMutex m_mutex;
+    QHash<QLocalSocket*, Subscriber> m_subscribers;
+    bool m_flushScheduled;
+    QProtobufSerializer m_serializer;
+};
+
+#endif // NOTIFICATIONHUB_H
@@ -0,0 +1,38 @@
+#ifndef SERVICEENVELOPE_H
+#define SERVICEENVELOPE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+// ============================================================================
+// Service envelope framing
+//
+// A decrypted secure packet payload is either a serialized patrol::Command
+// (legacy) or SERVICE_ENVELOPE_MARKER followed by a serialized
+// patrol::ServiceEnvelope (see proto/serviceext.proto). Protobuf field number
+// 0 is invalid, so a serialized Command can never start with 0x00.
+// ============================================================================
+
+#define SERVICE_ENVELOPE_MARKER     '\0'
+
+inline bool isServiceEnvelope(const QByteArray& payload)
+{
+    return !payload.isEmpty() && payload.at(0) == SERVICE_ENVELOPE_MARKER;
+}
+
+// View into payload - valid only while payload is alive and unmodified
+inline QByteArrayView serviceEnvelopeBody(const QByteArray& payload)
+{
+    return QByteArrayView(payload).sliced(1);
+}
+
+inline QByteArray wrapServiceEnvelope(const QByteArray& serializedEnvelope)
+{
+    QByteArray out;
+    out.reserve(serializedEnvelope.size() + 1);
+    out.append(SERVICE_ENVELOPE_MARKER);
+    out.append(serializedEnvelope);
+    return out;
+}
+
+#endif // SERVICEENVELOPE_H
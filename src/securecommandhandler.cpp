@@ -1,19 +1,58 @@
 #include "securecommandhandler.h"
 #include <QDataStream>
+#include <QtEndian>
+#include <QMetaEnum>
+
+namespace {
+
+// SubscribeRequest and ActionPollRequest carry the same filter fields
+template <typename Request>
+ActionConsumerFilter actionFilter(const Request& req)
+{
+    ActionConsumerFilter filter;
+    for (const patrol::EventIdRange& range : req.eventRanges()) {
+        filter.eventRanges.append({ range.first(), range.last() });
+    }
+    filter.controlCommands = !req.excludeControlCommands();
+    filter.sessionId = req.sessionId();
+    return filter;
+}
+
+} // namespace
 
 SecureCommandHandler::SecureCommandHandler(Logger* logger, CommandProc* cmdProc, QObject* parent)
     : QObject(parent)
     , m_pLogger(logger)
     , m_pCmdProc(cmdProc)
+    , m_pNotificationHub(nullptr)
+    , m_pMirrorProducer(nullptr)
+    , m_pPipeServer(nullptr)
+    , m_pBezelMonitor(nullptr)
+    , m_parkTimer(new QTimer(this))
+    , m_replyGate(QSharedPointer<ReplyGate>::create())
 {
+    m_replyGate->handler = this;
+
+    m_parkTimer->setSingleShot(true);
+    connect(m_parkTimer, &QTimer::timeout, this, &SecureCommandHandler::serviceParkedPolls);
+
+    // Queued: commands can be queued from inside processCommand() or other threads
+    connect(m_pCmdProc, &CommandProc::actionCommandsQueued,
+            this, &SecureCommandHandler::serviceParkedPolls, Qt::QueuedConnection);
 }
 
 SecureCommandHandler::~SecureCommandHandler()
 {
+    {
+        // WMI queries still running finish without a reply; their clients go away with us
+        QMutexLocker locker(&m_replyGate->mutex);
+        m_replyGate->handler = nullptr;
+    }
+
     m_clients.clear();
 }
 
-void SecureCommandHandler::registerClient(QLocalSocket* client)
+void SecureCommandHandler::registerClient(QLocalSocket* client, PipeType pipeType)
 {
     if (!client) return;
 
@@ -25,11 +64,13 @@ void SecureCommandHandler::registerClient(QLocalSocket* client)
     session.lastSequence = 0;
     session.clientIdentifier = QString::number(reinterpret_cast<quint64>(client));
     session.isAuthenticated = false;
+    session.canSubscribe = (pipeType == PipeType::CSMonitor);
+    session.canControl = (pipeType == PipeType::ControlScreens);
 
     m_clients[client] = session;
 
     if (m_pLogger) {
-        m_pLogger->log(QString("SecureHandler: Registered client: %1").arg(session.clientIdentifier), Logger::Info);
+        LOG_INFO(m_pLogger, CatSecureHandler, QString("Registered client: %1").arg(session.clientIdentifier));
     }
 }
 
@@ -37,10 +78,17 @@ void SecureCommandHandler::unregisterClient(QLocalSocket* client)
 {
     if (m_clients.contains(client)) {
         if (m_pLogger) {
-            m_pLogger->log(QString("SecureHandler: Unregistered client: %1").arg(m_clients[client].clientIdentifier), Logger::Info);
+            LOG_INFO(m_pLogger, CatSecureHandler, QString("Unregistered client: %1").arg(m_clients[client].clientIdentifier));
         }
         m_clients.remove(client);
     }
+
+    m_parkedPolls.removeIf([client](const ParkedPoll& parked) { return parked.client == client; });
+
+    if (m_pNotificationHub) {
+        m_pNotificationHub->unsubscribe(client);
+    }
+    m_pCmdProc->releaseActionConsumer(reinterpret_cast<quintptr>(client));
 }
 
 bool SecureCommandHandler::isClientAuthenticated(QLocalSocket* client)
@@ -55,19 +103,20 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
     QByteArray payload;
 
     if (!SecurePacketBuilder::parsePacket(data, header, payload)) {
+        FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthBadPacket);
         if (m_pLogger) {
-            m_pLogger->log("SecureHandler: Invalid packet format or HMAC verification failed", Logger::Error);
+            LOG_ERROR(m_pLogger, CatSecureHandler, "Invalid packet format or HMAC verification failed");
 
             // Debug info
             if (data.size() >= 4) {
                 uint32_t receivedMagic = *reinterpret_cast<const uint32_t*>(data.constData());
-                m_pLogger->log(QString("SecureHandler: Received magic: 0x%1, expected: 0x%2")
-                                   .arg(receivedMagic, 8, 16, QChar('0'))
-                                   .arg(PROTOCOL_MAGIC, 8, 16, QChar('0')), Logger::Debug);
+                LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Received magic: 0x%1, expected: 0x%2")
+                                                           .arg(receivedMagic, 8, 16, QChar('0'))
+                                                           .arg(PROTOCOL_MAGIC, 8, 16, QChar('0')));
             }
-            m_pLogger->log(QString("SecureHandler: Packet size: %1, expected header size: %2")
-                               .arg(data.size())
-                               .arg(sizeof(SecurePacketHeaderV2)), Logger::Debug);
+            LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Packet size: %1, expected header size: %2")
+                                                       .arg(data.size())
+                                                       .arg(sizeof(SecurePacketHeaderV2)));
         }
         return QByteArray();
     }
@@ -83,6 +132,7 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
                 m_clients[client].isAuthenticated = true;
                 m_clients[client].lastActivity = QDateTime::currentDateTime();
                 m_clients[client].lastSequence = 0;
+                m_clients[client].bulk.reset();     // Bulk key is tied to the token
             }
 
             // Build token response payload
@@ -92,14 +142,15 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
             stream << newToken;
 
             if (m_pLogger) {
-                m_pLogger->log(QString("SecureHandler: Client authenticated, token: %1").arg(newToken), Logger::Info);
+                LOG_INFO(m_pLogger, CatSecureHandler, QString("Client authenticated, token: %1").arg(newToken));
             }
 
             // Build response using shared protocol (handles encryption + HMAC)
             return SecurePacketBuilder::buildPacket(newToken, 0, responsePayload);
         } else {
+            FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthBadCredentials);
             if (m_pLogger) {
-                m_pLogger->log("SecureHandler: Authentication failed", Logger::Warning);
+                LOG_WARNING(m_pLogger, CatSecureHandler, "Authentication failed");
             }
             return QByteArray();
         }
@@ -107,8 +158,9 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
 
     // Validate client registration
     if (!m_clients.contains(client)) {
+        FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthUnknownClient);
         if (m_pLogger) {
-            m_pLogger->log("SecureHandler: Unknown client", Logger::Error);
+            LOG_ERROR(m_pLogger, CatSecureHandler, "Unknown client");
         }
         return QByteArray();
     }
@@ -117,25 +169,28 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
 
     // Validate authentication
     if (!session.isAuthenticated) {
+        FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthNotAuthenticated);
         if (m_pLogger) {
-            m_pLogger->log("SecureHandler: Client not authenticated", Logger::Warning);
+            LOG_WARNING(m_pLogger, CatSecureHandler, "Client not authenticated");
         }
         return QByteArray();
     }
 
     // Validate token
     if (header.sessionToken != session.token) {
+        FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthTokenMismatch);
         if (m_pLogger) {
-            m_pLogger->log(QString("SecureHandler: Token mismatch: expected %1, got %2")
-                               .arg(session.token).arg(header.sessionToken), Logger::Warning);
+            LOG_WARNING(m_pLogger, CatSecureHandler, QString("Token mismatch: expected %1, got %2")
+                                                         .arg(session.token).arg(header.sessionToken));
         }
         return QByteArray();
     }
 
     // Validate sequence number (anti-replay)
     if (!validateSequence(client, header.sequenceNumber)) {
+        FLIGHT_EVENT(m_pLogger, AuthFailure, FlightRecorder::AuthBadSequence);
         if (m_pLogger) {
-            m_pLogger->log("SecureHandler: Invalid sequence number", Logger::Warning);
+            LOG_WARNING(m_pLogger, CatSecureHandler, "Invalid sequence number");
         }
         return QByteArray();
     }
@@ -144,40 +199,539 @@ QByteArray SecureCommandHandler::processCommand(const QByteArray& data, QLocalSo
     session.lastActivity = QDateTime::currentDateTime();
     session.lastSequence = header.sequenceNumber;
 
+    // Service extension envelope (batch etc.) - the body is parsed in place, not copied out
+    if (isServiceEnvelope(payload)) {
+        QByteArray responsePayload = processEnvelope(serviceEnvelopeBody(payload), client);
+        if (responsePayload.isEmpty()) {
+            return QByteArray();
+        }
+        return SecurePacketBuilder::buildPacket(header.sessionToken, header.sequenceNumber, responsePayload);
+    }
+
     // Deserialize protobuf command (payload is already decrypted by parsePacket)
     patrol::Command request;
     if (!request.deserialize(&m_serializer, payload)) {
         if (m_pLogger) {
-            m_pLogger->log("SecureHandler: Failed to deserialize protobuf command", Logger::Error);
+            LOG_ERROR(m_pLogger, CatSecureHandler, "Failed to deserialize protobuf command");
         }
         return QByteArray();
     }
 
     if (m_pLogger) {
-        m_pLogger->log(QString("SecureHandler: Processing command, sequence: %1").arg(header.sequenceNumber), Logger::Debug);
+        LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Processing command, sequence: %1").arg(header.sequenceNumber));
+    }
+
+    // WMI queries can take seconds; the reply goes out through deferredResponse
+    // when the query finishes, keeping the pipe thread free
+    if (request.hasWmiQueryReq()) {
+        runWmiQuery(request, client, header.sessionToken, header.sequenceNumber);
+        return QByteArray();
     }
 
     // Process command via CommandProc
-    patrol::Command response = m_pCmdProc->processCommand(request);
+    patrol::Command response = m_pCmdProc->processCommand(request, nullptr, reinterpret_cast<quintptr>(client));
 
     // Serialize response
     QByteArray responsePayload = response.serialize(&m_serializer);
 
     if (m_pLogger) {
-        m_pLogger->log(QString("SecureHandler: Response size: %1 bytes").arg(responsePayload.size()), Logger::Debug);
+        LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Response size: %1 bytes").arg(responsePayload.size()));
     }
 
     // Build and return secure packet using shared protocol (handles encryption + HMAC)
     return SecurePacketBuilder::buildPacket(header.sessionToken, header.sequenceNumber, responsePayload);
 }
 
+QByteArray SecureCommandHandler::buildPushPacket(QLocalSocket* client, const QByteArray& payload)
+{
+    if (!m_clients.contains(client) || !m_clients[client].isAuthenticated) {
+        return QByteArray();
+    }
+
+    // Pushes use sequence 0; clients tell them from responses by the envelope type
+    return SecurePacketBuilder::buildPacket(m_clients[client].token, 0, payload);
+}
+
+QByteArray SecureCommandHandler::processEnvelope(QByteArrayView body, QLocalSocket* client)
+{
+    patrol::ServiceEnvelope request;
+    if (!request.deserialize(&m_serializer, body)) {
+        if (m_pLogger) {
+            LOG_ERROR(m_pLogger, CatSecureHandler, "Failed to deserialize service envelope");
+        }
+        return QByteArray();
+    }
+
+    patrol::ServiceEnvelope response;
+    response.setSequenceNumber(request.sequenceNumber());
+
+    if (request.hasBatchReq()) {
+        if (m_pLogger) {
+            LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Processing batch of %1 commands")
+                                                       .arg(request.batchReq().commands().size()));
+        }
+        response.setBatchResp(m_pCmdProc->processBatch(request.batchReq(), reinterpret_cast<quintptr>(client)));
+    }
+    else if (request.hasSubscribeReq()) {
+        response.setSubscribeResp(handleSubscribe(request.subscribeReq(), client));
+    }
+    else if (request.hasBulkReq()) {
+        if (request.bulkReq().command().hasWmiQueryReq()) {
+            runBulkWmiQuery(request, client);
+            return QByteArray();    // Answered when the query finishes
+        }
+        response.setBulkResp(handleBulk(request.bulkReq(), client));
+    }
+    else if (request.hasMetricsReq()) {
+        const bool reset = request.metricsReq().reset();
+        if (reset && !m_clients[client].canControl) {
+            // Counters are shared by every client; only ControlScreens may zero them
+            if (m_pLogger) {
+                LOG_WARNING(m_pLogger, CatSecureHandler, "Metrics reset refused: not on the ControlScreens pipe");
+            }
+            patrol::MetricsResponse refused;
+            refused.setResult(-2);
+            response.setMetricsResp(refused);
+        } else {
+            patrol::MetricsResponse metrics = m_pCmdProc->collectMetrics(reset);
+            if (m_pMirrorProducer) {
+                metrics.setMirrorRegions(m_pMirrorProducer->snapshot(reset));
+            }
+            addPipeMetrics(metrics, reset);
+            addBezelMetrics(metrics);
+            response.setMetricsResp(metrics);
+        }
+    }
+    else if (request.hasFlightDumpReq()) {
+        response.setFlightDumpResp(handleFlightDump(request.flightDumpReq(), client));
+    }
+    else if (request.hasActionPollReq()) {
+        const patrol::ActionPollResponse poll = handleActionPoll(request.actionPollReq(), client);
+        if (poll.commands().isEmpty() && poll.droppedCount() == 0 && request.actionPollReq().waitMs() > 0
+            && parkActionPoll(request, client)) {
+            return QByteArray();    // Answered by serviceParkedPolls()
+        }
+        response.setActionPollResp(poll);
+    }
+    else if (request.hasWmiCacheReq()) {
+        const patrol::WmiCacheRequest& req = request.wmiCacheReq();
+        if ((req.invalidate() || req.resetStats()) && !m_clients[client].canControl) {
+            // Flushing the cache or its counters affects every client
+            if (m_pLogger) {
+                LOG_WARNING(m_pLogger, CatSecureHandler, "WMI cache invalidate/reset refused: not on the ControlScreens pipe");
+            }
+            patrol::WmiCacheResponse refused;
+            refused.setResult(-2);
+            response.setWmiCacheResp(refused);
+        } else {
+            response.setWmiCacheResp(m_pCmdProc->handleWmiCache(req));
+        }
+    }
+    else if (request.hasLogLevelReq()) {
+        response.setLogLevelResp(handleLogLevel(request.logLevelReq(), client));
+    }
+    else {
+        if (m_pLogger) {
+            LOG_WARNING(m_pLogger, CatSecureHandler, "Unknown service envelope type");
+        }
+        return QByteArray();
+    }
+
+    QByteArray serialized = response.serialize(&m_serializer);
+    QByteArray responsePayload = wrapServiceEnvelope(serialized);
+
+    if (m_pLogger) {
+        LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Envelope response size: %1 bytes").arg(responsePayload.size()));
+    }
+
+    return responsePayload;
+}
+
+void SecureCommandHandler::addPipeMetrics(patrol::MetricsResponse& metrics, bool reset)
+{
+    if (!m_pPipeServer) {
+        return;
+    }
+
+    QList<patrol::PipeMetrics> pipes;
+    for (PipeType type : m_pPipeServer->registeredPipes()) {
+        const PipeStats stats = m_pPipeServer->pipeStats(type, reset);
+        patrol::PipeMetrics pipe;
+        pipe.setPipe(m_pPipeServer->pipeLabel(type));
+        pipe.setClients(static_cast<quint32>(stats.clients));
+        pipe.setRequests(stats.requests);
+        pipe.setThrottled(stats.throttled);
+        pipe.setRejectedConnections(stats.rejectedConnections);
+        pipes.append(pipe);
+    }
+    metrics.setPipes(pipes);
+
+    const OutboundStats stats = m_pPipeServer->outboundStats(reset);
+    const OutboundLimits limits = m_pPipeServer->outboundLimits();
+    patrol::OutboundMetrics outbound;
+    outbound.setFramesSent(stats.framesSent);
+    outbound.setBytesSent(stats.bytesSent);
+    outbound.setPushesDropped(stats.pushesDropped);
+    outbound.setSlowDisconnects(stats.slowDisconnects);
+    outbound.setPeakQueuedBytes(stats.peakQueuedBytes);
+    outbound.setCurrentQueuedBytes(stats.currentQueuedBytes);
+    outbound.setMaxQueuedBytes(limits.maxQueuedBytes);
+    outbound.setSocketHighWater(limits.socketHighWater);
+    outbound.setSlowConsumerPolicy(limits.policy == SlowConsumerPolicy::Disconnect
+                                       ? QStringLiteral("disconnect")
+                                       : QStringLiteral("drop_oldest_push"));
+    metrics.setOutbound(outbound);
+}
+
+void SecureCommandHandler::addBezelMetrics(patrol::MetricsResponse& metrics)
+{
+    if (!m_pBezelMonitor) {
+        return;
+    }
+
+    const BezelPollStatus status = m_pBezelMonitor->pollStatus();
+    patrol::BezelMetrics bezel;
+    switch (status.state) {
+    case BezelPollState::Active:   bezel.setState(QStringLiteral("active")); break;
+    case BezelPollState::Decaying: bezel.setState(QStringLiteral("decaying")); break;
+    case BezelPollState::Idle:     bezel.setState(QStringLiteral("idle")); break;
+    case BezelPollState::Absent:   bezel.setState(QStringLiteral("absent")); break;
+    }
+    bezel.setIntervalMs(static_cast<quint32>(status.intervalMs));
+    bezel.setLastActivityMs(status.lastActivityMs);
+    bezel.setLastPollMs(status.lastPollMs);
+    bezel.setLastPresenceCheckMs(status.lastPresenceCheckMs);
+    bezel.setPolls(status.polls);
+    bezel.setEcTransactions(status.ecTransactions);
+    metrics.setBezel(bezel);
+}
+
+patrol::FlightDumpResponse SecureCommandHandler::handleFlightDump(const patrol::FlightDumpRequest& req, QLocalSocket* client)
+{
+    patrol::FlightDumpResponse resp;
+    if (!m_pLogger) {
+        resp.setResult(-1);
+        return resp;
+    }
+
+    if (!m_clients.contains(client) || !m_clients[client].canControl) {
+        LOG_WARNING(m_pLogger, CatSecureHandler, "Flight dump refused: not on the ControlScreens pipe");
+        resp.setResult(-2);
+        return resp;
+    }
+
+    const QString reason = req.reason().isEmpty() ? QStringLiteral("requested") : req.reason();
+    FLIGHT_EVENT(m_pLogger, DumpRequested);
+
+    // Shares the automatic dumps' rate limit, so a client cannot fill the disk
+    int events = 0;
+    const QString path = m_pLogger->flightRecorder().trigger(QString("client request: %1").arg(reason), &events);
+    if (path.isEmpty()) {
+        LOG_INFO(m_pLogger, CatSecureHandler, "Flight recorder dump on request not written (rate limited or I/O error)");
+        resp.setResult(-1);
+        return resp;
+    }
+
+    resp.setResult(0);
+    resp.setPath(path);
+    resp.setEventCount(static_cast<quint32>(events));
+
+    LOG_INFO(m_pLogger, CatSecureHandler, QString("Flight recorder dumped on request (%1 events): %2")
+                                              .arg(events).arg(path));
+    return resp;
+}
+
+patrol::LogLevelResponse SecureCommandHandler::handleLogLevel(const patrol::LogLevelRequest& req, QLocalSocket* client)
+{
+    patrol::LogLevelResponse resp;
+    resp.setResult(0);
+    if (!m_pLogger) {
+        resp.setResult(-1);
+        return resp;
+    }
+
+    if (!m_clients.contains(client) || !m_clients[client].canControl) {
+        LOG_WARNING(m_pLogger, CatSecureHandler, "Log level change refused: not on the ControlScreens pipe");
+        resp.setResult(-2);
+        return resp;
+    }
+
+    const QMetaEnum levels = QMetaEnum::fromType<Logger::LogLevel>();
+    for (const patrol::LogCategoryLevel& entry : req.set()) {
+        Logger::LogCategory category;
+        bool levelOk = false;
+        const int level = levels.keyToValue(entry.level().toLatin1().constData(), &levelOk);
+        if (!Logger::categoryFromName(entry.category(), &category) || !levelOk) {
+            LOG_WARNING(m_pLogger, CatSecureHandler, QString("Ignoring log level '%1' for category '%2'")
+                                                         .arg(entry.level(), entry.category()));
+            resp.setResult(-1);
+            continue;
+        }
+
+        m_pLogger->setThreshold(category, static_cast<Logger::LogLevel>(level));
+        LOG_INFO(m_pLogger, CatSecureHandler, QString("Log threshold for %1 set to %2")
+                                                  .arg(entry.category(), entry.level()));
+    }
+
+    QList<patrol::LogCategoryLevel> current;
+    for (int i = 0; i < Logger::LogCategoryCount; i++) {
+        const Logger::LogCategory category = static_cast<Logger::LogCategory>(i);
+        patrol::LogCategoryLevel entry;
+        entry.setCategory(Logger::categoryName(category));
+        entry.setLevel(QString::fromLatin1(levels.valueToKey(m_pLogger->threshold(category))));
+        current.append(entry);
+    }
+    resp.setLevels(current);
+    return resp;
+}
+
+QByteArray SecureCommandHandler::bulkKey(uint32_t token) const
+{
+    QByteArray material("CSServiceBulk");
+    material.append(SHARED_SECRET);
+    char tokenBytes[4];
+    qToLittleEndian<quint32>(token, tokenBytes);
+    material.append(tokenBytes, sizeof(tokenBytes));
+    return QCryptographicHash::hash(material, QCryptographicHash::Sha256);
+}
+
+patrol::BulkResponse SecureCommandHandler::handleBulk(const patrol::BulkRequest& req, QLocalSocket* client)
+{
+    int result = -1;
+    patrol::Command cmdResp = m_pCmdProc->processCommand(req.command(), &result, reinterpret_cast<quintptr>(client));
+    return bulkResponse(cmdResp, result, req.minBulkSize(), client);
+}
+
+patrol::BulkResponse SecureCommandHandler::bulkResponse(const patrol::Command& cmdResp, int result, quint32 minBulkSize,
+                                                        QLocalSocket* client)
+{
+    patrol::BulkResponse resp;
+    resp.setResult(result);
+
+    const quint32 threshold = minBulkSize > 0 ? minBulkSize : BULK_DEFAULT_THRESHOLD;
+    QByteArray serialized = cmdResp.serialize(&m_serializer);
+
+    auto it = m_clients.find(client);
+    if (it != m_clients.end() && static_cast<quint32>(serialized.size()) >= threshold) {
+        ClientSession& session = it.value();
+        if (!session.bulk) {
+            RegionPeer peer;
+            if (SharedMemoryRegion::peerFromSocket(client->socketDescriptor(), peer)) {
+                session.bulk = QSharedPointer<BulkChannel>::create(m_pLogger, bulkKey(session.token), peer);
+            } else if (m_pLogger) {
+                LOG_WARNING(m_pLogger, CatSecureHandler, "Cannot identify bulk client, responding inline");
+            }
+        }
+
+        patrol::BulkDescriptor descriptor;
+        if (session.bulk && session.bulk->publish(serialized, descriptor)) {
+            resp.setDescriptor(descriptor);
+
+            if (m_pLogger) {
+                LOG_DEBUG(m_pLogger, CatSecureHandler, QString("%1-byte response published to bulk region (gen %2)")
+                                                           .arg(serialized.size()).arg(descriptor.generation()));
+            }
+            return resp;
+        }
+        // Region unavailable or response too large for it - fall back to the pipe
+    }
+
+    resp.setInlineResponse(cmdResp);
+    return resp;
+}
+
+patrol::SubscribeResponse SecureCommandHandler::handleSubscribe(const patrol::SubscribeRequest& req, QLocalSocket* client)
+{
+    patrol::SubscribeResponse resp;
+
+    if (!m_pNotificationHub || !m_clients.contains(client) || !m_clients[client].canSubscribe) {
+        if (m_pLogger) {
+            LOG_WARNING(m_pLogger, CatSecureHandler, "Subscription refused on this pipe");
+        }
+        resp.setResult(-1);
+        resp.setEventMask(0);
+        return resp;
+    }
+
+    quint32 granted = m_pNotificationHub->subscribe(client, req.eventMask(), static_cast<int>(req.maxQueue()),
+                                                    actionFilter(req));
+    resp.setResult(0);
+    resp.setEventMask(granted);
+    return resp;
+}
+
+patrol::ActionPollResponse SecureCommandHandler::handleActionPoll(const patrol::ActionPollRequest& req, QLocalSocket* client)
+{
+    patrol::ActionPollResponse resp;
+
+    const ActionBatch batch = m_pCmdProc->pollActionCommands(reinterpret_cast<quintptr>(client), actionFilter(req),
+                                                             static_cast<int>(req.maxCommands()));
+    resp.setResult(0);
+    resp.setCommands(batch.commands);
+    resp.setDroppedCount(batch.dropped);
+    resp.setMore(batch.more);
+    return resp;
+}
+
+bool SecureCommandHandler::parkActionPoll(const patrol::ServiceEnvelope& request, QLocalSocket* client)
+{
+    auto it = m_clients.constFind(client);
+    if (it == m_clients.constEnd()) {
+        return false;
+    }
+
+    // A client has one poll outstanding; an older one is answered empty
+    for (ParkedPoll& parked : m_parkedPolls) {
+        if (parked.client == client) {
+            parked.superseded = true;
+            parked.deadline = QDeadlineTimer(0);
+        }
+    }
+
+    const patrol::ActionPollRequest& req = request.actionPollReq();
+    ParkedPoll parked;
+    parked.client = client;
+    parked.token = it->token;
+    parked.packetSequence = it->lastSequence;     // Set from this packet's header
+    parked.envelopeSequence = request.sequenceNumber();
+    parked.filter = actionFilter(req);
+    parked.maxCommands = static_cast<int>(req.maxCommands());
+    parked.deadline = QDeadlineTimer(qMin<quint32>(req.waitMs(), ACTION_POLL_MAX_WAIT_MS));
+    m_parkedPolls.append(parked);
+
+    rescheduleParkTimer();
+    return true;
+}
+
+void SecureCommandHandler::serviceParkedPolls()
+{
+    for (qsizetype i = 0; i < m_parkedPolls.size();) {
+        const ParkedPoll parked = m_parkedPolls.at(i);
+
+        // Gone, or re-authenticated since: the reply could not be verified
+        auto session = m_clients.constFind(parked.client.data());
+        if (!parked.client || session == m_clients.constEnd() || session->token != parked.token) {
+            m_parkedPolls.removeAt(i);
+            continue;
+        }
+
+        // A superseded poll is answered empty; its commands go to the newer one
+        const bool expired = parked.superseded || parked.deadline.hasExpired();
+        ActionBatch batch;
+        if (!parked.superseded) {
+            batch = m_pCmdProc->pollActionCommands(reinterpret_cast<quintptr>(parked.client.data()),
+                                                   parked.filter, parked.maxCommands);
+        }
+        if (batch.commands.isEmpty() && batch.dropped == 0 && !expired) {
+            i++;
+            continue;
+        }
+
+        m_parkedPolls.removeAt(i);
+
+        patrol::ActionPollResponse poll;
+        poll.setResult(0);
+        poll.setCommands(batch.commands);
+        poll.setDroppedCount(batch.dropped);
+        poll.setMore(batch.more);
+
+        patrol::ServiceEnvelope response;
+        response.setSequenceNumber(parked.envelopeSequence);
+        response.setActionPollResp(poll);
+        sendDeferred(parked.client, parked.token, parked.packetSequence,
+                     wrapServiceEnvelope(response.serialize(&m_serializer)));
+    }
+
+    rescheduleParkTimer();
+}
+
+void SecureCommandHandler::rescheduleParkTimer()
+{
+    if (m_parkedPolls.isEmpty()) {
+        m_parkTimer->stop();
+        return;
+    }
+
+    qint64 nextMs = ACTION_POLL_MAX_WAIT_MS;
+    for (const ParkedPoll& parked : m_parkedPolls) {
+        nextMs = qMin(nextMs, parked.deadline.remainingTime());
+    }
+    m_parkTimer->start(static_cast<int>(qMax<qint64>(0, nextMs)));
+}
+
+void SecureCommandHandler::sendDeferred(QLocalSocket* client, uint32_t token, uint32_t packetSequence,
+                                        const QByteArray& payload)
+{
+    emit deferredResponse(client, SecurePacketBuilder::buildPacket(token, packetSequence, payload));
+}
+
+bool SecureCommandHandler::hasSession(QLocalSocket* client, uint32_t token) const
+{
+    // The client may have gone or re-authenticated while its reply was pending
+    auto session = m_clients.constFind(client);
+    return session != m_clients.constEnd() && session->token == token;
+}
+
+void SecureCommandHandler::runWmiQuery(const patrol::Command& request, QLocalSocket* client,
+                                       uint32_t token, uint32_t packetSequence)
+{
+    const QSharedPointer<ReplyGate> gate = m_replyGate;
+    m_pCmdProc->processWmiQueryAsync(request, [this, gate, client, token, packetSequence](const patrol::Command& response,
+                                                                                         int) {
+        // Sessions and the serializer belong to our thread
+        postReply(gate, [this, client, token, packetSequence, response]() {
+            if (hasSession(client, token)) {
+                sendDeferred(client, token, packetSequence, response.serialize(&m_serializer));
+            }
+        });
+    });
+}
+
+void SecureCommandHandler::runBulkWmiQuery(const patrol::ServiceEnvelope& request, QLocalSocket* client)
+{
+    auto it = m_clients.constFind(client);
+    if (it == m_clients.constEnd()) {
+        return;
+    }
+
+    const QSharedPointer<ReplyGate> gate = m_replyGate;
+    const uint32_t token = it->token;
+    const uint32_t packetSequence = it->lastSequence;     // Set from this packet's header
+    const uint32_t envelopeSequence = request.sequenceNumber();
+    const quint32 minBulkSize = request.bulkReq().minBulkSize();
+
+    m_pCmdProc->processWmiQueryAsync(request.bulkReq().command(),
+                                     [this, gate, client, token, packetSequence, envelopeSequence, minBulkSize]
+                                     (const patrol::Command& cmdResp, int result) {
+        postReply(gate, [this, client, token, packetSequence, envelopeSequence, minBulkSize, cmdResp, result]() {
+            if (!hasSession(client, token)) {
+                return;
+            }
+            patrol::ServiceEnvelope response;
+            response.setSequenceNumber(envelopeSequence);
+            response.setBulkResp(bulkResponse(cmdResp, result, minBulkSize, client));
+            sendDeferred(client, token, packetSequence, wrapServiceEnvelope(response.serialize(&m_serializer)));
+        });
+    });
+}
+
+void SecureCommandHandler::postReply(const QSharedPointer<ReplyGate>& gate, std::function<void()> reply)
+{
+    // Called from WMI workers, or from our own thread for a cache hit; either
+    // way the reply runs later on our thread, outside processCommand()
+    QMutexLocker locker(&gate->mutex);
+    if (gate->handler) {
+        QMetaObject::invokeMethod(gate->handler, std::move(reply), Qt::QueuedConnection);
+    }
+}
+
 bool SecureCommandHandler::authenticateClient(const QByteArray& authData, QLocalSocket* client)
 {
     Q_UNUSED(client)
 
     if (authData.isEmpty() || authData.size() < 32) {
         if (m_pLogger) {
-            m_pLogger->log(QString("SecureHandler: Auth data too small: %1 bytes").arg(authData.size()), Logger::Debug);
+            LOG_DEBUG(m_pLogger, CatSecureHandler, QString("Auth data too small: %1 bytes").arg(authData.size()));
         }
         return false;
     }
@@ -193,7 +747,7 @@ bool SecureCommandHandler::authenticateClient(const QByteArray& authData, QLocal
     bool matches = (clientAuth == expectedAuth);
 
     if (m_pLogger && !matches) {
-        m_pLogger->log("SecureHandler: Auth hash mismatch", Logger::Debug);
+        LOG_DEBUG(m_pLogger, CatSecureHandler, "Auth hash mismatch");
     }
 
     return matches;
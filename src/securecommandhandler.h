@@ -4,16 +4,30 @@
 #include <QObject>
 #include <QLocalSocket>
 #include <QByteArray>
-#include <QMap>
+#include <QHash>
 #include <QDateTime>
 #include <QProtobufSerializer>
 #include "Logger.h"
 #include "CommandProc.h"
 #include "command.qpb.h"
+#include "serviceext.qpb.h"
+#include "protocol/serviceenvelope.h"
+#include "shm/bulkchannel.h"
+#include "mirror/ecmirrorproducer.h"
+#include "bezel/bezel.h"
+#include "namedpipeserver.h"
+#include <QSharedPointer>
+#include <QPointer>
+#include <QTimer>
+#include <QDeadlineTimer>
+#include <QMutex>
+#include <functional>
 
 // Use the shared protocol - this ensures client and server match
 #include "../../Shared/Src/secureprotocol.h"
 
+#define ACTION_POLL_MAX_WAIT_MS     30000   // Longest an ActionPollRequest is held (wait_ms cap)
+
 struct ClientSession {
     uint32_t token;
     QLocalSocket* socket;
@@ -22,6 +36,9 @@ struct ClientSession {
     uint32_t lastSequence;
     QString clientIdentifier;
     bool isAuthenticated;
+    bool canSubscribe;          // Push subscriptions are only offered on the CSMonitor pipe
+    bool canControl;            // Service control (log levels) only from the ControlScreens pipe
+    QSharedPointer<BulkChannel> bulk;   // Created on the first large BulkRequest response
 };
 
 class SecureCommandHandler : public QObject
@@ -35,22 +52,87 @@ public:
     // Process incoming command - returns response packet
     QByteArray processCommand(const QByteArray& data, QLocalSocket* client);
 
+    // Build an unsolicited push packet (sequence 0) for an authenticated client
+    QByteArray buildPushPacket(QLocalSocket* client, const QByteArray& payload);
+
+    void setNotificationHub(NotificationHub* hub) { m_pNotificationHub = hub; }
+    void setMirrorProducer(EcMirrorProducer* producer) { m_pMirrorProducer = producer; }
+    void setPipeServer(NamedPipeServer* server) { m_pPipeServer = server; }
+    void setBezelMonitor(BezelMonitor* monitor) { m_pBezelMonitor = monitor; }
+
     // Client management
-    void registerClient(QLocalSocket* client);
+    void registerClient(QLocalSocket* client, PipeType pipeType);
     void unregisterClient(QLocalSocket* client);
     bool isClientAuthenticated(QLocalSocket* client);
 
+signals:
+    // A reply processCommand() returned empty for and answered later (long
+    // polls, WmiQuery). Emitted on the handler's thread outside processCommand().
+    void deferredResponse(QLocalSocket* client, const QByteArray& packet);
+
+private slots:
+    void serviceParkedPolls();
+
 private:
+    // ActionPollRequest waiting for a command; one per client
+    struct ParkedPoll {
+        QPointer<QLocalSocket> client;
+        uint32_t token = 0;
+        uint32_t packetSequence = 0;
+        uint32_t envelopeSequence = 0;
+        ActionConsumerFilter filter;
+        int maxCommands = 0;
+        QDeadlineTimer deadline;
+        bool superseded = false;            // A newer poll from the client takes the commands
+    };
+
+    // WMI completions run on engine workers that can outlive us; they post
+    // replies through the gate, which is closed in the destructor
+    struct ReplyGate {
+        QMutex mutex;
+        SecureCommandHandler* handler = nullptr;
+    };
+
     Logger* m_pLogger;
     CommandProc* m_pCmdProc;
-    QMap<QLocalSocket*, ClientSession> m_clients;
+    NotificationHub* m_pNotificationHub;
+    EcMirrorProducer* m_pMirrorProducer;
+    NamedPipeServer* m_pPipeServer;         // Pipe and outbound queue metrics only
+    BezelMonitor* m_pBezelMonitor;          // Poll status metrics only
+    QHash<QLocalSocket*, ClientSession> m_clients;
     QProtobufSerializer m_serializer;
+    QList<ParkedPoll> m_parkedPolls;
+    QTimer* m_parkTimer;                    // Earliest parked poll deadline
+
+    QSharedPointer<ReplyGate> m_replyGate;
 
     // Authentication
     bool authenticateClient(const QByteArray& authData, QLocalSocket* client);
 
     // Sequence validation
     bool validateSequence(QLocalSocket* client, uint32_t sequence);
+
+    // Service extension messages (batch etc.) - returns serialized response payload
+    QByteArray processEnvelope(QByteArrayView body, QLocalSocket* client);
+    patrol::BulkResponse handleBulk(const patrol::BulkRequest& req, QLocalSocket* client);
+    patrol::BulkResponse bulkResponse(const patrol::Command& cmdResp, int result, quint32 minBulkSize,
+                                      QLocalSocket* client);
+    QByteArray bulkKey(uint32_t token) const;
+    void addPipeMetrics(patrol::MetricsResponse& metrics, bool reset);
+    void addBezelMetrics(patrol::MetricsResponse& metrics);
+    patrol::FlightDumpResponse handleFlightDump(const patrol::FlightDumpRequest& req, QLocalSocket* client);
+    patrol::LogLevelResponse handleLogLevel(const patrol::LogLevelRequest& req, QLocalSocket* client);
+    patrol::SubscribeResponse handleSubscribe(const patrol::SubscribeRequest& req, QLocalSocket* client);
+    patrol::ActionPollResponse handleActionPoll(const patrol::ActionPollRequest& req, QLocalSocket* client);
+    bool parkActionPoll(const patrol::ServiceEnvelope& request, QLocalSocket* client);
+    void rescheduleParkTimer();
+    void sendDeferred(QLocalSocket* client, uint32_t token, uint32_t packetSequence, const QByteArray& payload);
+    bool hasSession(QLocalSocket* client, uint32_t token) const;
+
+    // WmiQuery replies, sent from our thread when the query finishes
+    void runWmiQuery(const patrol::Command& request, QLocalSocket* client, uint32_t token, uint32_t packetSequence);
+    void runBulkWmiQuery(const patrol::ServiceEnvelope& request, QLocalSocket* client);
+    static void postReply(const QSharedPointer<ReplyGate>& gate, std::function<void()> reply);
 };
 
 // Keep the old name as alias for compatibility with existing code
@@ -0,0 +1,84 @@
+#include "bulkchannel.h"
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+
+BulkChannel::BulkChannel(Logger* logger, const QByteArray& key, const RegionPeer& peer)
+    : m_pLogger(logger)
+    , m_key(key)
+    , m_peer(peer)
+    , m_region(logger)
+    , m_generation(0)
+{
+}
+
+QByteArray BulkChannel::computeMac(const QByteArray& key, quint32 generation,
+                                   quint32 offset, QByteArrayView data)
+{
+    char header[12];
+    qToLittleEndian<quint32>(generation, header);
+    qToLittleEndian<quint32>(offset, header + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(data.size()), header + 8);
+
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, key);
+    mac.addData(header, sizeof(header));
+    mac.addData(data);
+    return mac.result();
+}
+
+bool BulkChannel::ensureCapacity(qint64 bytes)
+{
+    if (m_region.isValid() && m_region.size() >= bytes) {
+        return true;
+    }
+
+    if (bytes > BULK_MAX_REGION_SIZE) {
+        if (m_pLogger) {
+            LOG_WARNING(m_pLogger, CatMirror, QString("BulkChannel: %1 bytes exceeds the %2 byte limit")
+                                                  .arg(bytes).arg(BULK_MAX_REGION_SIZE));
+        }
+        return false;
+    }
+
+    qint64 size = BULK_MIN_REGION_SIZE;
+    while (size < bytes) {
+        size *= 2;
+    }
+
+    // A fresh name each time; clients map whatever the descriptor names. Access
+    // is limited to the peer's account, the name is not what keeps others out.
+    const QString name = QString("CSService_Bulk_%1%2")
+                             .arg(QRandomGenerator::system()->generate64(), 16, 16, QChar('0'))
+                             .arg(QRandomGenerator::system()->generate64(), 16, 16, QChar('0'));
+
+    if (!m_region.createPrivate(name, size, m_peer)) {
+        return false;
+    }
+
+    if (m_pLogger) {
+        LOG_DEBUG(m_pLogger, CatMirror, QString("BulkChannel: Created %1 KB region %2").arg(size / 1024).arg(name));
+    }
+    return true;
+}
+
+bool BulkChannel::publish(const QByteArray& data, patrol::BulkDescriptor& descriptor)
+{
+    if (!ensureCapacity(data.size())) {
+        return false;
+    }
+
+    const quint32 offset = 0;
+    m_generation++;
+
+    // The only copy of the payload on the bulk path
+    memcpy(static_cast<char*>(m_region.data()) + offset, data.constData(), data.size());
+
+    descriptor.setRegionName(m_region.name());
+    descriptor.setRegionSize(static_cast<quint64>(m_region.size()));
+    descriptor.setOffset(offset);
+    descriptor.setLength(static_cast<quint32>(data.size()));
+    descriptor.setGeneration(m_generation);
+    descriptor.setHmac(computeMac(m_key, m_generation, offset, data));
+    return true;
+}
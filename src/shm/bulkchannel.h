@@ -0,0 +1,49 @@
+#ifndef BULKCHANNEL_H
+#define BULKCHANNEL_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include "sharedmemoryregion.h"
+#include "serviceext.qpb.h"
+
+#define BULK_DEFAULT_THRESHOLD  4096                // Responses below this stay inline
+#define BULK_MIN_REGION_SIZE    (256 * 1024)
+#define BULK_MAX_REGION_SIZE    (16 * 1024 * 1024)
+
+/**
+ * @brief BulkChannel - Per-session shared memory for large responses
+ *
+ * The service copies a serialized response into the session's region and
+ * sends only a BulkDescriptor through the pipe. The descriptor carries an
+ * HMAC over (generation, offset, length, data) keyed with the session's bulk
+ * key, so a client can verify the region contents without the payload ever
+ * being encrypted or framed.
+ *
+ * One region per session, one response at a time: a publish overwrites the
+ * previous one, which matches the one-request-in-flight pipe protocol.
+ * The region grows (under a new random name) when a response does not fit.
+ * Regions are private to the session's client account (see RegionPeer).
+ */
+class BulkChannel
+{
+public:
+    BulkChannel(Logger* logger, const QByteArray& key, const RegionPeer& peer);
+
+    // Copy data into the region and fill the descriptor. False if the data is
+    // over BULK_MAX_REGION_SIZE or the region could not be created.
+    bool publish(const QByteArray& data, patrol::BulkDescriptor& descriptor);
+
+    static QByteArray computeMac(const QByteArray& key, quint32 generation,
+                                 quint32 offset, QByteArrayView data);
+
+private:
+    bool ensureCapacity(qint64 bytes);
+
+    Logger* m_pLogger;
+    QByteArray m_key;
+    RegionPeer m_peer;
+    SharedMemoryRegion m_region;
+    quint32 m_generation;
+};
+
+#endif // BULKCHANNEL_H
@@ -0,0 +1,196 @@
+#include "changenotifier.h"
+#include <QElapsedTimer>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+#include <sddl.h>
+#elif defined(Q_OS_LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#endif
+
+static_assert(std::atomic<quint32>::is_always_lock_free, "ChangeNotifier needs lock-free 32-bit atomics");
+
+#define CHANGE_POLL_INTERVAL_MS  1     // Fallback wait granularity without a native primitive
+#define CHANGE_RECHECK_MS        10    // Longest event wait between sequence checks (Windows)
+
+#ifdef Q_OS_WIN
+static std::wstring eventName(const QString& name, int parity)
+{
+    return SharedMemoryRegion::nativeName(QString("%1Ev%2").arg(name).arg(parity)).toStdWString();
+}
+#endif
+
+ChangeNotifier::ChangeNotifier(Logger* logger)
+    : m_pLogger(logger)
+    , m_region(logger)
+    , m_pState(nullptr)
+#ifdef Q_OS_WIN
+    , m_events{nullptr, nullptr}
+#endif
+{
+}
+
+ChangeNotifier::~ChangeNotifier()
+{
+    close();
+}
+
+bool ChangeNotifier::create(const QString& name)
+{
+    close();
+
+    // Clients only read the counter
+    if (!m_region.create(name, sizeof(State), false)) {
+        return false;
+    }
+
+#ifdef Q_OS_WIN
+    // Authenticated Users may only wait (SYNCHRONIZE); setting and resetting is the owner's job
+    SECURITY_ATTRIBUTES sa = {0};
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = FALSE;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            L"D:(A;;0x00100000;;;AU)(A;;GA;;;BA)(A;;GA;;;SY)",
+            SDDL_REVISION_1, &sa.lpSecurityDescriptor, nullptr)) {
+        if (m_pLogger) {
+            LOG_ERROR(m_pLogger, CatMirror, QString("ChangeNotifier: security descriptor failed: %1").arg(GetLastError()));
+        }
+        m_region.close();
+        return false;
+    }
+
+    for (int parity = 0; parity < 2; parity++) {
+        const std::wstring native = eventName(name, parity);
+        m_events[parity] = CreateEventW(&sa, TRUE, FALSE, native.c_str());
+        if (!m_events[parity]) {
+            if (m_pLogger) {
+                LOG_ERROR(m_pLogger, CatMirror, QString("ChangeNotifier: CreateEvent failed: %1").arg(GetLastError()));
+            }
+            LocalFree(sa.lpSecurityDescriptor);
+            close();
+            return false;
+        }
+    }
+    LocalFree(sa.lpSecurityDescriptor);
+#endif
+
+    m_pState = static_cast<State*>(m_region.data());
+    m_pState->sequence.store(0, std::memory_order_release);
+    return true;
+}
+
+bool ChangeNotifier::open(const QString& name)
+{
+    close();
+
+    if (!m_region.open(name, sizeof(State), SharedMemoryRegion::Access::ReadOnly)) {
+        return false;
+    }
+
+#ifdef Q_OS_WIN
+    for (int parity = 0; parity < 2; parity++) {
+        const std::wstring native = eventName(name, parity);
+        m_events[parity] = OpenEventW(SYNCHRONIZE, FALSE, native.c_str());
+        if (!m_events[parity]) {
+            if (m_pLogger) {
+                LOG_ERROR(m_pLogger, CatMirror, QString("ChangeNotifier: OpenEvent failed: %1").arg(GetLastError()));
+            }
+            close();
+            return false;
+        }
+    }
+#endif
+
+    m_pState = static_cast<State*>(m_region.data());
+    return true;
+}
+
+void ChangeNotifier::close()
+{
+#ifdef Q_OS_WIN
+    for (HANDLE& event : m_events) {
+        if (event) {
+            CloseHandle(event);
+            event = nullptr;
+        }
+    }
+#endif
+
+    m_pState = nullptr;
+    m_region.close();
+}
+
+quint32 ChangeNotifier::sequence() const
+{
+    return m_pState ? m_pState->sequence.load(std::memory_order_acquire) : 0;
+}
+
+void ChangeNotifier::notify()
+{
+    if (!m_pState) return;
+
+#ifdef Q_OS_WIN
+    // Waiters on the new value are released; the event for the value after
+    // it is cleared first so it cannot still be set from two changes ago
+    const quint32 next = m_pState->sequence.load(std::memory_order_relaxed) + 1;
+    ResetEvent(m_events[(next + 1) & 1]);
+    m_pState->sequence.store(next, std::memory_order_seq_cst);
+    SetEvent(m_events[next & 1]);
+#else
+    m_pState->sequence.fetch_add(1, std::memory_order_seq_cst);
+#ifdef Q_OS_LINUX
+    // Shared (not FUTEX_PRIVATE) - the waiters are in other processes
+    syscall(SYS_futex, reinterpret_cast<quint32*>(&m_pState->sequence), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+#endif
+}
+
+bool ChangeNotifier::wait(quint32 seen, int timeoutMs)
+{
+    if (!m_pState) return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (;;) {
+        if (m_pState->sequence.load(std::memory_order_acquire) != seen) {
+            return true;
+        }
+        const int remaining = timeoutMs - static_cast<int>(timer.elapsed());
+        if (remaining <= 0) {
+            return false;
+        }
+#ifdef Q_OS_WIN
+        // A parity event can be reset by a second notify before this waiter
+        // sees it, so recheck the sequence periodically
+        sleepOnce(seen, qMin(remaining, CHANGE_RECHECK_MS));
+#else
+        // The futex compares the sequence in the kernel and cannot miss a
+        // wake; the fallback polls on its own
+        sleepOnce(seen, remaining);
+#endif
+    }
+}
+
+bool ChangeNotifier::sleepOnce(quint32 seen, int timeoutMs)
+{
+#ifdef Q_OS_WIN
+    return WaitForSingleObject(m_events[(seen + 1) & 1], static_cast<DWORD>(timeoutMs)) == WAIT_OBJECT_0;
+#elif defined(Q_OS_LINUX)
+    // Returns at once if the sequence is no longer seen
+    struct timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+    return syscall(SYS_futex, reinterpret_cast<quint32*>(&m_pState->sequence), FUTEX_WAIT, seen, &ts, nullptr, 0) == 0;
+#else
+    for (int waited = 0; waited < timeoutMs && m_pState->sequence.load(std::memory_order_acquire) == seen;
+         waited += CHANGE_POLL_INTERVAL_MS) {
+        QThread::msleep(CHANGE_POLL_INTERVAL_MS);
+    }
+    return m_pState->sequence.load(std::memory_order_acquire) != seen;
+#endif
+}
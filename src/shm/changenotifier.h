@@ -0,0 +1,72 @@
+#ifndef CHANGENOTIFIER_H
+#define CHANGENOTIFIER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include "logger.h"
+#include "sharedmemoryregion.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+/**
+ * @brief ChangeNotifier - Cross-process "something changed" signal
+ *
+ * A small region holds a change counter that only the owner can write;
+ * clients map it read-only, so no client can disturb another's wakeups.
+ *
+ * Linux:   waiters sleep in FUTEX_WAIT on the shared counter and the owner
+ *          issues FUTEX_WAKE on every change (one syscall, no waiter bookkeeping).
+ * Windows: two manual-reset events, one per counter parity. A waiter that saw
+ *          sequence s sleeps on the event for s + 1; the owner resets the event
+ *          for the change after next, bumps the counter, then sets the event for
+ *          the new value. Clients only hold SYNCHRONIZE, so they can wait on the
+ *          events but not set, reset or consume them.
+ * Other:   short sleeps; correct but not zero-latency.
+ *
+ * Waits are sliced and the counter rechecked between slices, so a wakeup lost
+ * to a burst of changes costs at most CHANGE_RECHECK_MS. A stale wakeup is
+ * harmless: callers recheck their own state and wait again.
+ */
+class ChangeNotifier
+{
+public:
+    explicit ChangeNotifier(Logger* logger = nullptr);
+    ~ChangeNotifier();
+
+    bool create(const QString& name);   // Owner (signals)
+    bool open(const QString& name);     // Client (waits)
+    void close();
+
+    bool isValid() const { return m_pState != nullptr; }
+
+    quint32 sequence() const;
+
+    // Owner: record a change and wake every waiter
+    void notify();
+
+    // Sleep until sequence() moves past seen or timeoutMs passes.
+    // Returns true if the sequence changed.
+    bool wait(quint32 seen, int timeoutMs);
+
+private:
+    struct State {
+        std::atomic<quint32> sequence;
+    };
+
+    bool sleepOnce(quint32 seen, int timeoutMs);
+
+    Logger* m_pLogger;
+    SharedMemoryRegion m_region;
+    State* m_pState;
+
+#ifdef Q_OS_WIN
+    HANDLE m_events[2];             // Set when the sequence becomes even / odd
+#endif
+
+    Q_DISABLE_COPY(ChangeNotifier)
+};
+
+#endif // CHANGENOTIFIER_H
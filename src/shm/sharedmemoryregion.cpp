@@ -0,0 +1,332 @@
+#include "sharedmemoryregion.h"
+
+#ifdef Q_OS_WIN
+#include <sddl.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+SharedMemoryRegion::SharedMemoryRegion(Logger* logger)
+    : m_pLogger(logger)
+    , m_pData(nullptr)
+    , m_size(0)
+    , m_owner(false)
+#ifdef Q_OS_WIN
+    , m_handle(nullptr)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+SharedMemoryRegion::~SharedMemoryRegion()
+{
+    close();
+}
+
+QString SharedMemoryRegion::nativeName(const QString& name)
+{
+#ifdef Q_OS_WIN
+    return QStringLiteral("Global\\") + name;
+#else
+    return QStringLiteral("/") + name;
+#endif
+}
+
+void SharedMemoryRegion::fail(const QString& what)
+{
+#ifdef Q_OS_WIN
+    m_error = QString("%1 '%2': %3").arg(what, m_name).arg(GetLastError());
+#else
+    m_error = QString("%1 '%2': %3").arg(what, m_name, QString::fromLocal8Bit(strerror(errno)));
+#endif
+    if (m_pLogger) {
+        LOG_ERROR(m_pLogger, CatMirror, QString("SharedMemoryRegion: %1").arg(m_error));
+    }
+    close();
+}
+
+#ifdef Q_OS_WIN
+
+bool SharedMemoryRegion::create(const QString& name, qint64 size, bool clientWritable)
+{
+    // Authenticated Users read (and optionally write), Administrators and SYSTEM full access
+    return createSection(name, size, clientWritable
+                                         ? "D:(A;OICI;GRGW;;;AU)(A;OICI;GA;;;BA)(A;OICI;GA;;;SY)"
+                                         : "D:(A;OICI;GR;;;AU)(A;OICI;GA;;;BA)(A;OICI;GA;;;SY)");
+}
+
+bool SharedMemoryRegion::createPrivate(const QString& name, qint64 size, const RegionPeer& peer)
+{
+    if (peer.sid.isEmpty()) {
+        m_name = name;
+        SetLastError(ERROR_INVALID_SID);
+        fail("No peer SID for private region");
+        return false;
+    }
+
+    // Protected DACL: the peer's account reads, SYSTEM has full access, nothing is inherited
+    return createSection(name, size, QString("D:P(A;OICI;GR;;;%1)(A;OICI;GA;;;SY)").arg(peer.sid));
+}
+
+bool SharedMemoryRegion::createSection(const QString& name, qint64 size, const QString& sddl)
+{
+    close();
+    m_name = name;
+    m_owner = true;
+
+    SECURITY_ATTRIBUTES sa = {0};
+    sa.nLength = sizeof(SECURITY_ATTRIBUTES);
+    sa.bInheritHandle = FALSE;
+    const std::wstring sddlW = sddl.toStdWString();
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            sddlW.c_str(), SDDL_REVISION_1, &sa.lpSecurityDescriptor, nullptr)) {
+        fail("Failed to create security descriptor for");
+        return false;
+    }
+
+    const std::wstring native = nativeName(name).toStdWString();
+    m_handle = CreateFileMappingW(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE,
+                                  static_cast<DWORD>(static_cast<quint64>(size) >> 32),
+                                  static_cast<DWORD>(size & 0xFFFFFFFF),
+                                  native.c_str());
+    LocalFree(sa.lpSecurityDescriptor);
+
+    if (!m_handle) {
+        fail("Failed to create section");
+        return false;
+    }
+
+    m_pData = MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(size));
+    if (!m_pData) {
+        fail("Failed to map section");
+        return false;
+    }
+
+    m_size = size;
+    ZeroMemory(m_pData, static_cast<SIZE_T>(size));
+    return true;
+}
+
+bool SharedMemoryRegion::open(const QString& name, qint64 size, Access access)
+{
+    close();
+    m_name = name;
+    m_owner = false;
+
+    const DWORD mapAccess = (access == Access::ReadWrite) ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ;
+    const std::wstring native = nativeName(name).toStdWString();
+
+    m_handle = OpenFileMappingW(mapAccess, FALSE, native.c_str());
+    if (!m_handle) {
+        fail("Failed to open section");
+        return false;
+    }
+
+    m_pData = MapViewOfFile(m_handle, mapAccess, 0, 0, static_cast<SIZE_T>(size));
+    if (!m_pData) {
+        fail("Failed to map section");
+        return false;
+    }
+
+    m_size = size;
+    return true;
+}
+
+void SharedMemoryRegion::close()
+{
+    if (m_pData) {
+        UnmapViewOfFile(m_pData);
+        m_pData = nullptr;
+    }
+
+    if (m_handle) {
+        CloseHandle(m_handle);
+        m_handle = nullptr;
+    }
+
+    m_size = 0;
+    m_owner = false;
+}
+
+bool SharedMemoryRegion::peerFromSocket(qintptr descriptor, RegionPeer& peer)
+{
+    ULONG pid = 0;
+    if (!GetNamedPipeClientProcessId(reinterpret_cast<HANDLE>(descriptor), &pid)) {
+        return false;
+    }
+
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process) {
+        return false;
+    }
+
+    HANDLE token = nullptr;
+    const BOOL opened = OpenProcessToken(process, TOKEN_QUERY, &token);
+    CloseHandle(process);
+    if (!opened) {
+        return false;
+    }
+
+    DWORD needed = 0;
+    GetTokenInformation(token, TokenUser, nullptr, 0, &needed);
+    QByteArray buffer(static_cast<int>(needed), '\0');
+    bool ok = needed > 0 && GetTokenInformation(token, TokenUser, buffer.data(), needed, &needed);
+    CloseHandle(token);
+    if (!ok) {
+        return false;
+    }
+
+    LPWSTR sidString = nullptr;
+    ok = ConvertSidToStringSidW(reinterpret_cast<TOKEN_USER*>(buffer.data())->User.Sid, &sidString);
+    if (!ok) {
+        return false;
+    }
+    peer.sid = QString::fromWCharArray(sidString);
+    LocalFree(sidString);
+    return true;
+}
+
+#else // POSIX
+
+bool SharedMemoryRegion::create(const QString& name, qint64 size, bool clientWritable)
+{
+    return createShm(name, size, clientWritable ? 0666 : 0644, -1);
+}
+
+bool SharedMemoryRegion::createPrivate(const QString& name, qint64 size, const RegionPeer& peer)
+{
+    if (peer.uid < 0) {
+        m_name = name;
+        errno = EINVAL;
+        fail("No peer uid for private region");
+        return false;
+    }
+    return createShm(name, size, 0600, peer.uid);
+}
+
+bool SharedMemoryRegion::createShm(const QString& name, qint64 size, int mode, qint64 ownerUid)
+{
+    close();
+    m_name = name;
+
+    const QByteArray native = nativeName(name).toLocal8Bit();
+
+    // Replace any region left behind by a previous instance
+    shm_unlink(native.constData());
+
+    m_fd = shm_open(native.constData(), O_CREAT | O_EXCL | O_RDWR, static_cast<mode_t>(mode));
+    if (m_fd < 0) {
+        fail("shm_open failed for");
+        return false;
+    }
+    m_owner = true;
+
+    // The umask may have stripped bits from mode
+    fchmod(m_fd, static_cast<mode_t>(mode));
+
+    // Hand a private region to its peer; refuse to fall back to a region the peer cannot open
+    if (ownerUid >= 0 && static_cast<uid_t>(ownerUid) != geteuid()
+        && fchown(m_fd, static_cast<uid_t>(ownerUid), static_cast<gid_t>(-1)) != 0) {
+        fail("fchown failed for");
+        return false;
+    }
+
+    if (ftruncate(m_fd, static_cast<off_t>(size)) != 0) {
+        fail("ftruncate failed for");
+        return false;
+    }
+
+    void* p = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+        fail("mmap failed for");
+        return false;
+    }
+
+    // New shm objects are zero-filled
+    m_pData = p;
+    m_size = size;
+    return true;
+}
+
+bool SharedMemoryRegion::open(const QString& name, qint64 size, Access access)
+{
+    close();
+    m_name = name;
+    m_owner = false;
+
+    const QByteArray native = nativeName(name).toLocal8Bit();
+    const bool writable = (access == Access::ReadWrite);
+
+    m_fd = shm_open(native.constData(), writable ? O_RDWR : O_RDONLY, 0);
+    if (m_fd < 0) {
+        fail("shm_open failed for");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size < size) {
+        errno = EINVAL;
+        fail("Region too small:");
+        return false;
+    }
+
+    void* p = mmap(nullptr, static_cast<size_t>(size), writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                   MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+        fail("mmap failed for");
+        return false;
+    }
+
+    m_pData = p;
+    m_size = size;
+    return true;
+}
+
+void SharedMemoryRegion::close()
+{
+    if (m_pData) {
+        munmap(m_pData, static_cast<size_t>(m_size));
+        m_pData = nullptr;
+    }
+
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    if (m_owner) {
+        shm_unlink(nativeName(m_name).toLocal8Bit().constData());
+        m_owner = false;
+    }
+
+    m_size = 0;
+}
+
+bool SharedMemoryRegion::peerFromSocket(qintptr descriptor, RegionPeer& peer)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(static_cast<int>(descriptor), SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return false;
+    }
+    peer.uid = cred.uid;
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    if (getpeereid(static_cast<int>(descriptor), &uid, &gid) != 0) {
+        return false;
+    }
+    peer.uid = uid;
+#endif
+    return true;
+}
+
+#endif
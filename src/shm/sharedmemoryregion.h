@@ -0,0 +1,93 @@
+#ifndef SHAREDMEMORYREGION_H
+#define SHAREDMEMORYREGION_H
+
+#include <QString>
+#include <QtGlobal>
+#include "logger.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+// The one account besides the service that may map a private region
+struct RegionPeer {
+    QString sid;        // Windows: string SID of the client process's user
+    qint64 uid = -1;    // POSIX: effective uid of the client process
+};
+
+/**
+ * @brief SharedMemoryRegion - Named shared memory mapping
+ *
+ * Windows: section object via CreateFileMappingW/OpenFileMappingW in the
+ *          Global\ namespace, so user-session clients see the service's regions.
+ * POSIX:   shm_open + ftruncate + mmap; the creator unlinks the name on close.
+ *
+ * Names are given without a namespace prefix ("ECMemoryMirror"); nativeName()
+ * adds "Global\" or "/" as the platform needs.
+ *
+ * Shared regions (create) are readable by every authenticated user. Private
+ * regions (createPrivate) carry data for one client: only that client's
+ * account can read them, so the name alone grants nothing.
+ */
+class SharedMemoryRegion
+{
+public:
+    enum class Access {
+        ReadOnly,
+        ReadWrite
+    };
+
+    explicit SharedMemoryRegion(Logger* logger = nullptr);
+    ~SharedMemoryRegion();
+
+    // Create and map a region owned by this process. Other users get read
+    // access, plus write access when clientWritable is set.
+    bool create(const QString& name, qint64 size, bool clientWritable = false);
+
+    // Create and map a region only peer (read) and the service can open.
+    // Windows: DACL with the peer's SID and SYSTEM. POSIX: mode 0600 owned by peer.uid.
+    bool createPrivate(const QString& name, qint64 size, const RegionPeer& peer);
+
+    // Map an existing region created by another process
+    bool open(const QString& name, qint64 size, Access access = Access::ReadOnly);
+
+    void close();
+
+    bool isValid() const { return m_pData != nullptr; }
+    void* data() { return m_pData; }
+    const void* constData() const { return m_pData; }
+    qint64 size() const { return m_size; }
+    QString name() const { return m_name; }
+    QString errorString() const { return m_error; }
+
+    static QString nativeName(const QString& name);
+
+    // Identify the client process on the other end of a local socket
+    // (QLocalSocket::socketDescriptor(): pipe handle on Windows, Unix socket elsewhere)
+    static bool peerFromSocket(qintptr descriptor, RegionPeer& peer);
+
+private:
+    void fail(const QString& what);
+#ifdef Q_OS_WIN
+    bool createSection(const QString& name, qint64 size, const QString& sddl);
+#else
+    bool createShm(const QString& name, qint64 size, int mode, qint64 ownerUid);
+#endif
+
+    Logger* m_pLogger;
+    QString m_name;
+    QString m_error;
+    void* m_pData;
+    qint64 m_size;
+    bool m_owner;
+
+#ifdef Q_OS_WIN
+    HANDLE m_handle;
+#else
+    int m_fd;
+#endif
+
+    Q_DISABLE_COPY(SharedMemoryRegion)
+};
+
+#endif // SHAREDMEMORYREGION_H
@@ -1,6 +1,8 @@
 #include "WindowsService.h"
 #include <QCoreApplication>
 #include <QDebug>
+#include <QSettings>
+#include "appresource.h"
 #include <memory>
 
 WindowsService* g_service = nullptr;
@@ -12,12 +14,14 @@ WindowsService::WindowsService(const QString &serviceName, QObject *parent)
     m_serviceStatusHandle(nullptr),
     m_running(false),
     m_shuttingDown(false),
-    m_logger("C:\\ProgramData\\Patrol PC\\Service", this),
+    m_logger("C:\\ProgramData\\Patrol PC\\Service", this, Logger::Async, Logger::BinaryFile),
     m_commandProc(&m_logger),
     m_pipeServer(nullptr),
     m_secureHandler(nullptr),
+    m_notificationHub(nullptr),
     m_monitor(nullptr),
-    m_ecMemoryWriter(nullptr),
+    m_mirrorProducer(nullptr),
+    m_telemetrySampler(nullptr),
     m_shutdownTimer(nullptr)
 {
     m_serviceStatus.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
@@ -33,11 +37,15 @@ WindowsService::WindowsService(const QString &serviceName, QObject *parent)
         m_logger.log("WARNING: Multiple WindowsService instances - replacing global pointer");
     }
     g_service = this;
+
+    // Whatever is still queued in the async logger reaches disk on a crash
+    Logger::installCrashHandler(&m_logger);
 }
 
 WindowsService::~WindowsService()
 {
     cleanup();
+    Logger::installCrashHandler(nullptr);
 
     QMutexLocker locker(&s_globalMutex);
     if (g_service == this) {
@@ -134,6 +142,15 @@ bool WindowsService::initializeService()
 
     // Create Secure Command Handler
     m_secureHandler = new SecureCommandHandlerV2(&m_logger, &m_commandProc, this);
+    connect(m_secureHandler, &SecureCommandHandler::deferredResponse,
+            this, &WindowsService::onDeferredResponse);
+
+    // Push channel for CSMonitor - replaces PollActionCommands for subscribed clients
+    m_notificationHub = new NotificationHub(&m_logger, this);
+    m_secureHandler->setNotificationHub(m_notificationHub);
+    m_commandProc.setNotificationHub(m_notificationHub);
+    connect(m_notificationHub, &NotificationHub::notificationReady,
+            this, &WindowsService::onNotificationReady);
     if(!m_commandProc.initializeEc(0x220)) {  // Note the ! (NOT) operator
         m_logger.log("Failed to initialize ec, continuing without EC", Logger::Warning);
     } else {
@@ -157,25 +174,57 @@ bool WindowsService::initializeService()
                                  Logger::Info);
                 });
 
-        m_bezelMonitor->start(50);  // 50ms poll = responsive button detection
+        connect(m_bezelMonitor, &BezelMonitor::bezelPresenceChanged,
+                m_notificationHub, &NotificationHub::publishBezelPresence);
+
+        m_bezelMonitor->start();    // Adaptive: 10ms after activity, 50ms idle, 2s without a bezel
+        m_secureHandler->setBezelMonitor(m_bezelMonitor);
+
+        // Shared EC mirror - clients read EC state from mapped memory
+        m_mirrorProducer = new EcMirrorProducer(m_commandProc.getEcManager(), &m_logger, this);
+        m_mirrorProducer->addDefaultRegions();
+        if (m_mirrorProducer->start()) {
+            m_secureHandler->setMirrorProducer(m_mirrorProducer);
+        } else {
+            m_logger.log("Failed to start EC mirror producer", Logger::Warning);
+            // Non-fatal, continue
+        }
+
+        // Battery/thermal history for dashboards, shared with all clients
+        m_telemetrySampler = new TelemetrySampler(m_commandProc.getEcManager(), &m_logger, this);
+        if (!m_telemetrySampler->start()) {
+            m_logger.log("Failed to start telemetry sampler", Logger::Warning);
+            // Non-fatal, continue
+        }
     }
-    // Create and initialize pipe server
+    // Create pipe server and register its endpoints
     m_pipeServer = new NamedPipeServer(&m_logger, this);
 
+    PipeConfig controlScreens;
+    controlScreens.name = PIPE_CONTROL_SCREENS;
+    controlScreens.label = "ControlScreens";
+    controlScreens.maxClients = 5;
+    controlScreens.handler = [this](const QByteArray& data, QLocalSocket* client) {
+        onControlScreensCommand(data, client);
+    };
+    m_pipeServer->registerPipe(PipeType::ControlScreens, controlScreens);
+
+    PipeConfig csMonitor;
+    csMonitor.name = PIPE_CSMONITOR;
+    csMonitor.label = "CSMonitor";
+    csMonitor.maxClients = 10;
+    csMonitor.handler = [this](const QByteArray& data, QLocalSocket* client) {
+        onCSMonitorCommand(data, client);
+    };
+    m_pipeServer->registerPipe(PipeType::CSMonitor, csMonitor);
+    m_pipeServer->setOutboundLimits(loadOutboundLimits());
+    m_secureHandler->setPipeServer(m_pipeServer);
+
     if (!m_pipeServer->initialize()) {
         m_logger.log("Failed to initialize pipe server", Logger::Error);
         return false;
     }
 
-
-
-    // Connect pipe-specific command signals
-    connect(m_pipeServer, &NamedPipeServer::controlScreensCommandReceived,
-            this, &WindowsService::onControlScreensCommand, Qt::DirectConnection);
-
-    connect(m_pipeServer, &NamedPipeServer::csMonitorCommandReceived,
-            this, &WindowsService::onCSMonitorCommand, Qt::DirectConnection);
-
     // Connect client connection/disconnection signals
     connect(m_pipeServer, &NamedPipeServer::clientConnected,
             this, &WindowsService::onClientConnected, Qt::DirectConnection);
@@ -190,21 +239,16 @@ bool WindowsService::initializeService()
                                  .arg(static_cast<int>(type)).arg(error), Logger::Error);
             }, Qt::DirectConnection);
 
-    // Start both pipes
+    // Start all registered pipes
     if (!m_pipeServer->startAll()) {
         m_logger.log("Failed to start all pipes - some may be running", Logger::Warning);
     }
 
-    m_logger.log(QString("Pipe status - ControlScreens: %1, CSMonitor: %2")
-                     .arg(m_pipeServer->isControlScreensRunning() ? "Running" : "Stopped")
-                     .arg(m_pipeServer->isCSMonitorRunning() ? "Running" : "Stopped"));
-
-    // Create EC Memory Writer
-    /*m_ecMemoryWriter = new ECMemoryWriter(&m_logger, this);
-    if (!m_ecMemoryWriter->create()) {
-        m_logger.log("Failed to create EC memory writer", Logger::Warning);
-        // Non-fatal, continue
-    }*/
+    for (PipeType type : m_pipeServer->registeredPipes()) {
+        m_logger.log(QString("Pipe status - %1: %2")
+                         .arg(m_pipeServer->pipeLabel(type))
+                         .arg(m_pipeServer->isPipeRunning(type) ? "Running" : "Stopped"));
+    }
 
     // Start Monitors
     m_monitor = new Monitor(&m_logger);
@@ -217,6 +261,37 @@ bool WindowsService::initializeService()
     m_logger.log("All service components initialized successfully");
     return true;
 }
+
+OutboundLimits WindowsService::loadOutboundLimits()
+{
+    // Missing or invalid values keep the defaults from OutboundLimits
+    OutboundLimits limits;
+    QSettings settings(QSettings::NativeFormat, QSettings::SystemScope, APP_ORGANIZATION_NAME, SERVICE_SETTINGS_NAME);
+    settings.beginGroup("Pipes");
+
+    bool ok = false;
+    const qint64 maxQueued = settings.value("OutboundMaxQueuedBytes").toLongLong(&ok);
+    if (ok && maxQueued > 0) {
+        limits.maxQueuedBytes = maxQueued;
+    }
+    const qint64 highWater = settings.value("OutboundSocketHighWater").toLongLong(&ok);
+    if (ok && highWater > 0) {
+        limits.socketHighWater = highWater;
+    }
+    const QString policy = settings.value("SlowConsumerPolicy").toString().toLower();
+    if (policy == "disconnect") {
+        limits.policy = SlowConsumerPolicy::Disconnect;
+    } else if (policy == "drop" || policy == "drop_oldest_push") {
+        limits.policy = SlowConsumerPolicy::DropOldestPush;
+    }
+
+    m_logger.log(QString("Pipe outbound limits: %1 bytes per client, socket high water %2, %3 for slow consumers")
+                     .arg(limits.maxQueuedBytes).arg(limits.socketHighWater)
+                     .arg(limits.policy == SlowConsumerPolicy::Disconnect ? "disconnect" : "drop oldest push"),
+                 Logger::Info);
+    return limits;
+}
+
 void WindowsService::clearEcState() {
     m_logger.log("Clearing any stale EC state...", Logger::Info);
 
@@ -298,7 +373,7 @@ void WindowsService::onControlScreensCommand(const QByteArray& data, QLocalSocke
         m_pipeServer->sendResponse(client, response);
         m_logger.log(QString("Sent ControlScreens response: %1 bytes").arg(response.size()));
     } else {
-        m_logger.log("No response for ControlScreens command (auth failed or invalid)");
+        m_logger.log("No immediate response for ControlScreens command (deferred, auth failed or invalid)");
     }
 }
 
@@ -321,24 +396,51 @@ void WindowsService::onCSMonitorCommand(const QByteArray& data, QLocalSocket* cl
         m_pipeServer->sendResponse(client, response);
         m_logger.log(QString("Sent CSMonitor response: %1 bytes").arg(response.size()));
     } else {
-        m_logger.log("No response for CSMonitor command (auth failed or invalid)");
+        m_logger.log("No immediate response for CSMonitor command (deferred, auth failed or invalid)");
     }
 }
 
+void WindowsService::onDeferredResponse(QLocalSocket* client, const QByteArray& packet)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_shuttingDown || !m_pipeServer) {
+        return;
+    }
+
+    // Stale client pointers are rejected by the pipe server
+    m_pipeServer->sendResponse(client, packet);
+    m_logger.log(QString("Sent deferred response: %1 bytes").arg(packet.size()));
+}
+
 void WindowsService::onClientConnected(PipeType pipeType, QLocalSocket* client)
 {
-    QString pipeName = (pipeType == PipeType::ControlScreens) ? "ControlScreens" : "CSMonitor";
+    QString pipeName = m_pipeServer->pipeLabel(pipeType);
     m_logger.log(QString("Client connected to %1 pipe - registering with secure handler").arg(pipeName));
-    m_secureHandler->registerClient(client);
+    m_secureHandler->registerClient(client, pipeType);
 }
 
 void WindowsService::onClientDisconnected(PipeType pipeType, QLocalSocket* client)
 {
-    QString pipeName = (pipeType == PipeType::ControlScreens) ? "ControlScreens" : "CSMonitor";
+    QString pipeName = m_pipeServer->pipeLabel(pipeType);
     m_logger.log(QString("Client disconnected from %1 pipe - unregistering").arg(pipeName));
     m_secureHandler->unregisterClient(client);
 }
 
+void WindowsService::onNotificationReady(QLocalSocket* client, const QByteArray& payload)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_shuttingDown || !m_pipeServer || !m_secureHandler) {
+        return;
+    }
+
+    QByteArray packet = m_secureHandler->buildPushPacket(client, payload);
+    if (!packet.isEmpty()) {
+        m_pipeServer->sendPush(client, packet);
+    }
+}
+
 // ============================================================================
 // Cleanup and Shutdown
 // ============================================================================
@@ -355,6 +457,9 @@ void WindowsService::cleanup()
         m_shutdownTimer = nullptr;
     }
     if (m_bezelMonitor) {
+        if (m_secureHandler) {
+            m_secureHandler->setBezelMonitor(nullptr);
+        }
         m_bezelMonitor->stop();
         delete m_bezelMonitor;
         m_bezelMonitor = nullptr;
@@ -370,10 +475,22 @@ void WindowsService::cleanup()
         m_secureHandler = nullptr;
     }
 
-    if (m_ecMemoryWriter) {
-        m_ecMemoryWriter->close();
-        delete m_ecMemoryWriter;
-        m_ecMemoryWriter = nullptr;
+    if (m_notificationHub) {
+        m_commandProc.setNotificationHub(nullptr);
+        delete m_notificationHub;
+        m_notificationHub = nullptr;
+    }
+
+    if (m_telemetrySampler) {
+        m_telemetrySampler->stop();
+        delete m_telemetrySampler;
+        m_telemetrySampler = nullptr;
+    }
+
+    if (m_mirrorProducer) {
+        m_mirrorProducer->stop();
+        delete m_mirrorProducer;
+        m_mirrorProducer = nullptr;
     }
 
     if (m_monitor) {
@@ -10,12 +10,17 @@
 #include "namedpipeserver.h"
 #include "commandproc.h"
 #include "monitor.h"
-#include "ecmemorymirror.h"
+#include "mirror/ecmirrorproducer.h"
+#include "mirror/telemetrysampler.h"
 #include "securecommandhandler.h"
 #include "bezel.h"
+#include "notify/notificationhub.h"
 
 #define SHUTDOWN_TIMEOUT_MS 10000
 
+// Service settings: HKLM\Software\Patrol PC\Service
+#define SERVICE_SETTINGS_NAME   "Service"
+
 class WindowsService : public QObject
 {
     Q_OBJECT
@@ -44,11 +49,14 @@ private slots:
     void onCSMonitorCommand(const QByteArray& data, QLocalSocket* client);
     void onClientConnected(PipeType pipeType, QLocalSocket* client);
     void onClientDisconnected(PipeType pipeType, QLocalSocket* client);
+    void onNotificationReady(QLocalSocket* client, const QByteArray& payload);
+    void onDeferredResponse(QLocalSocket* client, const QByteArray& packet);
 
 private:
     void setServiceStatus(DWORD currentState, DWORD win32ExitCode = NO_ERROR, DWORD waitHint = 0);
     void cleanup();
     bool initializeService();
+    OutboundLimits loadOutboundLimits();
 
     QString m_serviceName;
     SERVICE_STATUS_HANDLE m_serviceStatusHandle;
@@ -62,9 +70,11 @@ private:
     CommandProc m_commandProc;
     NamedPipeServer* m_pipeServer;
     SecureCommandHandler* m_secureHandler;  // Changed type name
+    NotificationHub* m_notificationHub;
     BezelMonitor* m_bezelMonitor;
     Monitor* m_monitor;
-    ECMemoryWriter* m_ecMemoryWriter;
+    EcMirrorProducer* m_mirrorProducer;
+    TelemetrySampler* m_telemetrySampler;
     QTimer* m_shutdownTimer;
 
     static QMutex s_globalMutex;
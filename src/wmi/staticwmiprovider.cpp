@@ -0,0 +1,54 @@
+#include "staticwmiprovider.h"
+#include <QThread>
+
+void StaticWmiProvider::setRows(const QString& namespacePath, const QString& className, const WmiRows& rows)
+{
+    QMutexLocker locker(&m_mutex);
+    m_rows.insert(key(namespacePath, className), rows);
+}
+
+bool StaticWmiProvider::query(const QString& namespacePath,
+                              const QString& query,
+                              WmiRows& results,
+                              const QString& property,
+                              int maxRows)
+{
+    m_calls.fetch_add(1, std::memory_order_relaxed);
+
+    const int latencyMs = m_latencyMs.load(std::memory_order_relaxed);
+    if (latencyMs > 0) {
+        QThread::msleep(static_cast<unsigned long>(latencyMs));
+    }
+
+    const QString className = queryClass(query);
+    if (className.isEmpty()) {
+        return false;       // Same as WMI rejecting the query
+    }
+
+    WmiRows rows;
+    {
+        QMutexLocker locker(&m_mutex);
+        rows = m_rows.value(key(namespacePath, className));
+    }
+
+    const int firstRow = results.size();
+    for (const WmiRow& row : rows) {
+        if (results.size() - firstRow >= maxRows) {
+            break;
+        }
+        if (property.isEmpty()) {
+            results.append(row);
+        } else if (row.contains(property)) {
+            WmiRow reduced;
+            reduced.insert(property, row.value(property));
+            results.append(reduced);
+        }
+    }
+    return true;
+}
+
+QString StaticWmiProvider::key(const QString& namespacePath, const QString& className)
+{
+    // Namespaces and class names are case-insensitive in WMI
+    return namespacePath.toLower() + QLatin1Char('\n') + className.toLower();
+}
@@ -0,0 +1,45 @@
+#ifndef STATICWMIPROVIDER_H
+#define STATICWMIPROVIDER_H
+
+#include <QHash>
+#include <QMutex>
+#include <atomic>
+#include "wmiprovider.h"
+
+/**
+ * @brief StaticWmiProvider - Canned WMI results for machines without WMI
+ *
+ * Rows are registered per namespace and class; a query returns the rows of
+ * the class named in its FROM clause (no WHERE evaluation), reduced to the
+ * requested property. A configurable delay stands in for the 50-500 ms a
+ * real query takes, so caching and concurrency can be measured.
+ */
+class StaticWmiProvider : public WmiProvider
+{
+public:
+    StaticWmiProvider() = default;
+
+    void setRows(const QString& namespacePath, const QString& className, const WmiRows& rows);
+    void setLatencyMs(int ms) { m_latencyMs.store(ms, std::memory_order_relaxed); }
+
+    // Queries that reached the provider
+    quint64 callCount() const { return m_calls.load(std::memory_order_relaxed); }
+
+    bool query(const QString& namespacePath,
+               const QString& query,
+               WmiRows& results,
+               const QString& property = QString(),
+               int maxRows = WMI_MAX_RESULT_ROWS) override;
+
+private:
+    static QString key(const QString& namespacePath, const QString& className);
+
+    mutable QMutex m_mutex;
+    QHash<QString, WmiRows> m_rows;
+    std::atomic<int> m_latencyMs{0};
+    std::atomic<quint64> m_calls{0};
+
+    Q_DISABLE_COPY(StaticWmiProvider)
+};
+
+#endif // STATICWMIPROVIDER_H
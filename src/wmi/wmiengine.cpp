@@ -0,0 +1,282 @@
+#include "wmiengine.h"
+#include <QDeadlineTimer>
+#include <QThread>
+
+WmiEngine::WmiEngine(WmiProvider* backend, Logger* logger, int workers)
+    : m_pBackend(backend)
+    , m_pLogger(logger)
+    , m_workerCount(qBound(1, workers, WMI_ENGINE_MAX_WORKERS))
+    , m_maxRows(WMI_MAX_RESULT_ROWS)
+    , m_timeoutMs(WMI_ENGINE_QUERY_TIMEOUT_MS)
+    , m_starting(0)
+    , m_running(false)
+    , m_stopping(false)
+{
+}
+
+WmiEngine::~WmiEngine()
+{
+    stop();
+}
+
+bool WmiEngine::start()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_running || !m_pBackend) {
+        return m_running;
+    }
+
+    m_stopping = false;
+    m_stats.workers = 0;
+    m_starting = m_workerCount;
+    for (int i = 0; i < m_workerCount; i++) {
+        QThread* thread = QThread::create([this]() { workerLoop(); });
+        thread->setObjectName(QString("WmiWorker%1").arg(i));
+        m_threads.append(thread);
+        thread->start();
+    }
+
+    while (m_starting > 0) {
+        m_workerStarted.wait(&m_mutex);
+    }
+    m_running = m_stats.workers > 0;
+
+    if (m_running) {
+        LOG_INFO(m_pLogger, CatWmi, QString("Engine started with %1 workers").arg(m_stats.workers));
+    } else {
+        LOG_ERROR(m_pLogger, CatWmi, "Engine failed to start: no worker could attach");
+    }
+
+    const bool running = m_running;
+    if (!running) {
+        locker.unlock();
+        stop();
+    }
+    return running;
+}
+
+void WmiEngine::stop()
+{
+    QList<QThread*> threads;
+    QList<QSharedPointer<Job>> orphaned;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_threads.isEmpty()) {
+            return;
+        }
+        m_stopping = true;
+        m_running = false;
+
+        // Callers still waiting in the queue get a failure now rather than at their timeout
+        while (!m_queue.isEmpty()) {
+            QSharedPointer<Job> job = m_queue.dequeue();
+            if (job->callback) {
+                orphaned.append(job);
+            } else {
+                job->finished = true;
+                job->done.wakeAll();
+            }
+        }
+        m_stats.queued = 0;
+
+        threads.swap(m_threads);
+        m_jobReady.wakeAll();
+    }
+
+    for (const QSharedPointer<Job>& job : orphaned) {
+        job->callback(false, WmiRows());
+    }
+
+    for (QThread* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_stats.workers = 0;
+}
+
+bool WmiEngine::isRunning() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_running;
+}
+
+void WmiEngine::setWorkerCount(int workers)
+{
+    QMutexLocker locker(&m_mutex);
+    m_workerCount = qBound(1, workers, WMI_ENGINE_MAX_WORKERS);
+}
+
+void WmiEngine::setMaxRows(int rows)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxRows = qMax(1, rows);
+}
+
+void WmiEngine::setQueryTimeoutMs(int ms)
+{
+    QMutexLocker locker(&m_mutex);
+    m_timeoutMs = qMax(1, ms);
+}
+
+bool WmiEngine::query(const QString& namespacePath,
+                      const QString& query,
+                      WmiRows& results,
+                      const QString& property,
+                      int maxRows)
+{
+    QSharedPointer<Job> job = QSharedPointer<Job>::create();
+    job->namespacePath = namespacePath;
+    job->query = query;
+    job->property = property;
+    job->maxRows = qMax(1, maxRows);
+
+    QMutexLocker locker(&m_mutex);
+    if (!enqueue(job)) {
+        return false;
+    }
+
+    QDeadlineTimer deadline(m_timeoutMs);
+    while (!job->finished && !deadline.hasExpired()) {
+        job->done.wait(&m_mutex, deadline);
+    }
+
+    if (!job->finished) {
+        // Still queued: drop it. Running: the worker discards the result.
+        job->abandoned = true;
+        m_queue.removeOne(job);
+        m_stats.queued = m_queue.size();
+        m_stats.timedOut++;
+        LOG_WARNING(m_pLogger, CatWmi, QString("Query timed out after %1 ms: %2").arg(m_timeoutMs).arg(query));
+        return false;
+    }
+
+    if (!job->ok) {
+        return false;
+    }
+    results += job->rows;
+    return true;
+}
+
+void WmiEngine::queryAsync(const QString& namespacePath,
+                           const QString& query,
+                           const QString& property,
+                           int maxRows,
+                           WmiQueryCallback done)
+{
+    QSharedPointer<Job> job = QSharedPointer<Job>::create();
+    job->namespacePath = namespacePath;
+    job->query = query;
+    job->property = property;
+    job->maxRows = qMax(1, maxRows);
+    job->callback = std::move(done);
+
+    QMutexLocker locker(&m_mutex);
+    if (!enqueue(job)) {
+        locker.unlock();
+        job->callback(false, WmiRows());
+    }
+}
+
+bool WmiEngine::enqueue(const QSharedPointer<Job>& job)
+{
+    if (!m_running) {
+        m_stats.rejected++;
+        LOG_WARNING(m_pLogger, CatWmi, QString("Engine not running, query rejected: %1").arg(job->query));
+        return false;
+    }
+    if (m_queue.size() >= WMI_ENGINE_MAX_QUEUED) {
+        m_stats.rejected++;
+        LOG_WARNING(m_pLogger, CatWmi, QString("Engine queue full, query rejected: %1").arg(job->query));
+        return false;
+    }
+
+    m_queue.enqueue(job);
+    m_stats.queued = m_queue.size();
+    m_stats.peakQueued = qMax(m_stats.peakQueued, m_stats.queued);
+    m_jobReady.wakeOne();
+    return true;
+}
+
+WmiEngineStats WmiEngine::stats(bool reset)
+{
+    QMutexLocker locker(&m_mutex);
+    WmiEngineStats current = m_stats;
+    if (reset) {
+        m_stats.peakQueued = m_stats.queued;
+        m_stats.completed = 0;
+        m_stats.failures = 0;
+        m_stats.rejected = 0;
+        m_stats.timedOut = 0;
+        m_stats.truncated = 0;
+    }
+    return current;
+}
+
+void WmiEngine::workerLoop()
+{
+    const bool attached = m_pBackend->attachThread();
+
+    QMutexLocker locker(&m_mutex);
+    if (attached) {
+        m_stats.workers++;
+    } else {
+        LOG_ERROR(m_pLogger, CatWmi, QString("%1 could not attach to the WMI backend")
+                                         .arg(QThread::currentThread()->objectName()));
+    }
+    m_starting--;
+    m_workerStarted.wakeAll();
+    if (!attached) {
+        return;
+    }
+
+    for (;;) {
+        while (m_queue.isEmpty() && !m_stopping) {
+            m_jobReady.wait(&m_mutex);
+        }
+        if (m_stopping) {
+            break;
+        }
+
+        QSharedPointer<Job> job = m_queue.dequeue();
+        m_stats.queued = m_queue.size();
+        m_stats.busy++;
+        const int maxRows = qMin(job->maxRows, m_maxRows);
+        locker.unlock();
+
+        // One row past the limit tells a cut result from one that fits exactly
+        WmiRows rows;
+        const bool ok = m_pBackend->query(job->namespacePath, job->query, rows, job->property, maxRows + 1);
+        const bool truncated = rows.size() > maxRows;
+        if (truncated) {
+            LOG_WARNING(m_pLogger, CatWmi, QString("Query has more than %1 rows, keeping the first %1: %2")
+                                               .arg(maxRows).arg(job->query));
+            rows.resize(maxRows);
+        }
+
+        locker.relock();
+        m_stats.busy--;
+        m_stats.completed++;
+        if (!ok) {
+            m_stats.failures++;
+        }
+        if (truncated) {
+            m_stats.truncated++;
+        }
+        if (job->callback) {
+            // Outside the lock: the callback may queue the next query
+            locker.unlock();
+            job->callback(ok, ok ? rows : WmiRows());
+            locker.relock();
+        } else if (!job->abandoned) {
+            job->ok = ok;
+            job->rows = std::move(rows);
+            job->finished = true;
+            job->done.wakeAll();
+        }
+    }
+
+    locker.unlock();
+    m_pBackend->detachThread();
+}
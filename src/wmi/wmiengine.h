@@ -0,0 +1,113 @@
+#ifndef WMIENGINE_H
+#define WMIENGINE_H
+
+#include <QList>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include "wmiprovider.h"
+#include "logger.h"
+
+class QThread;
+
+#define WMI_ENGINE_WORKERS              2       // Queries WMI runs at once
+#define WMI_ENGINE_MAX_WORKERS          8
+#define WMI_ENGINE_MAX_QUEUED           64      // Queries waiting for a worker; more are rejected
+#define WMI_ENGINE_QUERY_TIMEOUT_MS     60000   // Caller gives up; the worker finishes and discards
+
+struct WmiEngineStats {
+    int workers = 0;            // Attached to the backend
+    int busy = 0;
+    int queued = 0;
+    int peakQueued = 0;
+    quint64 completed = 0;
+    quint64 failures = 0;
+    quint64 rejected = 0;       // Queue full or engine stopped
+    quint64 timedOut = 0;
+    quint64 truncated = 0;      // Results cut at the row limit
+};
+
+/**
+ * @brief WmiEngine - Runs WMI queries on a fixed set of worker threads
+ *
+ * COM objects are tied to the apartment that created them, and the threads
+ * calling query() (pipe workers, the service thread) may be in any of them
+ * or none. The engine owns its own workers, attaches each to the backend
+ * once (joining the MTA for WmiAccess) and hands queries to them, so the
+ * number of queries running against WMI is the worker count regardless of
+ * how many clients ask.
+ *
+ * query() blocks until the query finishes or the timeout passes. A query
+ * that times out is dropped from the queue, or finished and discarded if a
+ * worker already has it. queryAsync() returns at once and calls back from
+ * the worker that ran the query (or from the caller if it is rejected), so
+ * the pipe thread never waits on WMI. The row limit is passed down to the backend, which
+ * stops enumerating there.
+ */
+class WmiEngine : public WmiProvider
+{
+public:
+    explicit WmiEngine(WmiProvider* backend, Logger* logger = nullptr, int workers = WMI_ENGINE_WORKERS);
+    ~WmiEngine() override;
+
+    // False if no worker could attach to the backend
+    bool start();
+    void stop();
+    bool isRunning() const;
+
+    // Worker count takes effect on the next start()
+    void setWorkerCount(int workers);
+    void setMaxRows(int rows);
+    void setQueryTimeoutMs(int ms);
+
+    bool query(const QString& namespacePath,
+               const QString& query,
+               WmiRows& results,
+               const QString& property = QString(),
+               int maxRows = WMI_MAX_RESULT_ROWS) override;
+
+    void queryAsync(const QString& namespacePath,
+                    const QString& query,
+                    const QString& property,
+                    int maxRows,
+                    WmiQueryCallback done) override;
+
+    WmiEngineStats stats(bool reset = false);
+
+private:
+    struct Job {
+        QString namespacePath;
+        QString query;
+        QString property;
+        int maxRows = WMI_MAX_RESULT_ROWS;
+        WmiRows rows;
+        QWaitCondition done;
+        bool finished = false;
+        bool abandoned = false;     // Caller timed out
+        bool ok = false;
+        WmiQueryCallback callback;  // queryAsync(): called instead of waking a caller
+    };
+
+    bool enqueue(const QSharedPointer<Job>& job);     // Caller holds m_mutex
+    void workerLoop();
+
+    WmiProvider* m_pBackend;
+    Logger* m_pLogger;
+    mutable QMutex m_mutex;
+    QWaitCondition m_jobReady;
+    QWaitCondition m_workerStarted;
+    QQueue<QSharedPointer<Job>> m_queue;
+    QList<QThread*> m_threads;
+    int m_workerCount;
+    int m_maxRows;
+    int m_timeoutMs;
+    int m_starting;                 // Workers that have not reported attach yet
+    bool m_running;
+    bool m_stopping;
+    WmiEngineStats m_stats;
+
+    Q_DISABLE_COPY(WmiEngine)
+};
+
+#endif // WMIENGINE_H
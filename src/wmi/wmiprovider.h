@@ -0,0 +1,69 @@
+#ifndef WMIPROVIDER_H
+#define WMIPROVIDER_H
+
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <QMap>
+#include <QRegularExpression>
+#include <functional>
+
+using WmiRow = QMap<QString, QVariant>;
+using WmiRows = QVector<WmiRow>;
+
+// Completion of an asynchronous query; rows is empty when ok is false
+using WmiQueryCallback = std::function<void(bool ok, const WmiRows& rows)>;
+
+#define WMI_MAX_RESULT_ROWS     4096    // Default rows kept per query
+
+/**
+ * @brief WmiProvider - Source of WMI query results
+ *
+ * WmiAccess talks to the WMI service; StaticWmiProvider serves canned rows
+ * so the layers above it (WmiEngine, WmiQueryCache) run on machines without
+ * WMI. query() may be called from several threads at once; a thread calls
+ * attachThread() before its first query and detachThread() when done.
+ */
+class WmiProvider
+{
+public:
+    virtual ~WmiProvider() = default;
+
+    // Returns all properties if property is empty. Appends at most maxRows
+    // rows and stops enumerating there, so large result sets are not read
+    // only to be thrown away.
+    virtual bool query(const QString& namespacePath,
+                       const QString& query,
+                       WmiRows& results,
+                       const QString& property = QString(),
+                       int maxRows = WMI_MAX_RESULT_ROWS) = 0;
+
+    // Runs the query and hands the result to done. The default runs it on
+    // the calling thread; WmiEngine queues it and calls done from a worker.
+    virtual void queryAsync(const QString& namespacePath,
+                            const QString& query,
+                            const QString& property,
+                            int maxRows,
+                            WmiQueryCallback done)
+    {
+        WmiRows rows;
+        const bool ok = this->query(namespacePath, query, rows, property, maxRows);
+        done(ok, ok ? rows : WmiRows());
+    }
+
+    // Per-thread setup and teardown (COM apartment membership for WmiAccess)
+    virtual bool attachThread() { return true; }
+    virtual void detachThread() {}
+
+    // Class a WQL query reads ("SELECT * FROM Win32_Battery" -> "Win32_Battery"),
+    // empty if there is no FROM clause
+    static QString queryClass(const QString& query)
+    {
+        static const QRegularExpression fromClause(QStringLiteral("\\bFROM\\s+(\\w+)"),
+                                                   QRegularExpression::CaseInsensitiveOption);
+        const QRegularExpressionMatch match = fromClause.match(query);
+        return match.hasMatch() ? match.captured(1) : QString();
+    }
+};
+
+#endif // WMIPROVIDER_H
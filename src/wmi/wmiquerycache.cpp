@@ -0,0 +1,296 @@
+#include "wmiquerycache.h"
+#include <QDeadlineTimer>
+
+namespace {
+
+// Collapse whitespace runs to one space, except inside '...' or "..." WQL
+// literals (backslash escapes the next character there), so queries that
+// differ only in layout share an entry but WHERE values stay exact
+QString normalizeQuery(const QString& query)
+{
+    QString out;
+    out.reserve(query.size());
+    QChar quote;
+    bool escaped = false;
+    bool pendingSpace = false;
+
+    for (const QChar ch : query) {
+        if (!quote.isNull()) {
+            out.append(ch);
+            if (escaped) {
+                escaped = false;
+            } else if (ch == QLatin1Char('\\')) {
+                escaped = true;
+            } else if (ch == quote) {
+                quote = QChar();
+            }
+            continue;
+        }
+
+        if (ch.isSpace()) {
+            pendingSpace = !out.isEmpty();
+            continue;
+        }
+        if (pendingSpace) {
+            out.append(QLatin1Char(' '));
+            pendingSpace = false;
+        }
+        if (ch == QLatin1Char('\'') || ch == QLatin1Char('"')) {
+            quote = ch;
+        }
+        out.append(ch);
+    }
+    return out;
+}
+
+} // namespace
+
+WmiQueryCache::WmiQueryCache(WmiProvider* provider, Logger* logger)
+    : m_pProvider(provider)
+    , m_pLogger(logger)
+    , m_generation(0)
+{
+    m_clock.start();
+
+    // Fixed hardware inventory
+    for (const char* name : { "Win32_VideoController", "Win32_BIOS", "Win32_BaseBoard", "Win32_ComputerSystem",
+                              "Win32_ComputerSystemProduct", "Win32_Processor", "Win32_PhysicalMemory",
+                              "Win32_DiskDrive", "Win32_OperatingSystem", "Win32_SystemEnclosure" }) {
+        setClassTtl(QLatin1String(name), WMI_CACHE_INVENTORY_TTL_MS);
+    }
+
+    // Changes while running - short TTL, or merging only
+    setClassTtl(QStringLiteral("Win32_Battery"), 2000);
+    setClassTtl(QStringLiteral("BatteryStatus"), 0);
+    setClassTtl(QStringLiteral("MSAcpi_ThermalZoneTemperature"), 0);
+    setClassTtl(QStringLiteral("Win32_Process"), 0);
+}
+
+bool WmiQueryCache::query(const QString& namespacePath,
+                          const QString& query,
+                          WmiRows& results,
+                          const QString& property)
+{
+    if (!m_pProvider) {
+        return false;
+    }
+
+    const QString key = cacheKey(namespacePath, query, property);
+    const QString className = WmiProvider::queryClass(query).toLower();
+
+    QSharedPointer<Flight> flight;
+    quint64 generation;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (lookup(key, results)) {
+            return true;
+        }
+
+        // Someone is already asking WMI the same thing - wait for their answer
+        auto running = m_flights.constFind(key);
+        if (running != m_flights.constEnd()) {
+            QSharedPointer<Flight> joined = running.value();
+            m_stats.joined++;
+
+            QDeadlineTimer deadline(WMI_CACHE_JOIN_TIMEOUT_MS);
+            while (!joined->finished && !deadline.hasExpired()) {
+                joined->done.wait(&m_mutex, deadline);
+            }
+            if (!joined->finished || !joined->ok) {
+                return false;
+            }
+            results += joined->rows;
+            return true;
+        }
+
+        flight = beginFlight(key, generation);
+    }
+
+    // The slow part runs unlocked so other keys are served meanwhile
+    WmiRows rows;
+    const bool ok = m_pProvider->query(namespacePath, query, rows, property);
+    finishFlight(key, className, flight, generation, ok, rows);
+
+    if (ok) {
+        results += rows;
+    }
+    return ok;
+}
+
+void WmiQueryCache::queryAsync(const QString& namespacePath,
+                               const QString& query,
+                               const QString& property,
+                               WmiQueryCallback done)
+{
+    if (!m_pProvider) {
+        done(false, WmiRows());
+        return;
+    }
+
+    const QString key = cacheKey(namespacePath, query, property);
+    const QString className = WmiProvider::queryClass(query).toLower();
+
+    QSharedPointer<Flight> flight;
+    quint64 generation;
+    {
+        QMutexLocker locker(&m_mutex);
+        WmiRows cached;
+        if (lookup(key, cached)) {
+            locker.unlock();
+            done(true, cached);
+            return;
+        }
+
+        auto running = m_flights.constFind(key);
+        if (running != m_flights.constEnd()) {
+            m_stats.joined++;
+            running.value()->waiters.append(std::move(done));
+            return;
+        }
+
+        flight = beginFlight(key, generation);
+        flight->waiters.append(std::move(done));
+    }
+
+    m_pProvider->queryAsync(namespacePath, query, property, WMI_MAX_RESULT_ROWS,
+                            [this, key, className, flight, generation](bool ok, const WmiRows& rows) {
+        finishFlight(key, className, flight, generation, ok, rows);
+    });
+}
+
+bool WmiQueryCache::lookup(const QString& key, WmiRows& results)
+{
+    auto it = m_entries.constFind(key);
+    if (it == m_entries.constEnd()) {
+        return false;
+    }
+    if (it->expiresAt <= m_clock.elapsed()) {
+        m_entries.erase(it);
+        return false;
+    }
+    m_stats.hits++;
+    results += it->rows;
+    return true;
+}
+
+QSharedPointer<WmiQueryCache::Flight> WmiQueryCache::beginFlight(const QString& key, quint64& generation)
+{
+    QSharedPointer<Flight> flight = QSharedPointer<Flight>::create();
+    m_flights.insert(key, flight);
+    generation = m_generation;
+    m_stats.misses++;
+    return flight;
+}
+
+void WmiQueryCache::finishFlight(const QString& key, const QString& className, const QSharedPointer<Flight>& flight,
+                                 quint64 generation, bool ok, const WmiRows& rows)
+{
+    QList<WmiQueryCallback> waiters;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flights.remove(key);
+        flight->ok = ok;
+        flight->rows = rows;
+        flight->finished = true;
+        flight->done.wakeAll();
+        waiters.swap(flight->waiters);
+
+        if (!ok) {
+            m_stats.failures++;
+        } else {
+            const int ttlMs = m_classTtl.value(className, WMI_CACHE_DEFAULT_TTL_MS);
+            if (ttlMs > 0 && generation == m_generation) {
+                store(key, Entry{ rows, className, m_clock.elapsed() + ttlMs });
+            }
+        }
+    }
+
+    // Outside the lock: a callback may query the cache again
+    for (const WmiQueryCallback& waiter : waiters) {
+        waiter(ok, ok ? rows : WmiRows());
+    }
+}
+
+void WmiQueryCache::setClassTtl(const QString& className, int ttlMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_classTtl.insert(className.toLower(), qMax(0, ttlMs));
+}
+
+int WmiQueryCache::classTtl(const QString& className) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_classTtl.value(className.toLower(), WMI_CACHE_DEFAULT_TTL_MS);
+}
+
+int WmiQueryCache::invalidate(const QString& className)
+{
+    QMutexLocker locker(&m_mutex);
+    m_generation++;
+
+    int dropped = 0;
+    if (className.isEmpty()) {
+        dropped = m_entries.size();
+        m_entries.clear();
+    } else {
+        const QString lower = className.toLower();
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it->className == lower) {
+                it = m_entries.erase(it);
+                dropped++;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    LOG_DEBUG(m_pLogger, CatWmi, QString("Cache invalidated (%1): %2 entries dropped")
+                                     .arg(className.isEmpty() ? QStringLiteral("all") : className).arg(dropped));
+    return dropped;
+}
+
+WmiCacheStats WmiQueryCache::stats(bool reset)
+{
+    QMutexLocker locker(&m_mutex);
+    WmiCacheStats snapshot = m_stats;
+    snapshot.entries = m_entries.size();
+    if (reset) {
+        m_stats = WmiCacheStats();
+    }
+    return snapshot;
+}
+
+QString WmiQueryCache::cacheKey(const QString& namespacePath, const QString& query, const QString& property)
+{
+    // Namespace and property names are case-insensitive; the query is kept
+    // as written apart from whitespace outside literals, since WHERE values may not be
+    return namespacePath.toLower() + QLatin1Char('\n') + normalizeQuery(query)
+           + QLatin1Char('\n') + property.toLower();
+}
+
+void WmiQueryCache::store(const QString& key, const Entry& entry)
+{
+    if (m_entries.size() >= WMI_CACHE_MAX_ENTRIES && !m_entries.contains(key)) {
+        // Drop what has expired, then the entry closest to expiry
+        const qint64 now = m_clock.elapsed();
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it->expiresAt <= now) {
+                it = m_entries.erase(it);
+                m_stats.evictions++;
+            } else {
+                ++it;
+            }
+        }
+        if (m_entries.size() >= WMI_CACHE_MAX_ENTRIES) {
+            auto oldest = m_entries.begin();
+            for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+                if (it->expiresAt < oldest->expiresAt) {
+                    oldest = it;
+                }
+            }
+            m_entries.erase(oldest);
+            m_stats.evictions++;
+        }
+    }
+    m_entries.insert(key, entry);
+}
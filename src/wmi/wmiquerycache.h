@@ -0,0 +1,101 @@
+#ifndef WMIQUERYCACHE_H
+#define WMIQUERYCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include "wmiprovider.h"
+#include "logger.h"
+
+#define WMI_CACHE_DEFAULT_TTL_MS    5000        // Classes without their own TTL
+#define WMI_CACHE_INVENTORY_TTL_MS  300000      // Hardware that does not change while running
+#define WMI_CACHE_MAX_ENTRIES       256
+#define WMI_CACHE_JOIN_TIMEOUT_MS   30000       // Give up waiting on another caller's query
+
+struct WmiCacheStats {
+    quint64 hits = 0;
+    quint64 misses = 0;         // Queries that went to the provider
+    quint64 joined = 0;         // Waited for an identical query already running
+    quint64 failures = 0;
+    quint64 evictions = 0;
+    int entries = 0;
+};
+
+/**
+ * @brief WmiQueryCache - TTL cache with single-flight in front of a WmiProvider
+ *
+ * Entries are keyed by namespace, query text and property. How long a
+ * result stays valid depends on the class in the FROM clause: hardware
+ * inventory (Win32_VideoController, Win32_BIOS, ...) for minutes, fast
+ * moving data (Win32_Battery, performance counters) briefly or not at all.
+ *
+ * Concurrent misses for the same key are merged: the first caller runs the
+ * query without holding the cache lock and the rest wait for its result.
+ * queryAsync() never blocks: a hit calls back at once, a miss or a join
+ * calls back when the provider's query finishes.
+ * Failures are not cached. invalidate() drops entries and also keeps queries
+ * already running from storing their (possibly stale) result.
+ */
+class WmiQueryCache
+{
+public:
+    explicit WmiQueryCache(WmiProvider* provider, Logger* logger = nullptr);
+
+    bool query(const QString& namespacePath,
+               const QString& query,
+               WmiRows& results,
+               const QString& property = QString());
+
+    void queryAsync(const QString& namespacePath,
+                    const QString& query,
+                    const QString& property,
+                    WmiQueryCallback done);
+
+    // ttlMs 0 = never cache (identical concurrent queries are still merged)
+    void setClassTtl(const QString& className, int ttlMs);
+    int classTtl(const QString& className) const;
+
+    // Empty class name = everything; returns the number of entries dropped
+    int invalidate(const QString& className = QString());
+
+    WmiCacheStats stats(bool reset = false);
+
+private:
+    struct Entry {
+        WmiRows rows;
+        QString className;      // Lower case
+        qint64 expiresAt;       // m_clock ms
+    };
+
+    struct Flight {
+        QWaitCondition done;
+        bool finished = false;
+        bool ok = false;
+        WmiRows rows;
+        QList<WmiQueryCallback> waiters;    // queryAsync() callers, the owner included
+    };
+
+    static QString cacheKey(const QString& namespacePath, const QString& query, const QString& property);
+    bool lookup(const QString& key, WmiRows& results);      // Caller holds m_mutex; counts a hit
+    QSharedPointer<Flight> beginFlight(const QString& key, quint64& generation);   // Caller holds m_mutex
+    void finishFlight(const QString& key, const QString& className, const QSharedPointer<Flight>& flight,
+                      quint64 generation, bool ok, const WmiRows& rows);
+    void store(const QString& key, const Entry& entry);     // Caller holds m_mutex
+
+    WmiProvider* m_pProvider;
+    Logger* m_pLogger;
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, QSharedPointer<Flight>> m_flights;
+    QHash<QString, int> m_classTtl;     // Lower-case class name -> ms
+    quint64 m_generation;               // Bumped by invalidate()
+    WmiCacheStats m_stats;
+
+    Q_DISABLE_COPY(WmiQueryCache)
+};
+
+#endif // WMIQUERYCACHE_H
@@ -1,10 +1,15 @@
 #include "WmiAccess.h"
 #include <QMutexLocker>
+#include <QDeadlineTimer>
+
+namespace {
+// Whether this thread's attachThread() initialized COM and so owes a CoUninitialize
+thread_local bool t_comAttached = false;
+}
 
 WmiAccess::WmiAccess(Logger* logger)
     : m_pLogger(logger)
     , m_pLoc(nullptr)
-    , m_pSvc(nullptr)
     , m_isInitialized(false)
     , m_comInitialized(false)
 {
@@ -12,9 +17,7 @@ WmiAccess::WmiAccess(Logger* logger)
 
 WmiAccess::~WmiAccess()
 {
-    if (m_pLogger) {
-        m_pLogger->log("WmiAccess: Closing", Logger::Info);
-    }
+    LOG_INFO(m_pLogger, CatWmi, "WmiAccess: Closing");
     deinitialize();
 }
 
@@ -23,9 +26,7 @@ bool WmiAccess::initialize()
     QMutexLocker locker(&m_mutex);
 
     if (m_isInitialized) {
-        if (m_pLogger) {
-            m_pLogger->log("WmiAccess: Already initialized", Logger::Warning);
-        }
+        LOG_WARNING(m_pLogger, CatWmi, "WmiAccess: Already initialized");
         return true;
     }
 
@@ -35,14 +36,10 @@ bool WmiAccess::initialize()
     hres = CoInitializeEx(0, COINIT_MULTITHREADED);
     if (hres == RPC_E_CHANGED_MODE) {
         // COM already initialized in different mode, try to continue
-        if (m_pLogger) {
-            m_pLogger->log("WmiAccess: COM already initialized in different mode", Logger::Warning);
-        }
+        LOG_WARNING(m_pLogger, CatWmi, "WmiAccess: COM already initialized in different mode");
         m_comInitialized = false; // Don't uninitialize in destructor
     } else if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Failed to initialize COM: %1").arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Failed to initialize COM: %1").arg(getComErrorString(hres)));
         return false;
     } else {
         m_comInitialized = true;
@@ -62,28 +59,7 @@ bool WmiAccess::initialize()
 
     if (FAILED(hres) && hres != RPC_E_TOO_LATE) {
         // RPC_E_TOO_LATE means security was already set, which is OK
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Failed to initialize COM security: %1").arg(getComErrorString(hres)), Logger::Error);
-        }
-        if (m_comInitialized) {
-            CoUninitialize();
-            m_comInitialized = false;
-        }
-        return false;
-    }
-
-    // Obtain the initial locator to WMI
-    hres = CoCreateInstance(
-        CLSID_WbemLocator,
-        0,
-        CLSCTX_INPROC_SERVER,
-        IID_IWbemLocator,
-        (LPVOID*)&m_pLoc);
-
-    if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Failed to create IWbemLocator: %1").arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Failed to initialize COM security: %1").arg(getComErrorString(hres)));
         if (m_comInitialized) {
             CoUninitialize();
             m_comInitialized = false;
@@ -91,10 +67,10 @@ bool WmiAccess::initialize()
         return false;
     }
 
+    // The locator is created by the first connection, on a thread in the MTA,
+    // so it does not depend on this thread's apartment
     m_isInitialized = true;
-    if (m_pLogger) {
-        m_pLogger->log("WmiAccess: Initialized successfully", Logger::Info);
-    }
+    LOG_INFO(m_pLogger, CatWmi, "WmiAccess: Initialized successfully");
 
     return true;
 }
@@ -107,7 +83,7 @@ void WmiAccess::deinitialize()
         return;
     }
 
-    disconnectServer();
+    releaseAllServices();
 
     if (m_pLoc) {
         m_pLoc->Release();
@@ -121,29 +97,67 @@ void WmiAccess::deinitialize()
 
     m_isInitialized = false;
 
-    if (m_pLogger) {
-        m_pLogger->log("WmiAccess: Deinitialized", Logger::Info);
+    LOG_INFO(m_pLogger, CatWmi, "WmiAccess: Deinitialized");
+}
+
+bool WmiAccess::attachThread()
+{
+    const HRESULT hres = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hres)) {
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Thread could not join the MTA: %1").arg(getComErrorString(hres)));
+        return false;
     }
+    t_comAttached = true;
+    return true;
 }
 
-bool WmiAccess::connectServer(const QString &namespacePath)
+void WmiAccess::detachThread()
 {
-    // If already connected to this namespace, return success
-    if (m_pSvc && m_currentNamespace == namespacePath) {
-        return true;
+    if (t_comAttached) {
+        t_comAttached = false;
+        CoUninitialize();
     }
+}
 
-    // Disconnect from current server if connected
-    disconnectServer();
+IWbemServices* WmiAccess::acquireService(const QString &namespacePath)
+{
+    const QString key = namespacePath.toLower();
+    IWbemLocator* pLoc = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (!m_isInitialized) {
+            LOG_ERROR(m_pLogger, CatWmi, "WmiAccess: Not initialized");
+            return nullptr;
+        }
 
-    if (!m_pLoc) {
-        if (m_pLogger) {
-            m_pLogger->log("WmiAccess: Not initialized", Logger::Error);
+        QList<IWbemServices*>& idle = m_idle[key];
+        if (!idle.isEmpty()) {
+            return idle.takeLast();
         }
-        return false;
+
+        if (!m_pLoc) {
+            HRESULT hres = CoCreateInstance(
+                CLSID_WbemLocator,
+                0,
+                CLSCTX_INPROC_SERVER,
+                IID_IWbemLocator,
+                (LPVOID*)&m_pLoc);
+
+            if (FAILED(hres)) {
+                LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Failed to create IWbemLocator: %1").arg(getComErrorString(hres)));
+                m_pLoc = nullptr;
+                return nullptr;
+            }
+        }
+
+        pLoc = m_pLoc;
+        pLoc->AddRef();
     }
 
-    HRESULT hres = m_pLoc->ConnectServer(
+    // Connecting takes tens of milliseconds - other namespaces are served meanwhile
+    IWbemServices* pSvc = nullptr;
+    HRESULT hres = pLoc->ConnectServer(
         _bstr_t(namespacePath.toStdWString().c_str()),
         nullptr,  // User name (nullptr = current user)
         nullptr,  // Password (nullptr = current)
@@ -151,19 +165,18 @@ bool WmiAccess::connectServer(const QString &namespacePath)
         0L,       // Security flags
         0,        // Authority
         0,        // Context object
-        &m_pSvc);
+        &pSvc);
+    pLoc->Release();
 
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Could not connect to namespace '%1': %2")
-                               .arg(namespacePath).arg(getComErrorString(hres)), Logger::Error);
-        }
-        return false;
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Could not connect to namespace '%1': %2")
+                                         .arg(namespacePath).arg(getComErrorString(hres)));
+        return nullptr;
     }
 
     // Set security levels on the proxy
     hres = CoSetProxyBlanket(
-        m_pSvc,
+        pSvc,
         RPC_C_AUTHN_WINNT,
         RPC_C_AUTHZ_NONE,
         nullptr,
@@ -173,51 +186,69 @@ bool WmiAccess::connectServer(const QString &namespacePath)
         EOAC_NONE);
 
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Could not set proxy blanket: %1").arg(getComErrorString(hres)), Logger::Error);
-        }
-        m_pSvc->Release();
-        m_pSvc = nullptr;
-        return false;
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Could not set proxy blanket: %1").arg(getComErrorString(hres)));
+        pSvc->Release();
+        return nullptr;
     }
 
-    m_currentNamespace = namespacePath;
-    return true;
+    return pSvc;
 }
 
-void WmiAccess::disconnectServer()
+void WmiAccess::releaseService(const QString &namespacePath, IWbemServices* pSvc, bool healthy)
 {
-    if (m_pSvc) {
-        m_pSvc->Release();
-        m_pSvc = nullptr;
+    if (!pSvc) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        QList<IWbemServices*>& idle = m_idle[namespacePath.toLower()];
+        if (healthy && m_isInitialized && idle.size() < WMI_POOL_MAX_IDLE) {
+            idle.append(pSvc);
+            return;
+        }
     }
-    m_currentNamespace.clear();
+    pSvc->Release();
 }
 
-bool WmiAccess::query(const QString &namespacePath,
-                      const QString &query,
-                      QVector<QMap<QString, QVariant>> &results,
-                      const QString &property)
+void WmiAccess::releaseAllServices()
 {
-    QMutexLocker locker(&m_mutex);
-
-    if (!m_isInitialized) {
-        if (m_pLogger) {
-            m_pLogger->log("WmiAccess: Not initialized", Logger::Error);
+    // Caller holds m_mutex
+    for (QList<IWbemServices*>& idle : m_idle) {
+        for (IWbemServices* pSvc : idle) {
+            pSvc->Release();
         }
-        return false;
     }
+    m_idle.clear();
+}
 
-    // Ensure connection to the WMI namespace
-    if (!connectServer(namespacePath)) {
+bool WmiAccess::isConnectionError(HRESULT hr)
+{
+    // The WMI service restarted or the proxy broke - reconnect next time
+    return hr == WBEM_E_TRANSPORT_FAILURE
+           || hr == RPC_E_DISCONNECTED
+           || hr == RPC_E_SERVER_DIED
+           || hr == RPC_E_SERVER_DIED_DNE
+           || hr == HRESULT_FROM_WIN32(RPC_S_SERVER_UNAVAILABLE)
+           || hr == HRESULT_FROM_WIN32(RPC_S_CALL_FAILED);
+}
+
+bool WmiAccess::query(const QString &namespacePath,
+                      const QString &query,
+                      WmiRows &results,
+                      const QString &property,
+                      int maxRows)
+{
+    IWbemServices* pSvc = acquireService(namespacePath);
+    if (!pSvc) {
         return false;
     }
 
     HRESULT hres;
     IEnumWbemClassObject* pEnumerator = nullptr;
 
-    // Execute WMI query
-    hres = m_pSvc->ExecQuery(
+    // Execute WMI query (semisynchronous: returns at once, objects arrive through Next)
+    hres = pSvc->ExecQuery(
         bstr_t("WQL"),
         bstr_t(query.toStdWString().c_str()),
         WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
@@ -225,101 +256,131 @@ bool WmiAccess::query(const QString &namespacePath,
         &pEnumerator);
 
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Query failed '%1': %2").arg(query).arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Query failed '%1': %2").arg(query).arg(getComErrorString(hres)));
+        releaseService(namespacePath, pSvc, !isConnectionError(hres));
         return false;
     }
 
-    IWbemClassObject* pclsObj = nullptr;
-    ULONG uReturn = 0;
-
-    // Iterate over the results
-    while (pEnumerator) {
-        HRESULT hr = pEnumerator->Next(WBEM_INFINITE, 1, &pclsObj, &uReturn);
-
-        if (uReturn == 0) {
-            break; // No more results
-        }
-
-        QMap<QString, QVariant> result;
-        VARIANT vtProp;
-        BSTR propName = nullptr;
-
-        // Begin enumeration of the properties
-        hr = pclsObj->BeginEnumeration(0);
-        if (SUCCEEDED(hr)) {
-            // Iterate over properties
-            while (pclsObj->Next(0, &propName, &vtProp, nullptr, nullptr) == WBEM_S_NO_ERROR) {
-                if (propName) {
-                    QString propertyName = QString::fromWCharArray(propName);
-
-                    // Filter by requested property if specified
-                    bool shouldInclude = property.isEmpty() || propertyName == property;
-
-                    // Filter out system properties (those starting with __)
-                    if (shouldInclude && !propertyName.startsWith("__")) {
-                        QVariant qValue;
-                        if (variantToQVariant(vtProp, qValue)) {
-                            result.insert(propertyName, qValue);
-                        }
-                    }
-
-                    SysFreeString(propName);
-                    propName = nullptr;
+    IWbemClassObject* batch[WMI_ENUM_BATCH_SIZE];
+    const int firstRow = results.size();
+    bool ok = true;
+    bool truncated = false;
+    QDeadlineTimer deadline(WMI_QUERY_TIMEOUT_MS);
+
+    // Iterate over the results, a batch per round trip
+    for (;;) {
+        // Near the limit ask only for what is still kept, plus one to see whether more follow
+        const int remaining = maxRows - (results.size() - firstRow);
+        const ULONG wanted = static_cast<ULONG>(qBound(1, remaining, WMI_ENUM_BATCH_SIZE));
+        ULONG returned = 0;
+        hres = pEnumerator->Next(WMI_ENUM_NEXT_TIMEOUT_MS, wanted, batch, &returned);
+
+        for (ULONG i = 0; i < returned; i++) {
+            if (results.size() - firstRow < maxRows) {
+                QMap<QString, QVariant> row;
+                // Add non-empty results
+                if (readObject(batch[i], property, row)) {
+                    results.append(row);
                 }
-                VariantClear(&vtProp);
+            } else {
+                truncated = true;
             }
-
-            pclsObj->EndEnumeration();
+            batch[i]->Release();
         }
 
-        // Add non-empty results
-        if (!result.isEmpty()) {
-            results.append(result);
+        if (FAILED(hres)) {
+            LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Enumeration failed '%1': %2").arg(query).arg(getComErrorString(hres)));
+            ok = false;
+            break;
+        }
+        if (truncated || hres == WBEM_S_FALSE) {
+            break;      // Row limit, or fewer objects than asked for - the end
+        }
+        if (hres == WBEM_S_TIMEDOUT && deadline.hasExpired()) {
+            LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Query '%1' still enumerating after %2 ms, giving up")
+                                             .arg(query).arg(WMI_QUERY_TIMEOUT_MS));
+            ok = false;
+            break;
         }
-
-        pclsObj->Release();
     }
 
     // Release enumerator
     pEnumerator->Release();
+    releaseService(namespacePath, pSvc, ok || !isConnectionError(hres));
 
-    if (m_pLogger) {
-        m_pLogger->log(QString("WmiAccess: Query returned %1 results").arg(results.size()), Logger::Info);
+    if (!ok) {
+        results.resize(firstRow);
+        return false;
+    }
+
+    if (truncated) {
+        LOG_FMT(m_pLogger, CatWmi, Debug, "WmiAccess: Query '%1' stopped at %2 results", query, maxRows);
+    } else {
+        LOG_FMT(m_pLogger, CatWmi, Debug, "WmiAccess: Query returned %1 results", results.size() - firstRow);
     }
 
     return true;
 }
 
+bool WmiAccess::readObject(IWbemClassObject* pObj, const QString &property, QMap<QString, QVariant> &row)
+{
+    VARIANT vtProp;
+    VariantInit(&vtProp);
+
+    // One named property: fetch it directly instead of walking them all
+    if (!property.isEmpty()) {
+        if (SUCCEEDED(pObj->Get(property.toStdWString().c_str(), 0, &vtProp, nullptr, nullptr))) {
+            QVariant qValue;
+            if (variantToQVariant(vtProp, qValue)) {
+                row.insert(property, qValue);
+            }
+        }
+        VariantClear(&vtProp);
+        return !row.isEmpty();
+    }
+
+    BSTR propName = nullptr;
+
+    // Begin enumeration of the properties, skipping system properties (__CLASS, ...)
+    if (SUCCEEDED(pObj->BeginEnumeration(WBEM_FLAG_NONSYSTEM_ONLY))) {
+        while (pObj->Next(0, &propName, &vtProp, nullptr, nullptr) == WBEM_S_NO_ERROR) {
+            if (propName) {
+                QVariant qValue;
+                if (variantToQVariant(vtProp, qValue)) {
+                    row.insert(QString::fromWCharArray(propName), qValue);
+                }
+
+                SysFreeString(propName);
+                propName = nullptr;
+            }
+            VariantClear(&vtProp);
+        }
+
+        pObj->EndEnumeration();
+    }
+
+    return !row.isEmpty();
+}
+
 bool WmiAccess::execMethod(const QString &namespacePath,
                            const QString &className,
                            const QString &methodName,
                            const QMap<QString, QVariant> &params,
                            QMap<QString, QVariant> &results)
 {
-    QMutexLocker locker(&m_mutex);
-
-    if (!m_isInitialized) {
-        if (m_pLogger) {
-            m_pLogger->log("WmiAccess: Not initialized", Logger::Error);
-        }
-        return false;
-    }
-
-    if (!connectServer(namespacePath)) {
+    IWbemServices* pSvc = acquireService(namespacePath);
+    if (!pSvc) {
         return false;
     }
 
     HRESULT hres;
     IWbemClassObject* pClass = nullptr;
 
-    hres = m_pSvc->GetObject(_bstr_t(className.toStdWString().c_str()), 0, nullptr, &pClass, nullptr);
+    hres = pSvc->GetObject(_bstr_t(className.toStdWString().c_str()), 0, nullptr, &pClass, nullptr);
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Could not get class '%1': %2")
-                               .arg(className).arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Could not get class '%1': %2")
+                                         .arg(className).arg(getComErrorString(hres)));
+        releaseService(namespacePath, pSvc, !isConnectionError(hres));
         return false;
     }
 
@@ -329,11 +390,10 @@ bool WmiAccess::execMethod(const QString &namespacePath,
     hres = pClass->GetMethod(_bstr_t(methodName.toStdWString().c_str()), 0, &pInParamsDefinition, &pOutParamsDefinition);
 
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Could not get method '%1': %2")
-                               .arg(methodName).arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Could not get method '%1': %2")
+                                         .arg(methodName).arg(getComErrorString(hres)));
         pClass->Release();
+        releaseService(namespacePath, pSvc, true);
         return false;
     }
 
@@ -342,12 +402,11 @@ bool WmiAccess::execMethod(const QString &namespacePath,
     if (pInParamsDefinition) {
         hres = pInParamsDefinition->SpawnInstance(0, &pClassInstance);
         if (FAILED(hres)) {
-            if (m_pLogger) {
-                m_pLogger->log("WmiAccess: Could not spawn instance for method", Logger::Error);
-            }
+            LOG_ERROR(m_pLogger, CatWmi, "WmiAccess: Could not spawn instance for method");
             if (pOutParamsDefinition) pOutParamsDefinition->Release();
             pInParamsDefinition->Release();
             pClass->Release();
+            releaseService(namespacePath, pSvc, true);
             return false;
         }
 
@@ -358,8 +417,8 @@ bool WmiAccess::execMethod(const QString &namespacePath,
 
             if (qVariantToVariant(it.value(), var)) {
                 hres = pClassInstance->Put(it.key().toStdWString().c_str(), 0, &var, 0);
-                if (FAILED(hres) && m_pLogger) {
-                    m_pLogger->log(QString("WmiAccess: Failed to set parameter '%1'").arg(it.key()), Logger::Warning);
+                if (FAILED(hres)) {
+                    LOG_WARNING(m_pLogger, CatWmi, QString("WmiAccess: Failed to set parameter '%1'").arg(it.key()));
                 }
             }
             VariantClear(&var);
@@ -368,7 +427,7 @@ bool WmiAccess::execMethod(const QString &namespacePath,
 
     // Execute method
     IWbemClassObject* pOutParams = nullptr;
-    hres = m_pSvc->ExecMethod(
+    hres = pSvc->ExecMethod(
         _bstr_t(className.toStdWString().c_str()),
         _bstr_t(methodName.toStdWString().c_str()),
         0,
@@ -382,12 +441,11 @@ bool WmiAccess::execMethod(const QString &namespacePath,
     if (pInParamsDefinition) pInParamsDefinition->Release();
     if (pOutParamsDefinition) pOutParamsDefinition->Release();
     pClass->Release();
+    releaseService(namespacePath, pSvc, !isConnectionError(hres));
 
     if (FAILED(hres)) {
-        if (m_pLogger) {
-            m_pLogger->log(QString("WmiAccess: Method execution failed '%1': %2")
-                               .arg(methodName).arg(getComErrorString(hres)), Logger::Error);
-        }
+        LOG_ERROR(m_pLogger, CatWmi, QString("WmiAccess: Method execution failed '%1': %2")
+                                         .arg(methodName).arg(getComErrorString(hres)));
         return false;
     }
 
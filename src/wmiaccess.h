@@ -6,14 +6,33 @@
 #include <QVariant>
 #include <QVector>
 #include <QMap>
+#include <QHash>
 #include <QMutex>
 #include "logger.h"
+#include "wmi/wmiprovider.h"
 #include <comdef.h>
 #include <Wbemidl.h>
 
 #pragma comment(lib, "wbemuuid.lib")
 
-class WmiAccess
+#define WMI_POOL_MAX_IDLE           4       // Idle connections kept per namespace
+#define WMI_ENUM_BATCH_SIZE         64      // Objects fetched per IEnumWbemClassObject::Next
+#define WMI_ENUM_NEXT_TIMEOUT_MS    1000    // Per Next() call; the query keeps going while rows arrive
+#define WMI_QUERY_TIMEOUT_MS        60000   // Whole enumeration
+
+/**
+ * @brief WmiAccess - WMI queries and method calls over COM
+ *
+ * Connected IWbemServices are pooled per namespace and taken for the
+ * duration of one call, so queries against different namespaces (or the
+ * same one) run in parallel without reconnecting. The locator and the
+ * pooled services live in the MTA; calling threads join it through
+ * attachThread(), which is what WmiEngine's workers do.
+ *
+ * Queries are semisynchronous and read objects in batches of
+ * WMI_ENUM_BATCH_SIZE, releasing the enumerator once maxRows objects are read.
+ */
+class WmiAccess : public WmiProvider
 {
 public:
     explicit WmiAccess(Logger* logger);
@@ -23,11 +42,16 @@ public:
     void deinitialize();
     bool isInitialized() const { return m_isInitialized; }
 
+    // Joins the calling thread to the MTA
+    bool attachThread() override;
+    void detachThread() override;
+
     // Query WMI - returns all properties if property is empty
     bool query(const QString &namespacePath,
                const QString &query,
-               QVector<QMap<QString, QVariant>> &results,
-               const QString &property = QString());
+               WmiRows &results,
+               const QString &property = QString(),
+               int maxRows = WMI_MAX_RESULT_ROWS) override;
 
     // Execute WMI method
     bool execMethod(const QString &namespacePath,
@@ -38,16 +62,19 @@ public:
 
 private:
     Logger* m_pLogger;
-    IWbemLocator* m_pLoc;
-    IWbemServices* m_pSvc;
-    QString m_currentNamespace;
+    IWbemLocator* m_pLoc;                               // Created on first use, in the MTA
+    QHash<QString, QList<IWbemServices*>> m_idle;       // Lower-case namespace -> idle connections
     bool m_isInitialized;
     bool m_comInitialized;
-    QMutex m_mutex;
+    QMutex m_mutex;                                     // Locator, pool and state - not held during calls
 
     bool initializeSecurity();
-    bool connectServer(const QString &namespacePath);
-    void disconnectServer();
+    IWbemServices* acquireService(const QString &namespacePath);
+    void releaseService(const QString &namespacePath, IWbemServices* pSvc, bool healthy);
+    void releaseAllServices();
+    static bool isConnectionError(HRESULT hr);
+
+    bool readObject(IWbemClassObject* pObj, const QString &property, QMap<QString, QVariant> &row);
 
     bool variantToQVariant(const VARIANT &variant, QVariant &qVariant);
     bool qVariantToVariant(const QVariant &qVariant, VARIANT &variant);
@@ -0,0 +1,366 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QProtobufSerializer>
+#include <QTextStream>
+#include "command.qpb.h"
+#include "serviceext.qpb.h"
+#include "serviceenvelope.h"
+#include "secureprotocol.h"
+#include "host_ec_cmds.h"
+#include "commandmix.h"
+
+// ============================================================================
+// CSAllocBench - heap allocations made per request, by request type
+//
+//   CSAllocBench --iterations 10000 [--mix acpiread,batch,caps]
+//
+// Runs the service side of each CSLoadGen request type in-process: packet
+// parse, envelope/Command deserialize, the EmiThread packet handling behind
+// each EC read, response assembly, serialize and packet build. Every call
+// into the C heap is counted while a request is served. "baseline" is the
+// request path before the buffer work (per-command packet buffers, a fresh
+// GET_RESULT packet, byte-by-byte growth and mid() for EC responses, copied
+// envelope bodies, responses copied into the Command); "current" is the path
+// as the service runs it now.
+//
+// Handler bodies are not run - they need an EC - so responses carry the
+// sizes the real handlers return but no handler-specific content.
+// ============================================================================
+
+namespace {
+
+bool s_counting = false;
+quint64 s_allocations = 0;
+quint64 s_allocatedBytes = 0;
+
+inline void countAllocation(size_t size)
+{
+    if (s_counting) {
+        s_allocations++;
+        s_allocatedBytes += size;
+    }
+}
+
+} // namespace
+
+#if defined(__GLIBC__)
+// Qt containers allocate through malloc() and operator new ends there too,
+// so wrapping the glibc entry points sees every allocation
+#define ALLOC_COUNTING 1
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+}
+#elif defined(_MSC_VER) && defined(_DEBUG)
+// The debug CRT reports every heap call from modules sharing it (Qt debug DLLs)
+#define ALLOC_COUNTING 1
+#include <crtdbg.h>
+namespace {
+int allocHook(int type, void*, size_t size, int, long, const unsigned char*, int)
+{
+    if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) {
+        countAllocation(size);
+    }
+    return TRUE;
+}
+} // namespace
+#else
+#define ALLOC_COUNTING 0
+#endif
+
+namespace {
+
+#define BENCH_TOKEN         0x1234ABCD
+#define EC_READ_SIZE        16      // Bytes each CSLoadGen EC read asks for
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+enum class RequestPath {
+    Baseline,
+    Current
+};
+
+struct AllocCount {
+    quint64 allocations = 0;
+    quint64 bytes = 0;
+};
+
+// EmiThread state that outlives one command
+struct EcThreadBuffers {
+    QByteArray packetOut;
+    QByteArray getResultPacket;
+};
+
+void buildOutPacket(RequestPath path, quint16 cmd, const QByteArray& payloadOut, QByteArray& packetOut)
+{
+    ec_host_cmd_request_header hdr = {};
+    hdr.prtcl_ver = 3;
+    hdr.cmd_id = cmd;
+    hdr.cmd_ver = 1;
+    hdr.data_len = static_cast<uint16_t>(payloadOut.size());
+
+    if (path == RequestPath::Baseline) {
+        packetOut.clear();
+    } else {
+        packetOut.truncate(0);
+        packetOut.reserve(sizeof(hdr) + payloadOut.size());
+    }
+    packetOut.append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    packetOut.append(payloadOut);
+}
+
+// One EC command through EmiThread::ProcCmd/GetPayloadIn and back to the handler
+QByteArray ecRoundTrip(RequestPath path, EcThreadBuffers& buffers, quint16 cmd, const QByteArray& payloadOut,
+                       int responseSize)
+{
+    const int headerSize = static_cast<int>(sizeof(ec_host_cmd_response_header));
+    QByteArray payloadIn;
+
+    if (path == RequestPath::Baseline) {
+        QByteArray packetOut;
+        buildOutPacket(path, cmd, payloadOut, packetOut);
+        QByteArray getResult;
+        buildOutPacket(path, ECCMD_GET_RESULT, QByteArray(), getResult);
+
+        QByteArray packetIn;
+        for (int i = 0; i < headerSize + responseSize; i++) {
+            packetIn.append(static_cast<char>(i));
+        }
+        payloadIn = packetIn.mid(headerSize);
+    } else {
+        buildOutPacket(path, cmd, payloadOut, buffers.packetOut);
+        if (buffers.getResultPacket.isEmpty()) {
+            buildOutPacket(path, ECCMD_GET_RESULT, QByteArray(), buffers.getResultPacket);
+        }
+
+        QByteArray packetIn;
+        packetIn.reserve(EMI_BUF_MAX_SIZE);
+        for (int i = 0; i < headerSize + responseSize; i++) {
+            packetIn.append(static_cast<char>(i));
+        }
+        payloadIn = std::move(packetIn);
+        payloadIn.remove(0, headerSize);
+    }
+    return payloadIn;
+}
+
+patrol::EcAcpiReadResponse acpiReadResponse(RequestPath path, EcThreadBuffers& buffers,
+                                            const patrol::EcAcpiReadRequest& req)
+{
+    QByteArray data = ecRoundTrip(path, buffers, 0x0030, QByteArray(4, '\0'), static_cast<int>(req.size()));
+    patrol::EcAcpiReadResponse resp;
+    resp.setResult(0);
+    if (path == RequestPath::Baseline) {
+        resp.setData(data);
+    } else {
+        resp.setData(std::move(data));
+    }
+    return resp;
+}
+
+// Service side of one request; returns the packet that would go on the pipe
+QByteArray serve(RequestPath path, EcThreadBuffers& buffers, QProtobufSerializer& serializer, const QByteArray& packet)
+{
+    SecurePacketHeaderV2 header;
+    QByteArray payload;
+    if (!SecurePacketBuilder::parsePacket(packet, header, payload)) {
+        return QByteArray();
+    }
+
+    if (isServiceEnvelope(payload)) {
+        patrol::ServiceEnvelope request;
+        const bool parsed = (path == RequestPath::Baseline)
+                                ? request.deserialize(&serializer, payload.mid(1))
+                                : request.deserialize(&serializer, serviceEnvelopeBody(payload));
+        if (!parsed || !request.hasBatchReq()) {
+            return QByteArray();
+        }
+
+        QList<patrol::Command> responses;
+        for (const patrol::Command& command : request.batchReq().commands()) {
+            patrol::Command response;
+            response.setSequenceNumber(command.sequenceNumber());
+            patrol::EcAcpiReadResponse read = acpiReadResponse(path, buffers, command.ecAcpiReadReq());
+            if (path == RequestPath::Baseline) {
+                response.setEcAcpiReadResp(read);
+            } else {
+                response.setEcAcpiReadResp(std::move(read));
+            }
+            responses.append(response);
+        }
+
+        patrol::CommandBatchResponse batch;
+        batch.setResult(0);
+        batch.setExecutedCount(static_cast<quint32>(responses.size()));
+        batch.setResponses(responses);
+
+        patrol::ServiceEnvelope response;
+        response.setSequenceNumber(request.sequenceNumber());
+        response.setBatchResp(batch);
+        return SecurePacketBuilder::buildPacket(header.sessionToken, header.sequenceNumber,
+                                                wrapServiceEnvelope(response.serialize(&serializer)));
+    }
+
+    patrol::Command request;
+    if (!request.deserialize(&serializer, payload)) {
+        return QByteArray();
+    }
+
+    patrol::Command response;
+    response.setSequenceNumber(request.sequenceNumber());
+
+    // The dispatch table copied handler responses in before the change and moves them now
+    auto assign = [path](auto&& resp, auto setter) {
+        if (path == RequestPath::Baseline) {
+            setter(resp);
+        } else {
+            setter(std::move(resp));
+        }
+    };
+
+    if (request.hasEcAcpiReadReq()) {
+        assign(acpiReadResponse(path, buffers, request.ecAcpiReadReq()),
+               [&response](auto&& r) { response.setEcAcpiReadResp(std::forward<decltype(r)>(r)); });
+    } else if (request.hasEcRamReadReq()) {
+        QByteArray data = ecRoundTrip(path, buffers, 0x0031, QByteArray(4, '\0'),
+                                      static_cast<int>(request.ecRamReadReq().size()));
+        patrol::EcRamReadResponse resp;
+        resp.setResult(0);
+        if (path == RequestPath::Baseline) {
+            resp.setData(data);
+        } else {
+            resp.setData(std::move(data));
+        }
+        assign(resp, [&response](auto&& r) { response.setEcRamReadResp(std::forward<decltype(r)>(r)); });
+    } else if (request.hasEcStatusReq()) {
+        patrol::EcGetStatusResponse resp;
+        resp.setResult(0);
+        assign(resp, [&response](auto&& r) { response.setEcStatusResp(std::forward<decltype(r)>(r)); });
+    } else if (request.hasGetCapabilitiesReq()) {
+        patrol::GetCapabilitiesResponse resp;
+        resp.setResult(0);
+        assign(resp, [&response](auto&& r) { response.setGetCapabilitiesResp(std::forward<decltype(r)>(r)); });
+    } else if (request.hasGetSystemInfoReq()) {
+        patrol::GetSystemInfoResponse resp;
+        resp.setResult(0);
+        assign(resp, [&response](auto&& r) { response.setGetSystemInfoResp(std::forward<decltype(r)>(r)); });
+    } else if (request.hasPollActionCmdsReq()) {
+        patrol::PollActionCommandsResponse resp;
+        resp.setResult(0);
+        assign(resp, [&response](auto&& r) { response.setPollActionCmdsResp(std::forward<decltype(r)>(r)); });
+    }
+
+    return SecurePacketBuilder::buildPacket(header.sessionToken, header.sequenceNumber,
+                                            response.serialize(&serializer));
+}
+
+AllocCount measure(RequestPath path, const QString& type, int iterations)
+{
+    CommandMix mix;
+    mix.parse(type + ":1", nullptr);
+    QProtobufSerializer serializer;
+    EcThreadBuffers buffers;
+
+    // Warm up: first-use allocations (serializer metadata, EmiThread buffers
+    // on the current path) are not per-request cost
+    const MixRequest warm = mix.next(1);
+    serve(path, buffers, serializer, SecurePacketBuilder::buildPacket(BENCH_TOKEN, 1, warm.payload));
+
+    AllocCount total;
+    for (int i = 0; i < iterations; i++) {
+        const quint32 sequence = static_cast<quint32>(i + 2);
+        const MixRequest request = mix.next(sequence);
+        const QByteArray packet = SecurePacketBuilder::buildPacket(BENCH_TOKEN, sequence, request.payload);
+
+        s_allocations = 0;
+        s_allocatedBytes = 0;
+        s_counting = true;
+        const QByteArray reply = serve(path, buffers, serializer, packet);
+        s_counting = false;
+
+        if (reply.isEmpty()) {
+            out() << QString("%1: request could not be served\n").arg(type);
+            return AllocCount();
+        }
+        total.allocations += s_allocations;
+        total.bytes += s_allocatedBytes;
+    }
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSAllocBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Heap allocations per request type, before and after the buffer work");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"iterations", "Requests per type and path.", "n", "10000"},
+        {"mix", "Comma-separated request types (see CSLoadGen).", "types", CommandMix::knownCommands().join(',')},
+    });
+    parser.process(app);
+
+#if !ALLOC_COUNTING
+    out() << "Allocation counting needs glibc or a debug MSVC build\n";
+    return 1;
+#else
+#if defined(_MSC_VER)
+    _CrtSetAllocHook(allocHook);
+#endif
+
+    const int iterations = qMax(1, parser.value("iterations").toInt());
+    const QStringList known = CommandMix::knownCommands();
+
+    out() << QString("%1 %2 %3 %4 %5\n")
+                 .arg("type", -10)
+                 .arg("baseline allocs", 16)
+                 .arg("bytes", 10)
+                 .arg("current allocs", 16)
+                 .arg("bytes", 10);
+
+    for (const QString& type : parser.value("mix").split(',', Qt::SkipEmptyParts)) {
+        if (!known.contains(type)) {
+            out() << QString("Unknown request type '%1' (known: %2)\n").arg(type, known.join(", "));
+            return 1;
+        }
+
+        const AllocCount baseline = measure(RequestPath::Baseline, type, iterations);
+        const AllocCount current = measure(RequestPath::Current, type, iterations);
+        out() << QString("%1 %2 %3 %4 %5\n")
+                     .arg(type, -10)
+                     .arg(static_cast<double>(baseline.allocations) / iterations, 16, 'f', 1)
+                     .arg(static_cast<double>(baseline.bytes) / iterations, 10, 'f', 0)
+                     .arg(static_cast<double>(current.allocations) / iterations, 16, 'f', 1)
+                     .arg(static_cast<double>(current.bytes) / iterations, 10, 'f', 0);
+    }
+    out().flush();
+    return 0;
+#endif
+}
@@ -0,0 +1,204 @@
+#include "commandmix.h"
+#include "serviceenvelope.h"
+
+#define BATCH_SIZE      8       // ACPI reads per "batch" request
+
+namespace {
+
+// Generic result reader for a plain Command response; the response field is
+// chosen by the request type, so each type passes its own accessor
+template <typename Getter>
+std::function<int(const QByteArray&)> commandResult(Getter getter)
+{
+    return [getter](const QByteArray& payload) {
+        QProtobufSerializer serializer;
+        patrol::Command response;
+        if (!response.deserialize(&serializer, payload)) {
+            return -1;
+        }
+        return static_cast<int>(getter(response));
+    };
+}
+
+patrol::EcAcpiReadRequest acpiRead(quint32 offset, quint32 size)
+{
+    patrol::EcAcpiReadRequest req;
+    req.setNamespaceId(0);
+    req.setOffset(offset);
+    req.setSize(size);
+    return req;
+}
+
+} // namespace
+
+CommandMix::CommandMix()
+    : m_totalWeight(0)
+    , m_rng(QRandomGenerator::securelySeeded())
+{
+}
+
+QStringList CommandMix::knownCommands()
+{
+    return { "caps", "sysinfo", "acpiread", "ecram", "ecstatus", "poll", "batch" };
+}
+
+bool CommandMix::parse(const QString& spec, QString* error)
+{
+    m_entries.clear();
+    m_totalWeight = 0;
+
+    const QStringList known = knownCommands();
+    for (const QString& part : spec.split(',', Qt::SkipEmptyParts)) {
+        Entry entry;
+        entry.name = part.section(':', 0, 0).trimmed();
+        const QString weight = part.section(':', 1, 1).trimmed();
+
+        bool ok = true;
+        entry.weight = weight.isEmpty() ? 1 : weight.toInt(&ok);
+
+        if (!known.contains(entry.name)) {
+            if (error) *error = QString("Unknown command '%1' (known: %2)").arg(entry.name, known.join(", "));
+            return false;
+        }
+        if (!ok || entry.weight <= 0) {
+            if (error) *error = QString("Bad weight for '%1'").arg(entry.name);
+            return false;
+        }
+
+        m_totalWeight += entry.weight;
+        m_entries.append(entry);
+    }
+
+    if (m_entries.isEmpty()) {
+        if (error) *error = "Empty command mix";
+        return false;
+    }
+    return true;
+}
+
+QStringList CommandMix::names() const
+{
+    QStringList out;
+    for (const Entry& entry : m_entries) {
+        out.append(entry.name);
+    }
+    return out;
+}
+
+MixRequest CommandMix::next(quint32 sequence)
+{
+    int pick = m_rng.bounded(m_totalWeight);
+    for (const Entry& entry : m_entries) {
+        if (pick < entry.weight) {
+            return build(entry.name, sequence);
+        }
+        pick -= entry.weight;
+    }
+    return build(m_entries.last().name, sequence);
+}
+
+MixRequest CommandMix::build(const QString& name, quint32 sequence)
+{
+    patrol::Command cmd;
+    cmd.setSequenceNumber(sequence);
+
+    if (name == "caps") {
+        cmd.setGetCapabilitiesReq(patrol::GetCapabilitiesRequest());
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.getCapabilitiesResp().result(); });
+        return req;
+    }
+    if (name == "sysinfo") {
+        cmd.setGetSystemInfoReq(patrol::GetSystemInfoRequest());
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.getSystemInfoResp().result(); });
+        return req;
+    }
+    if (name == "acpiread") {
+        cmd.setEcAcpiReadReq(acpiRead(0, 16));
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.ecAcpiReadResp().result(); });
+        return req;
+    }
+    if (name == "ecram") {
+        patrol::EcRamReadRequest ram;
+        ram.setOffset(0);
+        ram.setSize(16);
+        cmd.setEcRamReadReq(ram);
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.ecRamReadResp().result(); });
+        return req;
+    }
+    if (name == "ecstatus") {
+        cmd.setEcStatusReq(patrol::EcGetStatusRequest());
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.ecStatusResp().result(); });
+        return req;
+    }
+    if (name == "poll") {
+        cmd.setPollActionCmdsReq(patrol::PollActionCommandsRequest());
+        MixRequest req = commandRequest(name, cmd);
+        req.result = commandResult([](const patrol::Command& r) { return r.pollActionCmdsResp().result(); });
+        return req;
+    }
+
+    // "batch": BATCH_SIZE consecutive ACPI reads in one envelope
+    patrol::CommandBatchRequest batch;
+    QList<patrol::Command> commands;
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        patrol::Command read;
+        read.setSequenceNumber(sequence);
+        read.setEcAcpiReadReq(acpiRead(i * 16, 16));
+        commands.append(read);
+    }
+    batch.setCommands(commands);
+
+    patrol::ServiceEnvelope envelope;
+    envelope.setSequenceNumber(sequence);
+    envelope.setBatchReq(batch);
+    return envelopeRequest(name, envelope);
+}
+
+MixRequest CommandMix::metricsRequest(quint32 sequence, bool reset)
+{
+    patrol::MetricsRequest metrics;
+    metrics.setReset(reset);
+
+    patrol::ServiceEnvelope envelope;
+    envelope.setSequenceNumber(sequence);
+    envelope.setMetricsReq(metrics);
+    return envelopeRequest("metrics", envelope);
+}
+
+MixRequest CommandMix::commandRequest(const QString& name, const patrol::Command& cmd)
+{
+    MixRequest req;
+    req.name = name;
+    req.payload = cmd.serialize(&m_serializer);
+    return req;
+}
+
+MixRequest CommandMix::envelopeRequest(const QString& name, const patrol::ServiceEnvelope& envelope)
+{
+    MixRequest req;
+    req.name = name;
+    req.payload = wrapServiceEnvelope(envelope.serialize(&m_serializer));
+    req.result = [](const QByteArray& payload) {
+        if (!isServiceEnvelope(payload)) {
+            return -1;
+        }
+        QProtobufSerializer serializer;
+        patrol::ServiceEnvelope response;
+        if (!response.deserialize(&serializer, serviceEnvelopeBody(payload))) {
+            return -1;
+        }
+        if (response.hasBatchResp()) {
+            return static_cast<int>(response.batchResp().result());
+        }
+        if (response.hasMetricsResp()) {
+            return static_cast<int>(response.metricsResp().result());
+        }
+        return -1;
+    };
+    return req;
+}
@@ -0,0 +1,58 @@
+#ifndef COMMANDMIX_H
+#define COMMANDMIX_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QRandomGenerator>
+#include <QProtobufSerializer>
+#include <functional>
+#include "command.qpb.h"
+#include "serviceext.qpb.h"
+
+// One request ready to encrypt: the plain payload plus how to read its result
+struct MixRequest {
+    QString name;
+    QByteArray payload;
+    std::function<int(const QByteArray& responsePayload)> result;  // RES_OK (0) on success, -1 if unparseable
+};
+
+/**
+ * @brief CommandMix - Weighted set of request types for the load generator
+ *
+ * Spec format: "name:weight,name:weight", e.g. "acpiread:4,caps:1,batch:1".
+ * Weights are relative; each next() picks one type at random by weight.
+ */
+class CommandMix
+{
+public:
+    CommandMix();
+
+    static QStringList knownCommands();
+    static QString defaultSpec() { return QStringLiteral("acpiread:4,ecstatus:1,caps:1"); }
+
+    bool parse(const QString& spec, QString* error);
+    QStringList names() const;
+
+    MixRequest next(quint32 sequence);
+
+    // Service envelope asking for the server's dispatch metrics
+    MixRequest metricsRequest(quint32 sequence, bool reset);
+
+private:
+    struct Entry {
+        QString name;
+        int weight = 1;
+    };
+
+    MixRequest build(const QString& name, quint32 sequence);
+    MixRequest commandRequest(const QString& name, const patrol::Command& cmd);
+    MixRequest envelopeRequest(const QString& name, const patrol::ServiceEnvelope& envelope);
+
+    QList<Entry> m_entries;
+    int m_totalWeight;
+    QRandomGenerator m_rng;
+    QProtobufSerializer m_serializer;
+};
+
+#endif // COMMANDMIX_H
@@ -0,0 +1,224 @@
+#include "loadclient.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include "secureprotocol.h"
+
+LoadClient::LoadClient(int id, const QString& pipeName, CommandMix* mix, LoadStats* stats,
+                       const QElapsedTimer* clock, QObject* parent)
+    : QObject(parent)
+    , m_id(id)
+    , m_pipeName(pipeName)
+    , m_mix(mix)
+    , m_stats(stats)
+    , m_clock(clock)
+    , m_state(State::Idle)
+    , m_token(0)
+    , m_sequence(0)
+    , m_running(false)
+    , m_intervalNs(0)
+    , m_nextDueNs(0)
+    , m_inFlight(false)
+    , m_metricsInFlight(false)
+    , m_metricsPending(false)
+    , m_metricsReset(false)
+    , m_startNs(0)
+{
+    m_timeout.setSingleShot(true);
+    m_pace.setSingleShot(true);
+    m_pace.setTimerType(Qt::PreciseTimer);
+
+    connect(&m_socket, &QLocalSocket::connected, this, &LoadClient::onConnected);
+    connect(&m_socket, &QLocalSocket::readyRead, this, &LoadClient::onReadyRead);
+    connect(&m_socket, &QLocalSocket::disconnected, this, &LoadClient::onDisconnected);
+    connect(&m_socket, &QLocalSocket::errorOccurred, this, [this](QLocalSocket::LocalSocketError) {
+        fail(m_socket.errorString());
+    });
+    connect(&m_timeout, &QTimer::timeout, this, &LoadClient::onTimeout);
+    connect(&m_pace, &QTimer::timeout, this, &LoadClient::sendNext);
+}
+
+void LoadClient::connectToService()
+{
+    m_state = State::Connecting;
+    m_socket.connectToServer(m_pipeName);
+}
+
+void LoadClient::onConnected()
+{
+    // Same handshake as the real clients: SHA256("AuthChallenge" + SHARED_SECRET) with token 0
+    m_state = State::Authenticating;
+    QByteArray auth = QCryptographicHash::hash(QByteArray("AuthChallenge") + SHARED_SECRET,
+                                               QCryptographicHash::Sha256);
+    m_rx.clear();
+    m_socket.write(SecurePacketBuilder::buildPacket(0, 0, auth));
+    m_timeout.start(LOADGEN_REQUEST_TIMEOUT_MS);
+}
+
+void LoadClient::startLoad(double ratePerSec)
+{
+    if (m_state != State::Ready) {
+        return;
+    }
+
+    m_running = true;
+    m_intervalNs = ratePerSec > 0 ? static_cast<qint64>(1e9 / ratePerSec) : 0;
+    m_nextDueNs = m_clock->nsecsElapsed();
+    sendNext();
+}
+
+void LoadClient::stopLoad()
+{
+    m_running = false;
+    m_pace.stop();
+}
+
+void LoadClient::requestMetrics(bool reset)
+{
+    if (m_state != State::Ready) {
+        return;
+    }
+
+    // Goes out ahead of the next load request, or right away if idle
+    m_metricsPending = true;
+    m_metricsReset = reset;
+    if (!m_inFlight) {
+        m_pace.stop();
+        scheduleNext();
+    }
+}
+
+void LoadClient::sendNext()
+{
+    if (!m_running || m_inFlight || m_state != State::Ready) {
+        return;
+    }
+
+    qint64 startNs = m_clock->nsecsElapsed();
+    if (m_intervalNs > 0) {
+        // Measure from the scheduled slot, not the actual send, to avoid coordinated omission
+        startNs = m_nextDueNs;
+        m_nextDueNs += m_intervalNs;
+    }
+
+    send(m_mix->next(++m_sequence), startNs);
+}
+
+void LoadClient::send(const MixRequest& request, qint64 startNs)
+{
+    m_current = request;
+    m_startNs = startNs;
+    m_inFlight = true;
+    m_rx.clear();
+
+    m_socket.write(SecurePacketBuilder::buildPacket(m_token, m_sequence, request.payload));
+    m_timeout.start(LOADGEN_REQUEST_TIMEOUT_MS);
+}
+
+void LoadClient::scheduleNext()
+{
+    if (m_metricsPending) {
+        m_metricsPending = false;
+        m_metricsInFlight = true;
+        send(m_mix->metricsRequest(++m_sequence, m_metricsReset), m_clock->nsecsElapsed());
+        return;
+    }
+
+    if (!m_running) {
+        return;
+    }
+
+    if (m_intervalNs <= 0) {
+        sendNext();
+        return;
+    }
+
+    qint64 waitNs = m_nextDueNs - m_clock->nsecsElapsed();
+    m_pace.start(waitNs > 0 ? static_cast<int>(waitNs / 1000000) : 0);
+}
+
+void LoadClient::onReadyRead()
+{
+    m_rx.append(m_socket.readAll());
+
+    // A response may arrive in pieces; keep reading until it parses
+    SecurePacketHeaderV2 header;
+    QByteArray payload;
+    if (!SecurePacketBuilder::parsePacket(m_rx, header, payload)) {
+        if (m_rx.size() > LOADGEN_MAX_RESPONSE) {
+            fail("Unparseable response");
+        }
+        return;
+    }
+    m_rx.clear();
+    m_timeout.stop();
+
+    if (m_state == State::Authenticating) {
+        QDataStream stream(payload);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream >> m_token;
+        m_state = State::Ready;
+        emit ready(m_id);
+        return;
+    }
+
+    // Sequence 0 is an unsolicited push; anything else but the current
+    // sequence is a late answer to a request that already timed out
+    if (!m_inFlight || header.sequenceNumber != m_sequence) {
+        return;
+    }
+
+    m_inFlight = false;
+
+    if (m_metricsInFlight) {
+        m_metricsInFlight = false;
+        emit metricsReceived(payload);
+        scheduleNext();
+        return;
+    }
+
+    const qint64 latencyUs = (m_clock->nsecsElapsed() - m_startNs) / 1000;
+    if (m_current.result && m_current.result(payload) == 0) {
+        m_stats->recordSuccess(m_current.name, latencyUs);
+    } else {
+        m_stats->recordError(m_current.name, latencyUs);
+    }
+
+    scheduleNext();
+}
+
+void LoadClient::onTimeout()
+{
+    if (m_state == State::Authenticating) {
+        fail("Authentication timed out");
+        return;
+    }
+
+    if (m_inFlight) {
+        m_stats->recordTimeout(m_current.name);
+        m_inFlight = false;
+        m_metricsInFlight = false;
+        m_rx.clear();
+        scheduleNext();
+    }
+}
+
+void LoadClient::onDisconnected()
+{
+    if (m_state != State::Idle) {
+        fail("Disconnected by service");
+    }
+}
+
+void LoadClient::fail(const QString& reason)
+{
+    if (m_state == State::Idle) {
+        return;
+    }
+
+    m_state = State::Idle;
+    m_running = false;
+    m_inFlight = false;
+    m_timeout.stop();
+    m_pace.stop();
+    emit failed(m_id, reason);
+}
@@ -0,0 +1,89 @@
+#ifndef LOADCLIENT_H
+#define LOADCLIENT_H
+
+#include <QObject>
+#include <QLocalSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "commandmix.h"
+#include "loadstats.h"
+
+#define LOADGEN_REQUEST_TIMEOUT_MS  5000
+#define LOADGEN_MAX_RESPONSE        (1024 * 1024)
+
+/**
+ * @brief LoadClient - One authenticated connection driving requests at a set rate
+ *
+ * The service reads each pipe message as one packet, so a client keeps at most
+ * one request in flight. With a rate set, requests are scheduled on a fixed
+ * timetable and latency is measured from the scheduled time, so a slow server
+ * shows up as latency rather than as a lower send rate.
+ */
+class LoadClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoadClient(int id, const QString& pipeName, CommandMix* mix, LoadStats* stats,
+               const QElapsedTimer* clock, QObject* parent = nullptr);
+
+    void connectToService();
+
+    // ratePerSec <= 0 sends the next request as soon as the previous one completes
+    void startLoad(double ratePerSec);
+    void stopLoad();
+
+    // One-off MetricsRequest, sent as soon as no request is in flight. The
+    // decrypted response payload comes back through metricsReceived.
+    void requestMetrics(bool reset);
+
+    bool isIdle() const { return !m_inFlight; }
+    int id() const { return m_id; }
+
+signals:
+    void ready(int id);
+    void failed(int id, const QString& reason);
+    void metricsReceived(const QByteArray& payload);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+    void onDisconnected();
+    void onTimeout();
+    void sendNext();
+
+private:
+    enum class State { Idle, Connecting, Authenticating, Ready };
+
+    void send(const MixRequest& request, qint64 startNs);
+    void scheduleNext();
+    void fail(const QString& reason);
+
+    int m_id;
+    QString m_pipeName;
+    CommandMix* m_mix;
+    LoadStats* m_stats;
+    const QElapsedTimer* m_clock;
+
+    QLocalSocket m_socket;
+    QTimer m_timeout;
+    QTimer m_pace;
+    QByteArray m_rx;
+
+    State m_state;
+    quint32 m_token;
+    quint32 m_sequence;
+
+    bool m_running;
+    qint64 m_intervalNs;
+    qint64 m_nextDueNs;
+
+    bool m_inFlight;
+    bool m_metricsInFlight;
+    bool m_metricsPending;
+    bool m_metricsReset;
+    MixRequest m_current;
+    qint64 m_startNs;
+};
+
+#endif // LOADCLIENT_H
@@ -0,0 +1,78 @@
+#include "loadstats.h"
+#include <algorithm>
+
+void LoadStats::recordSuccess(const QString& name, qint64 latencyUs)
+{
+    m_series[name].latenciesUs.append(latencyUs);
+    m_completed++;
+}
+
+void LoadStats::recordError(const QString& name, qint64 latencyUs)
+{
+    Series& series = m_series[name];
+    series.latenciesUs.append(latencyUs);
+    series.errors++;
+    m_completed++;
+}
+
+void LoadStats::recordTimeout(const QString& name)
+{
+    m_series[name].timeouts++;
+}
+
+LoadStats::Summary LoadStats::summary(const QString& name) const
+{
+    auto it = m_series.constFind(name);
+    if (it == m_series.cend()) {
+        return Summary();
+    }
+    return summarize(it->latenciesUs, it->errors, it->timeouts);
+}
+
+LoadStats::Summary LoadStats::total() const
+{
+    QVector<qint64> all;
+    quint64 errors = 0;
+    quint64 timeouts = 0;
+    for (const Series& series : m_series) {
+        all += series.latenciesUs;
+        errors += series.errors;
+        timeouts += series.timeouts;
+    }
+    return summarize(all, errors, timeouts);
+}
+
+void LoadStats::clear()
+{
+    m_series.clear();
+    m_completed = 0;
+}
+
+LoadStats::Summary LoadStats::summarize(QVector<qint64> samples, quint64 errors, quint64 timeouts)
+{
+    Summary s;
+    s.errors = errors;
+    s.timeouts = timeouts;
+    s.count = samples.size();
+    if (samples.isEmpty()) {
+        return s;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    qint64 sum = 0;
+    for (qint64 v : samples) {
+        sum += v;
+    }
+
+    auto percentile = [&samples](double p) {
+        int index = static_cast<int>(p * (samples.size() - 1) + 0.5);
+        return samples.at(qBound(0, index, static_cast<int>(samples.size()) - 1));
+    };
+
+    s.meanUs = static_cast<double>(sum) / samples.size();
+    s.p50Us = percentile(0.50);
+    s.p99Us = percentile(0.99);
+    s.maxUs = samples.last();
+    return s;
+}
@@ -0,0 +1,51 @@
+#ifndef LOADSTATS_H
+#define LOADSTATS_H
+
+#include <QString>
+#include <QMap>
+#include <QVector>
+
+/**
+ * @brief LoadStats - Client-side latency samples and error counts per request type
+ *
+ * All clients run on the one event loop thread, so no locking is needed.
+ */
+class LoadStats
+{
+public:
+    struct Summary {
+        quint64 count = 0;
+        quint64 errors = 0;
+        quint64 timeouts = 0;
+        double meanUs = 0.0;
+        qint64 p50Us = 0;
+        qint64 p99Us = 0;
+        qint64 maxUs = 0;
+    };
+
+    void recordSuccess(const QString& name, qint64 latencyUs);
+    void recordError(const QString& name, qint64 latencyUs);
+    void recordTimeout(const QString& name);
+
+    quint64 completed() const { return m_completed; }
+    QStringList names() const { return m_series.keys(); }
+
+    Summary summary(const QString& name) const;
+    Summary total() const;
+
+    void clear();
+
+private:
+    struct Series {
+        QVector<qint64> latenciesUs;
+        quint64 errors = 0;
+        quint64 timeouts = 0;
+    };
+
+    static Summary summarize(QVector<qint64> samples, quint64 errors, quint64 timeouts);
+
+    QMap<QString, Series> m_series;
+    quint64 m_completed = 0;
+};
+
+#endif // LOADSTATS_H
@@ -0,0 +1,216 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include <QTextStream>
+#include <QProtobufSerializer>
+#include "loadclient.h"
+#include "serviceenvelope.h"
+
+// ============================================================================
+// CSLoadGen - end-to-end load test for the CSService secure pipe protocol
+//
+//   CSLoadGen --pipe PPC_SERV --connections 4 --rate 200 --duration 30 \
+//             --mix acpiread:4,caps:1,batch:1 --server-metrics
+//
+// Opens N authenticated connections, drives the command mix at the target
+// aggregate rate, then prints client-side throughput and latency per request
+// type. With --server-metrics the service's own per-handler timings are
+// fetched (MetricsRequest) and set against the client view; the difference is
+// time spent outside the handler - pipe transport, crypto and queueing.
+// ============================================================================
+
+namespace {
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// Upper bucket bound at which the cumulative count reaches fraction p
+qint64 histogramPercentile(const patrol::HandlerMetrics& m, const QList<quint32>& bounds, double p)
+{
+    const quint64 target = static_cast<quint64>(p * m.calls() + 0.5);
+    quint64 seen = 0;
+    const auto buckets = m.latencyBuckets();
+    for (int i = 0; i < buckets.size(); i++) {
+        seen += buckets.at(i);
+        if (seen >= target) {
+            return i < bounds.size() ? bounds.at(i) : static_cast<qint64>(m.maxUs());
+        }
+    }
+    return static_cast<qint64>(m.maxUs());
+}
+
+void printServerMetrics(const QByteArray& payload)
+{
+    QProtobufSerializer serializer;
+    patrol::ServiceEnvelope envelope;
+    if (!isServiceEnvelope(payload)
+        || !envelope.deserialize(&serializer, serviceEnvelopeBody(payload))
+        || !envelope.hasMetricsResp()) {
+        out() << "Server metrics: unexpected response\n";
+        return;
+    }
+
+    const patrol::MetricsResponse& metrics = envelope.metricsResp();
+    QList<quint32> bounds;
+    for (auto b : metrics.bucketBoundsUs()) {
+        bounds.append(static_cast<quint32>(b));
+    }
+
+    out() << "\nServer-side dispatch (handler time only)\n";
+    out() << QString("%1 %2 %3 %4 %5 %6\n")
+                 .arg("handler", -24).arg("calls", 10).arg("errors", 8)
+                 .arg("mean us", 10).arg("p50<=us", 10).arg("p99<=us", 10);
+    for (const patrol::HandlerMetrics& m : metrics.handlers()) {
+        const double mean = m.calls() ? static_cast<double>(m.totalUs()) / m.calls() : 0.0;
+        out() << QString("%1 %2 %3 %4 %5 %6\n")
+                     .arg(m.name(), -24).arg(static_cast<quint64>(m.calls()), 10)
+                     .arg(static_cast<quint64>(m.errors()), 8).arg(mean, 10, 'f', 1)
+                     .arg(histogramPercentile(m, bounds, 0.50), 10)
+                     .arg(histogramPercentile(m, bounds, 0.99), 10);
+    }
+    out() << "unknown commands: " << static_cast<quint64>(metrics.unknownCommands()) << "\n";
+}
+
+void printClientStats(const LoadStats& stats, double seconds)
+{
+    out() << "\nClient-side latency (scheduled send to decrypted response)\n";
+    out() << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                 .arg("type", -12).arg("count", 10).arg("errors", 8).arg("timeouts", 9)
+                 .arg("mean us", 10).arg("p50 us", 10).arg("p99 us", 10).arg("max us", 10);
+
+    auto row = [](const QString& name, const LoadStats::Summary& s) {
+        out() << QString("%1 %2 %3 %4 %5 %6 %7 %8\n")
+                     .arg(name, -12).arg(s.count, 10).arg(s.errors, 8).arg(s.timeouts, 9)
+                     .arg(s.meanUs, 10, 'f', 1).arg(s.p50Us, 10).arg(s.p99Us, 10).arg(s.maxUs, 10);
+    };
+
+    for (const QString& name : stats.names()) {
+        row(name, stats.summary(name));
+    }
+    const LoadStats::Summary total = stats.total();
+    row("TOTAL", total);
+
+    out() << QString("\nThroughput: %1 req/s over %2 s\n")
+                 .arg(seconds > 0 ? total.count / seconds : 0.0, 0, 'f', 1)
+                 .arg(seconds, 0, 'f', 1);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSLoadGen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator for the CSService secure pipe protocol");
+    parser.addHelpOption();
+    parser.addOptions({
+        {{"p", "pipe"}, "Pipe to connect to (PPC_SERV or PPC_MON).", "name", "PPC_SERV"},
+        {{"c", "connections"}, "Number of concurrent authenticated clients.", "n", "4"},
+        {{"r", "rate"}, "Aggregate target rate in requests/s (0 = closed loop, as fast as possible).", "rps", "0"},
+        {{"d", "duration"}, "Measured run length in seconds.", "s", "10"},
+        {{"w", "warmup"}, "Unmeasured warm-up in seconds.", "s", "1"},
+        {{"m", "mix"}, QString("Weighted command mix. Known: %1").arg(CommandMix::knownCommands().join(", ")),
+         "spec", CommandMix::defaultSpec()},
+        {"server-metrics", "Reset server metrics after warm-up and report them at the end."},
+    });
+    parser.process(app);
+
+    const QString pipeName = parser.value("pipe");
+    const int connections = qMax(1, parser.value("connections").toInt());
+    const double rate = parser.value("rate").toDouble();
+    const int durationSec = qMax(1, parser.value("duration").toInt());
+    const int warmupSec = qMax(0, parser.value("warmup").toInt());
+    const bool serverMetrics = parser.isSet("server-metrics");
+
+    CommandMix mix;
+    QString error;
+    if (!mix.parse(parser.value("mix"), &error)) {
+        out() << "Invalid --mix: " << error << "\n";
+        return 1;
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    LoadStats stats;
+    QList<LoadClient*> clients;
+    int readyCount = 0;
+    int failedCount = 0;
+    qint64 measureStartNs = 0;
+
+    auto finish = [&]() {
+        for (LoadClient* client : clients) {
+            client->stopLoad();
+        }
+        const double seconds = (clock.nsecsElapsed() - measureStartNs) / 1e9;
+        printClientStats(stats, seconds);
+
+        if (!serverMetrics || clients.isEmpty()) {
+            app.exit(failedCount == connections ? 1 : 0);
+            return;
+        }
+
+        // Let in-flight requests drain, then ask the service for its side
+        LoadClient* probe = clients.first();
+        QObject::connect(probe, &LoadClient::metricsReceived, &app, [&](const QByteArray& payload) {
+            printServerMetrics(payload);
+            app.exit(0);
+        });
+        probe->requestMetrics(false);
+        QTimer::singleShot(LOADGEN_REQUEST_TIMEOUT_MS * 2, &app, [&]() {
+            out() << "Server metrics: no response\n";
+            app.exit(0);
+        });
+    };
+
+    bool started = false;
+    auto beginLoad = [&]() {
+        started = true;
+        out() << QString("Running %1 clients on %2, mix %3, rate %4\n")
+                     .arg(readyCount).arg(pipeName, mix.names().join("/"))
+                     .arg(rate > 0 ? QString("%1 req/s").arg(rate) : QString("closed loop"));
+        out().flush();
+
+        for (LoadClient* client : clients) {
+            client->startLoad(rate > 0 ? rate / readyCount : 0);
+        }
+
+        QTimer::singleShot(warmupSec * 1000, &app, [&]() {
+            stats.clear();
+            measureStartNs = clock.nsecsElapsed();
+            if (serverMetrics && !clients.isEmpty()) {
+                // Zero the server counters so both sides cover the same window
+                clients.first()->requestMetrics(true);
+            }
+            QTimer::singleShot(durationSec * 1000, &app, finish);
+        });
+    };
+
+    for (int i = 0; i < connections; i++) {
+        LoadClient* client = new LoadClient(i, pipeName, &mix, &stats, &clock, &app);
+        clients.append(client);
+
+        QObject::connect(client, &LoadClient::ready, &app, [&](int) {
+            if (++readyCount + failedCount == connections && !started) {
+                beginLoad();
+            }
+        });
+        QObject::connect(client, &LoadClient::failed, &app, [&, client](int id, const QString& reason) {
+            out() << QString("Client %1 failed: %2\n").arg(id).arg(reason);
+            clients.removeOne(client);
+            if (++failedCount == connections) {
+                app.exit(1);
+            } else if (readyCount + failedCount == connections && !started) {
+                beginLoad();
+            }
+        });
+
+        client->connectToService();
+    }
+
+    return app.exec();
+}
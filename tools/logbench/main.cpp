@@ -0,0 +1,267 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QTextStream>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "logger.h"
+#include "latencyhistogram.h"
+
+// ============================================================================
+// CSLogBench - what a log() call costs the caller
+//
+//   CSLogBench --threads 8 --messages 50000 --mode all [--format binary]
+//
+// N threads log M messages each as fast as they can. Reports per-call latency
+// as seen by the logging thread, aggregate throughput, the time until
+// everything is on disk, and how many records the overflow policy dropped.
+// "legacy" is a copy of the pre-async log(): a file size stat, a formatted
+// timestamp and a qDebug echo on every call, write + flush under a mutex
+// (redirect stderr to keep the echo off the terminal). "sync" is today's
+// Logger in Synchronous mode, "async" the ring + writer thread. --format
+// binary logs through LOG_FMT into a binary file; the bytes-per-message
+// figure compares the two formats.
+// ============================================================================
+
+namespace {
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+quint64 histogramPercentile(const LatencyHistogram::Snapshot& snap, double p)
+{
+    const QList<quint32>& bounds = LatencyHistogram::boundsUs();
+    const quint64 target = static_cast<quint64>(p * snap.count + 0.5);
+    quint64 seen = 0;
+    for (int i = 0; i < snap.buckets.size(); i++) {
+        seen += snap.buckets.at(i);
+        if (seen >= target) {
+            return i < bounds.size() ? bounds.at(i) : snap.maxUs;
+        }
+    }
+    return snap.maxUs;
+}
+
+qint64 directoryBytes(const QString& path)
+{
+    qint64 total = 0;
+    for (const QFileInfo& info : QDir(path).entryInfoList(QDir::Files)) {
+        total += info.size();
+    }
+    return total;
+}
+
+// The log() path as it was before the ring: everything inline under one mutex
+class LegacyLogger
+{
+public:
+    explicit LegacyLogger(const QString& logDir)
+        : m_logDir(logDir)
+        , m_fileIndex(0)
+    {
+        QDir().mkpath(m_logDir);
+        openNewLogFile();
+    }
+
+    void log(const QString& message, Logger::LogLevel level)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (!m_logFile.isOpen()) {
+            return;
+        }
+
+        // Check file size and rotate if needed
+        if (m_logFile.size() > LEGACY_MAX_LOG_FILE_SIZE) {
+            openNewLogFile();
+        }
+
+        QString levelText;
+        switch (level) {
+        case Logger::Info:    levelText = "[INFO]";  break;
+        case Logger::Warning: levelText = "[WARN]";  break;
+        case Logger::Error:   levelText = "[ERROR]"; break;
+        case Logger::Debug:   levelText = "[DEBUG]"; break;
+        default:              levelText = "[INFO]";  break;
+        }
+
+        QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
+        QString logLine = QString("%1 %2 %3").arg(timestamp, levelText, message);
+
+        m_logStream << logLine << "\n";
+        m_logStream.flush();
+        qDebug().noquote() << logLine;
+    }
+
+private:
+    static constexpr qint64 LEGACY_MAX_LOG_FILE_SIZE = 5 * 1024 * 1024;
+
+    void openNewLogFile()
+    {
+        m_logStream.setDevice(nullptr);
+        m_logFile.close();
+        m_logFile.setFileName(QString("%1/log_%2.txt").arg(m_logDir).arg(m_fileIndex++));
+        if (m_logFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Append)) {
+            m_logStream.setDevice(&m_logFile);
+        }
+    }
+
+    QString m_logDir;
+    QFile m_logFile;
+    QTextStream m_logStream;
+    QMutex m_mutex;
+    int m_fileIndex;
+};
+
+struct BenchResult {
+    LatencyHistogram::Snapshot calls;
+    qint64 producedNs = 0;
+    qint64 flushedNs = 0;
+    quint64 dropped = 0;
+};
+
+// Runs logOne(thread, message) on every thread, then flush() until on disk
+BenchResult timeCalls(int threadCount, int messages, const std::function<void(int, int)>& logOne,
+                      const std::function<void()>& flush)
+{
+    LatencyHistogram callLatency;
+    QElapsedTimer clock;
+    std::vector<std::thread> threads;
+
+    clock.start();
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            QElapsedTimer timer;
+            for (int i = 0; i < messages; i++) {
+                timer.start();
+                logOne(t, i);
+                callLatency.record(static_cast<quint64>(timer.nsecsElapsed() / 1000));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    BenchResult result;
+    result.producedNs = clock.nsecsElapsed();
+    flush();
+    result.flushedNs = clock.nsecsElapsed();
+    result.calls = callLatency.snapshot();
+    return result;
+}
+
+void report(const QString& label, const BenchResult& r, const QString& logDir, int threadCount, int messages)
+{
+    const LatencyHistogram::Snapshot& s = r.calls;
+    const double total = static_cast<double>(threadCount) * messages;
+
+    out() << QString("%1: %2 msgs/s from callers, %3 msgs/s to disk\n")
+                 .arg(label, -6)
+                 .arg(total / (r.producedNs / 1e9), 0, 'f', 0)
+                 .arg(total / (r.flushedNs / 1e9), 0, 'f', 0);
+    out() << QString("        log() avg %1 us, p50 <= %2 us, p99 <= %3 us, max %4 us, dropped %5\n")
+                 .arg(s.count ? static_cast<double>(s.totalUs) / s.count : 0.0, 0, 'f', 2)
+                 .arg(histogramPercentile(s, 0.50))
+                 .arg(histogramPercentile(s, 0.99))
+                 .arg(s.maxUs)
+                 .arg(r.dropped);
+    out() << QString("        %1 bytes on disk per message\n")
+                 .arg(directoryBytes(logDir) / total, 0, 'f', 1);
+    out().flush();
+}
+
+void runLegacyBench(const QString& logDir, int threadCount, int messages)
+{
+    QDir(logDir).removeRecursively();
+    LegacyLogger logger(logDir);
+
+    const BenchResult r = timeCalls(threadCount, messages, [&](int t, int i) {
+        logger.log(QString("bench thread %1 message %2 - EC ACPI0 Read offset=0x0026, size=4").arg(t).arg(i),
+                   (i % 100 == 0) ? Logger::Warning : Logger::Info);
+    }, []() {});
+
+    report("legacy", r, logDir, threadCount, messages);
+}
+
+void runBench(const QString& label, Logger::Mode mode, Logger::FileFormat format, Logger::OverflowPolicy policy,
+              const QString& logDir, int threadCount, int messages)
+{
+    QDir(logDir).removeRecursively();
+    Logger logger(logDir, nullptr, mode, format);
+    logger.setOverflowPolicy(policy);
+
+    BenchResult r = timeCalls(threadCount, messages, [&](int t, int i) {
+        if (format == Logger::BinaryFile) {
+            if (i % 100 == 0) {
+                LOG_FMT(&logger, CatGeneral, Warning, "bench thread %1 message %2 - EC ACPI%3 Read offset=0x%4, size=%5",
+                        t, i, 0, Logger::hex(0x26, 4), 4);
+            } else {
+                LOG_FMT(&logger, CatGeneral, Info, "bench thread %1 message %2 - EC ACPI%3 Read offset=0x%4, size=%5",
+                        t, i, 0, Logger::hex(0x26, 4), 4);
+            }
+        } else {
+            logger.log(QString("bench thread %1 message %2 - EC ACPI0 Read offset=0x0026, size=4").arg(t).arg(i),
+                       (i % 100 == 0) ? Logger::Warning : Logger::Info);
+        }
+    }, [&]() { logger.flush(); });
+    r.dropped = logger.droppedCount();
+
+    report(label, r, logDir, threadCount, messages);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSLogBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Logger throughput and caller latency benchmark");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"threads", "Logging threads.", "n", "4"},
+        {"messages", "Messages per thread.", "n", "50000"},
+        {"mode", "legacy, sync, async or all.", "mode", "all"},
+        {"policy", "Async overflow policy: drop, block or warn (block Warning/Error only).", "policy", "warn"},
+        {"format", "Log file format: text or binary.", "format", "text"},
+        {"log-dir", "Scratch directory for log files.", "path", QDir::tempPath() + "/CSLogBench"},
+    });
+    parser.process(app);
+
+    const int threadCount = qMax(1, parser.value("threads").toInt());
+    const int messages = qMax(1, parser.value("messages").toInt());
+    const QString mode = parser.value("mode");
+    const QString logDir = parser.value("log-dir");
+    const Logger::FileFormat format = parser.value("format") == "binary" ? Logger::BinaryFile : Logger::TextFile;
+
+    Logger::OverflowPolicy policy = Logger::BlockOnWarning;
+    if (parser.value("policy") == "drop") {
+        policy = Logger::DropNewest;
+    } else if (parser.value("policy") == "block") {
+        policy = Logger::Block;
+    }
+
+    if (mode == "legacy" || mode == "all") {
+        runLegacyBench(logDir + "/legacy", threadCount, messages);
+    }
+    if (mode == "sync" || mode == "all") {
+        runBench("sync", Logger::Synchronous, format, policy, logDir + "/sync", threadCount, messages);
+    }
+    if (mode == "async" || mode == "all") {
+        runBench("async", Logger::Async, format, policy, logDir + "/async", threadCount, messages);
+    }
+
+    return 0;
+}
@@ -0,0 +1,330 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <functional>
+#include "logformat.h"
+#include "logger.h"
+
+// ============================================================================
+// CSLogDecode - text rendering of binary service logs
+//
+//   CSLogDecode "C:\ProgramData\Patrol PC\Service" --category EcManager,EmiThread --level debug
+//
+// Takes .clog files or directories (all log_*.clog, oldest first) and writes
+// the same lines the text log would have contained. --category and --level
+// filter on the record header without rendering the message.
+//
+//   CSLogDecode --verify-rotation [--log-dir <scratch>]
+//
+// Round trip through the real Logger: writes binary records that carry their
+// own wall-clock time until the file rotates, decodes every file and checks
+// each decoded timestamp against the one in the message.
+// ============================================================================
+
+namespace {
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream& err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+struct Filter {
+    QSet<QString> categories;   // Lower-case names; empty = all
+    int minSeverity = 0;
+};
+
+struct FileStats {
+    quint64 records = 0;
+    quint64 shown = 0;
+};
+
+#define VERIFY_PADDING_BYTES    (64 * 1024)     // Per record, so a rotation takes ~80 records
+#define VERIFY_INTERVAL_MS      20              // Gap between records; the skew a bad base would cause
+#define VERIFY_TOLERANCE_MS     5
+#define VERIFY_AFTER_ROTATION   10              // Records logged into the second file
+#define VERIFY_MAX_RECORDS      1000
+
+// Receives every record that passes the filter
+using RecordSink = std::function<void(qint64 wallMs, int severity, const QString& category, const QString& message)>;
+
+void printRecord(qint64 wallMs, int severity, const QString& category, const QString& message)
+{
+    out() << QDateTime::fromMSecsSinceEpoch(wallMs).toString("yyyy-MM-dd hh:mm:ss.zzz")
+          << ' ' << LogFormat::severityTag(severity) << ' ';
+    if (!category.isEmpty()) {
+        out() << '[' << category << "] ";
+    }
+    out() << message << '\n';
+}
+
+int severityFromName(const QString& name)
+{
+    const QString lower = name.toLower();
+    if (lower == "debug") return 0;
+    if (lower == "info") return 1;
+    if (lower == "warning" || lower == "warn") return 2;
+    if (lower == "error") return 3;
+    return -1;
+}
+
+bool decodeFile(const QString& path, const Filter& filter, FileStats& stats, const RecordSink& sink)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err() << path << ": " << file.errorString() << "\n";
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    const char* p = data.constData();
+    const char* end = p + data.size();
+
+    const int magicLength = static_cast<int>(sizeof(LOG_BINARY_MAGIC) - 1);
+    if (data.size() < magicLength + 1 || !data.startsWith(LOG_BINARY_MAGIC)) {
+        err() << path << ": not a binary log\n";
+        return false;
+    }
+    p += magicLength;
+    if (static_cast<quint8>(*p++) != LOG_BINARY_VERSION) {
+        err() << path << ": unsupported version " << static_cast<quint8>(p[-1]) << "\n";
+        return false;
+    }
+
+    // Session state
+    qint64 epochMs = 0;
+    qint64 sessionMonoUs = 0;
+    qint64 lastMonoUs = 0;
+    QStringList categoryNames;
+    QHash<quint64, QByteArray> formats;
+
+    while (p < end) {
+        const char* recordStart = p;
+        const quint8 type = static_cast<quint8>(*p++);
+        bool ok = true;
+
+        if (type == LogFormat::RecSession) {
+            quint64 wall, mono, base, count;
+            ok = LogFormat::getVarint(p, end, &wall)
+                 && LogFormat::getVarint(p, end, &mono)
+                 && LogFormat::getVarint(p, end, &base)
+                 && LogFormat::getVarint(p, end, &count);
+            categoryNames.clear();
+            for (quint64 i = 0; ok && i < count; i++) {
+                QByteArray name;
+                ok = LogFormat::getString(p, end, &name);
+                categoryNames.append(QString::fromUtf8(name));
+            }
+            epochMs = static_cast<qint64>(wall);
+            sessionMonoUs = static_cast<qint64>(mono);
+            lastMonoUs = static_cast<qint64>(base);
+        }
+        else if (type == LogFormat::RecFormat) {
+            quint64 id;
+            QByteArray format;
+            ok = LogFormat::getVarint(p, end, &id) && LogFormat::getString(p, end, &format);
+            formats.insert(id, format);
+        }
+        else if (type == LogFormat::RecEvent || type == LogFormat::RecText) {
+            qint64 delta = 0;
+            quint8 tag = 0;
+            quint64 formatId = 0;
+            QByteArray payload;
+            ok = LogFormat::getSigned(p, end, &delta) && p < end;
+            if (ok) {
+                tag = static_cast<quint8>(*p++);
+                if (type == LogFormat::RecEvent) {
+                    ok = LogFormat::getVarint(p, end, &formatId);
+                }
+                ok = ok && LogFormat::getString(p, end, &payload);
+            }
+
+            if (ok) {
+                const int category = tag >> 2;
+                const int severity = tag & 0x03;
+                lastMonoUs += delta;
+                stats.records++;
+
+                const QString categoryName = category < categoryNames.size()
+                                                 ? categoryNames.at(category)
+                                                 : QString::number(category);
+                if (severity < filter.minSeverity
+                    || (!filter.categories.isEmpty() && !filter.categories.contains(categoryName.toLower()))) {
+                    continue;
+                }
+                stats.shown++;
+
+                QString message;
+                if (type == LogFormat::RecText) {
+                    message = QString::fromUtf8(payload);
+                } else if (formats.contains(formatId)) {
+                    message = LogFormat::render(formats.value(formatId).constData(), payload);
+                } else {
+                    message = QString("<unknown format %1>").arg(formatId);
+                }
+
+                const qint64 wallMs = epochMs + (lastMonoUs - sessionMonoUs) / 1000;
+                sink(wallMs, severity, category != 0 ? categoryName : QString(), message);
+            }
+        }
+        else {
+            ok = false;
+        }
+
+        if (!ok) {
+            // A crash can leave a partial record at the tail
+            err() << path << ": truncated or corrupt record at offset "
+                  << (recordStart - data.constData()) << "\n";
+            break;
+        }
+    }
+
+    return true;
+}
+
+QStringList logFiles(const QString& path)
+{
+    QStringList files;
+    QDir dir(path);
+    // Names carry the open time, so name order is chronological
+    for (const QString& name : dir.entryList(QStringList() << "log_*.clog", QDir::Files, QDir::Name)) {
+        files.append(dir.filePath(name));
+    }
+    return files;
+}
+
+int verifyRotation(const QString& logDir)
+{
+    QDir(logDir).removeRecursively();
+    QDir().mkpath(logDir);
+
+    // Each record is its own writer batch, so the record that triggers the
+    // rotation is encoded against the previous record's time
+    const QString padding(VERIFY_PADDING_BYTES, QChar('x'));
+    int logged = 0;
+    int afterRotation = -1;
+    {
+        Logger logger(logDir, nullptr, Logger::Async, Logger::BinaryFile);
+        while (logged < VERIFY_MAX_RECORDS && afterRotation < VERIFY_AFTER_ROTATION) {
+            LOG_FMT(&logger, CatGeneral, Info, "verify %1 wall=%2 %3",
+                    logged, QDateTime::currentMSecsSinceEpoch(), padding);
+            logged++;
+            logger.flush();
+            if (afterRotation >= 0) {
+                afterRotation++;
+            } else if (logFiles(logDir).size() > 1) {
+                afterRotation = 0;
+            }
+            QThread::msleep(VERIFY_INTERVAL_MS);
+        }
+    }
+
+    const QStringList files = logFiles(logDir);
+    if (files.size() < 2) {
+        err() << "No rotation after " << logged << " records\n";
+        return 1;
+    }
+
+    int checked = 0;
+    int failures = 0;
+    for (const QString& path : files) {
+        FileStats stats;
+        decodeFile(path, Filter(), stats, [&](qint64 wallMs, int, const QString&, const QString& message) {
+            if (!message.startsWith("verify ")) {
+                return;
+            }
+            const QStringList fields = message.split(' ');
+            const qint64 expected = fields.value(2).mid(5).toLongLong();
+            const qint64 skew = wallMs - expected;
+            checked++;
+            if (qAbs(skew) > VERIFY_TOLERANCE_MS) {
+                failures++;
+                err() << QFileInfo(path).fileName() << ": record " << fields.value(1)
+                      << " decoded " << skew << " ms off\n";
+            }
+        });
+    }
+
+    out() << checked << " of " << logged << " records checked across " << files.size() << " files, "
+          << failures << " off by more than " << VERIFY_TOLERANCE_MS << " ms\n";
+    out().flush();
+    return (failures == 0 && checked == logged) ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSLogDecode");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Render binary service logs as text");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"category", "Only these categories (comma separated, e.g. EcManager,Mirror).", "names"},
+        {"level", "Minimum level: debug, info, warning or error.", "level", "debug"},
+        {"stats", "Print record counts per file to stderr."},
+        {"verify-rotation", "Write records through the Logger across a file rotation and check the decoded times."},
+        {"log-dir", "Scratch directory for --verify-rotation.", "path", QDir::tempPath() + "/CSLogDecodeVerify"},
+    });
+    parser.addPositionalArgument("paths", "Binary log files or log directories.", "<path>...");
+    parser.process(app);
+
+    if (parser.isSet("verify-rotation")) {
+        return verifyRotation(parser.value("log-dir"));
+    }
+
+    Filter filter;
+    filter.minSeverity = severityFromName(parser.value("level"));
+    if (filter.minSeverity < 0) {
+        err() << "Unknown level: " << parser.value("level") << "\n";
+        return 1;
+    }
+    if (parser.isSet("category")) {
+        for (const QString& name : parser.value("category").split(',', Qt::SkipEmptyParts)) {
+            filter.categories.insert(name.trimmed().toLower());
+        }
+    }
+
+    QStringList files;
+    for (const QString& path : parser.positionalArguments()) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            files.append(logFiles(path));
+        } else {
+            files.append(path);
+        }
+    }
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    int failures = 0;
+    for (const QString& path : files) {
+        FileStats stats;
+        if (!decodeFile(path, filter, stats, printRecord)) {
+            failures++;
+        }
+        if (parser.isSet("stats")) {
+            err() << path << ": " << stats.records << " records, " << stats.shown << " shown, "
+                  << QFileInfo(path).size() << " bytes\n";
+        }
+    }
+    out().flush();
+
+    return failures ? 1 : 0;
+}
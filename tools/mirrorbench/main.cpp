@@ -0,0 +1,234 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "ecmemorymirror.h"
+#include "latencyhistogram.h"
+
+// ============================================================================
+// CSMirrorBench - contention benchmark for the EC memory mirror seqlock
+//
+//   CSMirrorBench --readers 8 --duration 10 --rate 1000 --size 256 [--delta] [--wait]
+//
+// One writer thread publishes updates to a single mirror region through
+// ECMemoryWriter while N reader threads, each with its own mapping, read as
+// fast as they can - whole-region copies, or line deltas with --delta. Every
+// update fills the payload with a single byte value, so a reader that ever
+// sees mixed bytes has seen a torn read (or a delta assembled wrongly).
+// Reports writer update latency, reader throughput and how often readers had
+// to retry. With --wait readers block in waitForChange() instead of spinning,
+// and the time from publish to wakeup is reported.
+// ============================================================================
+
+namespace {
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+struct ReaderStats {
+    quint64 reads = 0;
+    quint64 failures = 0;
+    quint64 torn = 0;
+    quint64 retries = 0;
+};
+
+quint64 histogramPercentile(const LatencyHistogram::Snapshot& snap, double p)
+{
+    const QList<quint32>& bounds = LatencyHistogram::boundsUs();
+    const quint64 target = static_cast<quint64>(p * snap.count + 0.5);
+    quint64 seen = 0;
+    for (int i = 0; i < snap.buckets.size(); i++) {
+        seen += snap.buckets.at(i);
+        if (seen >= target) {
+            return i < bounds.size() ? bounds.at(i) : snap.maxUs;
+        }
+    }
+    return snap.maxUs;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSMirrorBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("EC memory mirror reader/writer contention benchmark");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"readers", "Reader threads.", "n", "4"},
+        {"duration", "Run time in seconds.", "s", "5"},
+        {"rate", "Writer updates per second (0 = as fast as possible).", "n", "1000"},
+        {"size", "Payload bytes per update.", "bytes", "256"},
+        {"delta", "Readers refresh a local view with readChanged() instead of copying the region."},
+        {"wait", "Readers block in waitForChange() between reads."},
+        {"log-dir", "Directory for the mirror's log output.", "path", QDir::tempPath() + "/CSMirrorBench"},
+    });
+    parser.process(app);
+
+    const int readerCount = qMax(1, parser.value("readers").toInt());
+    const int durationSec = qMax(1, parser.value("duration").toInt());
+    const int rate = qMax(0, parser.value("rate").toInt());
+    const int size = qBound(1, parser.value("size").toInt(), EC_MIRROR_MAX_REGION_SIZE);
+    const bool delta = parser.isSet("delta");
+    const bool waitMode = parser.isSet("wait");
+
+    Logger logger(parser.value("log-dir"));
+
+    ECMemoryWriter writer(&logger);
+    writer.addRegion(EC_REGION_ECRAM, "ECRAM", static_cast<quint32>(size));
+    if (!writer.create()) {
+        out() << "Failed to create the mirror (already in use, or insufficient rights?)\n";
+        return 1;
+    }
+
+    std::vector<ECMemoryReader*> readers;
+    for (int i = 0; i < readerCount; i++) {
+        ECMemoryReader* reader = new ECMemoryReader(&logger);
+        if (!reader->open()) {
+            out() << "Failed to open reader " << i << "\n";
+            return 1;
+        }
+        readers.push_back(reader);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> ready(0);
+    LatencyHistogram writeLatency;
+    LatencyHistogram wakeLatency;
+    std::atomic<qint64> publishNs(0);
+    QElapsedTimer clock;
+    clock.start();
+    quint64 updates = 0;
+    std::vector<ReaderStats> stats(readerCount);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < readerCount; i++) {
+        threads.emplace_back([&, i]() {
+            ECMemoryReader* reader = readers[i];
+            ReaderStats& s = stats[i];
+            ECMirrorRegionView view;
+            uint32_t lastVersion = 0;
+            ready.fetch_add(1);
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (waitMode) {
+                    if (!reader->waitForChange(EC_REGION_ECRAM, lastVersion, 100, &lastVersion)) {
+                        continue;
+                    }
+                    const qint64 woke = clock.nsecsElapsed();
+                    wakeLatency.record(static_cast<quint64>(qMax<qint64>(0, woke - publishNs.load()) / 1000));
+                }
+
+                bool ok = false;
+                QByteArray data;
+                if (delta) {
+                    ok = reader->readChanged(EC_REGION_ECRAM, view);
+                    data = view.data.left(view.dataSize);
+                } else {
+                    data = reader->readRegion(EC_REGION_ECRAM, &ok);
+                }
+                if (!ok) {
+                    s.failures++;
+                    continue;
+                }
+                s.reads++;
+
+                for (int b = 1; b < data.size(); b++) {
+                    if (data.at(b) != data.at(0)) {
+                        s.torn++;
+                        break;
+                    }
+                }
+            }
+            s.retries = reader->retryCount();
+        });
+    }
+
+    while (ready.load() < readerCount) {
+        QThread::yieldCurrentThread();
+    }
+
+    QByteArray payload(size, '\0');
+    const qint64 intervalNs = rate > 0 ? 1000000000LL / rate : 0;
+    const qint64 startNs = clock.nsecsElapsed();
+    qint64 nextNs = startNs;
+
+    while (clock.nsecsElapsed() - startNs < durationSec * 1000000000LL) {
+        if (intervalNs > 0) {
+            while (clock.nsecsElapsed() < nextNs) {
+                QThread::yieldCurrentThread();
+            }
+            nextNs += intervalNs;
+        }
+
+        payload.fill(static_cast<char>(updates & 0xFF));
+
+        const qint64 start = clock.nsecsElapsed();
+        publishNs.store(start);
+        writer.updateRegion(EC_REGION_ECRAM, payload);
+        writeLatency.record(static_cast<quint64>((clock.nsecsElapsed() - start) / 1000));
+        updates++;
+    }
+
+    stop.store(true);
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    const double seconds = (clock.nsecsElapsed() - startNs) / 1e9;
+    const LatencyHistogram::Snapshot w = writeLatency.snapshot();
+
+    out() << QString("Writer: %1 updates (%2/s), avg %3 us, p50 <= %4 us, p99 <= %5 us, max %6 us\n")
+                 .arg(updates)
+                 .arg(updates / seconds, 0, 'f', 0)
+                 .arg(w.count ? static_cast<double>(w.totalUs) / w.count : 0.0, 0, 'f', 2)
+                 .arg(histogramPercentile(w, 0.50))
+                 .arg(histogramPercentile(w, 0.99))
+                 .arg(w.maxUs);
+
+    if (waitMode) {
+        const LatencyHistogram::Snapshot k = wakeLatency.snapshot();
+        out() << QString("Wakeup: %1 wakes, avg %2 us, p50 <= %3 us, p99 <= %4 us, max %5 us\n")
+                     .arg(k.count)
+                     .arg(k.count ? static_cast<double>(k.totalUs) / k.count : 0.0, 0, 'f', 2)
+                     .arg(histogramPercentile(k, 0.50))
+                     .arg(histogramPercentile(k, 0.99))
+                     .arg(k.maxUs);
+    }
+
+    ReaderStats total;
+    for (int i = 0; i < readerCount; i++) {
+        const ReaderStats& s = stats[i];
+        out() << QString("Reader %1: %2 reads (%3/s), %4 retries, %5 failed, %6 torn\n")
+                     .arg(i).arg(s.reads).arg(s.reads / seconds, 0, 'f', 0)
+                     .arg(s.retries).arg(s.failures).arg(s.torn);
+        total.reads += s.reads;
+        total.failures += s.failures;
+        total.torn += s.torn;
+        total.retries += s.retries;
+    }
+
+    out() << QString("Readers: %1 reads/s total, %2 retries per 1000 reads, %3 failed, %4 torn\n")
+                 .arg(total.reads / seconds, 0, 'f', 0)
+                 .arg(total.reads ? total.retries * 1000.0 / total.reads : 0.0, 0, 'f', 2)
+                 .arg(total.failures)
+                 .arg(total.torn);
+    out().flush();
+
+    for (ECMemoryReader* reader : readers) {
+        delete reader;
+    }
+    writer.close();
+
+    return total.torn == 0 ? 0 : 2;
+}
@@ -0,0 +1,164 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "staticwmiprovider.h"
+#include "wmiengine.h"
+#include "wmiquerycache.h"
+#include "latencyhistogram.h"
+
+// ============================================================================
+// CSWmiBench - WMI query cache behaviour without WMI
+//
+//   CSWmiBench --clients 8 --requests 50 --latency 200 [--workers 2] [--no-cache] [--ttl 1000]
+//
+// N client threads repeat a mix of inventory and battery queries against a
+// StaticWmiProvider that sleeps --latency ms per query, as real WMI does.
+// With --workers the queries go through a WmiEngine with that many workers,
+// as in the service. Reports how many queries reached the provider, the
+// cache's hit / merge counts and the per-request latency clients saw.
+// ============================================================================
+
+namespace {
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+quint64 histogramPercentile(const LatencyHistogram::Snapshot& snap, double p)
+{
+    const QList<quint32>& bounds = LatencyHistogram::boundsUs();
+    const quint64 target = static_cast<quint64>(p * snap.count + 0.5);
+    quint64 seen = 0;
+    for (int i = 0; i < snap.buckets.size(); i++) {
+        seen += snap.buckets.at(i);
+        if (seen >= target) {
+            return i < bounds.size() ? bounds.at(i) : snap.maxUs;
+        }
+    }
+    return snap.maxUs;
+}
+
+WmiRow row(std::initializer_list<std::pair<QString, QVariant>> values)
+{
+    WmiRow r;
+    for (const auto& value : values) {
+        r.insert(value.first, value.second);
+    }
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("CSWmiBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("WMI query cache / single-flight benchmark against a stand-in provider");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"clients", "Client threads.", "n", "8"},
+        {"requests", "Queries per client.", "n", "50"},
+        {"latency", "Provider time per query in ms.", "ms", "200"},
+        {"ttl", "Override the TTL of every class in the mix (ms, -1 = built-in TTLs).", "ms", "-1"},
+        {"workers", "Run queries on a WmiEngine with this many workers (0 = on the client threads).", "n", "0"},
+        {"max-rows", "Engine row limit per query.", "n", QString::number(WMI_MAX_RESULT_ROWS)},
+        {"no-cache", "Query the provider (or engine) directly."},
+    });
+    parser.process(app);
+
+    const int clients = qMax(1, parser.value("clients").toInt());
+    const int requests = qMax(1, parser.value("requests").toInt());
+    const int ttl = parser.value("ttl").toInt();
+    const int workers = parser.value("workers").toInt();
+    const bool noCache = parser.isSet("no-cache");
+
+    const QString cimv2 = QStringLiteral("ROOT\\CIMV2");
+    StaticWmiProvider provider;
+    provider.setLatencyMs(qMax(0, parser.value("latency").toInt()));
+    provider.setRows(cimv2, "Win32_Battery", { row({{"Name", "Internal Battery"}, {"EstimatedChargeRemaining", 87}}) });
+    provider.setRows(cimv2, "Win32_VideoController", {
+        row({{"Name", "Integrated Graphics"}, {"DriverVersion", "31.0.101.5186"}}),
+        row({{"Name", "Discrete Graphics"}, {"DriverVersion", "552.22"}}),
+    });
+    provider.setRows(cimv2, "Win32_Processor", { row({{"Name", "Test CPU"}, {"NumberOfCores", 8}}) });
+
+    const QStringList mix = {
+        "SELECT * FROM Win32_VideoController",
+        "SELECT * FROM Win32_Battery",
+        "SELECT Name, NumberOfCores FROM Win32_Processor",
+    };
+
+    WmiEngine engine(&provider, nullptr, qMax(1, workers));
+    engine.setMaxRows(parser.value("max-rows").toInt());
+    if (workers > 0 && !engine.start()) {
+        out() << "Engine failed to start\n";
+        return 1;
+    }
+    WmiProvider* source = workers > 0 ? static_cast<WmiProvider*>(&engine) : &provider;
+
+    WmiQueryCache cache(source);
+    if (ttl >= 0) {
+        for (const QString& query : mix) {
+            cache.setClassTtl(WmiProvider::queryClass(query), ttl);
+        }
+    }
+
+    LatencyHistogram latency;
+    std::atomic<quint64> failures(0);
+    std::vector<std::thread> threads;
+    QElapsedTimer clock;
+    clock.start();
+
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([&, c]() {
+            for (int i = 0; i < requests; i++) {
+                const QString& query = mix.at((c + i) % mix.size());
+                WmiRows rows;
+                QElapsedTimer timer;
+                timer.start();
+                const bool ok = noCache ? source->query(cimv2, query, rows) : cache.query(cimv2, query, rows);
+                latency.record(static_cast<quint64>(timer.nsecsElapsed() / 1000));
+                if (!ok || rows.isEmpty()) {
+                    failures.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    const double seconds = clock.nsecsElapsed() / 1e9;
+    const quint64 total = static_cast<quint64>(clients) * requests;
+    const LatencyHistogram::Snapshot snap = latency.snapshot();
+
+    out() << QString("%1 requests in %2 s, %3 reached the provider, %4 failed\n")
+                 .arg(total).arg(seconds, 0, 'f', 2).arg(provider.callCount()).arg(failures.load());
+    if (!noCache) {
+        const WmiCacheStats stats = cache.stats();
+        out() << QString("Cache: %1 hits, %2 misses, %3 joined a running query, %4 entries\n")
+                     .arg(stats.hits).arg(stats.misses).arg(stats.joined).arg(stats.entries);
+    }
+    if (workers > 0) {
+        const WmiEngineStats stats = engine.stats();
+        out() << QString("Engine: %1 workers, peak %2 queued, %3 rejected, %4 timed out, %5 truncated\n")
+                     .arg(stats.workers).arg(stats.peakQueued).arg(stats.rejected)
+                     .arg(stats.timedOut).arg(stats.truncated);
+    }
+    out() << QString("Latency: avg %1 us, p50 <= %2 us, p99 <= %3 us, max %4 us\n")
+                 .arg(snap.count ? static_cast<double>(snap.totalUs) / snap.count : 0.0, 0, 'f', 0)
+                 .arg(histogramPercentile(snap, 0.50))
+                 .arg(histogramPercentile(snap, 0.99))
+                 .arg(snap.maxUs);
+    out().flush();
+
+    return failures.load() ? 1 : 0;
+}